@@ -14,6 +14,10 @@ const char* password = "YOUR_WIFI_PASSWORD"; // Замените на парол
 const char* ap_ssid = "ESP32_ChargingStations";
 const char* ap_password = "12345678";
 
+// Имя платы в mDNS: chargestation-XXXXXX (последние байты MAC). У каждой
+// платы свое имя, иначе объявления нескольких плат сливаются в одно
+char mdnsHost[32];
+
 // Веб-сервер и WebSocket
 AsyncWebServer server(80);
 AsyncWebSocket ws("/ws");
@@ -519,8 +523,27 @@ void setup() {
   Serial.println("✓ Настройка времени завершена");
 
   // Настройка mDNS для удобного доступа
-  if (MDNS.begin("chargingstations")) {
-    Serial.println("✓ mDNS запущен: http://chargingstations.local");
+  uint64_t mac = ESP.getEfuseMac();
+  snprintf(mdnsHost, sizeof(mdnsHost), "chargestation-%02x%02x%02x",
+           (uint8_t)(mac >> 24), (uint8_t)(mac >> 32), (uint8_t)(mac >> 40));
+  char macId[13];
+  snprintf(macId, sizeof(macId), "%02x%02x%02x%02x%02x%02x",
+           (uint8_t)mac, (uint8_t)(mac >> 8), (uint8_t)(mac >> 16),
+           (uint8_t)(mac >> 24), (uint8_t)(mac >> 32), (uint8_t)(mac >> 40));
+  if (MDNS.begin(mdnsHost)) {
+    Serial.printf("✓ mDNS запущен: http://%s.local\n", mdnsHost);
+
+    // Служба DNS-SD для обнаружения платы сервером (_chargestation._tcp):
+    // экземпляр службы назван по плате, id - полный MAC
+    MDNS.setInstanceName(mdnsHost);
+    MDNS.addService("chargestation", "tcp", 80);
+    MDNS.addServiceTxt("chargestation", "tcp", "id", macId);
+    if (stationCount > 0) {
+      MDNS.addServiceTxt("chargestation", "tcp", "type", stations[0].type);
+      MDNS.addServiceTxt("chargestation", "tcp", "name", stations[0].displayName);
+      MDNS.addServiceTxt("chargestation", "tcp", "technicalName", stations[0].technicalName);
+      MDNS.addServiceTxt("chargestation", "tcp", "maxPower", String(stations[0].maxPower, 1));
+    }
   }
 
   // Настройка WebSocket
@@ -597,7 +620,7 @@ fetch('/api/stations')
   if (WiFi.status() == WL_CONNECTED) {
     Serial.printf("   WiFi сеть: %s\n", ssid);
     Serial.printf("   IP адрес: http://%s\n", WiFi.localIP().toString().c_str());
-    Serial.printf("   mDNS: http://chargingstations.local\n");
+    Serial.printf("   mDNS: http://%s.local\n", mdnsHost);
     Serial.printf("   API: http://%s/api/stations\n", WiFi.localIP().toString().c_str());
   } else {
     Serial.printf("   WiFi сеть: ESP32_ChargingStations\n");
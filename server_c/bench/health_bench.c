@@ -0,0 +1,227 @@
+/**
+ * Бенчмарк автомата связи с ESP32 платами (esp32_health)
+ * Поднимает на loopback поддельные платы 127.0.1.x:порт (GET /api/station) и
+ * гоняет циклы синхронизации: esp32_get_data к каждой плате по очереди.
+ * После первого цикла часть плат зависает (принимает соединение и молчит):
+ * первые циклы ждут таймаутов, после ESP32_HEALTH_FAILURES ошибок автомат
+ * открывается и циклы снова быстрые. Затем платы оживают, и по окончании
+ * паузы автомата пробный запрос возвращает их в online.
+ * Запросы идут по адресам "ip:порт", права root не нужны
+ *
+ * Использование:
+ *   ./bench/health_bench [-b плат] [-s зависших] [-c циклов] [-p порт]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "esp32_client.h"
+#include "esp32_health.h"
+
+#define SUBNET 0x7F000100u  // 127.0.1.0
+#define MIN_TIMEOUT_MS 250
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+typedef struct {
+    int fd;
+    int host;
+    int hung;                 // меняется во время бенчмарка
+} fake_board_t;
+
+typedef struct {
+    fake_board_t *board;
+    int client;
+} fake_connection_t;
+
+/**
+ * Соединение: зависшая плата читает запрос и молчит, пока клиент не закроет
+ */
+static void* fake_connection(void *arg) {
+    fake_connection_t *connection = arg;
+    char request[2048], body[128], reply[256];
+
+    ssize_t length = read(connection->client, request, sizeof(request) - 1);
+    if (length > 0 && !__atomic_load_n(&connection->board->hung, __ATOMIC_RELAXED)) {
+        snprintf(body, sizeof(body), "{\"id\":%d,\"status\":\"available\",\"currentPower\":0.0}",
+                 connection->board->host);
+        int reply_length = snprintf(reply, sizeof(reply),
+                                    "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                                    "Content-Length: %zu\r\nConnection: close\r\n\r\n%s",
+                                    strlen(body), body);
+        if (write(connection->client, reply, reply_length) != reply_length) {
+            perror("write");
+        }
+    } else {
+        while (read(connection->client, request, sizeof(request)) > 0) {
+        }
+    }
+    close(connection->client);
+    free(connection);
+    return NULL;
+}
+
+static void* fake_board(void *arg) {
+    fake_board_t *board = arg;
+    for (;;) {
+        int client = accept(board->fd, NULL, NULL);
+        if (client < 0) continue;
+
+        fake_connection_t *connection = malloc(sizeof(fake_connection_t));
+        connection->board = board;
+        connection->client = client;
+        pthread_t thread;
+        pthread_create(&thread, NULL, fake_connection, connection);
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+static int start_board(fake_board_t *board, int port) {
+    board->fd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(board->fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(SUBNET | (uint32_t)board->host);
+    if (bind(board->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(board->fd, 64) != 0) {
+        perror("Ошибка запуска поддельной платы");
+        return -1;
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, fake_board, board);
+    pthread_detach(thread);
+    return 0;
+}
+
+/**
+ * Цикл синхронизации: запрос к каждой плате по очереди
+ */
+static double sync_cycle(int count, int port, int *failures) {
+    double start = now_ms();
+    *failures = 0;
+    for (int i = 0; i < count; i++) {
+        char ip[ESP32_MAX_IP];
+        snprintf(ip, sizeof(ip), "127.0.1.%u:%d", (unsigned char)(i + 1), port);
+
+        char *data = NULL;
+        if (esp32_get_data(ip, &data) != 0) {
+            (*failures)++;
+        }
+        free(data);
+    }
+    return now_ms() - start;
+}
+
+int main(int argc, char *argv[]) {
+    int board_count = 20;
+    int hung_count = 3;
+    int cycles = 8;
+    int port = 18091;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:s:c:p:")) != -1) {
+        switch (opt) {
+            case 'b': board_count = atoi(optarg); break;
+            case 's': hung_count = atoi(optarg); break;
+            case 'c': cycles = atoi(optarg); break;
+            case 'p': port = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Использование: %s [-b boards] [-s hung] [-c cycles] [-p port]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (board_count < 1 || board_count > 254 || hung_count < 0 || hung_count > board_count ||
+        cycles < ESP32_HEALTH_FAILURES + 3 || port < 1 || port > 65535) {
+        fprintf(stderr, "Плат от 1 до 254, зависших не больше плат, циклов не меньше %d, порт от 1 до 65535\n",
+                ESP32_HEALTH_FAILURES + 3);
+        return EXIT_FAILURE;
+    }
+
+    fake_board_t *boards = calloc(board_count, sizeof(fake_board_t));
+    for (int i = 0; i < board_count; i++) {
+        boards[i].host = i + 1;
+        if (start_board(&boards[i], port) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    esp32_health_options_t options;
+    esp32_health_default_options(&options);
+    options.min_timeout_ms = MIN_TIMEOUT_MS;
+    esp32_health_set_options(&options);
+
+    // Последние циклы: зависшие платы оживают, перед ними - пауза автомата
+    double times[64];
+    int failures[64];
+    if (cycles > 64) cycles = 64;
+    int recover_cycle = cycles - 1;
+    double recover_wait_ms = 0;
+
+    for (int cycle = 1; cycle <= cycles; cycle++) {
+        if (cycle == 2 || cycle == recover_cycle) {
+            for (int i = 0; i < hung_count; i++) {
+                __atomic_store_n(&boards[board_count - 1 - i].hung, cycle == 2, __ATOMIC_RELAXED);
+            }
+        }
+        if (cycle == recover_cycle) {
+            // Ждем конца паузы автоматов зависших плат
+            double wait_start = now_ms();
+            for (int i = 0; i < hung_count; i++) {
+                char ip[ESP32_MAX_IP];
+                snprintf(ip, sizeof(ip), "127.0.1.%u", (unsigned char)boards[board_count - 1 - i].host);
+                esp32_health_t health;
+                while (esp32_health_get(ip, &health) == 0 && health.state == ESP32_BREAKER_OPEN) {
+                    usleep(50000);
+                }
+            }
+            recover_wait_ms = now_ms() - wait_start;
+        }
+        times[cycle - 1] = sync_cycle(board_count, port, &failures[cycle - 1]);
+    }
+
+    int online = 0;
+    long short_circuits = 0;
+    for (int i = 0; i < board_count; i++) {
+        esp32_board_info_t info = {0};
+        snprintf(info.ip, sizeof(info.ip), "127.0.1.%u", (unsigned char)(i + 1));
+        esp32_apply_health(&info);
+        if (strcmp(info.status, "online") == 0) online++;
+
+        esp32_health_t health;
+        if (esp32_health_get(info.ip, &health) == 0) short_circuits += health.short_circuits;
+    }
+
+    printf("\nПлат: %d, зависают со 2-го цикла: %d, оживают в цикле %d (после паузы %.0f мс)\n",
+           board_count, hung_count, recover_cycle, recover_wait_ms);
+    for (int cycle = 1; cycle <= cycles; cycle++) {
+        printf("  цикл %d: %8.1f мс  ошибок и пропусков: %d\n", cycle, times[cycle - 1], failures[cycle - 1]);
+    }
+    printf("  без esp32_health каждый такой цикл ждал бы %d с (таймаут 10 с на зависшую плату)\n", hung_count * 10);
+    printf("  пропущено запросов к открытым автоматам: %ld  online в конце: %d/%d\n",
+           short_circuits, online, board_count);
+
+    // После открытия автомата циклы не ждут зависших плат
+    int ok = online == board_count && (hung_count == 0 || short_circuits > 0);
+    for (int cycle = ESP32_HEALTH_FAILURES + 2; cycle < recover_cycle; cycle++) {
+        if (times[cycle - 1] > MIN_TIMEOUT_MS / 2) ok = 0;
+    }
+    free(boards);
+    curl_global_cleanup();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,330 @@
+/**
+ * Нагрузочный тест HTTP сервера зарядных станций
+ * Имитирует дашборды, опрашивающие GET /api/stations, и выводит
+ * пропускную способность (запросов/с) и перцентили задержки
+ *
+ * Использование:
+ *   ./bench/http_bench [-h host] [-p port] [-c соединений] [-n запросов] [-u путь] [-k] [-w процент]
+ *
+ * -k - переиспользовать соединения (HTTP/1.1 keep-alive)
+ * -w - доля запросов PATCH показаний станции (ждут записи журнала изменений);
+ *      станция создается перед замером и удаляется после, задержки чтения
+ *      и записи выводятся отдельно
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/**
+ * Параметры нагрузки
+ */
+typedef struct {
+    const char *host;
+    int port;
+    int concurrency;
+    int total_requests;
+    const char *path;
+    int keep_alive;
+    int write_percent;
+    int station_id;     // Станция для PATCH при write_percent > 0
+} bench_config_t;
+
+/**
+ * Состояние одного клиентского потока
+ */
+typedef struct {
+    const bench_config_t *config;
+    int requests;
+    double *latencies_ms;
+    char *is_write;     // Запрос с тем же номером в latencies_ms - запись
+    int completed;
+    int errors;
+} bench_worker_t;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/**
+ * Поиск значения Content-Length в заголовках ответа
+ */
+static long parse_content_length(const char *headers) {
+    const char *p = strcasestr(headers, "Content-Length:");
+    return p ? strtol(p + 15, NULL, 10) : -1;
+}
+
+/**
+ * Установка TCP соединения с сервером
+ */
+static int open_connection(const struct sockaddr_in *addr) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(fd, (const struct sockaddr*)addr, sizeof(*addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Один запрос по соединению *fd (открывается при необходимости): GET пути
+ * из config, а при write - PATCH станции config->station_id.
+ * Без keep-alive соединение закрывается после ответа. Ответ со статусом 2xx
+ * копируется в reply (если передан). Возвращает 0 при успехе
+ */
+static int do_request(const bench_config_t *config, const struct sockaddr_in *addr, int *fd_ptr,
+                      const char *method, const char *path, const char *body,
+                      char *reply, size_t reply_size) {
+    if (*fd_ptr < 0) {
+        *fd_ptr = open_connection(addr);
+        if (*fd_ptr < 0) {
+            return -1;
+        }
+    }
+    int fd = *fd_ptr;
+
+    char request[512];
+    int request_len = snprintf(request, sizeof(request),
+        "%s %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n",
+        method, path, config->host, config->keep_alive ? "keep-alive" : "close");
+    if (body[0]) {
+        request_len += snprintf(request + request_len, sizeof(request) - request_len,
+            "Content-Type: application/json\r\nContent-Length: %zu\r\n", strlen(body));
+    }
+    request_len += snprintf(request + request_len, sizeof(request) - request_len, "\r\n%s", body);
+    if (send(fd, request, request_len, MSG_NOSIGNAL) != request_len) {
+        close(fd);
+        *fd_ptr = -1;
+        return -1;
+    }
+
+    // Читаем ответ целиком: заголовки + Content-Length байт тела
+    char buffer[65536];
+    size_t received = 0;
+    long expected = -1;
+    for (;;) {
+        ssize_t n = recv(fd, buffer + received, sizeof(buffer) - 1 - received, 0);
+        if (n <= 0) break;
+        received += n;
+        buffer[received] = '\0';
+
+        char *headers_end = strstr(buffer, "\r\n\r\n");
+        if (headers_end && expected < 0) {
+            long content_length = parse_content_length(buffer);
+            expected = (headers_end - buffer) + 4 + (content_length > 0 ? content_length : 0);
+        }
+        if (expected >= 0 && (long)received >= expected) break;
+        if (received >= sizeof(buffer) - 1) break;
+    }
+
+    int complete = expected >= 0 && (long)received >= expected;
+    int server_closes = strcasestr(buffer, "Connection: close") != NULL;
+    if (!config->keep_alive || !complete || server_closes) {
+        close(fd);
+        *fd_ptr = -1;
+    }
+
+    if (received <= 10 || strncmp(buffer, "HTTP/1.1 2", 10) != 0) {
+        return -1;
+    }
+    if (reply) {
+        snprintf(reply, reply_size, "%s", buffer);
+    }
+    return 0;
+}
+
+/**
+ * Создание или удаление станции для замера записей (отдельным соединением)
+ */
+static int station_request(const bench_config_t *config, const char *method, const char *path,
+                           const char *body, char *reply, size_t reply_size) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config->port);
+    inet_pton(AF_INET, config->host, &addr.sin_addr);
+    
+    int fd = -1;
+    int result = do_request(config, &addr, &fd, method, path, body, reply, reply_size);
+    if (fd >= 0) {
+        close(fd);
+    }
+    return result;
+}
+
+static void* worker_main(void *arg) {
+    bench_worker_t *worker = arg;
+    const bench_config_t *config = worker->config;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config->port);
+    inet_pton(AF_INET, config->host, &addr.sin_addr);
+
+    char write_path[64];
+    snprintf(write_path, sizeof(write_path), "/api/stations/%d", config->station_id);
+    
+    int fd = -1;
+    for (int i = 0; i < worker->requests; i++) {
+        // Записи равномерно перемешаны с чтениями
+        int is_write = (i * config->write_percent) % 100 + config->write_percent >= 100;
+        char body[64] = "";
+        if (is_write) {
+            snprintf(body, sizeof(body), "{\"voltagePhase1\":%d}", 220 + i % 20);
+        }
+        
+        double start = now_ms();
+        if (do_request(config, &addr, &fd, is_write ? "PATCH" : "GET",
+                       is_write ? write_path : config->path, body, NULL, 0) == 0) {
+            worker->is_write[worker->completed] = (char)is_write;
+            worker->latencies_ms[worker->completed++] = now_ms() - start;
+        } else {
+            worker->errors++;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    bench_config_t config = { "127.0.0.1", 5000, 64, 20000, "/api/stations", 0, 0, 0 };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:c:n:u:kw:")) != -1) {
+        switch (opt) {
+            case 'h': config.host = optarg; break;
+            case 'p': config.port = atoi(optarg); break;
+            case 'c': config.concurrency = atoi(optarg); break;
+            case 'n': config.total_requests = atoi(optarg); break;
+            case 'u': config.path = optarg; break;
+            case 'k': config.keep_alive = 1; break;
+            case 'w': config.write_percent = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Использование: %s [-h host] [-p port] [-c conns] [-n requests] [-u path] [-k] [-w percent]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (config.concurrency <= 0 || config.total_requests < config.concurrency ||
+        config.write_percent < 0 || config.write_percent > 100) {
+        fprintf(stderr, "Неверные параметры нагрузки\n");
+        return EXIT_FAILURE;
+    }
+    
+    if (config.write_percent > 0) {
+        char reply[4096];
+        const char *created = "{\"displayName\":\"http_bench\",\"type\":\"slave\",\"status\":\"available\",\"maxPower\":22}";
+        const char *id = NULL;
+        if (station_request(&config, "POST", "/api/stations", created, reply, sizeof(reply)) == 0) {
+            id = strstr(reply, "\"id\":");
+        }
+        if (!id) {
+            fprintf(stderr, "Не удалось создать станцию для записей\n");
+            return EXIT_FAILURE;
+        }
+        config.station_id = atoi(id + 5);
+    }
+
+    bench_worker_t *workers = calloc(config.concurrency, sizeof(bench_worker_t));
+    pthread_t *threads = calloc(config.concurrency, sizeof(pthread_t));
+    double *latencies = calloc(config.total_requests, sizeof(double));
+    char *is_write = calloc(config.total_requests, 1);
+    if (!workers || !threads || !latencies || !is_write) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        return EXIT_FAILURE;
+    }
+
+    int offset = 0;
+    for (int i = 0; i < config.concurrency; i++) {
+        workers[i].config = &config;
+        workers[i].requests = config.total_requests / config.concurrency +
+                              (i < config.total_requests % config.concurrency ? 1 : 0);
+        workers[i].latencies_ms = latencies + offset;
+        workers[i].is_write = is_write + offset;
+        offset += workers[i].requests;
+    }
+
+    double start = now_ms();
+    for (int i = 0; i < config.concurrency; i++) {
+        pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+    }
+    for (int i = 0; i < config.concurrency; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed_ms = now_ms() - start;
+    
+    if (config.write_percent > 0) {
+        char path[64];
+        snprintf(path, sizeof(path), "/api/stations/%d", config.station_id);
+        station_request(&config, "DELETE", path, "", NULL, 0);
+    }
+
+    // Собираем задержки успешных запросов в непрерывный массив, при записях
+    // отдельно - задержки чтений и записей
+    int completed = 0, errors = 0;
+    for (int i = 0; i < config.concurrency; i++) {
+        memmove(latencies + completed, workers[i].latencies_ms, workers[i].completed * sizeof(double));
+        memmove(is_write + completed, workers[i].is_write, workers[i].completed);
+        completed += workers[i].completed;
+        errors += workers[i].errors;
+    }
+    double *reads = malloc((completed + 1) * sizeof(double));
+    double *writes = malloc((completed + 1) * sizeof(double));
+    int read_count = 0, write_count = 0;
+    for (int i = 0; reads && writes && i < completed; i++) {
+        if (is_write[i]) writes[write_count++] = latencies[i];
+        else reads[read_count++] = latencies[i];
+    }
+    qsort(latencies, completed, sizeof(double), compare_double);
+
+    printf("Цель:        http://%s:%d%s\n", config.host, config.port, config.path);
+    printf("Соединений:  %d%s\n", config.concurrency, config.keep_alive ? " (keep-alive)" : "");
+    printf("Запросов:    %d (ошибок: %d)\n", completed, errors);
+    printf("Время:       %.1f мс\n", elapsed_ms);
+    if (completed > 0) {
+        printf("Запросов/с:  %.0f\n", completed * 1000.0 / elapsed_ms);
+        printf("p50:         %.2f мс\n", latencies[(int)(completed * 0.50)]);
+        printf("p99:         %.2f мс\n", latencies[(int)(completed * 0.99)]);
+        printf("max:         %.2f мс\n", latencies[completed - 1]);
+    }
+    if (config.write_percent > 0 && read_count > 0 && write_count > 0) {
+        qsort(reads, read_count, sizeof(double), compare_double);
+        qsort(writes, write_count, sizeof(double), compare_double);
+        printf("Чтения:      %d, p50 %.2f мс, p99 %.2f мс\n", read_count,
+               reads[(int)(read_count * 0.50)], reads[(int)(read_count * 0.99)]);
+        printf("Записи:      %d, p50 %.2f мс, p99 %.2f мс\n", write_count,
+               writes[(int)(write_count * 0.50)], writes[(int)(write_count * 0.99)]);
+    }
+
+    free(reads);
+    free(writes);
+    free(is_write);
+    free(latencies);
+    free(threads);
+    free(workers);
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,190 @@
+/**
+ * Бенчмарк сериализации JSON
+ * Строит массив станций с теми же полями, что отдает GET /api/stations,
+ * и сравнивает json_stringify дерева json_value_t с прямой записью
+ * структур через station_codec для разного числа станций. Множитель
+ * в строке codec - отношение к сборке дерева вместе с json_stringify
+ *
+ * Использование:
+ *   ./bench/json_bench [-n станций] [-i итераций]
+ *
+ * Без -n выполняется серия 1000 / 10000 / 100000 для проверки линейности
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "simple_json.h"
+#include "station_codec.h"
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/**
+ * Объект станции с полным набором полей ответа API
+ */
+static json_value_t* make_station(int id) {
+    char name[64];
+    json_value_t *station = json_create_object();
+
+    json_object_set(station, "id", json_create_number(id));
+    snprintf(name, sizeof(name), "Станция %d", id);
+    json_object_set(station, "displayName", json_create_string(name));
+    snprintf(name, sizeof(name), "ESP32-%05d", id);
+    json_object_set(station, "technicalName", json_create_string(name));
+    json_object_set(station, "type", json_create_string(id % 10 == 0 ? "master" : "slave"));
+    json_object_set(station, "status", json_create_string("available"));
+    json_object_set(station, "maxPower", json_create_number(22.0));
+    json_object_set(station, "currentPower", json_create_number(id % 23));
+    snprintf(name, sizeof(name), "192.168.%d.%d", (id / 250) % 256, id % 250 + 1);
+    json_object_set(station, "ipAddress", json_create_string(name));
+
+    json_object_set(station, "carConnection", json_create_bool(id % 2));
+    json_object_set(station, "carChargingPermission", json_create_bool(id % 3 == 0));
+    json_object_set(station, "carError", json_create_bool(0));
+    json_object_set(station, "masterOnline", json_create_bool(1));
+    json_object_set(station, "masterChargingPermission", json_create_bool(1));
+    json_object_set(station, "masterAvailablePower", json_create_number(150.0));
+
+    json_object_set(station, "voltagePhase1", json_create_number(230.1));
+    json_object_set(station, "voltagePhase2", json_create_number(229.8));
+    json_object_set(station, "voltagePhase3", json_create_number(231.4));
+    json_object_set(station, "currentPhase1", json_create_number(16.0));
+    json_object_set(station, "currentPhase2", json_create_number(15.7));
+    json_object_set(station, "currentPhase3", json_create_number(16.2));
+    json_object_set(station, "chargerPower", json_create_number(11.0));
+
+    json_object_set(station, "singlePhaseConnection", json_create_bool(0));
+    json_object_set(station, "powerOverconsumption", json_create_bool(0));
+    json_object_set(station, "fixedPower", json_create_bool(0));
+    return station;
+}
+
+/**
+ * Та же станция в виде структуры для station_codec
+ */
+static void fill_station(charging_station_t *station, int id) {
+    memset(station, 0, sizeof(*station));
+    station->id = id;
+    snprintf(station->display_name, sizeof(station->display_name), "Станция %d", id);
+    snprintf(station->technical_name, sizeof(station->technical_name), "ESP32-%05d", id);
+    strcpy(station->type, id % 10 == 0 ? "master" : "slave");
+    strcpy(station->status, "available");
+    station->max_power = 22.0f;
+    station->current_power = id % 23;
+    snprintf(station->ip_address, sizeof(station->ip_address), "192.168.%d.%d", (id / 250) % 256, id % 250 + 1);
+
+    station->car_connection = id % 2;
+    station->car_charging_permission = id % 3 == 0;
+    station->master_online = 1;
+    station->master_charging_permission = 1;
+    station->master_available_power = 150.0f;
+
+    station->voltage_phase1 = 230.1f;
+    station->voltage_phase2 = 229.8f;
+    station->voltage_phase3 = 231.4f;
+    station->current_phase1 = 16.0f;
+    station->current_phase2 = 15.7f;
+    station->current_phase3 = 16.2f;
+    station->charger_power = 11.0f;
+}
+
+/**
+ * Замер сериализации массива из count станций. Первый вызов - "холодный"
+ * (буфер растет удвоением), последующие используют размер предыдущего
+ * ответа и укладываются в одно выделение памяти
+ */
+static void run(int count, int iterations) {
+    // Сборка дерева входит в цену ответа при сериализации через json_value_t
+    double start = now_ms();
+    json_value_t *array = json_create_array();
+    for (int i = 1; i <= count; i++) {
+        json_array_add(array, make_station(i));
+    }
+    double build_ms = now_ms() - start;
+
+    size_t length = 0;
+    start = now_ms();
+    char *json = json_stringify_len(array, &length);
+    double cold_ms = now_ms() - start;
+    free(json);
+
+    start = now_ms();
+    for (int i = 0; i < iterations; i++) {
+        json = json_stringify_len(array, &length);
+        free(json);
+    }
+    double warm_ms = (now_ms() - start) / iterations;
+
+    printf("%7d станций  %9zu байт  дерево   первый: %8.2f мс  далее: %8.2f мс  %6.1f нс/станция  %7.1f МБ/с  сборка: %.2f мс\n",
+           count, length, cold_ms, warm_ms, warm_ms * 1000000.0 / count,
+           length / (warm_ms / 1000.0) / (1024.0 * 1024.0), build_ms);
+
+    json_free(array);
+    free(array);
+
+    // Прямая запись структур, буфер заранее по размеру предыдущего ответа
+    charging_station_t *stations = malloc(sizeof(charging_station_t) * count);
+    for (int i = 0; i < count; i++) {
+        fill_station(&stations[i], i + 1);
+    }
+
+    json_buf_t buf;
+    start = now_ms();
+    json_buf_init(&buf, 0);
+    stations_write_json(&buf, stations, count);
+    json = json_buf_detach(&buf, &length);
+    cold_ms = now_ms() - start;
+    free(json);
+
+    size_t hint = length;
+    start = now_ms();
+    for (int i = 0; i < iterations; i++) {
+        json_buf_init(&buf, hint + 64);
+        stations_write_json(&buf, stations, count);
+        json = json_buf_detach(&buf, &length);
+        free(json);
+    }
+    double codec_ms = (now_ms() - start) / iterations;
+
+    printf("%7d станций  %9zu байт  codec    первый: %8.2f мс  далее: %8.2f мс  %6.1f нс/станция  %7.1f МБ/с  (x%.1f)\n",
+           count, length, cold_ms, codec_ms, codec_ms * 1000000.0 / count,
+           length / (codec_ms / 1000.0) / (1024.0 * 1024.0), (build_ms + warm_ms) / codec_ms);
+
+    free(stations);
+}
+
+int main(int argc, char *argv[]) {
+    int count = 0;
+    int iterations = 20;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:i:")) != -1) {
+        switch (opt) {
+            case 'n': count = atoi(optarg); break;
+            case 'i': iterations = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Использование: %s [-n stations] [-i iterations]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (iterations <= 0) {
+        fprintf(stderr, "Неверное число итераций\n");
+        return EXIT_FAILURE;
+    }
+
+    if (count > 0) {
+        run(count, iterations);
+    } else {
+        run(1000, iterations);
+        run(10000, iterations);
+        run(100000, iterations > 5 ? 5 : iterations);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,166 @@
+/**
+ * Бенчмарк загрузки файла станций при запуске
+ * Создает во временном каталоге stations.json из N станций и замеряет
+ * storage_init: чтение файла, разбор прямо в массив слотов, индекс и
+ * открытие журнала - все, что происходит до приема соединений.
+ * С -b рядом записывается бинарный снимок, и storage_init загружает его
+ *
+ * storage_init выполняется один раз за процесс, поэтому один запуск - один размер
+ *
+ * Использование:
+ *   ./bench/load_bench [-n станций] [-b]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+
+#include "storage.h"
+#include "station_codec.h"
+#include "station_binary.h"
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void fill_station(charging_station_t *station, int id) {
+    memset(station, 0, sizeof(*station));
+    station->id = id;
+    snprintf(station->display_name, sizeof(station->display_name), "Станция %d", id);
+    snprintf(station->technical_name, sizeof(station->technical_name), "ESP32-%05d", id);
+    strcpy(station->type, id % 10 == 0 ? "master" : "slave");
+    strcpy(station->status, "available");
+    snprintf(station->ip_address, sizeof(station->ip_address), "10.%d.%d.%d", (id >> 16) & 255, (id >> 8) & 255, id & 255);
+    station->max_power = 22.0f;
+    station->current_power = id % 23;
+    station->car_connection = id % 2;
+    station->master_online = 1;
+    station->master_available_power = 150.0f;
+    station->voltage_phase1 = 230.1f;
+    station->voltage_phase2 = 229.8f;
+    station->voltage_phase3 = 231.4f;
+    station->current_phase1 = 16.0f;
+    station->charger_power = 11.0f;
+}
+
+static void write_file(const char *path, const void *header, size_t header_length,
+                       const void *data, size_t length) {
+    FILE *file = fopen(path, "w");
+    if (!file || fwrite(header, 1, header_length, file) != header_length ||
+        fwrite(data, 1, length, file) != length) {
+        fprintf(stderr, "Не удалось записать %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    fclose(file);
+}
+
+/**
+ * Файлы станций в форматах, которые пишет уплотнение (бинарный - вторым,
+ * как при уплотнении). Возвращает размер загружаемого файла
+ */
+static size_t write_stations(const char *path, int count, int binary) {
+    charging_station_t *stations = calloc(count, sizeof(charging_station_t));
+    if (!stations) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < count; i++) {
+        fill_station(&stations[i], i + 1);
+    }
+
+    json_buf_t buf;
+    json_buf_init(&buf, (size_t)count * 600 + 64);
+    stations_write_json(&buf, stations, count);
+    size_t length;
+    char *json = json_buf_detach(&buf, &length);
+    if (!json) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        exit(EXIT_FAILURE);
+    }
+    write_file(path, "", 0, json, length);
+    free(json);
+
+    if (binary) {
+        char binary_path[300];
+        station_binary_header_t header;
+        snprintf(binary_path, sizeof(binary_path), "%s.bin", path);
+        station_binary_header(&header, stations, count, 1);
+        length = (size_t)count * sizeof(charging_station_t);
+        write_file(binary_path, &header, sizeof(header), stations, length);
+        length += sizeof(header);
+    }
+    free(stations);
+    return length;
+}
+
+static void remove_directory(const char *path) {
+    DIR *dir = opendir(path);
+    if (!dir) return;
+
+    struct dirent *entry;
+    char file[1024];
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        unlink(file);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+int main(int argc, char *argv[]) {
+    int count = 100000;
+    int binary = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b")) != -1) {
+        switch (opt) {
+            case 'n': count = atoi(optarg); break;
+            case 'b': binary = 1; break;
+            default:
+                fprintf(stderr, "Использование: %s [-n stations] [-b]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (count <= 0) {
+        fprintf(stderr, "Число станций должно быть больше 0\n");
+        return EXIT_FAILURE;
+    }
+
+    char dir[] = "/tmp/load_bench.XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    char path[256];
+    snprintf(path, sizeof(path), "%s/stations.json", dir);
+
+    size_t length = write_stations(path, count, binary);
+
+    storage_set_data_file_path(path);
+    double start = now_ms();
+    int result = storage_init();
+    double init_ms = now_ms() - start;
+
+    const stations_snapshot_t *loaded = result == 0 ? storage_acquire_stations() : NULL;
+    int loaded_count = loaded ? loaded->count : 0;
+    storage_release_stations(loaded);
+    if (loaded_count != count) {
+        fprintf(stderr, "Загружено %d станций вместо %d\n", loaded_count, count);
+        remove_directory(dir);
+        return EXIT_FAILURE;
+    }
+    storage_cleanup();
+    remove_directory(dir);
+
+    printf("\n%7d станций, %s файл %.1f МБ\n", count, binary ? "бинарный" : "JSON",
+           length / (1024.0 * 1024.0));
+    printf("  storage_init: %8.1f мс  %6.0f МБ/с  %6.2f мкс на станцию\n",
+           init_ms, length / (1024.0 * 1024.0) / (init_ms / 1000.0), init_ms * 1000.0 / count);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,357 @@
+/**
+ * Бенчмарк обнаружения ESP32 плат через mDNS
+ * Поддельный ответчик на loopback изображает N плат службы
+ * _chargestation._tcp: отвечает на запросы PTR через 20-120 мс (как
+ * требует RFC 6762 для общих записей), объявляет новую плату и прощается
+ * с ней. Замеряется время до появления плат в реестре esp32_mdns, а также
+ * сколько записей платы повторяют на запрос с известными ответами.
+ * Имена - как у прошивки: экземпляр и хост chargestation-XXXXXX по
+ * последним байтам MAC платы, id в TXT - полный MAC
+ *
+ * Использование:
+ *   ./bench/mdns_bench [-b плат] [-p порт]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "esp32_mdns.h"
+
+#define SUBNET 0x7F000100u  // 127.0.1.0
+#define BOARD_TTL 120
+#define MAX_BOARDS 250
+#define BOARD_MAC_PREFIX "246f28"          // OUI Espressif
+#define BOARD_SUFFIX_BASE 0x100000u        // последние байты MAC платы N - BOARD_SUFFIX_BASE + N
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int responder_fd = -1;
+static struct sockaddr_in group;
+static int board_count = 0;
+static pthread_mutex_t responder_lock = PTHREAD_MUTEX_INITIALIZER;
+static long answered_records = 0;   // записей PTR в ответах на запросы
+static long suppressed_records = 0; // записей, подавленных known answers
+
+static int put_name(unsigned char *packet, int offset, const char *name) {
+    while (*name) {
+        const char *dot = strchr(name, '.');
+        int label = dot ? (int)(dot - name) : (int)strlen(name);
+        packet[offset++] = (unsigned char)label;
+        memcpy(packet + offset, name, label);
+        offset += label;
+        name += label + (dot ? 1 : 0);
+    }
+    packet[offset++] = 0;
+    return offset;
+}
+
+static int put_record(unsigned char *packet, int offset, const char *name, int type, int flush, uint32_t ttl) {
+    offset = put_name(packet, offset, name);
+    packet[offset++] = 0;
+    packet[offset++] = (unsigned char)type;
+    packet[offset++] = flush ? 0x80 : 0;
+    packet[offset++] = 1;
+    packet[offset++] = (unsigned char)(ttl >> 24);
+    packet[offset++] = (unsigned char)(ttl >> 16);
+    packet[offset++] = (unsigned char)(ttl >> 8);
+    packet[offset++] = (unsigned char)ttl;
+    return offset + 2;  // место длины данных
+}
+
+static void put_length(unsigned char *packet, int data_offset, int end) {
+    int length = end - data_offset;
+    packet[data_offset - 2] = (unsigned char)(length >> 8);
+    packet[data_offset - 1] = (unsigned char)length;
+}
+
+static int put_txt(unsigned char *packet, int offset, const char *entry) {
+    int length = (int)strlen(entry);
+    packet[offset++] = (unsigned char)length;
+    memcpy(packet + offset, entry, length);
+    return offset + length;
+}
+
+/**
+ * Ответ одной платы: PTR в ответах, SRV, TXT и A - в дополнительных записях
+ */
+static void send_board(int board, uint32_t ttl) {
+    unsigned char packet[1024] = {0};
+    char instance[128], host[64], entry[96];
+    unsigned int suffix = BOARD_SUFFIX_BASE + (unsigned int)board;
+    snprintf(instance, sizeof(instance), "chargestation-%06x.%s", suffix, ESP32_MDNS_SERVICE);
+    snprintf(host, sizeof(host), "chargestation-%06x.local", suffix);
+
+    packet[2] = 0x84;   // ответ, authoritative
+    packet[7] = 1;
+    packet[11] = 3;
+    int offset = 12, data;
+
+    offset = data = put_record(packet, offset, ESP32_MDNS_SERVICE, 12, 0, ttl);
+    offset = put_name(packet, offset, instance);
+    put_length(packet, data, offset);
+
+    offset = data = put_record(packet, offset, instance, 33, 1, ttl);
+    memset(packet + offset, 0, 4);
+    packet[offset + 4] = 0;
+    packet[offset + 5] = 80;
+    offset = put_name(packet, offset + 6, host);
+    put_length(packet, data, offset);
+
+    offset = data = put_record(packet, offset, instance, 16, 1, ttl);
+    snprintf(entry, sizeof(entry), "id=" BOARD_MAC_PREFIX "%06x", suffix);
+    offset = put_txt(packet, offset, entry);
+    offset = put_txt(packet, offset, board % 5 == 0 ? "type=master" : "type=slave");
+    snprintf(entry, sizeof(entry), "name=Плата %d", board);
+    offset = put_txt(packet, offset, entry);
+    snprintf(entry, sizeof(entry), "technicalName=ESP32-%03d", board);
+    offset = put_txt(packet, offset, entry);
+    offset = put_txt(packet, offset, "maxPower=22.0");
+    put_length(packet, data, offset);
+
+    offset = data = put_record(packet, offset, host, 1, 1, ttl);
+    uint32_t address = htonl(SUBNET | (uint32_t)board);
+    memcpy(packet + offset, &address, 4);
+    offset += 4;
+    put_length(packet, data, offset);
+
+    if (sendto(responder_fd, packet, offset, 0, (struct sockaddr *)&group, sizeof(group)) < 0) {
+        perror("sendto");
+    }
+}
+
+static int skip_name(const unsigned char *packet, int length, int offset) {
+    while (offset < length) {
+        if (packet[offset] == 0) return offset + 1;
+        if ((packet[offset] & 0xC0) == 0xC0) return offset + 2;
+        offset += packet[offset] + 1;
+    }
+    return length;
+}
+
+/**
+ * Известные ответы из запроса: платы с TTL больше половины. Возвращает
+ * флаг TC - известные ответы продолжаются в следующем пакете
+ */
+static int read_known(const unsigned char *packet, int length, unsigned char *known) {
+    int questions = packet[4] << 8 | packet[5];
+    int answers = packet[6] << 8 | packet[7];
+    int offset = 12;
+    for (int i = 0; i < questions; i++) {
+        offset = skip_name(packet, length, offset) + 4;
+    }
+    for (int i = 0; i < answers; i++) {
+        offset = skip_name(packet, length, offset);
+        if (offset + 10 > length) break;
+        uint32_t ttl = (uint32_t)packet[offset + 4] << 24 | (uint32_t)packet[offset + 5] << 16 |
+                       (uint32_t)packet[offset + 6] << 8 | packet[offset + 7];
+        int data_length = packet[offset + 8] << 8 | packet[offset + 9];
+        unsigned int suffix = 0;
+        // Метка экземпляра "chargestation-XXXXXX" в начале данных PTR
+        if (data_length > 7 && sscanf((const char *)packet + offset + 11, "chargestation-%6x", &suffix) == 1 &&
+            suffix > BOARD_SUFFIX_BASE && suffix <= BOARD_SUFFIX_BASE + MAX_BOARDS && ttl >= BOARD_TTL / 2) {
+            known[suffix - BOARD_SUFFIX_BASE] = 1;
+        }
+        offset += 10 + data_length;
+    }
+    return packet[2] & 0x02;
+}
+
+static int compare_delays(const void *a, const void *b) {
+    return ((const int *)a)[1] - ((const int *)b)[1];
+}
+
+/**
+ * Поддельные платы: на запрос PTR службы отвечают все, кроме
+ * перечисленных в known answers с TTL больше половины. Каждая плата
+ * выбирает свою задержку 20-120 мс, как настоящие ответчики
+ */
+static void* responder(void *arg) {
+    (void)arg;
+    unsigned char packet[9000];
+    int order[MAX_BOARDS][2];
+    for (;;) {
+        ssize_t length = recv(responder_fd, packet, sizeof(packet), 0);
+        // Только запросы с вопросом; продолжения known answers читаются ниже
+        if (length < 12 || (packet[2] & 0x80) || (packet[4] << 8 | packet[5]) == 0) continue;
+
+        unsigned char known[MAX_BOARDS + 1] = {0};
+        int truncated = read_known(packet, (int)length, known);
+        while (truncated) {
+            length = recv(responder_fd, packet, sizeof(packet), 0);  // до таймаута сокета
+            if (length < 0) break;
+            if (length < 12 || (packet[2] & 0x80)) continue;
+            truncated = read_known(packet, (int)length, known);
+        }
+
+        pthread_mutex_lock(&responder_lock);
+        int count = board_count;
+        pthread_mutex_unlock(&responder_lock);
+        for (int i = 0; i < count; i++) {
+            order[i][0] = i + 1;
+            order[i][1] = 20 + rand() % 100;
+        }
+        qsort(order, count, sizeof(order[0]), compare_delays);
+
+        double start = now_ms();
+        for (int i = 0; i < count; i++) {
+            int board = order[i][0];
+            double wait = start + order[i][1] - now_ms();
+            if (wait > 0) usleep((useconds_t)(wait * 1000));
+
+            pthread_mutex_lock(&responder_lock);
+            if (known[board]) {
+                suppressed_records++;
+            } else if (board <= board_count) {
+                send_board(board, BOARD_TTL);
+                answered_records++;
+            }
+            pthread_mutex_unlock(&responder_lock);
+        }
+    }
+    return NULL;
+}
+
+static int start_responder(int port) {
+    responder_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int reuse = 1;
+    setsockopt(responder_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    setsockopt(responder_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+    // Продолжение known answers ждется до 500 мс (RFC 6762, 7.2)
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = 500000 };
+    setsockopt(responder_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    group.sin_family = AF_INET;
+    group.sin_port = htons((uint16_t)port);
+    inet_pton(AF_INET, ESP32_MDNS_GROUP, &group.sin_addr);
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = group.sin_port;
+    struct ip_mreq request = { .imr_multiaddr = group.sin_addr };
+    inet_pton(AF_INET, "127.0.0.1", &request.imr_interface);
+    if (bind(responder_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        setsockopt(responder_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) != 0 ||
+        setsockopt(responder_fd, IPPROTO_IP, IP_MULTICAST_IF, &request.imr_interface, sizeof(request.imr_interface)) != 0) {
+        perror("Ошибка запуска поддельного ответчика");
+        return -1;
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, responder, NULL);
+    pthread_detach(thread);
+    return 0;
+}
+
+static int registry_count(void) {
+    esp32_board_info_t *boards;
+    int count = 0;
+    if (esp32_mdns_boards(&boards, &count) != 0) return -1;
+    free(boards);
+    return count;
+}
+
+/**
+ * Ожидание, пока в реестре не станет expected плат. Возвращает время в мс
+ * или -1 по таймауту
+ */
+static double wait_count(int expected, double start) {
+    while (now_ms() - start < 5000) {
+        if (registry_count() == expected) return now_ms() - start;
+        usleep(500);
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    int boards = 50;
+    int port = 15353;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:p:")) != -1) {
+        switch (opt) {
+            case 'b': boards = atoi(optarg); break;
+            case 'p': port = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Использование: %s [-b boards] [-p port]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (boards <= 0 || boards >= MAX_BOARDS) {
+        fprintf(stderr, "Плат - от 1 до %d\n", MAX_BOARDS - 1);
+        return EXIT_FAILURE;
+    }
+
+    board_count = boards;
+    if (start_responder(port) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    esp32_mdns_options_t options;
+    esp32_mdns_default_options(&options);
+    options.interface = "127.0.0.1";
+    options.port = port;
+
+    // Запуск: первый запрос сразу, платы отвечают через 20-120 мс
+    double start = now_ms();
+    if (esp32_mdns_start(&options) != 0) {
+        return EXIT_FAILURE;
+    }
+    int first = esp32_mdns_wait(5000);
+    double first_ms = now_ms() - start;
+    double all_ms = wait_count(boards, start);
+    printf("Плат: %d  первая в реестре: %.1f мс  все: %.1f мс\n", boards, first > 0 ? first_ms : -1, all_ms);
+
+    // Новая плата объявляет себя сама, без запроса
+    start = now_ms();
+    pthread_mutex_lock(&responder_lock);
+    board_count = boards + 1;
+    send_board(boards + 1, BOARD_TTL);
+    pthread_mutex_unlock(&responder_lock);
+    double announce_ms = wait_count(boards + 1, start);
+
+    // Прощание (TTL 0) убирает плату сразу
+    start = now_ms();
+    pthread_mutex_lock(&responder_lock);
+    board_count = boards;
+    send_board(boards + 1, 0);
+    pthread_mutex_unlock(&responder_lock);
+    double goodbye_ms = wait_count(boards, start);
+    printf("Объявление новой платы: %.2f мс  прощание: %.2f мс\n", announce_ms, goodbye_ms);
+
+    // Повторный запрос: известные платы в known answers, отвечать некому
+    pthread_mutex_lock(&responder_lock);
+    long answered_before = answered_records;
+    pthread_mutex_unlock(&responder_lock);
+    esp32_mdns_query();
+    usleep(300 * 1000);
+    pthread_mutex_lock(&responder_lock);
+    long repeated = answered_records - answered_before;
+    long suppressed = suppressed_records;
+    pthread_mutex_unlock(&responder_lock);
+    printf("Повторный запрос: ответили плат: %ld  подавлено known answers: %ld  запросов отправлено: %ld\n",
+           repeated, suppressed, esp32_mdns_query_count());
+
+    int ok = all_ms >= 0 && announce_ms >= 0 && goodbye_ms >= 0 && repeated == 0;
+    esp32_board_info_t *found = NULL;
+    int found_count = 0;
+    if (esp32_mdns_boards(&found, &found_count) == 0 && found_count > 0) {
+        printf("Первая плата: %s %s (%s) %s %.1f кВт\n", found[0].id, found[0].ip, found[0].type,
+               found[0].technical_name, found[0].max_power);
+        ok = ok && strcmp(found[0].ip, "127.0.1.1") == 0 && strcmp(found[0].id, BOARD_MAC_PREFIX "100001") == 0;
+    }
+    free(found);
+    esp32_mdns_stop();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,265 @@
+/**
+ * Бенчмарк опроса ESP32 плат
+ * Создает хранилище из станций с адресами 127.0.1.x и поднимает на loopback
+ * поддельные платы с постоянными соединениями (HTTP/1.1 keep-alive), часть
+ * заряжает, часть простаивает, у части адресов платы нет совсем. За T
+ * секунд опроса считаются запросы к платам каждого вида, новые соединения
+ * и пакеты записи в хранилище; в конце проверяются статусы станций
+ *
+ * Использование:
+ *   ./bench/poller_bench [-c заряжающих] [-i простаивающих] [-d недоступных] [-t секунд] [-p порт]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "storage.h"
+#include "station_codec.h"
+#include "esp32_poller.h"
+
+#define SUBNET 0x7F000100u  // 127.0.1.0
+
+typedef struct {
+    int fd;
+    int host;
+    int charging;
+    long requests;
+    long connections;
+} fake_board_t;
+
+typedef struct {
+    fake_board_t *board;
+    int client;
+} fake_connection_t;
+
+/**
+ * Соединение с поддельной платой: ответы на запросы, пока клиент не закроет
+ */
+static void* fake_connection(void *arg) {
+    fake_connection_t *connection = arg;
+    fake_board_t *board = connection->board;
+    char request[2048], body[256], reply[512];
+
+    for (;;) {
+        ssize_t length = read(connection->client, request, sizeof(request) - 1);
+        if (length <= 0) break;
+        request[length] = '\0';
+        if (!strstr(request, "\r\n\r\n")) continue;  // запросы короткие и приходят целиком
+
+        long number = __atomic_add_fetch(&board->requests, 1, __ATOMIC_RELAXED);
+        snprintf(body, sizeof(body),
+                 "{\"id\":%d,\"status\":\"%s\",\"currentPower\":%.1f,\"carConnection\":%s,"
+                 "\"voltagePhase1\":%.1f,\"currentPhase1\":%.1f,\"chargerPower\":%.1f,\"firmware\":\"1.0\"}",
+                 board->host, board->charging ? "charging" : "available",
+                 board->charging ? 11.0 + number % 10 / 10.0 : 0.0, board->charging ? "true" : "false",
+                 229.5 + number % 10 / 10.0, board->charging ? 16.0 : 0.0, board->charging ? 11.0 : 0.0);
+        int reply_length = snprintf(reply, sizeof(reply),
+                                    "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n%s",
+                                    strlen(body), body);
+        if (write(connection->client, reply, reply_length) != reply_length) break;
+    }
+    close(connection->client);
+    free(connection);
+    return NULL;
+}
+
+static void* fake_board(void *arg) {
+    fake_board_t *board = arg;
+    for (;;) {
+        int client = accept(board->fd, NULL, NULL);
+        if (client < 0) continue;
+        __atomic_add_fetch(&board->connections, 1, __ATOMIC_RELAXED);
+
+        fake_connection_t *connection = malloc(sizeof(fake_connection_t));
+        connection->board = board;
+        connection->client = client;
+        pthread_t thread;
+        pthread_create(&thread, NULL, fake_connection, connection);
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+static int start_board(fake_board_t *board, int port) {
+    board->fd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(board->fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(SUBNET | (uint32_t)board->host);
+    if (bind(board->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(board->fd, 64) != 0) {
+        perror("Ошибка запуска поддельной платы");
+        return -1;
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, fake_board, board);
+    pthread_detach(thread);
+    return 0;
+}
+
+static void remove_directory(const char *path) {
+    DIR *dir = opendir(path);
+    if (!dir) return;
+
+    struct dirent *entry;
+    char file[1024];
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        unlink(file);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+/**
+ * Файл станций: станция i имеет адрес 127.0.1.i, все начинают как available
+ */
+static int write_stations(const char *path, int count) {
+    charging_station_t *stations = calloc(count, sizeof(charging_station_t));
+    for (int i = 0; i < count; i++) {
+        stations[i].id = i + 1;
+        snprintf(stations[i].display_name, sizeof(stations[i].display_name), "Станция %d", i + 1);
+        strcpy(stations[i].type, "slave");
+        strcpy(stations[i].status, "available");
+        snprintf(stations[i].ip_address, sizeof(stations[i].ip_address), "127.0.1.%u", (unsigned char)(i + 1));
+        stations[i].max_power = 22.0f;
+    }
+
+    json_buf_t buf;
+    json_buf_init(&buf, (size_t)count * 600 + 64);
+    stations_write_json(&buf, stations, count);
+    free(stations);
+
+    FILE *file = fopen(path, "w");
+    int ok = file && !buf.failed && fwrite(buf.data, 1, buf.length, file) == buf.length;
+    if (file) fclose(file);
+    json_buf_free(&buf);
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    int charging = 10;
+    int idle = 30;
+    int dead = 10;
+    int seconds = 6;
+    int port = 18090;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:i:d:t:p:")) != -1) {
+        switch (opt) {
+            case 'c': charging = atoi(optarg); break;
+            case 'i': idle = atoi(optarg); break;
+            case 'd': dead = atoi(optarg); break;
+            case 't': seconds = atoi(optarg); break;
+            case 'p': port = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Использование: %s [-c charging] [-i idle] [-d dead] [-t seconds] [-p port]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    int total = charging + idle + dead;
+    if (charging < 0 || idle < 0 || dead < 0 || total == 0 || total > 254 || seconds <= 0) {
+        fprintf(stderr, "Станций всего - от 1 до 254, время больше 0\n");
+        return EXIT_FAILURE;
+    }
+
+    // Платы: сначала заряжающие, потом простаивающие; у последних dead адресов платы нет
+    fake_board_t *boards = calloc(total, sizeof(fake_board_t));
+    for (int i = 0; i < charging + idle; i++) {
+        boards[i].host = i + 1;
+        boards[i].charging = i < charging;
+        if (start_board(&boards[i], port) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    char dir[] = "/tmp/poller_bench.XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    char path[256];
+    snprintf(path, sizeof(path), "%s/stations.json", dir);
+    if (write_stations(path, total) != 0) {
+        remove_directory(dir);
+        return EXIT_FAILURE;
+    }
+    storage_set_data_file_path(path);
+    if (storage_init() != 0) {
+        remove_directory(dir);
+        return EXIT_FAILURE;
+    }
+
+    esp32_poller_options_t options;
+    esp32_poller_default_options(&options);
+    options.port = port;
+    options.fast_ms = 250;
+    options.slow_ms = 1000;
+    options.offline_min_ms = 250;
+    options.offline_max_ms = 2000;
+    options.timeout_ms = 500;
+    if (esp32_poller_start(&options) != 0) {
+        fprintf(stderr, "Опрос плат не запущен (нужна сборка с libcurl)\n");
+        storage_cleanup();
+        remove_directory(dir);
+        return EXIT_FAILURE;
+    }
+    sleep((unsigned int)seconds);
+
+    // Число плат и недоступных - до остановки, остановка убирает платы из опроса
+    esp32_poller_stats_t stats;
+    esp32_poller_stats(&stats);
+    int offline = stats.offline;
+    esp32_poller_stop();
+    esp32_poller_stats(&stats);
+
+    long charging_requests = 0, idle_requests = 0, connections = 0;
+    for (int i = 0; i < charging + idle; i++) {
+        if (boards[i].charging) charging_requests += boards[i].requests;
+        else idle_requests += boards[i].requests;
+        connections += boards[i].connections;
+    }
+    long dead_polls = stats.polls - charging_requests - idle_requests;
+
+    // Статусы станций после опроса
+    int charging_ok = 0, idle_ok = 0, offline_ok = 0;
+    for (int i = 0; i < total; i++) {
+        charging_station_t station;
+        if (storage_get_station(i + 1, &station) != 0) continue;
+        if (i < charging && strcmp(station.status, "charging") == 0 && station.current_power > 10.0f) charging_ok++;
+        else if (i >= charging && i < charging + idle && strcmp(station.status, "available") == 0) idle_ok++;
+        else if (i >= charging + idle && strcmp(station.status, "offline") == 0) offline_ok++;
+    }
+    storage_cleanup();
+    remove_directory(dir);
+
+    printf("\nСтанций: %d (заряжают %d, простаивают %d, недоступны %d), опрос %d с\n",
+           total, charging, idle, dead, seconds);
+    printf("  запросов на плату: заряжает %.1f  простаивает %.1f  недоступна %.1f\n",
+           charging ? (double)charging_requests / charging : 0.0,
+           idle ? (double)idle_requests / idle : 0.0,
+           dead ? (double)dead_polls / dead : 0.0);
+    printf("  ответов плат: %ld  соединений принято платами: %ld  новых соединений curl: %ld\n",
+           charging_requests + idle_requests, connections, stats.connections);
+    printf("  пакетов записи: %ld  станций в пакетах: %ld (%.1f на пакет)\n",
+           stats.batches, stats.updates, stats.batches ? (double)stats.updates / stats.batches : 0.0);
+    printf("  статусы: charging %d/%d  available %d/%d  offline %d/%d\n",
+           charging_ok, charging, idle_ok, idle, offline_ok, dead);
+
+    free(boards);
+    int ok = charging_ok == charging && idle_ok == idle && offline_ok == dead &&
+             connections <= charging + idle && offline == dead;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
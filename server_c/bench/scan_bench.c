@@ -0,0 +1,163 @@
+/**
+ * Бенчмарк сканирования сети ESP32
+ * Поднимает на loopback поддельные платы (127.0.1.x, каждая отвечает на
+ * GET /api/info) и по умолчанию сканирует 127.0.1.1-127.0.1.254 через esp32_scan_targets.
+ * Остальные адреса loopback отклоняют соединение сразу; с -s часть адресов
+ * принимает соединение, но не отвечает (как зависшие устройства).
+ * С -t сканируются заданные диапазоны (как ESP32_SCAN_TARGETS), например
+ * несколько подсетей сразу; -r - предел новых проб в секунду
+ *
+ * Использование:
+ *   ./bench/scan_bench [-b плат] [-s зависших] [-p порт] [-t диапазоны] [-r проб/с]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "esp32_client.h"
+
+#define SUBNET 0x7F000100u  // 127.0.1.0
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+typedef struct {
+    int fd;
+    int host;
+    int silent;
+} fake_board_t;
+
+/**
+ * Поддельная плата: на каждое соединение - ответ /api/info и закрытие.
+ * Зависшая плата принимает соединения и молчит
+ */
+static void* fake_board(void *arg) {
+    fake_board_t *board = arg;
+    char body[256], reply[512], request[1024];
+    snprintf(body, sizeof(body),
+             "{\"id\":\"esp32-%d\",\"type\":\"%s\",\"name\":\"Плата %d\",\"technicalName\":\"ESP32-%03d\",\"maxPower\":22}",
+             board->host, board->host % 5 == 0 ? "master" : "slave", board->host, board->host);
+    int length = snprintf(reply, sizeof(reply),
+                          "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+                          "Connection: close\r\n\r\n%s", strlen(body), body);
+
+    for (;;) {
+        int client = accept(board->fd, NULL, NULL);
+        if (client < 0) continue;
+        if (board->silent) {
+            continue; // соединение остается открытым без ответа
+        }
+        if (read(client, request, sizeof(request)) > 0) {
+            if (write(client, reply, length) < 0) {
+                // клиент уже закрыл соединение
+            }
+        }
+        close(client);
+    }
+    return NULL;
+}
+
+static int start_board(fake_board_t *board, int port) {
+    board->fd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(board->fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(SUBNET | (uint32_t)board->host);
+    if (bind(board->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(board->fd, 64) != 0) {
+        perror("Ошибка запуска поддельной платы");
+        return -1;
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, fake_board, board);
+    pthread_detach(thread);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int board_count = 16;
+    int silent_count = 0;
+    int port = 18080;
+    const char *spec = "127.0.1.1-127.0.1.254";
+    int rate = -1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:s:p:t:r:")) != -1) {
+        switch (opt) {
+            case 'b': board_count = atoi(optarg); break;
+            case 's': silent_count = atoi(optarg); break;
+            case 'p': port = atoi(optarg); break;
+            case 't': spec = optarg; break;
+            case 'r': rate = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Использование: %s [-b boards] [-s silent] [-p port] [-t targets] [-r rate]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (board_count < 0 || silent_count < 0 || board_count + silent_count > 254) {
+        fprintf(stderr, "Плат и зависших вместе - не больше 254\n");
+        return EXIT_FAILURE;
+    }
+
+    // Платы разбросаны по подсети с шагом, зависшие - следом за ними
+    int total = board_count + silent_count;
+    fake_board_t *boards = calloc(total > 0 ? total : 1, sizeof(fake_board_t));
+    for (int i = 0; i < total; i++) {
+        boards[i].host = 1 + (int)((long)i * 253 / (total > 1 ? total - 1 : 1));
+        boards[i].silent = i >= board_count;
+        // Шаг может совпасть у соседних, тогда берется следующий свободный адрес
+        for (int j = 0; j < i; j++) {
+            if (boards[j].host == boards[i].host) {
+                boards[i].host++;
+                j = -1;
+            }
+        }
+        if (start_board(&boards[i], port) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    esp32_scan_target_t targets[ESP32_SCAN_MAX_TARGETS];
+    int target_count = 0;
+    if (esp32_parse_scan_targets(spec, targets, ESP32_SCAN_MAX_TARGETS, &target_count) != 0) {
+        return EXIT_FAILURE;
+    }
+    long hosts = 0;
+    for (int i = 0; i < target_count; i++) {
+        hosts += (long)(targets[i].last_ip - targets[i].first_ip) + 1;
+    }
+
+    esp32_scan_options_t options;
+    esp32_scan_default_options(&options);
+    options.port = port;
+    if (rate >= 0) options.rate_per_sec = rate;
+
+    esp32_board_info_t *found = NULL;
+    int found_count = 0;
+    double start = now_ms();
+    if (esp32_scan_targets(targets, target_count, &options, &found, &found_count) != 0) {
+        fprintf(stderr, "Ошибка сканирования\n");
+        return EXIT_FAILURE;
+    }
+    double elapsed = now_ms() - start;
+
+    printf("Диапазоны: %s  адресов: %ld  проб/с: %d  плат: %d  зависших: %d  найдено: %d  время: %.1f мс\n",
+           spec, hosts, options.rate_per_sec, board_count, silent_count, found_count, elapsed);
+
+    free(found);
+    free(boards);
+    return found_count == board_count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
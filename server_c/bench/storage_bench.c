@@ -0,0 +1,163 @@
+/**
+ * Бенчмарк поиска станции по id
+ * Сравнивает прежний линейный проход по массиву станций с хэш-индексом
+ * station_index для 10k и 100k станций. Перед замером часть станций
+ * удаляется и создается заново, чтобы в массиве были переиспользованные слоты
+ *
+ * Использование:
+ *   ./bench/storage_bench [-n станций] [-l поисков]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "storage.h"
+#include "station_index.h"
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static unsigned int rng_state = 12345;
+
+static unsigned int rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Результат поиска копируется, как в storage_get_station
+static charging_station_t result;
+
+static int linear_lookup(const charging_station_t *stations, int count, int id) {
+    for (int i = 0; i < count; i++) {
+        if (stations[i].id == id) {
+            memcpy(&result, &stations[i], sizeof(result));
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int index_lookup(const station_index_t *index, const charging_station_t *stations, int id) {
+    int slot = station_index_find(index, id);
+    if (slot < 0) return -1;
+    memcpy(&result, &stations[slot], sizeof(result));
+    return 0;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Среднее и p99 по пачкам из 16 поисков (таймер на каждый поиск
+ * сопоставим по цене с поиском в индексе)
+ */
+#define BATCH 16
+
+static void report(const char *name, int count, double *samples, int batches, double total_ns, int lookups) {
+    qsort(samples, batches, sizeof(double), compare_double);
+    printf("%7d станций  %s  среднее: %10.1f нс  p50: %10.1f нс  p99: %10.1f нс\n",
+           count, name, total_ns / lookups, samples[batches / 2], samples[batches * 99 / 100]);
+}
+
+static void run(int count, int lookups) {
+    charging_station_t *stations = calloc(count, sizeof(charging_station_t));
+    station_index_t index;
+    if (!stations || station_index_init(&index, count) != 0) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < count; i++) {
+        stations[i].id = i + 1;
+        snprintf(stations[i].display_name, sizeof(stations[i].display_name), "Станция %d", i + 1);
+        station_index_put(&index, stations[i].id, i);
+    }
+
+    // 10% станций удаляются, их слоты занимают новые станции
+    int next_id = count + 1;
+    for (int i = 0; i < count / 10; i++) {
+        int slot = rng_next() % count;
+        int removed = station_index_remove(&index, stations[slot].id);
+        if (removed != slot) {
+            fprintf(stderr, "Индекс вернул слот %d вместо %d\n", removed, slot);
+            exit(EXIT_FAILURE);
+        }
+        stations[slot].id = next_id++;
+        station_index_put(&index, stations[slot].id, slot);
+    }
+
+    int *ids = malloc(sizeof(int) * lookups);
+    for (int i = 0; i < lookups; i++) {
+        ids[i] = stations[rng_next() % count].id;
+    }
+
+    int batches = lookups / BATCH;
+    double *samples = malloc(sizeof(double) * batches);
+
+    // Линейный проход дорог, для него хватает меньшего числа поисков
+    int linear_batches = batches > 256 ? 256 : batches;
+    double total = 0;
+    for (int b = 0; b < linear_batches; b++) {
+        double start = now_ns();
+        for (int i = 0; i < BATCH; i++) {
+            if (linear_lookup(stations, count, ids[b * BATCH + i]) != 0) abort();
+        }
+        samples[b] = (now_ns() - start) / BATCH;
+        total += samples[b] * BATCH;
+    }
+    report("линейный", count, samples, linear_batches, total, linear_batches * BATCH);
+
+    total = 0;
+    for (int b = 0; b < batches; b++) {
+        double start = now_ns();
+        for (int i = 0; i < BATCH; i++) {
+            if (index_lookup(&index, stations, ids[b * BATCH + i]) != 0) abort();
+        }
+        samples[b] = (now_ns() - start) / BATCH;
+        total += samples[b] * BATCH;
+    }
+    report("индекс  ", count, samples, batches, total, batches * BATCH);
+
+    free(samples);
+    free(ids);
+    station_index_destroy(&index);
+    free(stations);
+}
+
+int main(int argc, char *argv[]) {
+    int count = 0;
+    int lookups = 1000000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:l:")) != -1) {
+        switch (opt) {
+            case 'n': count = atoi(optarg); break;
+            case 'l': lookups = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Использование: %s [-n stations] [-l lookups]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (lookups < BATCH * 100) {
+        fprintf(stderr, "Нужно не меньше %d поисков\n", BATCH * 100);
+        return EXIT_FAILURE;
+    }
+
+    if (count > 0) {
+        run(count, lookups);
+    } else {
+        run(10000, lookups);
+        run(100000, lookups);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,240 @@
+/**
+ * Бенчмарк истории телеметрии
+ * Записывает одной станции измерения за D дней с интервалом I секунд
+ * (напряжения около 230 В с шумом, токи следуют за сессиями зарядки) и
+ * замеряет запись измерения и запросы графиков разной длины: уровень
+ * выбирается автоматически, как в GET /api/stations/:id/telemetry.
+ * Затем история сохраняется, как при уплотнении (полная запись и дозапись
+ * еще через час), восстанавливается из полученного файла и сравнивается с
+ * исходной на всех уровнях
+ *
+ * Использование:
+ *   ./bench/telemetry_bench [-d дней] [-i секунд]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "storage.h"
+#include "station_telemetry.h"
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static unsigned int rng_state = 12345;
+
+static unsigned int rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Значения с датчика приходят с точностью до десятых
+static float noisy(float base, float spread) {
+    int tenths = (int)(base * 10) + (int)(rng_next() % (unsigned int)(spread * 20 + 1)) - (int)(spread * 10);
+    return tenths / 10.0f;
+}
+
+static long max_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void query(const char *name, int64_t from, int64_t to, int points) {
+    station_telemetry_series_t series;
+    int64_t step = (to - from) / points + 1;
+    int runs = 20;
+
+    double start = now_ms();
+    for (int i = 0; i < runs; i++) {
+        if (station_telemetry_query(1, STATION_TELEMETRY_AUTO, from, to, step, &series) != 0) {
+            fprintf(stderr, "Ошибка запроса\n");
+            exit(EXIT_FAILURE);
+        }
+        if (i < runs - 1) station_telemetry_series_free(&series);
+    }
+    double elapsed = (now_ms() - start) / runs;
+
+    printf("%-10s уровень: %-6s  точек: %4d  время: %8.3f мс\n",
+           name, station_telemetry_tier_name(series.tier), series.count, elapsed);
+    station_telemetry_series_free(&series);
+}
+
+/**
+ * Измерения за count интервалов
+ */
+static int record_samples(charging_station_t *station, long count, int interval, int64_t *timestamp) {
+    for (long i = 0; i < count; i++) {
+        // Сессия зарядки - первые 20 минут каждого часа
+        int charging = (*timestamp / 1000) % 3600 < 1200;
+        station->voltage_phase1 = noisy(230.0f, 1.5f);
+        station->voltage_phase2 = noisy(230.0f, 1.5f);
+        station->voltage_phase3 = noisy(230.0f, 1.5f);
+        station->current_phase1 = charging ? noisy(16.0f, 0.5f) : 0.0f;
+        station->current_phase2 = charging ? noisy(16.0f, 0.5f) : 0.0f;
+        station->current_phase3 = charging ? noisy(16.0f, 0.5f) : 0.0f;
+        station->charger_power = charging ? noisy(11.0f, 0.2f) : 0.0f;
+
+        // Измерения приходят с дрожанием в несколько десятков мс
+        *timestamp += interval * 1000LL + (int)(rng_next() % 64) - 32;
+        if (station_telemetry_record(station, *timestamp) != 0) {
+            fprintf(stderr, "Ошибка записи измерения\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Запись истории, как при уплотнении: к файлу добавляются записи снимка
+ */
+static int save(char **file, size_t *length, unsigned long segment) {
+    station_telemetry_capture_t capture;
+    if (station_telemetry_capture(&capture, segment) != 0 ||
+        station_telemetry_capture_records(&capture, *length) != 0) {
+        station_telemetry_capture_free(&capture);
+        return -1;
+    }
+
+    size_t offset = capture.rewrite ? 0 : *length;
+    char *data = realloc(*file, offset + capture.length);
+    if (!data) {
+        station_telemetry_capture_free(&capture);
+        return -1;
+    }
+    memcpy(data + offset, capture.data, capture.length);
+    *file = data;
+    *length = offset + capture.length;
+
+    station_telemetry_capture_commit(&capture);
+    station_telemetry_capture_free(&capture);
+    return 0;
+}
+
+/**
+ * Все строки уровня по одной на точку
+ */
+static int snapshot_tiers(station_telemetry_series_t *tiers, int64_t from, int64_t to) {
+    for (int tier = 0; tier < STATION_TELEMETRY_TIERS; tier++) {
+        if (station_telemetry_query(1, (station_telemetry_tier_t)tier, from, to, 1, &tiers[tier]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int series_equal(const station_telemetry_series_t *a, const station_telemetry_series_t *b) {
+    if (a->count != b->count ||
+        memcmp(a->timestamps, b->timestamps, a->count * sizeof(int64_t)) != 0) {
+        return 0;
+    }
+    for (int i = 0; i < STATION_TELEMETRY_METRICS; i++) {
+        if (memcmp(a->values[i], b->values[i], a->count * sizeof(float)) != 0 ||
+            memcmp(a->min[i], b->min[i], a->count * sizeof(float)) != 0 ||
+            memcmp(a->max[i], b->max[i], a->count * sizeof(float)) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    int days = 31;
+    int interval = 5;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:i:")) != -1) {
+        switch (opt) {
+            case 'd': days = atoi(optarg); break;
+            case 'i': interval = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Использование: %s [-d days] [-i seconds]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (days <= 0 || interval <= 0) {
+        fprintf(stderr, "Нужны положительные -d и -i\n");
+        return EXIT_FAILURE;
+    }
+
+    charging_station_t station;
+    memset(&station, 0, sizeof(station));
+    station.id = 1;
+
+    long rss_before = max_rss_kb();
+    int64_t start_ms = 1700000000000LL;
+    long samples = (long)days * 24 * 60 * 60 / interval;
+    int64_t timestamp = start_ms;
+
+    double start = now_ms();
+    if (record_samples(&station, samples, interval, &timestamp) != 0) {
+        return EXIT_FAILURE;
+    }
+    double elapsed = now_ms() - start;
+
+    printf("Измерений: %ld за %d дн. (интервал %d с)  запись: %.0f нс/измерение  память: ~%ld КБ\n",
+           samples, days, interval, elapsed * 1e6 / samples, max_rss_kb() - rss_before);
+
+    int64_t hour = 60LL * 60 * 1000;
+    query("1 час", timestamp - hour, timestamp, 500);
+    query("24 часа", timestamp - 24 * hour, timestamp, 500);
+    query("7 дней", timestamp - 7 * 24 * hour, timestamp, 500);
+    query("30 дней", timestamp - 30 * 24 * hour, timestamp, 500);
+    query("все", start_ms, timestamp, 500);
+
+    // Полная запись, час измерений и дозапись
+    char *file = NULL;
+    size_t length = 0;
+    start = now_ms();
+    if (save(&file, &length, 1) != 0) {
+        fprintf(stderr, "Ошибка сохранения истории\n");
+        return EXIT_FAILURE;
+    }
+    double save_ms = now_ms() - start;
+    size_t full_length = length;
+
+    if (record_samples(&station, 3600 / interval, interval, &timestamp) != 0 || save(&file, &length, 2) != 0) {
+        fprintf(stderr, "Ошибка сохранения истории\n");
+        return EXIT_FAILURE;
+    }
+
+    station_telemetry_series_t before[STATION_TELEMETRY_TIERS], after[STATION_TELEMETRY_TIERS];
+    if (snapshot_tiers(before, start_ms, timestamp) != 0) {
+        fprintf(stderr, "Ошибка запроса\n");
+        return EXIT_FAILURE;
+    }
+
+    station_telemetry_cleanup();
+    unsigned long segment = 0;
+    size_t valid_length = 0;
+    start = now_ms();
+    int restored = station_telemetry_restore(file, length, &segment, &valid_length);
+    double restore_ms = now_ms() - start;
+    if (restored != 0 || snapshot_tiers(after, start_ms, timestamp) != 0) {
+        fprintf(stderr, "Ошибка восстановления истории\n");
+        return EXIT_FAILURE;
+    }
+
+    int same = segment == 2 && valid_length == length;
+    for (int tier = 0; tier < STATION_TELEMETRY_TIERS; tier++) {
+        if (!series_equal(&before[tier], &after[tier])) same = 0;
+        station_telemetry_series_free(&before[tier]);
+        station_telemetry_series_free(&after[tier]);
+    }
+    printf("Файл истории: %zu КБ (запись %.1f мс), дозапись через час: %zu КБ, "
+           "восстановление: %.1f мс  уровни совпадают: %s\n",
+           full_length / 1024, save_ms, (length - full_length) / 1024, restore_ms, same ? "да" : "НЕТ");
+
+    free(file);
+    station_telemetry_cleanup();
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -4,6 +4,8 @@
  */
 
 #include "esp32_client.h"
+#include "esp32_mdns.h"
+#include "esp32_health.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,12 +15,17 @@
 #include <arpa/inet.h>
 #include <ifaddrs.h>
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <net/if.h>
 #include <cjson/cJSON.h>
 
 /**
  * Callback функция для обработки ответа CURL
  */
-size_t curl_write_callback(void *contents, size_t size, size_t nmemb, http_response_t *response) {
+size_t esp32_write_callback(char *contents, size_t size, size_t nmemb, void *userdata) {
+    http_response_t *response = userdata;
     size_t total_size = size * nmemb;
     
     char *new_data = realloc(response->data, response->size + total_size + 1);
@@ -98,14 +105,283 @@ int get_local_network_info(char *network_base, char *subnet_mask) {
 }
 
 /**
- * Проверка доступности хоста через ping (упрощенная версия)
+ * Параметры сканирования по умолчанию
+ */
+void esp32_scan_default_options(esp32_scan_options_t *options) {
+    options->port = ESP32_SCAN_PORT;
+    options->connect_timeout_ms = ESP32_SCAN_CONNECT_TIMEOUT_MS;
+    options->request_timeout_ms = ESP32_SCAN_REQUEST_TIMEOUT_MS;
+    options->max_probes = ESP32_SCAN_MAX_PROBES;
+    options->max_requests = ESP32_SCAN_MAX_REQUESTS;
+    options->rate_per_sec = ESP32_SCAN_RATE;
+}
+
+static long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/**
+ * Проба TCP соединения в полете
+ */
+typedef struct {
+    int fd;       // -1 - слот свободен
+    int index;    // номер адреса
+    long deadline;
+} scan_probe_t;
+
+/**
+ * Неблокирующие TCP пробы порта через epoll: одновременно не больше
+ * max_probes соединений, каждое ждет не дольше connect_timeout_ms, новые
+ * пробы начинаются не чаще rate_per_sec (корзина токенов на 50 мс).
+ * open[i] = 1 для адресов, принявших соединение (адреса в порядке хоста)
+ */
+static int probe_hosts(const uint32_t *addresses, int count, const esp32_scan_options_t *options,
+                       unsigned char *open) {
+    int max_probes = options->max_probes > 0 ? options->max_probes : 1;
+    if (max_probes > count) max_probes = count;
+    
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    scan_probe_t *probes = malloc((max_probes > 0 ? max_probes : 1) * sizeof(scan_probe_t));
+    if (epoll_fd < 0 || !probes) {
+        if (epoll_fd >= 0) close(epoll_fd);
+        free(probes);
+        return -1;
+    }
+    for (int i = 0; i < max_probes; i++) {
+        probes[i].fd = -1;
+    }
+    
+    int rate = options->rate_per_sec;
+    double burst = rate > 0 && rate / 20 > 1 ? rate / 20 : 1;
+    double tokens = burst;
+    long refilled_at = monotonic_ms();
+    
+    struct epoll_event events[64];
+    int next = 0, in_flight = 0;
+    
+    while (next < count || in_flight > 0) {
+        long now = monotonic_ms();
+        if (rate > 0) {
+            tokens += (now - refilled_at) * (double)rate / 1000.0;
+            if (tokens > burst) tokens = burst;
+            refilled_at = now;
+        }
+        
+        // Новые пробы в свободные слоты, пока есть токены
+        for (int slot = 0; slot < max_probes && next < count; slot++) {
+            if (probes[slot].fd >= 0) continue;
+            if (rate > 0) {
+                if (tokens < 1) break;
+                tokens -= 1;
+            }
+            
+            int index = next++;
+            int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) {
+                continue;
+            }
+            
+            struct sockaddr_in addr = {0};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons((uint16_t)options->port);
+            addr.sin_addr.s_addr = htonl(addresses[index]);
+            
+            int result = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+            if (result == 0 || errno != EINPROGRESS) {
+                // Соединение установлено сразу (локальный адрес) или отклонено
+                open[index] = result == 0;
+                close(fd);
+                continue;
+            }
+            
+            struct epoll_event event = { .events = EPOLLOUT, .data.u32 = (uint32_t)slot };
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                close(fd);
+                continue;
+            }
+            probes[slot].fd = fd;
+            probes[slot].index = index;
+            probes[slot].deadline = now + options->connect_timeout_ms;
+            in_flight++;
+        }
+        
+        // Ожидание - до ближайшего срока пробы или следующего токена
+        long wait_ms = options->connect_timeout_ms;
+        if (next < count && in_flight < max_probes) {
+            wait_ms = rate > 0 && tokens < 1 ? (long)((1 - tokens) * 1000 / rate) + 1 : 0;
+        }
+        
+        // Истекшие пробы закрываются
+        now = monotonic_ms();
+        for (int slot = 0; slot < max_probes; slot++) {
+            if (probes[slot].fd < 0) continue;
+            if (probes[slot].deadline <= now) {
+                close(probes[slot].fd);
+                probes[slot].fd = -1;
+                in_flight--;
+                wait_ms = 0;
+            } else if (probes[slot].deadline - now < wait_ms) {
+                wait_ms = probes[slot].deadline - now;
+            }
+        }
+        if (in_flight == 0 && next == count) {
+            break;
+        }
+        
+        int ready = epoll_wait(epoll_fd, events, 64, (int)wait_ms);
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        for (int i = 0; i < ready; i++) {
+            scan_probe_t *probe = &probes[events[i].data.u32];
+            if (probe->fd < 0) continue;
+            
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (getsockopt(probe->fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0) {
+                open[probe->index] = 1;
+            }
+            close(probe->fd);
+            probe->fd = -1;
+            in_flight--;
+        }
+    }
+    
+    for (int slot = 0; slot < max_probes; slot++) {
+        if (probes[slot].fd >= 0) close(probes[slot].fd);
+    }
+    free(probes);
+    close(epoll_fd);
+    return 0;
+}
+
+/**
+ * Разбор адреса платы "ip" или "ip:port" (без порта - ESP32_SCAN_PORT)
+ */
+static int parse_board_address(const char *ip, uint32_t *address, int *port) {
+    char host[INET_ADDRSTRLEN];
+    const char *colon = strchr(ip, ':');
+    size_t length = colon ? (size_t)(colon - ip) : strlen(ip);
+    if (length >= sizeof(host)) {
+        return -1;
+    }
+    memcpy(host, ip, length);
+    host[length] = '\0';
+
+    struct in_addr addr;
+    if (inet_pton(AF_INET, host, &addr) != 1) {
+        return -1;
+    }
+    *address = ntohl(addr.s_addr);
+    *port = ESP32_SCAN_PORT;
+    if (colon) {
+        char *end;
+        long value = strtol(colon + 1, &end, 10);
+        if (end == colon + 1 || *end != '\0' || value < 1 || value > 65535) {
+            return -1;
+        }
+        *port = (int)value;
+    }
+    return 0;
+}
+
+/**
+ * Проверка доступности ESP32 платы: TCP соединение с портом платы
  */
 int esp32_ping_board(const char *ip) {
-    char ping_cmd[256];
-    snprintf(ping_cmd, sizeof(ping_cmd), "ping -c 1 -W 1 %s > /dev/null 2>&1", ip);
+    uint32_t address;
+    int port;
+    if (!ip || parse_board_address(ip, &address, &port) != 0) {
+        return 0;
+    }
+    
+    esp32_scan_options_t options;
+    esp32_scan_default_options(&options);
+    options.port = port;
     
-    int result = system(ping_cmd);
-    return (result == 0) ? 1 : 0;
+    unsigned char open = 0;
+    if (probe_hosts(&address, 1, &options, &open) != 0) {
+        return 0;
+    }
+    return open;
+}
+
+/**
+ * URL запроса к плате: адрес - "ip" (порт 80) или "ip:port"
+ */
+static int board_url(char *url, size_t size, const char *address, const char *path) {
+    int length = snprintf(url, size, "http://%s%s", address, path);
+    return length > 0 && (size_t)length < size ? 0 : -1;
+}
+
+/**
+ * Разрешение запроса к плате по ее состоянию (esp32_health): при открытом
+ * автомате запрос не выполняется, иначе таймауты сокращаются по задержке
+ * прошлых ответов
+ */
+static int board_request_begin(CURL *curl, const char *ip, int timeout_ms, int connect_timeout_ms) {
+    int limit_ms;
+    if (esp32_health_begin(ip, timeout_ms, &limit_ms) != 0) {
+        printf("ESP32 %s не отвечает, запрос пропущен до пробного\n", ip);
+        return -1;
+    }
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)limit_ms);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, (long)(connect_timeout_ms < limit_ms ? connect_timeout_ms : limit_ms));
+    return 0;
+}
+
+/**
+ * Итог запроса для esp32_health, задержка - полное время ответа
+ */
+static void board_request_end(CURL *curl, const char *ip, CURLcode res) {
+    double total_time = 0;
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total_time);
+    esp32_health_report(ip, res == CURLE_OK, total_time * 1000.0);
+}
+
+/**
+ * Статус и время последнего ответа платы по esp32_health: online, пока
+ * автомат закрыт; last_seen - более позднее из известного и последнего ответа
+ */
+void esp32_apply_health(esp32_board_info_t *board_info) {
+    esp32_health_t health;
+    if (esp32_health_get(board_info->ip, &health) != 0) {
+        return;
+    }
+    
+    strcpy(board_info->status, health.state == ESP32_BREAKER_CLOSED ? "online" : "offline");
+    if (health.last_seen > 0) {
+        char last_seen[sizeof(board_info->last_seen)];
+        struct tm tm_info;
+        localtime_r(&health.last_seen, &tm_info);
+        strftime(last_seen, sizeof(last_seen), "%Y-%m-%d %H:%M:%S", &tm_info);
+        // Формат сравним как строка
+        if (strcmp(last_seen, board_info->last_seen) > 0) {
+            strcpy(board_info->last_seen, last_seen);
+        }
+    }
+}
+
+/**
+ * Заполнение информации о плате из ответа /api/info
+ */
+static int board_from_info(const char *ip, const char *json_data, esp32_board_info_t *board_info) {
+    if (parse_esp32_response(json_data, board_info) != 0) {
+        return -1;
+    }
+    
+    strncpy(board_info->ip, ip, ESP32_MAX_IP - 1);
+    strcpy(board_info->status, "online");
+    
+    // Получаем текущее время для last_seen
+    time_t now = time(NULL);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    strftime(board_info->last_seen, sizeof(board_info->last_seen), 
+            "%Y-%m-%d %H:%M:%S", &tm_info);
+    return 0;
 }
 
 /**
@@ -122,15 +398,21 @@ int esp32_check_charging_board(const char *ip, esp32_board_info_t *board_info) {
     }
     
     char url[256];
-    snprintf(url, sizeof(url), "http://%s/api/info", ip);
+    if (board_url(url, sizeof(url), ip, "/api/info") != 0) {
+        curl_easy_cleanup(curl);
+        return -1;
+    }
     
     curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, esp32_write_callback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 3L);
+    if (board_request_begin(curl, ip, 5000, 3000) != 0) {
+        curl_easy_cleanup(curl);
+        return -1;
+    }
     
     res = curl_easy_perform(curl);
+    board_request_end(curl, ip, res);
     curl_easy_cleanup(curl);
     
     if (res != CURLE_OK) {
@@ -139,22 +421,9 @@ int esp32_check_charging_board(const char *ip, esp32_board_info_t *board_info) {
     }
     
     // Парсим JSON ответ
-    if (parse_esp32_response(response.data, board_info) == 0) {
-        strcpy(board_info->ip, ip);
-        strcpy(board_info->status, "online");
-        
-        // Получаем текущее время для last_seen
-        time_t now = time(NULL);
-        struct tm *tm_info = localtime(&now);
-        strftime(board_info->last_seen, sizeof(board_info->last_seen), 
-                "%Y-%m-%d %H:%M:%S", tm_info);
-        
-        free_http_response(&response);
-        return 0;
-    }
-    
+    int result = board_from_info(ip, response.data, board_info);
     free_http_response(&response);
-    return -1;
+    return result;
 }
 
 /**
@@ -212,83 +481,469 @@ int parse_esp32_response(const char *json_data, esp32_board_info_t *board_info)
 }
 
 /**
- * Сканирование одного IP адреса
+ * Запрос /api/info в полете
  */
-static int scan_single_ip(const char *ip, esp32_board_info_t *board_info) {
-    // Сначала проверяем доступность хоста
-    if (!esp32_ping_board(ip)) {
-        return -1; // Хост недоступен
+typedef struct {
+    CURL *curl;
+    int index;
+    char ip[INET_ADDRSTRLEN];
+    http_response_t response;
+} scan_fetch_t;
+
+/**
+ * Запросы /api/info к адресам через curl multi, одновременно не больше
+ * max_requests. Платы записываются в found в порядке адресов
+ */
+static int fetch_boards(const uint32_t *addresses, int count, const esp32_scan_options_t *options,
+                        esp32_board_info_t *found, int *found_count) {
+    int max_requests = options->max_requests > 0 ? options->max_requests : 1;
+    CURLM *multi = curl_multi_init();
+    scan_fetch_t *fetches = calloc(max_requests, sizeof(scan_fetch_t));
+    unsigned char *is_board = calloc(count > 0 ? count : 1, 1);
+    esp32_board_info_t *boards = malloc((count > 0 ? count : 1) * sizeof(esp32_board_info_t));
+    if (!multi || !fetches || !is_board || !boards) {
+        if (multi) curl_multi_cleanup(multi);
+        free(fetches);
+        free(is_board);
+        free(boards);
+        return -1;
+    }
+    
+    int next = 0, active = 0, running = 0;
+    do {
+        // Новые запросы в свободные слоты
+        for (int slot = 0; slot < max_requests && next < count; slot++) {
+            if (fetches[slot].curl) continue;
+            
+            scan_fetch_t *fetch = &fetches[slot];
+            fetch->index = next++;
+            fetch->curl = curl_easy_init();
+            if (!fetch->curl) continue;
+            
+            struct in_addr addr;
+            addr.s_addr = htonl(addresses[fetch->index]);
+            inet_ntop(AF_INET, &addr, fetch->ip, sizeof(fetch->ip));
+            
+            char url[64];
+            snprintf(url, sizeof(url), "http://%s:%d/api/info", fetch->ip, options->port);
+            curl_easy_setopt(fetch->curl, CURLOPT_URL, url);
+            curl_easy_setopt(fetch->curl, CURLOPT_WRITEFUNCTION, esp32_write_callback);
+            curl_easy_setopt(fetch->curl, CURLOPT_WRITEDATA, &fetch->response);
+            curl_easy_setopt(fetch->curl, CURLOPT_PRIVATE, fetch);
+            curl_easy_setopt(fetch->curl, CURLOPT_NOSIGNAL, 1L);
+            curl_easy_setopt(fetch->curl, CURLOPT_TIMEOUT_MS, (long)options->request_timeout_ms);
+            curl_easy_setopt(fetch->curl, CURLOPT_CONNECTTIMEOUT_MS, (long)options->connect_timeout_ms);
+            curl_multi_add_handle(multi, fetch->curl);
+            active++;
+        }
+        
+        curl_multi_perform(multi, &running);
+        
+        CURLMsg *message;
+        int queued;
+        while ((message = curl_multi_info_read(multi, &queued)) != NULL) {
+            if (message->msg != CURLMSG_DONE) continue;
+            
+            scan_fetch_t *fetch;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char **)&fetch);
+            long status = 0;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+            
+            if (message->data.result == CURLE_OK && status == 200 && fetch->response.data &&
+                board_from_info(fetch->ip, fetch->response.data, &boards[fetch->index]) == 0) {
+                is_board[fetch->index] = 1;
+                board_request_end(message->easy_handle, fetch->ip, CURLE_OK);
+            }
+            
+            curl_multi_remove_handle(multi, fetch->curl);
+            curl_easy_cleanup(fetch->curl);
+            fetch->curl = NULL;
+            free_http_response(&fetch->response);
+            active--;
+        }
+        
+        if (running > 0) {
+            curl_multi_poll(multi, NULL, 0, 100, NULL);
+        }
+    } while (active > 0 || next < count);
+    
+    for (int i = 0; i < count; i++) {
+        if (is_board[i]) {
+            memcpy(&found[(*found_count)++], &boards[i], sizeof(esp32_board_info_t));
+        }
     }
     
-    // Проверяем, является ли это ESP32 зарядной станцией
-    return esp32_check_charging_board(ip, board_info);
+    free(boards);
+    free(is_board);
+    free(fetches);
+    curl_multi_cleanup(multi);
+    return 0;
+}
+
+static int compare_targets(const void *a, const void *b) {
+    const esp32_scan_target_t *x = a, *y = b;
+    return x->first_ip < y->first_ip ? -1 : x->first_ip > y->first_ip;
+}
+
+static int compare_addresses(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
 }
 
 /**
- * Сканирование локальной сети для поиска ESP32 плат
+ * Сканирование диапазонов адресов: пересекающиеся диапазоны (например,
+ * два интерфейса в одной подсети) объединяются, адреса диапазонов
+ * чередуются, поэтому все подсети пробуются одновременно. Больше
+ * ESP32_SCAN_MAX_HOSTS адресов не пробуется. Затем /api/info
+ * запрашивается только у адресов, принявших соединение
  */
-int esp32_scan_network(esp32_board_info_t **boards, int *count) {
-    char network_base[INET_ADDRSTRLEN];
-    char subnet_mask[INET_ADDRSTRLEN];
-    
+int esp32_scan_targets(const esp32_scan_target_t *targets, int target_count, const esp32_scan_options_t *options,
+                       esp32_board_info_t **boards, int *count) {
     *boards = NULL;
     *count = 0;
+    if (target_count <= 0) {
+        return 0;
+    }
     
-    // Получаем информацию о локальной сети
-    if (get_local_network_info(network_base, subnet_mask) != 0) {
+    esp32_scan_target_t *ranges = malloc(target_count * sizeof(esp32_scan_target_t));
+    if (!ranges) {
         return -1;
     }
+    memcpy(ranges, targets, target_count * sizeof(esp32_scan_target_t));
+    qsort(ranges, target_count, sizeof(esp32_scan_target_t), compare_targets);
+    
+    int range_count = 0;
+    uint64_t total = 0;
+    for (int i = 0; i < target_count; i++) {
+        if (ranges[i].last_ip < ranges[i].first_ip) continue;
+        if (range_count > 0 && (uint64_t)ranges[i].first_ip <= (uint64_t)ranges[range_count - 1].last_ip + 1) {
+            if (ranges[i].last_ip > ranges[range_count - 1].last_ip) {
+                ranges[range_count - 1].last_ip = ranges[i].last_ip;
+            }
+        } else {
+            ranges[range_count++] = ranges[i];
+        }
+    }
+    for (int i = 0; i < range_count; i++) {
+        total += (uint64_t)ranges[i].last_ip - ranges[i].first_ip + 1;
+    }
+    // Адреса чередуются, поэтому предел сокращает самые большие диапазоны
+    // с конца, а малые подсети проверяются целиком
+    if (total > ESP32_SCAN_MAX_HOSTS) {
+        printf("Диапазон сканирования сокращен: %llu адресов, проверяются %d\n",
+               (unsigned long long)total, ESP32_SCAN_MAX_HOSTS);
+        total = ESP32_SCAN_MAX_HOSTS;
+    }
     
-    // Парсим базовый адрес сети
-    struct in_addr network_addr;
-    if (inet_pton(AF_INET, network_base, &network_addr) != 1) {
-        printf("Ошибка парсинга сетевого адреса\n");
+    int hosts = (int)total;
+    uint32_t *addresses = malloc((hosts > 0 ? hosts : 1) * sizeof(uint32_t));
+    unsigned char *open = calloc(hosts > 0 ? hosts : 1, 1);
+    if (!addresses || !open) {
+        free(ranges);
+        free(addresses);
+        free(open);
         return -1;
     }
     
-    uint32_t base_ip = ntohl(network_addr.s_addr);
+    // По одному адресу из каждого диапазона по кругу
+    int filled = 0;
+    for (uint32_t offset = 0; filled < hosts; offset++) {
+        for (int i = 0; i < range_count; i++) {
+            if ((uint64_t)ranges[i].first_ip + offset <= ranges[i].last_ip) {
+                addresses[filled++] = ranges[i].first_ip + offset;
+            }
+        }
+    }
+    free(ranges);
     
-    // Для простоты сканируем /24 подсеть (256 адресов)
-    // В реальном проекте можно реализовать более сложную логику по маске
-    const int max_boards = 256;
-    esp32_board_info_t *found_boards = malloc(max_boards * sizeof(esp32_board_info_t));
-    if (!found_boards) {
+    long start = monotonic_ms();
+    if (probe_hosts(addresses, hosts, options, open) != 0) {
+        free(addresses);
+        free(open);
         return -1;
     }
     
-    int found_count = 0;
+    // Открытые адреса по возрастанию
+    int open_count = 0;
+    for (int i = 0; i < hosts; i++) {
+        if (open[i]) addresses[open_count++] = addresses[i];
+    }
+    free(open);
+    qsort(addresses, open_count, sizeof(uint32_t), compare_addresses);
+    long probed = monotonic_ms();
     
-    // Сканируем адреса с .1 по .254
-    for (int i = 1; i < 255 && found_count < max_boards; i++) {
-        uint32_t scan_ip = (base_ip & 0xFFFFFF00) | i;
-        
-        struct in_addr addr;
-        addr.s_addr = htonl(scan_ip);
-        char ip_str[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &addr, ip_str, INET_ADDRSTRLEN);
-        
-        esp32_board_info_t board_info;
-        if (scan_single_ip(ip_str, &board_info) == 0) {
-            memcpy(&found_boards[found_count], &board_info, sizeof(esp32_board_info_t));
-            found_count++;
-            printf("Найдена ESP32 плата: %s (%s) на %s\n", 
-                   board_info.name, board_info.type, ip_str);
+    esp32_board_info_t *found_boards = NULL;
+    int found_count = 0;
+    if (open_count > 0) {
+        found_boards = malloc(open_count * sizeof(esp32_board_info_t));
+        if (!found_boards ||
+            fetch_boards(addresses, open_count, options, found_boards, &found_count) != 0) {
+            free(found_boards);
+            free(addresses);
+            return -1;
         }
     }
+    free(addresses);
     
-    printf("Сканирование завершено. Найдено ESP32 плат: %d\n", found_count);
+    for (int i = 0; i < found_count; i++) {
+        printf("Найдена ESP32 плата: %s (%s) на %s\n", 
+               found_boards[i].name, found_boards[i].type, found_boards[i].ip);
+    }
+    printf("Сканирование завершено за %ld мс (пробы: %ld мс, открыто: %d из %d). Найдено ESP32 плат: %d\n",
+           monotonic_ms() - start, probed - start, open_count, hosts, found_count);
     
     if (found_count > 0) {
         // Сжимаем массив до реального размера
-        *boards = realloc(found_boards, found_count * sizeof(esp32_board_info_t));
+        esp32_board_info_t *shrunk = realloc(found_boards, found_count * sizeof(esp32_board_info_t));
+        *boards = shrunk ? shrunk : found_boards;
         *count = found_count;
     } else {
         free(found_boards);
+    }
+    
+    return 0;
+}
+
+/**
+ * Сканирование одного диапазона адресов [first_ip, last_ip] (порядок хоста)
+ */
+int esp32_scan_range(uint32_t first_ip, uint32_t last_ip, const esp32_scan_options_t *options,
+                     esp32_board_info_t **boards, int *count) {
+    esp32_scan_target_t target = { first_ip, last_ip };
+    return esp32_scan_targets(&target, 1, options, boards, count);
+}
+
+/**
+ * Диапазон адресов узлов подсети: без адреса сети и широковещательного,
+ * кроме /31 и /32, где адресов узлов нет отдельно
+ */
+static esp32_scan_target_t subnet_target(uint32_t address, int prefix) {
+    uint32_t mask = prefix == 0 ? 0 : 0xFFFFFFFFu << (32 - prefix);
+    esp32_scan_target_t target = { address & mask, (address & mask) | ~mask };
+    if (prefix <= 30) {
+        target.first_ip++;
+        target.last_ip--;
+    }
+    return target;
+}
+
+/**
+ * Интерфейс с собственным устройством (Ethernet, Wi-Fi): у мостов,
+ * veth, tun и других виртуальных интерфейсов в /sys/class/net нет device
+ */
+static int interface_is_physical(const char *name) {
+    char path[IF_NAMESIZE + 32];
+    snprintf(path, sizeof(path), "/sys/class/net/%s/device", name);
+    return access(path, F_OK) == 0;
+}
+
+/**
+ * Диапазоны по подсетям активных IPv4 интерфейсов (кроме loopback).
+ * Виртуальные интерфейсы (docker0, мосты, VPN) пропускаются, если есть
+ * физические: платы подключены к локальной сети, а не к контейнерам.
+ * Маска берется у интерфейса; подсети шире /ESP32_SCAN_MIN_PREFIX
+ * сужаются до соседних с адресом интерфейса
+ */
+int esp32_local_scan_targets(esp32_scan_target_t *targets, int max_targets, int *count) {
+    struct ifaddrs *ifaddrs_ptr = NULL;
+    *count = 0;
+    
+    if (getifaddrs(&ifaddrs_ptr) == -1) {
+        perror("getifaddrs");
+        return -1;
+    }
+    
+    int has_physical = 0;
+    for (struct ifaddrs *ifa = ifaddrs_ptr; ifa != NULL; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr == NULL || ifa->ifa_netmask == NULL) continue;
+        if (ifa->ifa_addr->sa_family != AF_INET) continue;
+        if ((ifa->ifa_flags & IFF_LOOPBACK) || !(ifa->ifa_flags & IFF_UP)) continue;
+        if (interface_is_physical(ifa->ifa_name)) {
+            has_physical = 1;
+            break;
+        }
+    }
+    
+    for (struct ifaddrs *ifa = ifaddrs_ptr; ifa != NULL && *count < max_targets; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr == NULL || ifa->ifa_netmask == NULL) continue;
+        if (ifa->ifa_addr->sa_family != AF_INET) continue;
+        if ((ifa->ifa_flags & IFF_LOOPBACK) || !(ifa->ifa_flags & IFF_UP)) continue;
+        
+        uint32_t address = ntohl(((struct sockaddr_in *)ifa->ifa_addr)->sin_addr.s_addr);
+        uint32_t mask = ntohl(((struct sockaddr_in *)ifa->ifa_netmask)->sin_addr.s_addr);
+        int prefix = __builtin_popcount(mask);
+        if (prefix == 32) continue; // point-to-point без соседей
+        
+        char ip_str[INET_ADDRSTRLEN];
+        struct in_addr addr = { htonl(address) };
+        inet_ntop(AF_INET, &addr, ip_str, sizeof(ip_str));
+        if (has_physical && !interface_is_physical(ifa->ifa_name)) {
+            printf("Пропущена виртуальная сеть: %s/%d (интерфейс: %s)\n", ip_str, prefix, ifa->ifa_name);
+            continue;
+        }
+        
+        int scan_prefix = prefix < ESP32_SCAN_MIN_PREFIX ? ESP32_SCAN_MIN_PREFIX : prefix;
+        targets[(*count)++] = subnet_target(address, scan_prefix);
+        
+        if (scan_prefix != prefix) {
+            printf("Найдена локальная сеть: %s/%d (интерфейс: %s, сканируется /%d)\n",
+                   ip_str, prefix, ifa->ifa_name, scan_prefix);
+        } else {
+            printf("Найдена локальная сеть: %s/%d (интерфейс: %s)\n", ip_str, prefix, ifa->ifa_name);
+        }
+    }
+    
+    freeifaddrs(ifaddrs_ptr);
+    if (*count == 0) {
+        printf("Не удалось определить локальную сеть\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_ipv4(const char *text, uint32_t *address) {
+    struct in_addr addr;
+    if (inet_pton(AF_INET, text, &addr) != 1) {
+        return -1;
+    }
+    *address = ntohl(addr.s_addr);
+    return 0;
+}
+
+/**
+ * Разбор диапазонов через запятую или пробел:
+ *   "10.0.0.0/22"             - узлы подсети
+ *   "10.0.4.10-10.0.4.50"     - диапазон адресов
+ *   "10.0.5.7"                - один адрес
+ */
+int esp32_parse_scan_targets(const char *spec, esp32_scan_target_t *targets, int max_targets, int *count) {
+    *count = 0;
+    if (!spec) {
+        return -1;
+    }
+    
+    char *copy = strdup(spec);
+    if (!copy) {
+        return -1;
+    }
+    
+    int result = 0;
+    char *saveptr = NULL;
+    for (char *item = strtok_r(copy, ", ", &saveptr); item; item = strtok_r(NULL, ", ", &saveptr)) {
+        if (*count == max_targets) {
+            result = -1;
+            break;
+        }
+        
+        esp32_scan_target_t target;
+        char *slash = strchr(item, '/');
+        char *dash = strchr(item, '-');
+        if (slash) {
+            *slash = '\0';
+            char *end;
+            long prefix = strtol(slash + 1, &end, 10);
+            if (end == slash + 1 || *end != '\0' || prefix < 0 || prefix > 32 ||
+                parse_ipv4(item, &target.first_ip) != 0) {
+                result = -1;
+                break;
+            }
+            target = subnet_target(target.first_ip, (int)prefix);
+        } else if (dash) {
+            *dash = '\0';
+            if (parse_ipv4(item, &target.first_ip) != 0 || parse_ipv4(dash + 1, &target.last_ip) != 0 ||
+                target.last_ip < target.first_ip) {
+                result = -1;
+                break;
+            }
+        } else {
+            if (parse_ipv4(item, &target.first_ip) != 0) {
+                result = -1;
+                break;
+            }
+            target.last_ip = target.first_ip;
+        }
+        targets[(*count)++] = target;
+    }
+    
+    free(copy);
+    if (result == 0 && *count == 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        printf("Неверный диапазон сканирования: %s\n", spec);
+    }
+    return result;
+}
+
+/**
+ * Платы из реестра mDNS. Обнаружение запускается при первом вызове, и
+ * тогда ответы ждутся до ESP32_MDNS_WAIT_MS; дальше реестр обновляется в
+ * фоне и читается без ожидания
+ */
+static int discover_mdns(esp32_board_info_t **boards, int *count) {
+    int started = 0;
+    if (!esp32_mdns_running()) {
+        if (esp32_mdns_start(NULL) != 0 && !esp32_mdns_running()) {
+            return -1;
+        }
+        started = 1;
+    }
+    
+    if (started && esp32_mdns_wait(ESP32_MDNS_WAIT_MS) > 0) {
+        // Остальные платы отвечают с задержкой до 120 мс
+        usleep(ESP32_MDNS_SETTLE_MS * 1000);
+    }
+    return esp32_mdns_boards(boards, count);
+}
+
+/**
+ * Поиск ESP32 плат. По умолчанию платы берутся из реестра mDNS, а сеть
+ * сканируется, только если ни одна плата не объявила себя;
+ * ESP32_DISCOVERY=sweep отключает mDNS.
+ * Диапазоны сканирования берутся из ESP32_SCAN_TARGETS (см.
+ * esp32_parse_scan_targets), иначе - подсети всех интерфейсов;
+ * ESP32_SCAN_RATE задает предел новых проб в секунду
+ */
+int esp32_scan_network(esp32_board_info_t **boards, int *count) {
+    esp32_scan_target_t targets[ESP32_SCAN_MAX_TARGETS];
+    int target_count = 0;
+    
+    *boards = NULL;
+    *count = 0;
+    
+    const char *env_discovery = getenv("ESP32_DISCOVERY");
+    if (!env_discovery || strcmp(env_discovery, "sweep") != 0) {
+        if (discover_mdns(boards, count) == 0 && *count > 0) {
+            // Объявление в mDNS живет дольше платы: статус - по последним запросам
+            for (int i = 0; i < *count; i++) {
+                esp32_apply_health(&(*boards)[i]);
+            }
+            printf("mDNS: найдено плат: %d\n", *count);
+            return 0;
+        }
+        free(*boards);
         *boards = NULL;
         *count = 0;
+        printf("mDNS: платы не объявлены, сканирование сети\n");
     }
     
-    return 0;
+    const char *env_targets = getenv("ESP32_SCAN_TARGETS");
+    if (env_targets && env_targets[0]) {
+        if (esp32_parse_scan_targets(env_targets, targets, ESP32_SCAN_MAX_TARGETS, &target_count) != 0) {
+            return -1;
+        }
+    } else if (esp32_local_scan_targets(targets, ESP32_SCAN_MAX_TARGETS, &target_count) != 0) {
+        return -1;
+    }
+    
+    esp32_scan_options_t options;
+    esp32_scan_default_options(&options);
+    const char *env_rate = getenv("ESP32_SCAN_RATE");
+    if (env_rate) {
+        options.rate_per_sec = atoi(env_rate);
+    }
+    
+    return esp32_scan_targets(targets, target_count, &options, boards, count);
 }
 
 /**
@@ -338,7 +993,10 @@ int esp32_send_data(const char *ip, const char *json_data) {
     }
     
     char url[256];
-    snprintf(url, sizeof(url), "http://%s/api/station", ip);
+    if (board_url(url, sizeof(url), ip, "/api/station") != 0) {
+        curl_easy_cleanup(curl);
+        return -1;
+    }
     
     struct curl_slist *headers = NULL;
     headers = curl_slist_append(headers, "Content-Type: application/json");
@@ -346,12 +1004,16 @@ int esp32_send_data(const char *ip, const char *json_data) {
     curl_easy_setopt(curl, CURLOPT_URL, url);
     curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data);
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, esp32_write_callback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
+    if (board_request_begin(curl, ip, 10000, 5000) != 0) {
+        curl_slist_free_all(headers);
+        curl_easy_cleanup(curl);
+        return -1;
+    }
     
     res = curl_easy_perform(curl);
+    board_request_end(curl, ip, res);
     
     curl_slist_free_all(headers);
     curl_easy_cleanup(curl);
@@ -383,15 +1045,21 @@ int esp32_get_data(const char *ip, char **response_data) {
     }
     
     char url[256];
-    snprintf(url, sizeof(url), "http://%s/api/station", ip);
+    if (board_url(url, sizeof(url), ip, "/api/station") != 0) {
+        curl_easy_cleanup(curl);
+        return -1;
+    }
     
     curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, esp32_write_callback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
+    if (board_request_begin(curl, ip, 10000, 5000) != 0) {
+        curl_easy_cleanup(curl);
+        return -1;
+    }
     
     res = curl_easy_perform(curl);
+    board_request_end(curl, ip, res);
     curl_easy_cleanup(curl);
     
     if (res != CURLE_OK) {
@@ -6,11 +6,12 @@
 #ifndef ESP32_CLIENT_H
 #define ESP32_CLIENT_H
 
+#include <stdint.h>
 #include <curl/curl.h>
 
 // Максимальные размеры строк для ESP32 данных
 #define ESP32_MAX_STRING 256
-#define ESP32_MAX_IP 16
+#define ESP32_MAX_IP 24     // IPv4 адрес, возможно с портом ("ip:port")
 
 /**
  * Структура информации о ESP32 плате
@@ -26,6 +27,37 @@ typedef struct {
     char last_seen[64];
 } esp32_board_info_t;
 
+/**
+ * Параметры сканирования сети: TCP пробы порта через epoll, затем запросы
+ * /api/info к открытым адресам через curl multi
+ */
+#define ESP32_SCAN_PORT 80
+#define ESP32_SCAN_CONNECT_TIMEOUT_MS 500
+#define ESP32_SCAN_REQUEST_TIMEOUT_MS 1000
+#define ESP32_SCAN_MAX_PROBES 256
+#define ESP32_SCAN_MAX_REQUESTS 32
+#define ESP32_SCAN_RATE 2000          // новых TCP проб в секунду на все диапазоны
+#define ESP32_SCAN_MAX_HOSTS 65536    // адресов за одно сканирование (лишние отбрасываются)
+#define ESP32_SCAN_MAX_TARGETS 32
+#define ESP32_SCAN_MIN_PREFIX 22      // подсети интерфейсов шире /22 сужаются до /22 с адресом интерфейса
+
+typedef struct {
+    int port;
+    int connect_timeout_ms;   // ожидание TCP соединения (проба и запрос)
+    int request_timeout_ms;   // весь запрос /api/info
+    int max_probes;           // одновременных TCP проб
+    int max_requests;         // одновременных запросов /api/info
+    int rate_per_sec;         // новых TCP проб в секунду (0 - без ограничения)
+} esp32_scan_options_t;
+
+/**
+ * Диапазон адресов сканирования (порядок хоста, включительно)
+ */
+typedef struct {
+    uint32_t first_ip;
+    uint32_t last_ip;
+} esp32_scan_target_t;
+
 /**
  * Структура для хранения ответа HTTP запроса
  */
@@ -41,6 +73,22 @@ typedef struct {
 // Сканирование локальной сети для поиска ESP32 плат
 int esp32_scan_network(esp32_board_info_t **boards, int *count);
 
+// Сканирование диапазонов адресов: все диапазоны пробуются одновременно
+// (адреса чередуются), общий предел скорости - options->rate_per_sec
+void esp32_scan_default_options(esp32_scan_options_t *options);
+int esp32_scan_targets(const esp32_scan_target_t *targets, int target_count, const esp32_scan_options_t *options,
+                       esp32_board_info_t **boards, int *count);
+int esp32_scan_range(uint32_t first_ip, uint32_t last_ip, const esp32_scan_options_t *options,
+                     esp32_board_info_t **boards, int *count);
+
+// Диапазоны по подсетям всех активных IPv4 интерфейсов (кроме loopback)
+int esp32_local_scan_targets(esp32_scan_target_t *targets, int max_targets, int *count);
+
+// Разбор диапазонов через запятую: "10.0.0.0/22", "10.0.4.10-10.0.4.50", "10.0.5.7"
+int esp32_parse_scan_targets(const char *spec, esp32_scan_target_t *targets, int max_targets, int *count);
+
+// Запросы к отдельной плате принимают адрес "ip" (порт 80) или "ip:port"
+
 // Подключение к конкретной ESP32 плате по IP
 int esp32_connect_to_board(const char *ip, const char *expected_type, esp32_board_info_t *board_info);
 
@@ -56,6 +104,9 @@ int esp32_ping_board(const char *ip);
 // Проверка является ли устройство ESP32 зарядной станцией
 int esp32_check_charging_board(const char *ip, esp32_board_info_t *board_info);
 
+// Статус и last_seen платы по состоянию связи (esp32_health.h)
+void esp32_apply_health(esp32_board_info_t *board_info);
+
 /**
  * Вспомогательные функции
  */
@@ -64,7 +115,7 @@ int esp32_check_charging_board(const char *ip, esp32_board_info_t *board_info);
 int get_local_network_info(char *network_base, char *subnet_mask);
 
 // Callback функция для обработки ответа CURL
-size_t curl_write_callback(void *contents, size_t size, size_t nmemb, http_response_t *response);
+size_t esp32_write_callback(char *contents, size_t size, size_t nmemb, void *userdata);
 
 // Освобождение памяти HTTP ответа
 void free_http_response(http_response_t *response);
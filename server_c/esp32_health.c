@@ -0,0 +1,254 @@
+/**
+ * Состояние связи с ESP32 платами: EWMA задержки и circuit breaker
+ * Таблица адрес -> состояние с открытой адресацией под одним мьютексом;
+ * записи не удаляются (плат в сети немного, адреса повторяются)
+ */
+
+#include "esp32_health.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#define HEALTH_MIN_CAPACITY 64
+
+typedef struct {
+    uint32_t address;         // 0 - пустая ячейка
+    int probing;              // идет пробный запрос half-open
+    esp32_health_t health;
+} health_entry_t;
+
+static pthread_mutex_t health_lock = PTHREAD_MUTEX_INITIALIZER;
+static health_entry_t *health_entries = NULL;
+static size_t health_capacity = 0;
+static size_t health_count = 0;
+static esp32_health_options_t health_options = {
+    ESP32_HEALTH_FAILURES, ESP32_HEALTH_OPEN_MS, ESP32_HEALTH_OPEN_MAX_MS, ESP32_HEALTH_MIN_TIMEOUT_MS
+};
+
+static long long health_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static size_t health_hash(uint32_t address, size_t capacity) {
+    uint32_t h = address * 2654435761u;
+    h ^= h >> 16;
+    return h & (capacity - 1);
+}
+
+/**
+ * Ключ платы - IPv4 адрес; порт ("ip:port") в ключ не входит
+ */
+static int parse_address(const char *ip, uint32_t *address) {
+    char host[INET_ADDRSTRLEN];
+    const char *colon = ip ? strchr(ip, ':') : NULL;
+    size_t length = colon ? (size_t)(colon - ip) : (ip ? strlen(ip) : 0);
+    if (!ip || length >= sizeof(host)) {
+        return -1;
+    }
+    memcpy(host, ip, length);
+    host[length] = '\0';
+
+    struct in_addr addr;
+    if (inet_pton(AF_INET, host, &addr) != 1 || addr.s_addr == 0) {
+        return -1;
+    }
+    *address = ntohl(addr.s_addr);
+    return 0;
+}
+
+static health_entry_t* find_entry(uint32_t address) {
+    if (health_capacity == 0) return NULL;
+
+    size_t pos = health_hash(address, health_capacity);
+    while (health_entries[pos].address != 0) {
+        if (health_entries[pos].address == address) {
+            return &health_entries[pos];
+        }
+        pos = (pos + 1) & (health_capacity - 1);
+    }
+    return NULL;
+}
+
+/**
+ * Перестроение таблицы с удвоенной емкостью (заполнение не больше половины)
+ */
+static int grow_entries(void) {
+    size_t capacity = health_capacity ? health_capacity * 2 : HEALTH_MIN_CAPACITY;
+    health_entry_t *entries = calloc(capacity, sizeof(health_entry_t));
+    if (!entries) return -1;
+
+    for (size_t i = 0; i < health_capacity; i++) {
+        if (health_entries[i].address == 0) continue;
+        size_t pos = health_hash(health_entries[i].address, capacity);
+        while (entries[pos].address != 0) {
+            pos = (pos + 1) & (capacity - 1);
+        }
+        entries[pos] = health_entries[i];
+    }
+    free(health_entries);
+    health_entries = entries;
+    health_capacity = capacity;
+    return 0;
+}
+
+static health_entry_t* get_entry(uint32_t address) {
+    health_entry_t *entry = find_entry(address);
+    if (entry) return entry;
+
+    if ((health_count + 1) * 2 > health_capacity && grow_entries() != 0) {
+        return NULL;
+    }
+    size_t pos = health_hash(address, health_capacity);
+    while (health_entries[pos].address != 0) {
+        pos = (pos + 1) & (health_capacity - 1);
+    }
+    entry = &health_entries[pos];
+    memset(entry, 0, sizeof(*entry));
+    entry->address = address;
+    health_count++;
+    return entry;
+}
+
+/**
+ * Открытие автомата: пауза удваивается с каждым открытием подряд
+ */
+static void open_breaker(esp32_health_t *health, long long now_ms) {
+    long long pause_ms = health_options.open_ms;
+    for (int i = 0; i < health->trips && pause_ms < health_options.open_max_ms; i++) {
+        pause_ms *= 2;
+    }
+    if (pause_ms > health_options.open_max_ms) pause_ms = health_options.open_max_ms;
+
+    health->state = ESP32_BREAKER_OPEN;
+    health->trips++;
+    health->retry_at_ms = now_ms + pause_ms;
+}
+
+void esp32_health_default_options(esp32_health_options_t *options) {
+    options->failures = ESP32_HEALTH_FAILURES;
+    options->open_ms = ESP32_HEALTH_OPEN_MS;
+    options->open_max_ms = ESP32_HEALTH_OPEN_MAX_MS;
+    options->min_timeout_ms = ESP32_HEALTH_MIN_TIMEOUT_MS;
+}
+
+void esp32_health_set_options(const esp32_health_options_t *options) {
+    pthread_mutex_lock(&health_lock);
+    health_options = *options;
+    if (health_options.failures < 1) health_options.failures = 1;
+    if (health_options.open_max_ms < health_options.open_ms) health_options.open_max_ms = health_options.open_ms;
+    pthread_mutex_unlock(&health_lock);
+}
+
+/**
+ * Разрешение запроса. Адреса, которые не разбираются как IPv4, не
+ * отслеживаются и пропускаются с исходным таймаутом
+ */
+int esp32_health_begin(const char *ip, int timeout_ms, int *limit_ms) {
+    *limit_ms = timeout_ms;
+
+    uint32_t address;
+    if (parse_address(ip, &address) != 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&health_lock);
+    health_entry_t *entry = get_entry(address);
+    if (!entry) {
+        pthread_mutex_unlock(&health_lock);
+        return 0;
+    }
+    esp32_health_t *health = &entry->health;
+
+    if (health->state == ESP32_BREAKER_OPEN && health_now_ms() >= health->retry_at_ms) {
+        health->state = ESP32_BREAKER_HALF_OPEN;
+        entry->probing = 0;
+    }
+
+    int result = 0;
+    if (health->state == ESP32_BREAKER_OPEN || (health->state == ESP32_BREAKER_HALF_OPEN && entry->probing)) {
+        health->short_circuits++;
+        result = -1;
+    } else if (health->state == ESP32_BREAKER_HALF_OPEN) {
+        // Проба: плата долго не отвечала, ждать ее полный таймаут незачем
+        entry->probing = 1;
+        if (*limit_ms > health_options.min_timeout_ms) *limit_ms = health_options.min_timeout_ms;
+    } else if (health->latency_ms > 0) {
+        int adaptive_ms = (int)(health->latency_ms * ESP32_HEALTH_TIMEOUT_FACTOR);
+        if (adaptive_ms < health_options.min_timeout_ms) adaptive_ms = health_options.min_timeout_ms;
+        if (adaptive_ms < *limit_ms) *limit_ms = adaptive_ms;
+    }
+    pthread_mutex_unlock(&health_lock);
+    return result;
+}
+
+/**
+ * Итог запроса: успех закрывает автомат в любом состоянии, ошибка
+ * открывает его после порога или после неудачной пробы
+ */
+void esp32_health_report(const char *ip, int ok, double latency_ms) {
+    uint32_t address;
+    if (parse_address(ip, &address) != 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&health_lock);
+    health_entry_t *entry = get_entry(address);
+    if (!entry) {
+        pthread_mutex_unlock(&health_lock);
+        return;
+    }
+    esp32_health_t *health = &entry->health;
+    health->requests++;
+
+    if (ok) {
+        health->latency_ms = health->latency_ms > 0 ?
+            health->latency_ms + ESP32_HEALTH_EWMA_ALPHA * (latency_ms - health->latency_ms) : latency_ms;
+        health->failures = 0;
+        health->trips = 0;
+        health->state = ESP32_BREAKER_CLOSED;
+        health->last_seen = time(NULL);
+    } else {
+        health->failures++;
+        if (health->state == ESP32_BREAKER_HALF_OPEN ||
+            (health->state == ESP32_BREAKER_CLOSED && health->failures >= health_options.failures)) {
+            open_breaker(health, health_now_ms());
+        }
+    }
+    if (health->state != ESP32_BREAKER_HALF_OPEN) {
+        entry->probing = 0;
+    }
+    pthread_mutex_unlock(&health_lock);
+}
+
+int esp32_health_get(const char *ip, esp32_health_t *health) {
+    uint32_t address;
+    if (parse_address(ip, &address) != 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&health_lock);
+    health_entry_t *entry = find_entry(address);
+    if (entry) {
+        *health = entry->health;
+        // Пауза могла истечь без запросов: автомат откроется пробе
+        if (health->state == ESP32_BREAKER_OPEN && health_now_ms() >= health->retry_at_ms) {
+            health->state = ESP32_BREAKER_HALF_OPEN;
+        }
+    }
+    pthread_mutex_unlock(&health_lock);
+    return entry ? 0 : -1;
+}
+
+void esp32_health_reset(void) {
+    pthread_mutex_lock(&health_lock);
+    free(health_entries);
+    health_entries = NULL;
+    health_capacity = 0;
+    health_count = 0;
+    pthread_mutex_unlock(&health_lock);
+}
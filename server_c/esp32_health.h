@@ -0,0 +1,65 @@
+/**
+ * Состояние связи с ESP32 платами
+ * Для каждого адреса ("ip" или "ip:port", порт не различается) хранятся EWMA задержки успешных запросов, ошибки
+ * подряд и автомат (circuit breaker): closed - запросы идут как обычно;
+ * open - после ESP32_HEALTH_FAILURES ошибок подряд запросы к плате сразу
+ * отклоняются, не дожидаясь таймаутов; half-open - по истечении паузы
+ * пропускается один пробный запрос, успех закрывает автомат, ошибка снова
+ * открывает его с вдвое большей паузой.
+ * Таймаут запроса к отвечавшей плате сокращается по ее EWMA задержки
+ */
+
+#ifndef ESP32_HEALTH_H
+#define ESP32_HEALTH_H
+
+#include <time.h>
+
+#define ESP32_HEALTH_FAILURES 3           // ошибок подряд до открытия автомата
+#define ESP32_HEALTH_OPEN_MS 5000         // первая пауза перед пробным запросом
+#define ESP32_HEALTH_OPEN_MAX_MS 300000   // предел удвоения паузы
+#define ESP32_HEALTH_MIN_TIMEOUT_MS 1000  // нижняя граница таймаута по задержке и таймаут пробы
+#define ESP32_HEALTH_TIMEOUT_FACTOR 10    // таймаут - столько EWMA задержек
+#define ESP32_HEALTH_EWMA_ALPHA 0.2
+
+typedef enum {
+    ESP32_BREAKER_CLOSED = 0,
+    ESP32_BREAKER_OPEN,
+    ESP32_BREAKER_HALF_OPEN
+} esp32_breaker_state_t;
+
+typedef struct {
+    int failures;             // ошибок подряд до открытия
+    int open_ms;
+    int open_max_ms;
+    int min_timeout_ms;
+} esp32_health_options_t;
+
+typedef struct {
+    esp32_breaker_state_t state;
+    double latency_ms;        // EWMA задержки успешных запросов (0 - не было)
+    int failures;             // ошибок подряд
+    int trips;                // открытий подряд без успешного запроса
+    long long retry_at_ms;    // монотонное время пробного запроса (open)
+    time_t last_seen;         // последний успешный ответ (0 - не было)
+    long requests;            // завершенных запросов
+    long short_circuits;      // отклоненных без обращения к плате
+} esp32_health_t;
+
+void esp32_health_default_options(esp32_health_options_t *options);
+void esp32_health_set_options(const esp32_health_options_t *options);
+
+// Разрешение запроса к плате: -1 - автомат открыт (или проба уже идет),
+// иначе в *limit_ms - таймаут запроса, не больше timeout_ms.
+// На каждое разрешение должен прийти esp32_health_report
+int esp32_health_begin(const char *ip, int timeout_ms, int *limit_ms);
+
+// Итог запроса; вызывается и без esp32_health_begin (опрос, сканирование)
+void esp32_health_report(const char *ip, int ok, double latency_ms);
+
+// Состояние платы (-1 - с платой еще не было запросов)
+int esp32_health_get(const char *ip, esp32_health_t *health);
+
+// Забыть все платы
+void esp32_health_reset(void);
+
+#endif // ESP32_HEALTH_H
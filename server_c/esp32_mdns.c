@@ -0,0 +1,822 @@
+/**
+ * Обнаружение ESP32 плат через mDNS/DNS-SD (RFC 6762, RFC 6763)
+ *
+ * Платы объявляют службу при запуске и отвечают на запросы PTR записями
+ * PTR (экземпляр), SRV (хост и порт), TXT (данные платы) и A (адрес).
+ * Реестр обновляется по любым ответам в группе, в том числе на чужие
+ * запросы, а в свои запросы добавляются уже известные экземпляры (known
+ * answers), чтобы платы не повторяли их без необходимости
+ */
+
+#include "esp32_mdns.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_PTR 12
+#define DNS_TYPE_TXT 16
+#define DNS_TYPE_SRV 33
+#define DNS_CLASS_IN 1
+#define DNS_CLASS_MASK 0x7FFF     // старший бит - cache-flush в ответах
+#define DNS_FLAG_RESPONSE 0x8000
+#define DNS_NAME_MAX 256
+#define DNS_LABEL_MAX 63
+#define MDNS_PACKET_MAX 9000      // ответы mDNS могут превышать 512 байт
+#define MDNS_QUERY_MAX 1400       // запрос с known answers - в один кадр Ethernet
+
+/**
+ * Экземпляр службы в реестре
+ */
+typedef struct {
+    char instance[DNS_NAME_MAX];   // "Плата._chargestation._tcp.local"
+    char host[DNS_NAME_MAX];       // цель SRV
+    uint16_t port;
+    uint32_t address;              // из записи A (порядок хоста), 0 - неизвестен
+    esp32_board_info_t info;       // id, type, name, technical_name, max_power из TXT
+    long received_ms;              // последнее объявление
+    long ttl_ms;
+    int refresh_stage;             // отправлено запросов обновления (80, 85, 90, 95% TTL)
+    time_t seen;
+} mdns_service_t;
+
+/**
+ * Адрес хоста из записи A: SRV и A могут прийти в разных пакетах
+ */
+typedef struct {
+    char name[DNS_NAME_MAX];
+    uint32_t address;
+    long expires_ms;
+} mdns_host_t;
+
+static char mdns_service_name[DNS_NAME_MAX];
+static mdns_service_t *mdns_services = NULL;
+static int mdns_service_count = 0;
+static mdns_host_t *mdns_hosts = NULL;
+static int mdns_host_count = 0;
+
+static int mdns_fd = -1;
+static int mdns_wake_fd = -1;
+static struct sockaddr_in mdns_group;
+static struct in_addr mdns_interfaces[ESP32_MDNS_MAX_INTERFACES];
+static int mdns_interface_count = 0;   // 0 - интерфейс по умолчанию
+
+static int mdns_running = 0;
+static int mdns_stop = 0;
+static int mdns_query_now = 0;
+static long mdns_queries = 0;
+
+static pthread_t mdns_thread;
+static pthread_mutex_t mdns_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mdns_changed;   // в реестре появилась плата с адресом
+
+static long mdns_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static uint16_t read16(const unsigned char *data) {
+    return (uint16_t)(data[0] << 8 | data[1]);
+}
+
+static uint32_t read32(const unsigned char *data) {
+    return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3];
+}
+
+static void write16(unsigned char *data, uint16_t value) {
+    data[0] = (unsigned char)(value >> 8);
+    data[1] = (unsigned char)value;
+}
+
+static void write32(unsigned char *data, uint32_t value) {
+    write16(data, (uint16_t)(value >> 16));
+    write16(data + 2, (uint16_t)value);
+}
+
+/**
+ * Чтение имени со сжатием (RFC 1035, 4.1.4) в виде "метка.метка.local".
+ * Возвращает смещение за именем или -1 для поврежденного пакета
+ */
+static int read_name(const unsigned char *packet, int length, int offset, char *name, size_t size) {
+    int end = -1;
+    int jumps = 0;
+    size_t used = 0;
+    name[0] = '\0';
+
+    for (;;) {
+        if (offset >= length) return -1;
+        unsigned char label = packet[offset];
+        if (label == 0) {
+            offset++;
+            break;
+        }
+        if ((label & 0xC0) == 0xC0) {
+            if (offset + 1 >= length || ++jumps > 16) return -1;
+            if (end < 0) end = offset + 2;
+            offset = (label & 0x3F) << 8 | packet[offset + 1];
+            continue;
+        }
+        if ((label & 0xC0) != 0 || offset + 1 + label > length || used + label + 2 > size) {
+            return -1;
+        }
+        if (used > 0) name[used++] = '.';
+        memcpy(name + used, packet + offset + 1, label);
+        used += label;
+        name[used] = '\0';
+        offset += 1 + label;
+    }
+    return end >= 0 ? end : offset;
+}
+
+/**
+ * Запись имени метками без сжатия. Возвращает смещение за именем или -1
+ */
+static int write_name(unsigned char *packet, int offset, int size, const char *name) {
+    while (*name) {
+        const char *dot = strchr(name, '.');
+        int label = dot ? (int)(dot - name) : (int)strlen(name);
+        if (label == 0 || label > DNS_LABEL_MAX || offset + 1 + label >= size) return -1;
+        packet[offset++] = (unsigned char)label;
+        memcpy(packet + offset, name, label);
+        offset += label;
+        name += label + (dot ? 1 : 0);
+    }
+    if (offset >= size) return -1;
+    packet[offset++] = 0;
+    return offset;
+}
+
+/**
+ * Длина метки экземпляра, если name - экземпляр нашей службы, иначе 0
+ */
+static size_t instance_label(const char *name) {
+    size_t length = strlen(name);
+    size_t service_length = strlen(mdns_service_name);
+    if (length <= service_length + 1 || name[length - service_length - 1] != '.' ||
+        strcasecmp(name + length - service_length, mdns_service_name) != 0) {
+        return 0;
+    }
+    return length - service_length - 1;
+}
+
+static mdns_service_t* find_service(const char *instance) {
+    for (int i = 0; i < mdns_service_count; i++) {
+        if (strcasecmp(mdns_services[i].instance, instance) == 0) {
+            return &mdns_services[i];
+        }
+    }
+    return NULL;
+}
+
+static void remove_service(mdns_service_t *service) {
+    *service = mdns_services[--mdns_service_count];
+}
+
+static uint32_t host_address(const char *name, long now) {
+    for (int i = 0; i < mdns_host_count; i++) {
+        if (mdns_hosts[i].expires_ms > now && strcasecmp(mdns_hosts[i].name, name) == 0) {
+            return mdns_hosts[i].address;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Экземпляр из PTR, SRV или TXT: новый получает имя и id по метке экземпляра,
+ * пока не пришла TXT
+ */
+static mdns_service_t* add_service(const char *instance, long now) {
+    mdns_service_t *service = find_service(instance);
+    if (service) {
+        return service;
+    }
+    size_t label = instance_label(instance);
+    if (label == 0 || mdns_service_count == ESP32_MDNS_MAX_SERVICES) {
+        return NULL;
+    }
+
+    service = &mdns_services[mdns_service_count++];
+    memset(service, 0, sizeof(*service));
+    strncpy(service->instance, instance, sizeof(service->instance) - 1);
+    snprintf(service->info.id, sizeof(service->info.id), "%.*s", (int)label, instance);
+    snprintf(service->info.name, sizeof(service->info.name), "%.*s", (int)label, instance);
+    service->received_ms = now;
+    return service;
+}
+
+static void touch_service(mdns_service_t *service, uint32_t ttl, long now) {
+    service->received_ms = now;
+    service->ttl_ms = (long)ttl * 1000;
+    service->refresh_stage = 0;
+    service->seen = time(NULL);
+}
+
+/**
+ * TXT: строки "ключ=значение" с длиной в первом байте
+ */
+static void parse_txt(mdns_service_t *service, const unsigned char *data, int length) {
+    esp32_board_info_t *info = &service->info;
+    int offset = 0;
+    while (offset < length) {
+        int size = data[offset++];
+        if (offset + size > length) break;
+
+        const char *entry = (const char *)data + offset;
+        const char *equals = memchr(entry, '=', size);
+        offset += size;
+        if (!equals) continue;
+
+        int key_length = (int)(equals - entry);
+        int value_length = size - key_length - 1;
+        const char *value = equals + 1;
+
+        if (key_length == 2 && strncasecmp(entry, "id", 2) == 0) {
+            snprintf(info->id, sizeof(info->id), "%.*s", value_length, value);
+        } else if (key_length == 4 && strncasecmp(entry, "type", 4) == 0) {
+            snprintf(info->type, sizeof(info->type), "%.*s", value_length, value);
+        } else if (key_length == 4 && strncasecmp(entry, "name", 4) == 0) {
+            snprintf(info->name, sizeof(info->name), "%.*s", value_length, value);
+        } else if (key_length == 13 && strncasecmp(entry, "technicalName", 13) == 0) {
+            snprintf(info->technical_name, sizeof(info->technical_name), "%.*s", value_length, value);
+        } else if (key_length == 8 && strncasecmp(entry, "maxPower", 8) == 0) {
+            char number[32];
+            snprintf(number, sizeof(number), "%.*s", value_length, value);
+            info->max_power = strtof(number, NULL);
+        }
+    }
+}
+
+static void set_host_address(const char *name, uint32_t address, uint32_t ttl, long now) {
+    mdns_host_t *host = NULL;
+    for (int i = 0; i < mdns_host_count; i++) {
+        if (strcasecmp(mdns_hosts[i].name, name) == 0) {
+            host = &mdns_hosts[i];
+            break;
+        }
+    }
+    if (!host) {
+        // Место истекшей записи или новое
+        for (int i = 0; i < mdns_host_count && !host; i++) {
+            if (mdns_hosts[i].expires_ms <= now) host = &mdns_hosts[i];
+        }
+        if (!host && mdns_host_count < ESP32_MDNS_MAX_SERVICES) {
+            host = &mdns_hosts[mdns_host_count++];
+        }
+        if (!host) return;
+        strncpy(host->name, name, sizeof(host->name) - 1);
+        host->name[sizeof(host->name) - 1] = '\0';
+    }
+    host->address = address;
+    host->expires_ms = now + (long)ttl * 1000;
+
+    for (int i = 0; i < mdns_service_count; i++) {
+        if (strcasecmp(mdns_services[i].host, name) == 0) {
+            mdns_services[i].address = ttl > 0 ? address : 0;
+        }
+    }
+}
+
+/**
+ * Одна запись ответа. TTL 0 - прощание (goodbye): экземпляр удаляется
+ */
+static void handle_record(const unsigned char *packet, int length, const char *name, int type,
+                          uint32_t ttl, int data, int data_length, long now) {
+    char target[DNS_NAME_MAX];
+    mdns_service_t *service;
+
+    switch (type) {
+        case DNS_TYPE_PTR:
+            if (strcasecmp(name, mdns_service_name) != 0 ||
+                read_name(packet, length, data, target, sizeof(target)) < 0) {
+                return;
+            }
+            if (ttl == 0) {
+                service = find_service(target);
+                if (service) remove_service(service);
+                return;
+            }
+            service = add_service(target, now);
+            if (service) touch_service(service, ttl, now);
+            return;
+
+        case DNS_TYPE_SRV:
+            if (data_length < 7 || instance_label(name) == 0) return;
+            if (ttl == 0) {
+                service = find_service(name);
+                if (service) remove_service(service);
+                return;
+            }
+            service = add_service(name, now);
+            if (!service || read_name(packet, length, data + 6, target, sizeof(target)) < 0) return;
+            service->port = read16(packet + data + 4);
+            strcpy(service->host, target);
+            if (!service->address) service->address = host_address(target, now);
+            if (service->ttl_ms == 0) touch_service(service, ttl, now);
+            return;
+
+        case DNS_TYPE_TXT:
+            if (ttl == 0 || instance_label(name) == 0) return;
+            service = add_service(name, now);
+            if (!service) return;
+            parse_txt(service, packet + data, data_length);
+            if (service->ttl_ms == 0) touch_service(service, ttl, now);
+            return;
+
+        case DNS_TYPE_A:
+            if (data_length == 4) set_host_address(name, read32(packet + data), ttl, now);
+            return;
+    }
+}
+
+static int known_boards(void) {
+    int count = 0;
+    for (int i = 0; i < mdns_service_count; i++) {
+        if (mdns_services[i].address) count++;
+    }
+    return count;
+}
+
+/**
+ * Разбор ответа: записи всех разделов (PTR обычно в ответах, SRV, TXT и A -
+ * в дополнительных). Запросы, в том числе свои, пропускаются
+ */
+static void handle_packet(const unsigned char *packet, int length, long now) {
+    if (length < 12 || !(read16(packet + 2) & DNS_FLAG_RESPONSE)) {
+        return;
+    }
+    int questions = read16(packet + 4);
+    int records = read16(packet + 6) + read16(packet + 8) + read16(packet + 10);
+
+    char name[DNS_NAME_MAX];
+    int offset = 12;
+    for (int i = 0; i < questions; i++) {
+        offset = read_name(packet, length, offset, name, sizeof(name));
+        if (offset < 0 || offset + 4 > length) return;
+        offset += 4;
+    }
+
+    pthread_mutex_lock(&mdns_lock);
+    int before = known_boards();
+    for (int i = 0; i < records; i++) {
+        offset = read_name(packet, length, offset, name, sizeof(name));
+        if (offset < 0 || offset + 10 > length) break;
+
+        int type = read16(packet + offset);
+        int class = read16(packet + offset + 2) & DNS_CLASS_MASK;
+        uint32_t ttl = read32(packet + offset + 4);
+        int data_length = read16(packet + offset + 8);
+        int data = offset + 10;
+        if (data + data_length > length) break;
+
+        if (class == DNS_CLASS_IN) {
+            handle_record(packet, length, name, type, ttl, data, data_length, now);
+        }
+        offset = data + data_length;
+    }
+    if (known_boards() != before) {
+        pthread_cond_broadcast(&mdns_changed);
+    }
+    pthread_mutex_unlock(&mdns_lock);
+}
+
+/**
+ * Истекшие экземпляры удаляются; на 80, 85, 90 и 95% TTL нужен запрос
+ * обновления (RFC 6762, 5.2). Возвращает 1, если запрос нужен, и срок
+ * следующего события в *next
+ */
+static int expire_services(long now, long *next) {
+    int query = 0;
+    for (int i = 0; i < mdns_service_count; i++) {
+        mdns_service_t *service = &mdns_services[i];
+        long expires = service->received_ms + service->ttl_ms;
+        if (expires <= now) {
+            remove_service(service);
+            i--;
+            continue;
+        }
+
+        long due = expires;
+        if (service->refresh_stage < 4) {
+            long refresh = service->received_ms + service->ttl_ms * (80 + 5 * service->refresh_stage) / 100;
+            if (refresh <= now) {
+                service->refresh_stage++;
+                query = 1;
+                if (service->refresh_stage < 4) {
+                    refresh += service->ttl_ms * 5 / 100;
+                }
+            }
+            if (service->refresh_stage < 4) due = refresh;
+        }
+        if (due < *next) *next = due;
+    }
+    return query;
+}
+
+/**
+ * Запрос PTR службы с известными экземплярами, у которых осталось больше
+ * половины TTL (known-answer suppression, RFC 6762, 7.1). Ответы, не
+ * поместившиеся в пакет, уходят в следующих пакетах без вопроса, а у
+ * предыдущего ставится флаг TC. *position - с какого экземпляра начать,
+ * после последнего пакета -1. Имя службы всегда лежит по смещению 12
+ * (в вопросе или в первом ответе), остальные записи ссылаются на него
+ */
+static int build_query(unsigned char *packet, long now, int *position) {
+    int first = *position == 0;
+    memset(packet, 0, 12);
+    int offset = write_name(packet, 12, MDNS_QUERY_MAX, mdns_service_name);
+    if (offset < 0 || offset + 4 > MDNS_QUERY_MAX) return -1;
+    if (first) {
+        write16(packet + 4, 1);
+        write16(packet + offset, DNS_TYPE_PTR);
+        write16(packet + offset + 2, DNS_CLASS_IN);
+        offset += 4;
+    }
+
+    int answers = 0;
+    int i;
+    for (i = *position; i < mdns_service_count; i++) {
+        mdns_service_t *service = &mdns_services[i];
+        long remaining = service->received_ms + service->ttl_ms - now;
+        size_t label = instance_label(service->instance);
+        if (remaining <= service->ttl_ms / 2 || label == 0 || label > DNS_LABEL_MAX) continue;
+
+        int data_length = 1 + (int)label + 2;
+        if (offset + 12 + data_length > MDNS_QUERY_MAX) break;
+
+        if (first || answers > 0) {
+            write16(packet + offset, 0xC00C);
+            offset += 2;
+        }
+        write16(packet + offset, DNS_TYPE_PTR);
+        write16(packet + offset + 2, DNS_CLASS_IN);
+        write32(packet + offset + 4, (uint32_t)(remaining / 1000));
+        write16(packet + offset + 8, (uint16_t)data_length);
+        offset += 10;
+        packet[offset++] = (unsigned char)label;
+        memcpy(packet + offset, service->instance, label);
+        offset += (int)label;
+        write16(packet + offset, 0xC00C);
+        offset += 2;
+        answers++;
+    }
+
+    *position = i < mdns_service_count ? i : -1;
+    if (*position >= 0) {
+        write16(packet + 2, 0x0200);   // TC: известные ответы продолжаются
+    }
+    write16(packet + 6, (uint16_t)answers);
+    return first || answers > 0 ? offset : 0;
+}
+
+static void send_query(const unsigned char *packet, int length) {
+    int interfaces = mdns_interface_count > 0 ? mdns_interface_count : 1;
+    for (int i = 0; i < interfaces; i++) {
+        if (mdns_interface_count > 0) {
+            setsockopt(mdns_fd, IPPROTO_IP, IP_MULTICAST_IF, &mdns_interfaces[i], sizeof(mdns_interfaces[i]));
+        }
+        if (sendto(mdns_fd, packet, length, 0, (struct sockaddr *)&mdns_group, sizeof(mdns_group)) < 0) {
+            printf("mDNS: не удалось отправить запрос: %s\n", strerror(errno));
+        }
+    }
+}
+
+/**
+ * Поток обнаружения: прием ответов, периодические запросы (интервал
+ * удваивается от ESP32_MDNS_QUERY_MIN_MS до ESP32_MDNS_QUERY_MAX_MS),
+ * обновление и удаление записей по TTL
+ */
+static void* mdns_thread_main(void *arg) {
+    (void)arg;
+    unsigned char *packet = malloc(MDNS_PACKET_MAX);
+    unsigned char query[MDNS_QUERY_MAX];
+    long interval = ESP32_MDNS_QUERY_MIN_MS;
+    long next_query = mdns_now_ms();
+
+    while (packet) {
+        long now = mdns_now_ms();
+        long next = next_query;
+
+        pthread_mutex_lock(&mdns_lock);
+        if (mdns_stop) {
+            pthread_mutex_unlock(&mdns_lock);
+            break;
+        }
+        if (mdns_query_now) {
+            mdns_query_now = 0;
+            interval = ESP32_MDNS_QUERY_MIN_MS;
+            next_query = now;
+        }
+        int periodic = now >= next_query;
+        if (expire_services(now, &next) || periodic) {
+            // Пакеты запроса строятся по реестру и уходят под блокировкой:
+            // sendto для UDP не ждет получателя
+            int position = 0;
+            while (position >= 0) {
+                int length = build_query(query, now, &position);
+                if (length <= 0) break;
+                send_query(query, length);
+            }
+            mdns_queries++;
+        }
+        pthread_mutex_unlock(&mdns_lock);
+        if (periodic) {
+            next_query = now + interval;
+            interval = interval * 2 < ESP32_MDNS_QUERY_MAX_MS ? interval * 2 : ESP32_MDNS_QUERY_MAX_MS;
+            if (next_query < next) next = next_query;
+        }
+
+        struct pollfd fds[2] = {
+            { .fd = mdns_fd, .events = POLLIN },
+            { .fd = mdns_wake_fd, .events = POLLIN },
+        };
+        long wait_ms = next - mdns_now_ms();
+        if (poll(fds, 2, wait_ms > 0 ? (int)wait_ms : 0) < 0 && errno != EINTR) {
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t value;
+            if (read(mdns_wake_fd, &value, sizeof(value)) < 0) {
+                // счетчик уже сброшен
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            ssize_t length;
+            while ((length = recv(mdns_fd, packet, MDNS_PACKET_MAX, MSG_DONTWAIT)) > 0) {
+                handle_packet(packet, (int)length, mdns_now_ms());
+            }
+        }
+    }
+    free(packet);
+    return NULL;
+}
+
+static void mdns_wake(void) {
+    uint64_t value = 1;
+    if (write(mdns_wake_fd, &value, sizeof(value)) < 0) {
+        // счетчик переполнен - поток и так проснется
+    }
+}
+
+/**
+ * Присоединение к группе на заданном интерфейсе или на всех активных
+ * multicast интерфейсах, кроме loopback
+ */
+static int join_group(const char *interface) {
+    mdns_interface_count = 0;
+    struct ip_mreq request;
+    request.imr_multiaddr = mdns_group.sin_addr;
+
+    if (interface) {
+        if (inet_pton(AF_INET, interface, &request.imr_interface) != 1 ||
+            setsockopt(mdns_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) != 0) {
+            return -1;
+        }
+        mdns_interfaces[mdns_interface_count++] = request.imr_interface;
+        return 0;
+    }
+
+    struct ifaddrs *ifaddrs_ptr;
+    if (getifaddrs(&ifaddrs_ptr) == 0) {
+        for (struct ifaddrs *ifa = ifaddrs_ptr; ifa; ifa = ifa->ifa_next) {
+            if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET ||
+                !(ifa->ifa_flags & IFF_UP) || !(ifa->ifa_flags & IFF_MULTICAST) ||
+                (ifa->ifa_flags & IFF_LOOPBACK) || mdns_interface_count == ESP32_MDNS_MAX_INTERFACES) {
+                continue;
+            }
+            request.imr_interface = ((struct sockaddr_in *)ifa->ifa_addr)->sin_addr;
+            if (setsockopt(mdns_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) == 0) {
+                mdns_interfaces[mdns_interface_count++] = request.imr_interface;
+            }
+        }
+        freeifaddrs(ifaddrs_ptr);
+    }
+    if (mdns_interface_count > 0) {
+        return 0;
+    }
+
+    // Интерфейс выберет таблица маршрутизации
+    request.imr_interface.s_addr = htonl(INADDR_ANY);
+    return setsockopt(mdns_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request));
+}
+
+/**
+ * Параметры обнаружения по умолчанию
+ */
+void esp32_mdns_default_options(esp32_mdns_options_t *options) {
+    options->interface = NULL;
+    options->port = ESP32_MDNS_PORT;
+    options->service = ESP32_MDNS_SERVICE;
+}
+
+/**
+ * Запуск обнаружения: сокет в группе и поток, первый запрос - сразу
+ */
+int esp32_mdns_start(const esp32_mdns_options_t *options) {
+    esp32_mdns_options_t defaults;
+    if (!options) {
+        esp32_mdns_default_options(&defaults);
+        options = &defaults;
+    }
+
+    pthread_mutex_lock(&mdns_lock);
+    if (mdns_running) {
+        pthread_mutex_unlock(&mdns_lock);
+        return -1;
+    }
+
+    snprintf(mdns_service_name, sizeof(mdns_service_name), "%s", options->service);
+    mdns_group.sin_family = AF_INET;
+    mdns_group.sin_port = htons((uint16_t)options->port);
+    inet_pton(AF_INET, ESP32_MDNS_GROUP, &mdns_group.sin_addr);
+
+    mdns_services = calloc(ESP32_MDNS_MAX_SERVICES, sizeof(mdns_service_t));
+    mdns_hosts = calloc(ESP32_MDNS_MAX_SERVICES, sizeof(mdns_host_t));
+    mdns_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    mdns_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    int reuse = 1;
+    unsigned char ttl = 255, loop = 1;
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = mdns_group.sin_port;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    // Порт 5353 может быть занят системным демоном (avahi): нужен SO_REUSEPORT
+    int ready = mdns_services && mdns_hosts && mdns_fd >= 0 && mdns_wake_fd >= 0 &&
+                setsockopt(mdns_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == 0 &&
+                setsockopt(mdns_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == 0 &&
+                bind(mdns_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+                join_group(options->interface) == 0 &&
+                setsockopt(mdns_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) == 0 &&
+                setsockopt(mdns_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) == 0;
+
+    if (ready) {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&mdns_changed, &attr);
+        pthread_condattr_destroy(&attr);
+
+        mdns_stop = 0;
+        mdns_query_now = 0;
+        mdns_queries = 0;
+        mdns_service_count = 0;
+        mdns_host_count = 0;
+        ready = pthread_create(&mdns_thread, NULL, mdns_thread_main, NULL) == 0;
+    }
+
+    if (!ready) {
+        printf("mDNS: не удалось запустить обнаружение: %s\n", strerror(errno));
+        if (mdns_fd >= 0) close(mdns_fd);
+        if (mdns_wake_fd >= 0) close(mdns_wake_fd);
+        mdns_fd = mdns_wake_fd = -1;
+        free(mdns_services);
+        free(mdns_hosts);
+        mdns_services = NULL;
+        mdns_hosts = NULL;
+        pthread_mutex_unlock(&mdns_lock);
+        return -1;
+    }
+
+    mdns_running = 1;
+    printf("mDNS: обнаружение %s (интерфейсов: %d)\n", mdns_service_name,
+           mdns_interface_count > 0 ? mdns_interface_count : 1);
+    pthread_mutex_unlock(&mdns_lock);
+    return 0;
+}
+
+/**
+ * Остановка обнаружения: поток завершается, реестр очищается
+ */
+void esp32_mdns_stop(void) {
+    pthread_mutex_lock(&mdns_lock);
+    if (!mdns_running) {
+        pthread_mutex_unlock(&mdns_lock);
+        return;
+    }
+    mdns_stop = 1;
+    pthread_mutex_unlock(&mdns_lock);
+
+    mdns_wake();
+    pthread_join(mdns_thread, NULL);
+
+    pthread_mutex_lock(&mdns_lock);
+    close(mdns_fd);
+    close(mdns_wake_fd);
+    mdns_fd = mdns_wake_fd = -1;
+    free(mdns_services);
+    free(mdns_hosts);
+    mdns_services = NULL;
+    mdns_hosts = NULL;
+    mdns_service_count = 0;
+    mdns_host_count = 0;
+    mdns_running = 0;
+    pthread_cond_broadcast(&mdns_changed);
+    pthread_cond_destroy(&mdns_changed);
+    pthread_mutex_unlock(&mdns_lock);
+}
+
+int esp32_mdns_running(void) {
+    pthread_mutex_lock(&mdns_lock);
+    int running = mdns_running;
+    pthread_mutex_unlock(&mdns_lock);
+    return running;
+}
+
+void esp32_mdns_query(void) {
+    pthread_mutex_lock(&mdns_lock);
+    int running = mdns_running;
+    if (running) mdns_query_now = 1;
+    pthread_mutex_unlock(&mdns_lock);
+    if (running) mdns_wake();
+}
+
+long esp32_mdns_query_count(void) {
+    pthread_mutex_lock(&mdns_lock);
+    long queries = mdns_queries;
+    pthread_mutex_unlock(&mdns_lock);
+    return queries;
+}
+
+/**
+ * Ожидание первой платы с адресом не дольше timeout_ms
+ */
+int esp32_mdns_wait(int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&mdns_lock);
+    int count = mdns_running ? known_boards() : 0;
+    while (mdns_running && count == 0) {
+        if (pthread_cond_timedwait(&mdns_changed, &mdns_lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+        count = mdns_running ? known_boards() : 0;
+    }
+    pthread_mutex_unlock(&mdns_lock);
+    return count;
+}
+
+static int compare_boards(const void *a, const void *b) {
+    uint32_t left = ntohl(inet_addr(((const esp32_board_info_t *)a)->ip));
+    uint32_t right = ntohl(inet_addr(((const esp32_board_info_t *)b)->ip));
+    return left < right ? -1 : left > right;
+}
+
+/**
+ * Копия реестра в формате результатов сканирования
+ */
+int esp32_mdns_boards(esp32_board_info_t **boards, int *count) {
+    *boards = NULL;
+    *count = 0;
+
+    pthread_mutex_lock(&mdns_lock);
+    int total = known_boards();
+    esp32_board_info_t *result = malloc((total > 0 ? (size_t)total : 1) * sizeof(esp32_board_info_t));
+    if (!result) {
+        pthread_mutex_unlock(&mdns_lock);
+        return -1;
+    }
+
+    int found = 0;
+    for (int i = 0; i < mdns_service_count; i++) {
+        mdns_service_t *service = &mdns_services[i];
+        if (!service->address) continue;
+
+        esp32_board_info_t *board = &result[found++];
+        *board = service->info;
+        struct in_addr addr = { .s_addr = htonl(service->address) };
+        inet_ntop(AF_INET, &addr, board->ip, sizeof(board->ip));
+        strcpy(board->status, "online");
+
+        struct tm tm_info;
+        localtime_r(&service->seen, &tm_info);
+        strftime(board->last_seen, sizeof(board->last_seen), "%Y-%m-%d %H:%M:%S", &tm_info);
+    }
+    pthread_mutex_unlock(&mdns_lock);
+
+    qsort(result, found, sizeof(esp32_board_info_t), compare_boards);
+    *boards = result;
+    *count = found;
+    return 0;
+}
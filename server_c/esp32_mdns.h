@@ -0,0 +1,50 @@
+/**
+ * Обнаружение ESP32 плат через mDNS/DNS-SD
+ * Фоновый поток слушает объявления службы _chargestation._tcp в
+ * multicast группе 224.0.0.251:5353, периодически отправляет запросы PTR
+ * (интервал удваивается от 1 с до минуты, записи обновляются до истечения
+ * TTL) и ведет реестр плат: экземпляр службы, адрес из записи A и данные
+ * платы из TXT (id, type, name, technicalName, maxPower)
+ */
+
+#ifndef ESP32_MDNS_H
+#define ESP32_MDNS_H
+
+#include "esp32_client.h"
+
+#define ESP32_MDNS_GROUP "224.0.0.251"
+#define ESP32_MDNS_PORT 5353
+#define ESP32_MDNS_SERVICE "_chargestation._tcp.local"
+#define ESP32_MDNS_MAX_SERVICES 1024
+#define ESP32_MDNS_MAX_INTERFACES 16
+#define ESP32_MDNS_QUERY_MIN_MS 1000     // первый повтор запроса
+#define ESP32_MDNS_QUERY_MAX_MS 60000    // предел удвоения интервала запросов
+#define ESP32_MDNS_WAIT_MS 1000          // ожидание первых ответов после запуска
+#define ESP32_MDNS_SETTLE_MS 150         // ответы на общие записи задерживаются до 120 мс
+
+typedef struct {
+    const char *interface;   // IPv4 адрес интерфейса (NULL - все multicast интерфейсы, кроме loopback)
+    int port;                // порт группы (5353, другой - для тестов)
+    const char *service;     // тип службы с доменом .local
+} esp32_mdns_options_t;
+
+void esp32_mdns_default_options(esp32_mdns_options_t *options);
+
+// Запуск и остановка фонового потока (повторный запуск - ошибка)
+int esp32_mdns_start(const esp32_mdns_options_t *options);
+void esp32_mdns_stop(void);
+int esp32_mdns_running(void);
+
+// Внеочередной запрос PTR; интервал повторов снова начинается с минимального
+void esp32_mdns_query(void);
+
+// Ожидание хотя бы одной платы в реестре; возвращает число известных плат
+int esp32_mdns_wait(int timeout_ms);
+
+// Копия реестра (платы с известным адресом), отсортированная по IP
+int esp32_mdns_boards(esp32_board_info_t **boards, int *count);
+
+// Число запросов, отправленных с запуска
+long esp32_mdns_query_count(void);
+
+#endif // ESP32_MDNS_H
@@ -0,0 +1,586 @@
+/**
+ * Опрос ESP32 плат станций
+ *
+ * Каждая плата - один easy handle, который повторно добавляется в общий
+ * curl multi: соединения остаются в кэше multi и переиспользуются
+ * следующими запросами к той же плате (не больше одного на плату).
+ * Сроки опроса лежат в колесе таймеров: постановка и снятие - O(1), за
+ * шаг просматривается один слот. Список плат сверяется со станциями
+ * хранилища: станция с ipAddress опрашивается, без него - нет
+ */
+
+#include "esp32_poller.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CURL
+
+#include <pthread.h>
+#include <time.h>
+#include <curl/curl.h>
+
+#include "station_codec.h"
+#include "station_index.h"
+#include "esp32_health.h"
+
+#define POLL_RESPONSE_MAX (64 * 1024)
+
+/**
+ * Плата в опросе
+ */
+typedef struct poll_board {
+    int id;                       // id станции
+    char ip[MAX_IP_LENGTH];
+    CURL *easy;
+    char *response;
+    size_t response_length;
+    size_t response_capacity;
+    int in_flight;
+    int charging;
+    int failures;                 // ошибок подряд
+    int offline;                  // станции выставлен статус offline
+    unsigned long generation;     // сверка с хранилищем, в которой плата встречена
+
+    // Колесо таймеров
+    struct poll_board *prev;
+    struct poll_board *next;
+    int slot;                     // -1 - не запланирована
+    unsigned long rounds;         // полных оборотов до срабатывания
+} poll_board_t;
+
+static esp32_poller_options_t poller_options;
+static CURLM *poller_multi = NULL;
+
+static poll_board_t **poller_boards = NULL;   // плотный массив, station_index: id -> позиция
+static int poller_board_count = 0;
+static int poller_board_capacity = 0;
+static station_index_t poller_index;
+static unsigned long poller_generation = 0;
+
+static poll_board_t *wheel[ESP32_POLL_WHEEL_SLOTS];
+static unsigned long wheel_tick = 0;          // последний обработанный шаг
+static long wheel_start_ms = 0;
+
+static station_update_t *poller_batch = NULL;
+static int poller_batch_count = 0;
+static long poller_batch_started_ms = 0;
+
+static int poller_in_flight = 0;
+static int poller_running = 0;
+static int poller_stop_requested = 0;
+static esp32_poller_stats_t poller_totals;
+
+static pthread_t poller_thread;
+static pthread_mutex_t poller_lock = PTHREAD_MUTEX_INITIALIZER;   // флаги и статистика
+
+static long poller_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static void stats_boards(int boards, int offline) {
+    pthread_mutex_lock(&poller_lock);
+    poller_totals.boards += boards;
+    poller_totals.offline += offline;
+    pthread_mutex_unlock(&poller_lock);
+}
+
+/**
+ * Постановка платы в колесо через delay_ms (не раньше следующего шага)
+ */
+static void wheel_schedule(poll_board_t *board, long delay_ms) {
+    unsigned long ticks = delay_ms > 0 ? (unsigned long)(delay_ms + ESP32_POLL_TICK_MS - 1) / ESP32_POLL_TICK_MS : 1;
+    if (ticks == 0) ticks = 1;
+
+    board->slot = (int)((wheel_tick + ticks) % ESP32_POLL_WHEEL_SLOTS);
+    board->rounds = (ticks - 1) / ESP32_POLL_WHEEL_SLOTS;
+    board->prev = NULL;
+    board->next = wheel[board->slot];
+    if (board->next) board->next->prev = board;
+    wheel[board->slot] = board;
+}
+
+static void wheel_cancel(poll_board_t *board) {
+    if (board->slot < 0) return;
+    if (board->prev) board->prev->next = board->next;
+    else wheel[board->slot] = board->next;
+    if (board->next) board->next->prev = board->prev;
+    board->prev = board->next = NULL;
+    board->slot = -1;
+}
+
+static size_t poll_write_callback(char *contents, size_t size, size_t nmemb, void *userdata) {
+    poll_board_t *board = userdata;
+    size_t length = size * nmemb;
+    if (board->response_length + length + 1 > POLL_RESPONSE_MAX) {
+        return 0;   // прерывает передачу
+    }
+    if (board->response_length + length + 1 > board->response_capacity) {
+        size_t capacity = board->response_capacity ? board->response_capacity * 2 : 2048;
+        while (capacity < board->response_length + length + 1) capacity *= 2;
+        char *grown = realloc(board->response, capacity);
+        if (!grown) return 0;
+        board->response = grown;
+        board->response_capacity = capacity;
+    }
+    memcpy(board->response + board->response_length, contents, length);
+    board->response_length += length;
+    board->response[board->response_length] = '\0';
+    return length;
+}
+
+static void board_set_url(poll_board_t *board) {
+    char url[64];
+    snprintf(url, sizeof(url), "http://%s:%d/api/station", board->ip, poller_options.port);
+    curl_easy_setopt(board->easy, CURLOPT_URL, url);
+}
+
+static poll_board_t* board_create(const charging_station_t *station) {
+    poll_board_t *board = calloc(1, sizeof(poll_board_t));
+    if (!board) return NULL;
+    board->easy = curl_easy_init();
+    if (!board->easy) {
+        free(board);
+        return NULL;
+    }
+
+    board->id = station->id;
+    board->slot = -1;
+    board->charging = strcmp(station->status, "charging") == 0;
+    board->offline = strcmp(station->status, "offline") == 0;
+    snprintf(board->ip, sizeof(board->ip), "%s", station->ip_address);
+
+    board_set_url(board);
+    curl_easy_setopt(board->easy, CURLOPT_WRITEFUNCTION, poll_write_callback);
+    curl_easy_setopt(board->easy, CURLOPT_WRITEDATA, board);
+    curl_easy_setopt(board->easy, CURLOPT_PRIVATE, board);
+    curl_easy_setopt(board->easy, CURLOPT_TIMEOUT_MS, (long)poller_options.timeout_ms);
+    curl_easy_setopt(board->easy, CURLOPT_CONNECTTIMEOUT_MS, (long)poller_options.timeout_ms);
+    curl_easy_setopt(board->easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(board->easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    return board;
+}
+
+static void board_destroy(poll_board_t *board) {
+    wheel_cancel(board);
+    if (board->in_flight) {
+        curl_multi_remove_handle(poller_multi, board->easy);
+        poller_in_flight--;
+    }
+    curl_easy_cleanup(board->easy);
+    free(board->response);
+    free(board);
+}
+
+static void batch_flush(void) {
+    if (poller_batch_count == 0) return;
+    int updated = storage_update_stations(poller_batch, poller_batch_count);
+
+    pthread_mutex_lock(&poller_lock);
+    poller_totals.batches++;
+    if (updated > 0) poller_totals.updates += updated;
+    pthread_mutex_unlock(&poller_lock);
+
+    if (updated < 0) {
+        printf("Опрос плат: пакет из %d изменений не записан\n", poller_batch_count);
+    }
+    poller_batch_count = 0;
+}
+
+/**
+ * Изменение станции в пакет; повторное изменение той же станции
+ * объединяется с уже накопленным
+ */
+static void batch_add(int id, const charging_station_t *values, station_field_mask_t fields, long now) {
+    station_update_t *update = NULL;
+    for (int i = 0; i < poller_batch_count; i++) {
+        if (poller_batch[i].id == id) {
+            update = &poller_batch[i];
+            break;
+        }
+    }
+    if (!update) {
+        if (poller_batch_count == ESP32_POLL_BATCH_MAX) batch_flush();
+        if (poller_batch_count == 0) poller_batch_started_ms = now;
+        update = &poller_batch[poller_batch_count++];
+        update->id = id;
+        update->fields = 0;
+    }
+
+    // Поля копируются по одному, как station_apply_fields в хранилище
+    #define POLL_COPY_FIELD(kind, key, member) \
+        if (fields & STATION_FIELD(member)) { \
+            memcpy(&update->values.member, &values->member, sizeof(values->member)); \
+        }
+    STATION_FIELDS(POLL_COPY_FIELD)
+    #undef POLL_COPY_FIELD
+    update->fields |= fields;
+}
+
+/**
+ * Интервал следующего опроса: заряжающая станция - часто, простаивающая -
+ * редко, недоступная - с удвоением от offline_min_ms до offline_max_ms
+ */
+static long board_interval(const poll_board_t *board) {
+    if (board->failures > 0) {
+        long interval = poller_options.offline_min_ms;
+        for (int i = 1; i < board->failures && interval < poller_options.offline_max_ms; i++) {
+            interval *= 2;
+        }
+        return interval < poller_options.offline_max_ms ? interval : poller_options.offline_max_ms;
+    }
+    return board->charging ? poller_options.fast_ms : poller_options.slow_ms;
+}
+
+static void board_start(poll_board_t *board) {
+    board->response_length = 0;
+    if (curl_multi_add_handle(poller_multi, board->easy) != CURLM_OK) {
+        wheel_schedule(board, board_interval(board));
+        return;
+    }
+    board->in_flight = 1;
+    poller_in_flight++;
+}
+
+/**
+ * Завершение запроса: ответ разбирается в изменение станции, ошибка
+ * увеличивает интервал, а после ESP32_POLL_OFFLINE_FAILURES ошибок подряд
+ * станция получает статус offline
+ */
+static void board_complete(poll_board_t *board, CURLcode result, long now) {
+    curl_multi_remove_handle(poller_multi, board->easy);
+    board->in_flight = 0;
+    poller_in_flight--;
+
+    long status_code = 0;
+    long connects = 0;
+    double total_time = 0;
+    curl_easy_getinfo(board->easy, CURLINFO_RESPONSE_CODE, &status_code);
+    curl_easy_getinfo(board->easy, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(board->easy, CURLINFO_TOTAL_TIME, &total_time);
+
+    charging_station_t values;
+    station_field_mask_t present = 0;
+    int ok = result == CURLE_OK && status_code == 200 && board->response_length > 0 &&
+             station_read_json(board->response, NULL, &values, &present) == STATION_CODEC_OK;
+    // Опрос - фоновая проверка связи и для запросов esp32_client к той же плате
+    esp32_health_report(board->ip, ok, total_time * 1000.0);
+
+    if (ok) {
+        station_field_mask_t fields = present & ESP32_POLL_FIELDS;
+        if (board->offline && !(fields & STATION_FIELD(status))) {
+            strcpy(values.status, "available");
+            fields |= STATION_FIELD(status);
+        }
+        if (board->offline) stats_boards(0, -1);
+        if (fields & STATION_FIELD(status)) {
+            board->charging = strcmp(values.status, "charging") == 0;
+        }
+        board->failures = 0;
+        board->offline = 0;
+        if (fields) batch_add(board->id, &values, fields, now);
+    } else {
+        board->failures++;
+        if (board->failures >= ESP32_POLL_OFFLINE_FAILURES && !board->offline) {
+            memset(&values, 0, sizeof(values));
+            strcpy(values.status, "offline");
+            batch_add(board->id, &values, STATION_FIELD(status), now);
+            board->offline = 1;
+            board->charging = 0;
+            stats_boards(0, 1);
+            printf("Опрос плат: станция %d (%s) недоступна\n", board->id, board->ip);
+        }
+    }
+
+    pthread_mutex_lock(&poller_lock);
+    poller_totals.polls++;
+    poller_totals.connections += connects;
+    if (!ok) poller_totals.failures++;
+    pthread_mutex_unlock(&poller_lock);
+
+    wheel_schedule(board, board_interval(board));
+}
+
+static int board_add(poll_board_t *board) {
+    if (poller_board_count == poller_board_capacity) {
+        int capacity = poller_board_capacity ? poller_board_capacity * 2 : 64;
+        poll_board_t **grown = realloc(poller_boards, capacity * sizeof(poll_board_t *));
+        if (!grown) return -1;
+        poller_boards = grown;
+        poller_board_capacity = capacity;
+    }
+    if (station_index_put(&poller_index, board->id, poller_board_count) != 0) {
+        return -1;
+    }
+    poller_boards[poller_board_count++] = board;
+    stats_boards(1, board->offline);
+    return 0;
+}
+
+static void board_remove(int position) {
+    poll_board_t *board = poller_boards[position];
+    stats_boards(-1, -board->offline);
+    station_index_remove(&poller_index, board->id);
+    board_destroy(board);
+
+    poller_board_count--;
+    if (position != poller_board_count) {
+        poller_boards[position] = poller_boards[poller_board_count];
+        station_index_put(&poller_index, poller_boards[position]->id, position);
+    }
+}
+
+/**
+ * Сверка со станциями хранилища: новые станции с ipAddress опрашиваются
+ * сразу, у измененных меняется адрес, удаленные и оставшиеся без адреса
+ * убираются из опроса
+ */
+static void poller_sync(void) {
+    const stations_snapshot_t *snapshot = storage_acquire_stations();
+    if (!snapshot) return;
+
+    unsigned long generation = ++poller_generation;
+    for (int i = 0; i < snapshot->count; i++) {
+        const charging_station_t *station = &snapshot->stations[i];
+        if (station->ip_address[0] == '\0') continue;
+
+        int position = station_index_find(&poller_index, station->id);
+        poll_board_t *board = position >= 0 ? poller_boards[position] : NULL;
+        if (!board) {
+            board = board_create(station);
+            if (!board || board_add(board) != 0) {
+                if (board) board_destroy(board);
+                continue;
+            }
+            wheel_schedule(board, 0);
+        } else if (strcmp(board->ip, station->ip_address) != 0) {
+            snprintf(board->ip, sizeof(board->ip), "%s", station->ip_address);
+            board_set_url(board);
+        }
+        board->generation = generation;
+    }
+    storage_release_stations(snapshot);
+
+    for (int i = poller_board_count - 1; i >= 0; i--) {
+        if (poller_boards[i]->generation != generation) {
+            board_remove(i);
+        }
+    }
+
+    // Кэш соединений multi вмещает по одному соединению на плату
+    curl_multi_setopt(poller_multi, CURLMOPT_MAXCONNECTS, (long)poller_board_count + 16);
+}
+
+/**
+ * Шаги колеса до текущего времени: сработавшие платы опрашиваются, пока
+ * есть свободные запросы, остальные переносятся на следующий шаг
+ */
+static void wheel_advance(long now) {
+    unsigned long current = (unsigned long)(now - wheel_start_ms) / ESP32_POLL_TICK_MS;
+    while (wheel_tick < current) {
+        wheel_tick++;
+        int slot = (int)(wheel_tick % ESP32_POLL_WHEEL_SLOTS);
+
+        poll_board_t *board = wheel[slot];
+        while (board) {
+            poll_board_t *next = board->next;
+            if (board->rounds > 0) {
+                board->rounds--;
+            } else {
+                wheel_cancel(board);
+                if (poller_in_flight < poller_options.max_requests) {
+                    board_start(board);
+                } else {
+                    wheel_schedule(board, ESP32_POLL_TICK_MS);
+                }
+            }
+            board = next;
+        }
+    }
+}
+
+static int poller_should_stop(void) {
+    pthread_mutex_lock(&poller_lock);
+    int stop = poller_stop_requested;
+    pthread_mutex_unlock(&poller_lock);
+    return stop;
+}
+
+static void* poller_main(void *arg) {
+    (void)arg;
+    wheel_start_ms = poller_now_ms();
+    wheel_tick = 0;
+    long next_sync = wheel_start_ms;
+
+    while (!poller_should_stop()) {
+        long now = poller_now_ms();
+        if (now >= next_sync) {
+            poller_sync();
+            next_sync = now + ESP32_POLL_SYNC_MS;
+        }
+        wheel_advance(now);
+
+        int running = 0;
+        curl_multi_perform(poller_multi, &running);
+
+        CURLMsg *message;
+        int queued;
+        while ((message = curl_multi_info_read(poller_multi, &queued)) != NULL) {
+            if (message->msg != CURLMSG_DONE) continue;
+            poll_board_t *board = NULL;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char **)&board);
+            if (board) board_complete(board, message->data.result, now);
+        }
+
+        now = poller_now_ms();
+        if (poller_batch_count > 0 &&
+            (poller_batch_count >= ESP32_POLL_BATCH_MAX || now - poller_batch_started_ms >= ESP32_POLL_BATCH_MS)) {
+            batch_flush();
+        }
+
+        // Ожидание - до следующего шага колеса, событий curl или срока пакета
+        long wait_ms = wheel_start_ms + (long)(wheel_tick + 1) * ESP32_POLL_TICK_MS - now;
+        if (poller_batch_count > 0 && poller_batch_started_ms + ESP32_POLL_BATCH_MS - now < wait_ms) {
+            wait_ms = poller_batch_started_ms + ESP32_POLL_BATCH_MS - now;
+        }
+        long curl_timeout = -1;
+        curl_multi_timeout(poller_multi, &curl_timeout);
+        if (curl_timeout >= 0 && curl_timeout < wait_ms) {
+            wait_ms = curl_timeout;
+        }
+        curl_multi_poll(poller_multi, NULL, 0, wait_ms > 0 ? (int)wait_ms : 0, NULL);
+    }
+
+    batch_flush();
+    return NULL;
+}
+
+/**
+ * Параметры опроса по умолчанию
+ */
+void esp32_poller_default_options(esp32_poller_options_t *options) {
+    options->port = ESP32_POLL_PORT;
+    options->fast_ms = ESP32_POLL_FAST_MS;
+    options->slow_ms = ESP32_POLL_SLOW_MS;
+    options->offline_min_ms = ESP32_POLL_OFFLINE_MIN_MS;
+    options->offline_max_ms = ESP32_POLL_OFFLINE_MAX_MS;
+    options->timeout_ms = ESP32_POLL_TIMEOUT_MS;
+    options->max_requests = ESP32_POLL_MAX_REQUESTS;
+}
+
+/**
+ * Запуск опроса: первая сверка с хранилищем - сразу в потоке опроса
+ */
+int esp32_poller_start(const esp32_poller_options_t *options) {
+    pthread_mutex_lock(&poller_lock);
+    if (poller_running) {
+        pthread_mutex_unlock(&poller_lock);
+        return -1;
+    }
+
+    if (options) {
+        poller_options = *options;
+    } else {
+        esp32_poller_default_options(&poller_options);
+    }
+    if (poller_options.max_requests <= 0) poller_options.max_requests = 1;
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    poller_multi = curl_multi_init();
+    poller_batch = malloc(ESP32_POLL_BATCH_MAX * sizeof(station_update_t));
+    if (!poller_multi || !poller_batch || station_index_init(&poller_index, 64) != 0) {
+        if (poller_multi) curl_multi_cleanup(poller_multi);
+        free(poller_batch);
+        poller_multi = NULL;
+        poller_batch = NULL;
+        pthread_mutex_unlock(&poller_lock);
+        return -1;
+    }
+    // Платы держат мало сокетов: к каждой не больше одного соединения
+    curl_multi_setopt(poller_multi, CURLMOPT_MAX_HOST_CONNECTIONS, 1L);
+
+    memset(wheel, 0, sizeof(wheel));
+    memset(&poller_totals, 0, sizeof(poller_totals));
+    poller_board_count = 0;
+    poller_batch_count = 0;
+    poller_in_flight = 0;
+    poller_stop_requested = 0;
+
+    if (pthread_create(&poller_thread, NULL, poller_main, NULL) != 0) {
+        curl_multi_cleanup(poller_multi);
+        station_index_destroy(&poller_index);
+        free(poller_batch);
+        poller_multi = NULL;
+        poller_batch = NULL;
+        pthread_mutex_unlock(&poller_lock);
+        return -1;
+    }
+    poller_running = 1;
+    pthread_mutex_unlock(&poller_lock);
+
+    printf("Опрос плат: порт %d, интервалы %d / %d мс, недоступные - до %d мс\n",
+           poller_options.port, poller_options.fast_ms, poller_options.slow_ms, poller_options.offline_max_ms);
+    return 0;
+}
+
+/**
+ * Остановка: поток записывает накопленный пакет и завершается, платы и
+ * их соединения закрываются
+ */
+void esp32_poller_stop(void) {
+    pthread_mutex_lock(&poller_lock);
+    if (!poller_running) {
+        pthread_mutex_unlock(&poller_lock);
+        return;
+    }
+    poller_stop_requested = 1;
+    pthread_mutex_unlock(&poller_lock);
+
+    curl_multi_wakeup(poller_multi);
+    pthread_join(poller_thread, NULL);
+
+    while (poller_board_count > 0) {
+        board_remove(poller_board_count - 1);
+    }
+    free(poller_boards);
+    poller_boards = NULL;
+    poller_board_capacity = 0;
+    station_index_destroy(&poller_index);
+    curl_multi_cleanup(poller_multi);
+    poller_multi = NULL;
+    free(poller_batch);
+    poller_batch = NULL;
+
+    pthread_mutex_lock(&poller_lock);
+    poller_running = 0;
+    pthread_mutex_unlock(&poller_lock);
+}
+
+void esp32_poller_stats(esp32_poller_stats_t *stats) {
+    pthread_mutex_lock(&poller_lock);
+    *stats = poller_totals;
+    pthread_mutex_unlock(&poller_lock);
+}
+
+#else
+
+void esp32_poller_default_options(esp32_poller_options_t *options) {
+    memset(options, 0, sizeof(*options));
+}
+
+int esp32_poller_start(const esp32_poller_options_t *options) {
+    (void)options;
+    return -1;
+}
+
+void esp32_poller_stop(void) {
+}
+
+void esp32_poller_stats(esp32_poller_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+#endif // HAVE_CURL
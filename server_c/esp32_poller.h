@@ -0,0 +1,70 @@
+/**
+ * Опрос ESP32 плат станций
+ * Фоновый поток опрашивает GET /api/station каждой станции с ipAddress
+ * через curl multi: соединение с платой постоянное (keep-alive), сроки
+ * опроса хранятся в колесе таймеров, интервал зависит от состояния платы
+ * (заряжает, простаивает, недоступна). Ответы применяются к хранилищу
+ * пакетами через storage_update_stations.
+ * Работает только в сборке с libcurl (make CURL=1)
+ */
+
+#ifndef ESP32_POLLER_H
+#define ESP32_POLLER_H
+
+#include "storage.h"
+
+#define ESP32_POLL_PORT 80
+#define ESP32_POLL_FAST_MS 1000           // станция заряжает
+#define ESP32_POLL_SLOW_MS 10000          // станция простаивает
+#define ESP32_POLL_OFFLINE_MIN_MS 5000    // первый повтор после ошибки
+#define ESP32_POLL_OFFLINE_MAX_MS 300000  // предел удвоения для недоступной платы
+#define ESP32_POLL_OFFLINE_FAILURES 3     // ошибок подряд до статуса offline
+#define ESP32_POLL_TIMEOUT_MS 2000        // весь запрос, включая соединение
+#define ESP32_POLL_MAX_REQUESTS 64        // одновременных запросов
+#define ESP32_POLL_BATCH_MS 200           // сколько копить ответы перед записью в хранилище
+#define ESP32_POLL_BATCH_MAX 256
+#define ESP32_POLL_SYNC_MS 2000           // сверка списка плат с хранилищем
+#define ESP32_POLL_TICK_MS 50             // шаг колеса таймеров
+#define ESP32_POLL_WHEEL_SLOTS 512        // 25.6 с на оборот, дальние сроки - с кругами
+
+/**
+ * Поля, которые сообщает плата; остальные (имя, тип, адрес...) принадлежат серверу
+ */
+#define ESP32_POLL_FIELDS \
+    (STATION_FIELD(status) | STATION_FIELD(current_power) | \
+     STATION_FIELD(car_connection) | STATION_FIELD(car_charging_permission) | STATION_FIELD(car_error) | \
+     STATION_FIELD(master_online) | STATION_FIELD(master_charging_permission) | \
+     STATION_FIELD(master_available_power) | \
+     STATION_FIELD(voltage_phase1) | STATION_FIELD(voltage_phase2) | STATION_FIELD(voltage_phase3) | \
+     STATION_FIELD(current_phase1) | STATION_FIELD(current_phase2) | STATION_FIELD(current_phase3) | \
+     STATION_FIELD(charger_power))
+
+typedef struct {
+    int port;                 // порт плат
+    int fast_ms;
+    int slow_ms;
+    int offline_min_ms;
+    int offline_max_ms;
+    int timeout_ms;
+    int max_requests;
+} esp32_poller_options_t;
+
+typedef struct {
+    int boards;               // плат в опросе
+    int offline;              // из них недоступны
+    long polls;               // завершенных запросов
+    long failures;
+    long connections;         // новых TCP соединений (остальные запросы - по старым)
+    long batches;             // пакетов storage_update_stations
+    long updates;             // измененных станций в пакетах
+} esp32_poller_stats_t;
+
+void esp32_poller_default_options(esp32_poller_options_t *options);
+
+// Запуск и остановка (остановка записывает накопленный пакет)
+int esp32_poller_start(const esp32_poller_options_t *options);
+void esp32_poller_stop(void);
+
+void esp32_poller_stats(esp32_poller_stats_t *stats);
+
+#endif // ESP32_POLLER_H
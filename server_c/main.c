@@ -11,14 +11,20 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <time.h>
+#include <limits.h>
+#include <pthread.h>
 
 #include "simple_http.h"
 #include "simple_json.h"
 #include "storage.h"
+#include "static_files.h"
+#include "station_codec.h"
+#include "station_telemetry.h"
+#include "esp32_poller.h"
 
 // Глобальные переменные
 static http_server_t server;
-static int server_running = 1;
+static volatile sig_atomic_t server_running = 1;
 
 // Конфигурация сервера
 static int port = 5000;
@@ -37,15 +43,19 @@ void init_port_config() {
 
 /**
  * Обработчик сигналов для корректного завершения работы сервера
+ * Здесь только останавливается прием соединений: цикл сервера возвращается
+ * в main, и опрос плат, кэш и хранилище освобождаются обычным путем - не
+ * из обработчика, прервавшего поток, который, возможно, держит их блокировки.
+ * Повторный сигнал завершает процесс сразу, если остановка затянулась
  */
 void signal_handler(int sig) {
+    if (!server_running) {
+        _exit(EXIT_FAILURE);
+    }
     printf("\nПолучен сигнал %d, завершаем работу сервера...\n", sig);
     server_running = 0;
     
     http_server_stop(&server);
-    storage_cleanup();
-    
-    exit(0);
 }
 
 /**
@@ -79,6 +89,208 @@ long get_current_time_ms(void) {
     return (ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
 }
 
+/**
+ * Арена для разбора тел запросов: у каждого потока обработки своя,
+ * блоки переживают запросы и освобождаются при завершении потока
+ */
+static pthread_key_t request_arena_key;
+static pthread_once_t request_arena_once = PTHREAD_ONCE_INIT;
+
+static void request_arena_destroy(void *ptr) {
+    json_arena_destroy(ptr);
+    free(ptr);
+}
+
+static void request_arena_key_create(void) {
+    pthread_key_create(&request_arena_key, request_arena_destroy);
+}
+
+/**
+ * Арена текущего потока, сброшенная для нового запроса
+ */
+static json_arena_t* request_arena(void) {
+    pthread_once(&request_arena_once, request_arena_key_create);
+    
+    json_arena_t *arena = pthread_getspecific(request_arena_key);
+    if (!arena) {
+        arena = malloc(sizeof(json_arena_t));
+        if (!arena) return NULL;
+        json_arena_init(arena, JSON_ARENA_BLOCK_SIZE);
+        pthread_setspecific(request_arena_key, arena);
+    }
+    
+    json_arena_reset(arena);
+    return arena;
+}
+
+/**
+ * Ответ с JSON объектом станции
+ */
+static int set_station_response(http_response_t *response, int status_code, const char *status_text,
+                                const charging_station_t *station) {
+    size_t json_length;
+    char *json_string = station_to_json_string(station, &json_length);
+    if (!json_string) {
+        return -1;
+    }
+    
+    http_set_response_status(response, status_code, status_text);
+    http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
+    http_set_response_body_data(response, json_string, json_length);
+    return 0;
+}
+
+/**
+ * Целочисленный параметр строки запроса: 1 - задан, 0 - нет, -1 - не число
+ */
+static int query_int64(const http_request_t *request, const char *name, int64_t *value) {
+    char text[32];
+    if (http_query_param(request, name, text, sizeof(text)) != 0) {
+        return 0;
+    }
+    
+    char *end;
+    errno = 0;
+    long long number = strtoll(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0) {
+        return -1;
+    }
+    *value = number;
+    return 1;
+}
+
+/**
+ * Параметры выборки списка станций (query.status и query.type указывают
+ * в буферы этой же структуры)
+ */
+typedef struct {
+    stations_query_t query;
+    station_field_mask_t fields;
+    char status[32];
+    char type[32];
+} stations_request_t;
+
+/**
+ * Разбор параметров выборки:
+ *   status=, type=  - фильтры по индексам снимка
+ *   fields=         - ключи JSON через запятую (по умолчанию все поля)
+ *   limit=, cursor= - страница после станции с id = cursor
+ * -1 - неверные параметры
+ */
+static int parse_stations_request(const http_request_t *request, stations_request_t *selection) {
+    char fields_list[512];
+    int64_t limit = 0, cursor = 0;
+    
+    memset(selection, 0, sizeof(*selection));
+    selection->fields = STATION_FIELDS_ALL;
+    if (http_query_param(request, "status", selection->status, sizeof(selection->status)) == 0) {
+        selection->query.status = selection->status;
+    }
+    if (http_query_param(request, "type", selection->type, sizeof(selection->type)) == 0) {
+        selection->query.type = selection->type;
+    }
+    if (http_query_param(request, "fields", fields_list, sizeof(fields_list)) == 0 &&
+        station_fields_parse(fields_list, &selection->fields) != 0) {
+        return -1;
+    }
+    int has_limit = query_int64(request, "limit", &limit);
+    int has_cursor = query_int64(request, "cursor", &cursor);
+    if (has_limit < 0 || has_cursor < 0 || (has_limit && (limit <= 0 || limit > INT_MAX)) ||
+        cursor < 0 || cursor > INT_MAX) {
+        return -1;
+    }
+    selection->query.limit = (int)limit;
+    selection->query.after_id = (int)cursor;
+    return 0;
+}
+
+/**
+ * Выборка списка станций по разобранным параметрам; если есть следующая
+ * страница, ее курсор попадает в next_cursor.
+ * Станции выводятся по возрастанию id. -2 - ошибка памяти
+ */
+static int write_selected_stations(const stations_request_t *selection, const stations_snapshot_t *stations,
+                                   json_buf_t *buf, char *next_cursor, size_t next_cursor_size) {
+    const stations_query_t *query = &selection->query;
+    station_field_mask_t fields = selection->fields;
+    
+    int capacity = query->limit > 0 && query->limit < stations->count ? query->limit : stations->count;
+    int *positions = malloc((capacity ? capacity : 1) * sizeof(int));
+    int next_id = 0;
+    int count = positions ? storage_select_stations(stations, query, positions, &next_id) : -1;
+    if (count < 0) {
+        free(positions);
+        return -2;
+    }
+    
+    json_buf_init(buf, 64 + (size_t)count * (fields == STATION_FIELDS_ALL ? 512 : 64));
+    stations_write_json_selected(buf, stations->stations, positions, count, fields);
+    free(positions);
+    
+    if (next_id > 0) {
+        snprintf(next_cursor, next_cursor_size, "%d", next_id);
+    }
+    return 0;
+}
+
+/**
+ * Ответ с историей телеметрии: столбцы времени и значений метрик
+ */
+static int set_telemetry_response(http_response_t *response, int station_id, int64_t from, int64_t to,
+                                  int64_t step, const station_telemetry_series_t *series) {
+    json_buf_t buf;
+    json_buf_init(&buf, 256 + series->count * (16 + STATION_TELEMETRY_METRICS * 3 * 8));
+    
+    json_buf_append_str(&buf, "{\"stationId\":");
+    json_buf_append_number(&buf, station_id);
+    json_buf_append_str(&buf, ",\"from\":");
+    json_buf_append_number(&buf, (double)from);
+    json_buf_append_str(&buf, ",\"to\":");
+    json_buf_append_number(&buf, (double)to);
+    json_buf_append_str(&buf, ",\"step\":");
+    json_buf_append_number(&buf, (double)step);
+    
+    json_buf_append_str(&buf, ",\"tier\":");
+    json_buf_append_string(&buf, station_telemetry_tier_name(series->tier));
+    
+    json_buf_append_str(&buf, ",\"timestamps\":[");
+    for (int i = 0; i < series->count; i++) {
+        if (i > 0) json_buf_append(&buf, ",", 1);
+        json_buf_append_number(&buf, (double)series->timestamps[i]);
+    }
+    json_buf_append(&buf, "]", 1);
+    
+    // "series" - средние значения, "min" и "max" - крайние значения интервала
+    static const char *groups[] = { ",\"series\":{", ",\"min\":{", ",\"max\":{" };
+    float *const *columns[] = { series->values, series->min, series->max };
+    for (int group = 0; group < 3; group++) {
+        json_buf_append_str(&buf, groups[group]);
+        for (int metric = 0; metric < STATION_TELEMETRY_METRICS; metric++) {
+            if (metric > 0) json_buf_append(&buf, ",", 1);
+            json_buf_append_string(&buf, station_telemetry_metric_key(metric));
+            json_buf_append_str(&buf, ":[");
+            for (int i = 0; i < series->count; i++) {
+                if (i > 0) json_buf_append(&buf, ",", 1);
+                json_buf_append_float(&buf, columns[group][metric][i]);
+            }
+            json_buf_append(&buf, "]", 1);
+        }
+        json_buf_append(&buf, "}", 1);
+    }
+    json_buf_append(&buf, "}", 1);
+    
+    size_t json_length;
+    char *json_string = json_buf_detach(&buf, &json_length);
+    if (!json_string) {
+        return -1;
+    }
+    
+    http_set_response_status(response, 200, "OK");
+    http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
+    http_set_response_body_data(response, json_string, json_length);
+    return 0;
+}
+
 /**
  * Основной обработчик HTTP запросов
  */
@@ -98,73 +310,150 @@ void handle_request(const http_request_t *request, http_response_t *response) {
         
         // GET /api/stations
         if (strcmp(request->path, "/api/stations") == 0 && strcmp(request->method, "GET") == 0) {
-            stations_array_t stations;
+            // Параметры проверяются до сравнения ETag: неверный запрос -
+            // 400 и при актуальной версии списка
+            stations_request_t selection;
+            if (request->query[0] != '\0' && parse_stations_request(request, &selection) != 0) {
+                http_set_response_status(response, 400, "Bad Request");
+                http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
+                http_set_response_body(response, "{\"message\":\"Invalid stations query\"}");
+                log_request("GET", "/api/stations", 400, "{\"message\":\"Invalid stations query\"}");
+                return;
+            }
             
-            if (storage_get_stations(&stations) != 0) {
+            // Версия читается до копирования данных; если список не менялся,
+            // сериализация не нужна
+            char etag[STORAGE_ETAG_SIZE];
+            storage_stations_etag(storage_get_stations_version(), etag, sizeof(etag));
+            if (http_etag_matches(request, etag)) {
+                http_set_not_modified(response, etag);
+                http_add_response_header(response, "Cache-Control", "no-cache");
+                log_request("GET", "/api/stations", 304, "");
+                return;
+            }
+            
+            // Снимок списка не блокирует писателей и не меняется во время сериализации
+            const stations_snapshot_t *stations = storage_acquire_stations();
+            if (!stations) {
                 http_set_response_status(response, 500, "Internal Server Error");
                 http_set_response_body(response, "{\"message\":\"Failed to fetch stations\"}");
                 log_request("GET", "/api/stations", 500, "{\"message\":\"Failed to fetch stations\"}");
                 return;
             }
-            
-            // Создаем JSON массив
-            json_value_t *json_array = json_create_array();
-            for (int i = 0; i < stations.count; i++) {
-                json_value_t *station_obj = json_create_object();
-                
-                json_object_set(station_obj, "id", json_create_number(stations.stations[i].id));
-                json_object_set(station_obj, "displayName", json_create_string(stations.stations[i].display_name));
-                json_object_set(station_obj, "technicalName", json_create_string(stations.stations[i].technical_name));
-                json_object_set(station_obj, "type", json_create_string(stations.stations[i].type));
-                json_object_set(station_obj, "status", json_create_string(stations.stations[i].status));
-                json_object_set(station_obj, "maxPower", json_create_number(stations.stations[i].max_power));
-                json_object_set(station_obj, "currentPower", json_create_number(stations.stations[i].current_power));
-                
-                if (strlen(stations.stations[i].ip_address) > 0) {
-                    json_object_set(station_obj, "ipAddress", json_create_string(stations.stations[i].ip_address));
-                }
-                
-                if (strlen(stations.stations[i].description) > 0) {
-                    json_object_set(station_obj, "description", json_create_string(stations.stations[i].description));
+            storage_stations_etag(stations->version, etag, sizeof(etag));
+            
+            // Сериализация напрямую из структур; начальный размер буфера -
+            // по предыдущему ответу этого потока
+            static __thread size_t list_length_hint = 0;
+            json_buf_t buf;
+            char next_cursor_text[16] = "";
+            if (request->query[0] == '\0') {
+                json_buf_init(&buf, list_length_hint + list_length_hint / 8 + 64);
+                stations_write_json(&buf, stations->stations, stations->count);
+            } else {
+                int selected = write_selected_stations(&selection, stations, &buf, next_cursor_text, sizeof(next_cursor_text));
+                if (selected != 0) {
+                    storage_release_stations(stations);
+                    http_set_response_status(response, 500, "Internal Server Error");
+                    http_set_response_body(response, "{\"message\":\"Failed to fetch stations\"}");
+                    log_request("GET", "/api/stations", 500, "{\"message\":\"Failed to fetch stations\"}");
+                    return;
                 }
-                
-                // Slave-specific данные
-                json_object_set(station_obj, "carConnection", json_create_bool(stations.stations[i].car_connection));
-                json_object_set(station_obj, "carChargingPermission", json_create_bool(stations.stations[i].car_charging_permission));
-                json_object_set(station_obj, "carError", json_create_bool(stations.stations[i].car_error));
-                json_object_set(station_obj, "masterOnline", json_create_bool(stations.stations[i].master_online));
-                json_object_set(station_obj, "masterChargingPermission", json_create_bool(stations.stations[i].master_charging_permission));
-                json_object_set(station_obj, "masterAvailablePower", json_create_number(stations.stations[i].master_available_power));
-                
-                // Электрические параметры
-                json_object_set(station_obj, "voltagePhase1", json_create_number(stations.stations[i].voltage_phase1));
-                json_object_set(station_obj, "voltagePhase2", json_create_number(stations.stations[i].voltage_phase2));
-                json_object_set(station_obj, "voltagePhase3", json_create_number(stations.stations[i].voltage_phase3));
-                json_object_set(station_obj, "currentPhase1", json_create_number(stations.stations[i].current_phase1));
-                json_object_set(station_obj, "currentPhase2", json_create_number(stations.stations[i].current_phase2));
-                json_object_set(station_obj, "currentPhase3", json_create_number(stations.stations[i].current_phase3));
-                json_object_set(station_obj, "chargerPower", json_create_number(stations.stations[i].charger_power));
-                
-                // Дополнительные параметры
-                json_object_set(station_obj, "singlePhaseConnection", json_create_bool(stations.stations[i].single_phase_connection));
-                json_object_set(station_obj, "powerOverconsumption", json_create_bool(stations.stations[i].power_overconsumption));
-                json_object_set(station_obj, "fixedPower", json_create_bool(stations.stations[i].fixed_power));
-                
-                json_array_add(json_array, station_obj);
+            }
+            storage_release_stations(stations);
+            
+            size_t json_length;
+            char *json_string = json_buf_detach(&buf, &json_length);
+            if (!json_string) {
+                http_set_response_status(response, 500, "Internal Server Error");
+                http_set_response_body(response, "{\"message\":\"Failed to fetch stations\"}");
+                log_request("GET", "/api/stations", 500, "{\"message\":\"Failed to fetch stations\"}");
+                return;
+            }
+            
+            if (request->query[0] == '\0') {
+                list_length_hint = json_length;
             }
             
-            char *json_string = json_stringify(json_array);
             http_set_response_status(response, 200, "OK");
-            http_set_response_body(response, json_string);
+            http_add_response_header(response, "ETag", etag);
+            if (next_cursor_text[0]) {
+                http_add_response_header(response, "X-Next-Cursor", next_cursor_text);
+            }
+            http_add_response_header(response, "Cache-Control", "no-cache");
+            // Буфер сериализатора отправляется как есть, без копирования
+            http_set_response_body_data(response, json_string, json_length);
             
             long end_time = get_current_time_ms();
             printf("%s [express] GET /api/stations 200 in %ldms :: %s\n", 
                    "time", end_time - start_time, 
-                   strlen(json_string) > 60 ? "truncated..." : json_string);
+                   json_length > 60 ? "truncated..." : json_string);
+            return;
+        }
+        
+        // GET /api/stations/:id/telemetry?from=&to=&step=&tier= (время в мс с эпохи Unix)
+        const char *telemetry_suffix = strstr(request->path, "/telemetry");
+        if (strncmp(request->path, "/api/stations/", 14) == 0 && strcmp(request->method, "GET") == 0 &&
+            telemetry_suffix && strcmp(telemetry_suffix, "/telemetry") == 0) {
+            int station_id = atoi(request->path + 14);
             
-            free(json_string);
-            json_free(json_array);
-            stations_array_free(&stations);
+            charging_station_t station;
+            if (station_id <= 0 || storage_get_station(station_id, &station) != 0) {
+                http_set_response_status(response, 404, "Not Found");
+                http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
+                http_set_response_body(response, "{\"message\":\"Station not found\"}");
+                log_request("GET", request->path, 404, "{\"message\":\"Station not found\"}");
+                return;
+            }
+            
+            // По умолчанию - последний час, не больше STATION_TELEMETRY_DEFAULT_POINTS точек
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            int64_t to = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+            int64_t from = 0, step = 0;
+            int has_to = query_int64(request, "to", &to);
+            int has_from = query_int64(request, "from", &from);
+            int has_step = query_int64(request, "step", &step);
+            
+            // Уровень хранения: raw, minute, hour (по умолчанию выбирается по диапазону и шагу)
+            station_telemetry_tier_t tier = STATION_TELEMETRY_AUTO;
+            char tier_name[16];
+            int bad_tier = http_query_param(request, "tier", tier_name, sizeof(tier_name)) == 0 &&
+                           station_telemetry_tier_parse(tier_name, &tier) != 0;
+            // Границы проверяются до любой арифметики с ними
+            int bad_range = to < 0 || to > STATION_TELEMETRY_MAX_TIMESTAMP_MS ||
+                            (has_from > 0 && (from < 0 || from > STATION_TELEMETRY_MAX_TIMESTAMP_MS)) ||
+                            (has_step > 0 && step > STATION_TELEMETRY_MAX_TIMESTAMP_MS);
+            if (!has_from && !bad_range) {
+                from = to > STATION_TELEMETRY_DEFAULT_RANGE_MS ? to - STATION_TELEMETRY_DEFAULT_RANGE_MS : 0;
+            }
+            if (!has_step && !bad_range && to >= from) {
+                step = (to - from) / STATION_TELEMETRY_DEFAULT_POINTS + 1;
+            }
+            
+            if (has_to < 0 || has_from < 0 || has_step < 0 || bad_tier || bad_range || step <= 0 || to < from ||
+                (to - from) / step >= STATION_TELEMETRY_MAX_POINTS) {
+                http_set_response_status(response, 400, "Bad Request");
+                http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
+                http_set_response_body(response, "{\"message\":\"Invalid telemetry range\"}");
+                log_request("GET", request->path, 400, "{\"message\":\"Invalid telemetry range\"}");
+                return;
+            }
+            
+            station_telemetry_series_t series;
+            if (station_telemetry_query(station_id, tier, from, to, step, &series) != 0 ||
+                set_telemetry_response(response, station_id, from, to, step, &series) != 0) {
+                station_telemetry_series_free(&series);
+                http_set_response_status(response, 500, "Internal Server Error");
+                http_set_response_body(response, "{\"message\":\"Failed to fetch telemetry\"}");
+                log_request("GET", request->path, 500, "{\"message\":\"Failed to fetch telemetry\"}");
+                return;
+            }
+            
+            long end_time = get_current_time_ms();
+            printf("%s [express] GET %s 200 in %ldms :: %d points\n", 
+                   "time", request->path, end_time - start_time, series.count);
+            station_telemetry_series_free(&series);
             return;
         }
         
@@ -190,59 +479,27 @@ void handle_request(const http_request_t *request, http_response_t *response) {
                 return;
             }
             
-            // Создаем JSON объект для станции
-            json_value_t *station_obj = json_create_object();
-            
-            json_object_set(station_obj, "id", json_create_number(station.id));
-            json_object_set(station_obj, "displayName", json_create_string(station.display_name));
-            json_object_set(station_obj, "technicalName", json_create_string(station.technical_name));
-            json_object_set(station_obj, "type", json_create_string(station.type));
-            json_object_set(station_obj, "status", json_create_string(station.status));
-            json_object_set(station_obj, "maxPower", json_create_number(station.max_power));
-            json_object_set(station_obj, "currentPower", json_create_number(station.current_power));
-            
-            if (strlen(station.ip_address) > 0) {
-                json_object_set(station_obj, "ipAddress", json_create_string(station.ip_address));
+            char etag[STORAGE_ETAG_SIZE];
+            storage_station_etag(&station, etag, sizeof(etag));
+            if (http_etag_matches(request, etag)) {
+                http_set_not_modified(response, etag);
+                http_add_response_header(response, "Cache-Control", "no-cache");
+                log_request("GET", request->path, 304, "");
+                return;
             }
             
-            if (strlen(station.description) > 0) {
-                json_object_set(station_obj, "description", json_create_string(station.description));
+            if (set_station_response(response, 200, "OK", &station) != 0) {
+                http_set_response_status(response, 500, "Internal Server Error");
+                http_set_response_body(response, "{\"message\":\"Failed to fetch station\"}");
+                log_request("GET", request->path, 500, "{\"message\":\"Failed to fetch station\"}");
+                return;
             }
-            
-            // Slave-specific данные
-            json_object_set(station_obj, "carConnection", json_create_bool(station.car_connection));
-            json_object_set(station_obj, "carChargingPermission", json_create_bool(station.car_charging_permission));
-            json_object_set(station_obj, "carError", json_create_bool(station.car_error));
-            json_object_set(station_obj, "masterOnline", json_create_bool(station.master_online));
-            json_object_set(station_obj, "masterChargingPermission", json_create_bool(station.master_charging_permission));
-            json_object_set(station_obj, "masterAvailablePower", json_create_number(station.master_available_power));
-            
-            // Электрические параметры
-            json_object_set(station_obj, "voltagePhase1", json_create_number(station.voltage_phase1));
-            json_object_set(station_obj, "voltagePhase2", json_create_number(station.voltage_phase2));
-            json_object_set(station_obj, "voltagePhase3", json_create_number(station.voltage_phase3));
-            json_object_set(station_obj, "currentPhase1", json_create_number(station.current_phase1));
-            json_object_set(station_obj, "currentPhase2", json_create_number(station.current_phase2));
-            json_object_set(station_obj, "currentPhase3", json_create_number(station.current_phase3));
-            json_object_set(station_obj, "chargerPower", json_create_number(station.charger_power));
-            
-            // Дополнительные параметры
-            json_object_set(station_obj, "singlePhaseConnection", json_create_bool(station.single_phase_connection));
-            json_object_set(station_obj, "powerOverconsumption", json_create_bool(station.power_overconsumption));
-            json_object_set(station_obj, "fixedPower", json_create_bool(station.fixed_power));
-            
-            char *json_string = json_stringify(station_obj);
-            
-            http_set_response_status(response, 200, "OK");
-            http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
-            http_set_response_body(response, json_string);
+            http_add_response_header(response, "ETag", etag);
+            http_add_response_header(response, "Cache-Control", "no-cache");
             
             long end_time = get_current_time_ms();
             printf("%s [express] GET %s 200 in %ldms :: station data\n", 
                    "time", request->path, end_time - start_time);
-            
-            free(json_string);
-            json_free(station_obj);
             return;
         }
         
@@ -280,169 +537,41 @@ void handle_request(const http_request_t *request, http_response_t *response) {
                 return;
             }
             
-            json_value_t *json_data = json_parse(request->body);
-            if (!json_data) {
+            // Копируем существующие данные и обновляем только переданные поля
+            charging_station_t updated_station = existing_station;
+            station_field_mask_t fields = 0;
+            int parse_result = station_read_json(request->body, NULL, &updated_station, &fields);
+            if (parse_result != STATION_CODEC_OK) {
+                const char *message = parse_result == STATION_CODEC_TYPE_ERROR ?
+                    "{\"message\":\"Invalid field type in request body\"}" :
+                    "{\"message\":\"Invalid JSON in request body\"}";
                 http_set_response_status(response, 400, "Bad Request");
                 http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
-                http_set_response_body(response, "{\"message\":\"Invalid JSON in request body\"}");
-                log_request("PATCH", request->path, 400, "{\"message\":\"Invalid JSON\"}");
+                http_set_response_body(response, message);
+                log_request("PATCH", request->path, 400, message);
                 return;
             }
             
-            // Копируем существующие данные и обновляем только переданные поля
-            charging_station_t updated_station = existing_station;
-            
-            // Обновляем только переданные поля
-            json_value_t *field_value;
-            
-            if ((field_value = json_object_get(json_data, "displayName"))) {
-                const char* str_val = json_get_string(field_value);
-                if (str_val) {
-                    printf("DEBUG: Updating displayName from '%s' to '%s'\n", updated_station.display_name, str_val);
-                    strncpy(updated_station.display_name, str_val, MAX_STRING_LENGTH - 1);
-                    updated_station.display_name[MAX_STRING_LENGTH - 1] = '\0';
-                }
-            }
-            
-            if ((field_value = json_object_get(json_data, "technicalName"))) {
-                const char* str_val = json_get_string(field_value);
-                if (str_val) {
-                    printf("DEBUG: Updating technicalName from '%s' to '%s'\n", updated_station.technical_name, str_val);
-                    strncpy(updated_station.technical_name, str_val, MAX_STRING_LENGTH - 1);
-                    updated_station.technical_name[MAX_STRING_LENGTH - 1] = '\0';
-                }
-            }
-            
-            if ((field_value = json_object_get(json_data, "description"))) {
-                const char* str_val = json_get_string(field_value);
-                if (str_val) {
-                    printf("DEBUG: Updating description\n");
-                    strncpy(updated_station.description, str_val, MAX_DESCRIPTION_LENGTH - 1);
-                    updated_station.description[MAX_DESCRIPTION_LENGTH - 1] = '\0';
-                }
-            }
-            
-            // Проверяем все возможные поля для обновления
-            
-            if ((field_value = json_object_get(json_data, "maxPower"))) {
-                updated_station.max_power = (float)json_get_number(field_value);
-            }
-            
-            if ((field_value = json_object_get(json_data, "chargerPower"))) {
-                updated_station.charger_power = (float)json_get_number(field_value);
-            }
-            
-            if ((field_value = json_object_get(json_data, "carError"))) {
-                updated_station.car_error = json_get_bool(field_value);
-            }
-            
-            if ((field_value = json_object_get(json_data, "carConnection"))) {
-                updated_station.car_connection = json_get_bool(field_value);
-            }
-            
-            if ((field_value = json_object_get(json_data, "currentPower"))) {
-                updated_station.current_power = (float)json_get_number(field_value);
-            }
-            
-            if ((field_value = json_object_get(json_data, "carChargingPermission"))) {
-                updated_station.car_charging_permission = json_get_bool(field_value);
-            }
-            
-            if ((field_value = json_object_get(json_data, "currentPower"))) {
-                float new_power = (float)json_get_number(field_value);
-                printf("DEBUG: Updating currentPower from %.2f to %.2f\n", updated_station.current_power, new_power);
-                updated_station.current_power = new_power;
-            }
-            
-            if ((field_value = json_object_get(json_data, "carConnection"))) {
-                int new_val = json_get_bool(field_value);
-                printf("DEBUG: Updating carConnection from %d to %d\n", updated_station.car_connection, new_val);
-                updated_station.car_connection = new_val;
-            }
-            
-            if ((field_value = json_object_get(json_data, "carChargingPermission"))) {
-                updated_station.car_charging_permission = json_get_bool(field_value);
-            }
-            
-            if ((field_value = json_object_get(json_data, "voltagePhase1"))) {
-                updated_station.voltage_phase1 = (float)json_get_number(field_value);
-            }
-            
-            if ((field_value = json_object_get(json_data, "voltagePhase2"))) {
-                updated_station.voltage_phase2 = (float)json_get_number(field_value);
-            }
-            
-            if ((field_value = json_object_get(json_data, "voltagePhase3"))) {
-                updated_station.voltage_phase3 = (float)json_get_number(field_value);
-            }
-            
-            if ((field_value = json_object_get(json_data, "singlePhaseConnection"))) {
-                updated_station.single_phase_connection = json_get_bool(field_value);
-            }
-            
-            if ((field_value = json_object_get(json_data, "fixedPower"))) {
-                updated_station.fixed_power = json_get_bool(field_value);
-            }
-            
-            // Обновляем данные в storage
-            printf("DEBUG: About to call storage_update_station with name='%s', maxPower=%.2f\n", 
-                   updated_station.display_name, updated_station.max_power);
-            
-            if (storage_update_station(station_id, &updated_station) != 0) {
+            if (storage_update_station(station_id, &updated_station, fields) != 0) {
                 http_set_response_status(response, 500, "Internal Server Error");
                 http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
                 http_set_response_body(response, "{\"message\":\"Failed to update station\"}");
                 log_request("PATCH", request->path, 500, "{\"message\":\"Failed to update station\"}");
-                json_free(json_data);
                 return;
             }
             
-            // Возвращаем обновленные данные станции
-            json_value_t *response_obj = json_create_object();
-            json_object_set(response_obj, "id", json_create_number(updated_station.id));
-            json_object_set(response_obj, "displayName", json_create_string(updated_station.display_name));
-            json_object_set(response_obj, "technicalName", json_create_string(updated_station.technical_name));
-            json_object_set(response_obj, "type", json_create_string(updated_station.type));
-            json_object_set(response_obj, "status", json_create_string(updated_station.status));
-            json_object_set(response_obj, "maxPower", json_create_number(updated_station.max_power));
-            json_object_set(response_obj, "currentPower", json_create_number(updated_station.current_power));
-            
-            if (strlen(updated_station.description) > 0) {
-                json_object_set(response_obj, "description", json_create_string(updated_station.description));
+            // Возвращаем обновленные данные станции в том виде, в каком они сохранены
+            if (storage_get_station(station_id, &updated_station) != 0 ||
+                set_station_response(response, 200, "OK", &updated_station) != 0) {
+                http_set_response_status(response, 500, "Internal Server Error");
+                http_set_response_body(response, "{\"message\":\"Failed to update station\"}");
+                log_request("PATCH", request->path, 500, "{\"message\":\"Failed to update station\"}");
+                return;
             }
             
-            json_object_set(response_obj, "carConnection", json_create_bool(updated_station.car_connection));
-            json_object_set(response_obj, "carChargingPermission", json_create_bool(updated_station.car_charging_permission));
-            json_object_set(response_obj, "carError", json_create_bool(updated_station.car_error));
-            json_object_set(response_obj, "masterOnline", json_create_bool(updated_station.master_online));
-            json_object_set(response_obj, "masterChargingPermission", json_create_bool(updated_station.master_charging_permission));
-            json_object_set(response_obj, "masterAvailablePower", json_create_number(updated_station.master_available_power));
-            
-            json_object_set(response_obj, "voltagePhase1", json_create_number(updated_station.voltage_phase1));
-            json_object_set(response_obj, "voltagePhase2", json_create_number(updated_station.voltage_phase2));
-            json_object_set(response_obj, "voltagePhase3", json_create_number(updated_station.voltage_phase3));
-            json_object_set(response_obj, "currentPhase1", json_create_number(updated_station.current_phase1));
-            json_object_set(response_obj, "currentPhase2", json_create_number(updated_station.current_phase2));
-            json_object_set(response_obj, "currentPhase3", json_create_number(updated_station.current_phase3));
-            json_object_set(response_obj, "chargerPower", json_create_number(updated_station.charger_power));
-            
-            json_object_set(response_obj, "singlePhaseConnection", json_create_bool(updated_station.single_phase_connection));
-            json_object_set(response_obj, "powerOverconsumption", json_create_bool(updated_station.power_overconsumption));
-            json_object_set(response_obj, "fixedPower", json_create_bool(updated_station.fixed_power));
-            
-            char *response_json = json_stringify(response_obj);
-            
-            http_set_response_status(response, 200, "OK");
-            http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
-            http_set_response_body(response, response_json);
-            
             long end_time = get_current_time_ms();
             printf("%s [express] PATCH %s 200 in %ldms :: station updated\n", 
                    "time", request->path, end_time - start_time);
-            
-            free(response_json);
-            json_free(response_obj);
-            json_free(json_data);
             return;
         }
         
@@ -456,60 +585,20 @@ void handle_request(const http_request_t *request, http_response_t *response) {
                 return;
             }
             
-            json_value_t *json_data = json_parse(request->body);
-            if (!json_data) {
+            // Создаем новую станцию из переданных полей
+            charging_station_t new_station = {0};
+            int parse_result = station_read_json(request->body, NULL, &new_station, NULL);
+            if (parse_result != STATION_CODEC_OK) {
+                const char *message = parse_result == STATION_CODEC_TYPE_ERROR ?
+                    "{\"message\":\"Invalid field type in request body\"}" :
+                    "{\"message\":\"Invalid JSON in request body\"}";
                 http_set_response_status(response, 400, "Bad Request");
                 http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
-                http_set_response_body(response, "{\"message\":\"Invalid JSON in request body\"}");
-                log_request("POST", "/api/stations", 400, "{\"message\":\"Invalid JSON\"}");
+                http_set_response_body(response, message);
+                log_request("POST", "/api/stations", 400, message);
                 return;
             }
             
-            // Создаем новую станцию
-            charging_station_t new_station = {0};
-            json_value_t *field_value;
-            
-            // Получаем обязательные поля
-            if ((field_value = json_object_get(json_data, "type"))) {
-                const char* str_val = json_get_string(field_value);
-                if (str_val) {
-                    strncpy(new_station.type, str_val, MAX_STRING_LENGTH - 1);
-                    new_station.type[MAX_STRING_LENGTH - 1] = '\0';
-                }
-            }
-            
-            if ((field_value = json_object_get(json_data, "displayName"))) {
-                const char* str_val = json_get_string(field_value);
-                if (str_val) {
-                    strncpy(new_station.display_name, str_val, MAX_STRING_LENGTH - 1);
-                    new_station.display_name[MAX_STRING_LENGTH - 1] = '\0';
-                }
-            }
-            
-            if ((field_value = json_object_get(json_data, "technicalName"))) {
-                const char* str_val = json_get_string(field_value);
-                if (str_val) {
-                    strncpy(new_station.technical_name, str_val, MAX_STRING_LENGTH - 1);
-                    new_station.technical_name[MAX_STRING_LENGTH - 1] = '\0';
-                }
-            }
-            
-            if ((field_value = json_object_get(json_data, "status"))) {
-                const char* str_val = json_get_string(field_value);
-                if (str_val) {
-                    strncpy(new_station.status, str_val, MAX_STRING_LENGTH - 1);
-                    new_station.status[MAX_STRING_LENGTH - 1] = '\0';
-                }
-            }
-            
-            if ((field_value = json_object_get(json_data, "maxPower"))) {
-                new_station.max_power = (float)json_get_number(field_value);
-            }
-            
-            if ((field_value = json_object_get(json_data, "currentPower"))) {
-                new_station.current_power = (float)json_get_number(field_value);
-            }
-            
             // Устанавливаем значения по умолчанию если они не заданы
             if (strlen(new_station.type) == 0) {
                 strcpy(new_station.type, "slave");
@@ -525,39 +614,19 @@ void handle_request(const http_request_t *request, http_response_t *response) {
                 http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
                 http_set_response_body(response, "{\"message\":\"Failed to create station\"}");
                 log_request("POST", "/api/stations", 500, "{\"message\":\"Failed to create station\"}");
-                json_free(json_data);
                 return;
             }
             
             // Получаем созданную станцию для ответа
             charging_station_t created_station;
-            if (storage_get_station(new_id, &created_station) == 0) {
-                json_value_t *response_obj = json_create_object();
-                json_object_set(response_obj, "id", json_create_number(created_station.id));
-                json_object_set(response_obj, "displayName", json_create_string(created_station.display_name));
-                json_object_set(response_obj, "technicalName", json_create_string(created_station.technical_name));
-                json_object_set(response_obj, "type", json_create_string(created_station.type));
-                json_object_set(response_obj, "status", json_create_string(created_station.status));
-                json_object_set(response_obj, "maxPower", json_create_number(created_station.max_power));
-                json_object_set(response_obj, "currentPower", json_create_number(created_station.current_power));
-                
-                char *response_json = json_stringify(response_obj);
-                
-                http_set_response_status(response, 201, "Created");
-                http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
-                http_set_response_body(response, response_json);
-                
+            if (storage_get_station(new_id, &created_station) == 0 &&
+                set_station_response(response, 201, "Created", &created_station) == 0) {
                 long end_time = get_current_time_ms();
                 printf("%s [express] POST /api/stations 201 in %ldms :: station created\n", 
                        "time", end_time - start_time);
-                
-                free(response_json);
-                json_free(response_obj);
-                json_free(json_data);
                 return;
             }
             
-            json_free(json_data);
             http_set_response_status(response, 500, "Internal Server Error");
             http_set_response_body(response, "{\"message\":\"Failed to retrieve created station\"}");
             log_request("POST", "/api/stations", 500, "{\"message\":\"Failed to retrieve created station\"}");
@@ -604,7 +673,9 @@ void handle_request(const http_request_t *request, http_response_t *response) {
                 return;
             }
             
-            json_value_t *json_data = json_parse(request->body);
+            // Дерево разбора живет в арене потока до следующего запроса
+            json_arena_t *arena = request_arena();
+            json_value_t *json_data = arena ? json_parse_arena(request->body, arena) : NULL;
             if (!json_data) {
                 http_set_response_status(response, 400, "Bad Request");
                 http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
@@ -619,7 +690,6 @@ void handle_request(const http_request_t *request, http_response_t *response) {
                 http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
                 http_set_response_body(response, "{\"message\":\"Board ID is required\"}");
                 log_request("POST", "/api/board/connect", 400, "{\"message\":\"Board ID is required\"}");
-                json_free(json_data);
                 return;
             }
             
@@ -631,33 +701,20 @@ void handle_request(const http_request_t *request, http_response_t *response) {
                 http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
                 http_set_response_body(response, "{\"message\":\"Board not found\"}");
                 log_request("POST", "/api/board/connect", 404, "{\"message\":\"Board not found\"}");
-                json_free(json_data);
                 return;
             }
             
-            // Создаем ответ с данными платы
-            json_value_t *response_obj = json_create_object();
-            json_object_set(response_obj, "id", json_create_number(station.id));
-            json_object_set(response_obj, "type", json_create_string(station.type));
-            json_object_set(response_obj, "displayName", json_create_string(station.display_name));
-            json_object_set(response_obj, "technicalName", json_create_string(station.technical_name));
-            json_object_set(response_obj, "status", json_create_string(station.status));
-            json_object_set(response_obj, "maxPower", json_create_number(station.max_power));
-            json_object_set(response_obj, "currentPower", json_create_number(station.current_power));
-            
-            char *response_json = json_stringify(response_obj);
-            
-            http_set_response_status(response, 200, "OK");
-            http_add_response_header(response, "Content-Type", "application/json; charset=utf-8");
-            http_set_response_body(response, response_json);
+            // Ответ с данными платы
+            if (set_station_response(response, 200, "OK", &station) != 0) {
+                http_set_response_status(response, 500, "Internal Server Error");
+                http_set_response_body(response, "{\"message\":\"Failed to connect board\"}");
+                log_request("POST", "/api/board/connect", 500, "{\"message\":\"Failed to connect board\"}");
+                return;
+            }
             
             long end_time = get_current_time_ms();
             printf("%s [express] POST /api/board/connect 200 in %ldms :: board connected\n", 
                    "time", end_time - start_time);
-            
-            free(response_json);
-            json_free(response_obj);
-            json_free(json_data);
             return;
         }
         
@@ -690,81 +747,15 @@ void handle_request(const http_request_t *request, http_response_t *response) {
         return;
     }
     
-    // Статические файлы - serve index.html for SPA routing
+    // Статические файлы: корень и пути без расширения отдают index.html (SPA routing)
+    const char *static_path = request->path;
     if (strcmp(request->path, "/") == 0 || strstr(request->path, ".") == NULL) {
-        // Serve index.html for root path or paths without extensions (SPA routing)
-        FILE *file = fopen("../dist/public/index.html", "r");
-        if (file) {
-            fseek(file, 0, SEEK_END);
-            long file_size = ftell(file);
-            fseek(file, 0, SEEK_SET);
-            
-            char *file_content = malloc(file_size + 1);
-            fread(file_content, 1, file_size, file);
-            file_content[file_size] = '\0';
-            fclose(file);
-            
-            http_set_response_status(response, 200, "OK");
-            http_add_response_header(response, "Content-Type", "text/html");
-            http_set_response_body(response, file_content);
-            
-            free(file_content);
-            log_request(request->method, request->path, 200, "index.html served");
-            return;
-        }
+        static_path = "/index.html";
     }
     
-    // Static asset files
-    char file_path[1024];
-    snprintf(file_path, sizeof(file_path), "../dist/public%s", request->path);
-    
-    FILE *file = fopen(file_path, "rb");  // Use binary mode for all files
-    if (file) {
-        fseek(file, 0, SEEK_END);
-        long file_size = ftell(file);
-        fseek(file, 0, SEEK_SET);
-        
-        char *file_content = malloc(file_size + 1);
-        size_t bytes_read = fread(file_content, 1, file_size, file);
-        fclose(file);
-        
-        // Don't null-terminate binary files, but ensure we have the right size
-        if (bytes_read != (size_t)file_size) {
-            free(file_content);
-            http_set_response_status(response, 500, "Internal Server Error");
-            http_set_response_body(response, "{\"message\":\"File read error\"}");
-            log_request(request->method, request->path, 500, "File read error");
-            return;
-        }
-        
-        // Set appropriate content type with proper MIME types for modules
-        const char *content_type = "text/plain";
-        if (strstr(request->path, ".html")) content_type = "text/html; charset=utf-8";
-        else if (strstr(request->path, ".css")) content_type = "text/css; charset=utf-8";
-        else if (strstr(request->path, ".js")) content_type = "text/javascript; charset=utf-8";
-        else if (strstr(request->path, ".mjs")) content_type = "text/javascript; charset=utf-8";
-        else if (strstr(request->path, ".json")) content_type = "application/json; charset=utf-8";
-        else if (strstr(request->path, ".png")) content_type = "image/png";
-        else if (strstr(request->path, ".jpg") || strstr(request->path, ".jpeg")) content_type = "image/jpeg";
-        else if (strstr(request->path, ".svg")) content_type = "image/svg+xml";
-        else if (strstr(request->path, ".ico")) content_type = "image/x-icon";
-        
-        http_set_response_status(response, 200, "OK");
-        http_add_response_header(response, "Content-Type", content_type);
-        
-        // For large files, use body_data; for small files, use regular body
-        if (file_size < MAX_RESPONSE_SIZE - 1) {
-            memcpy(response->body, file_content, file_size);
-            response->body[file_size] = '\0';
-            response->body_length = file_size;
-        } else {
-            response->body_data = malloc(file_size);
-            memcpy(response->body_data, file_content, file_size);
-            response->body_size = file_size;
-        }
-        
-        free(file_content);
-        log_request(request->method, request->path, 200, "static file served");
+    if (static_files_serve(request, static_path, response) == 0) {
+        log_request(request->method, request->path, response->status_code,
+                    response->status_code == 304 ? "" : "static file served");
         return;
     }
     
@@ -778,6 +769,20 @@ void handle_request(const http_request_t *request, http_response_t *response) {
  * Инициализация компонентов сервера
  */
 int initialize_server() {
+    // Группа журнала изменений: сколько миллисекунд копить изменения перед
+    // fdatasync (0 - сбрасывать сразу, группы складываются во время записи)
+    const char *env_wal_commit = getenv("WAL_COMMIT_MS");
+    if (env_wal_commit && strlen(env_wal_commit) > 0) {
+        storage_set_wal_commit_ms(atoi(env_wal_commit));
+    }
+    
+    // Бинарный снимок для быстрого запуска (JSON пишется всегда)
+    const char *env_binary = getenv("STATIONS_BINARY_SNAPSHOT");
+    storage_set_binary_snapshot(env_binary && strcmp(env_binary, "1") == 0);
+    
+    // Необязательная копия файла станций, пишется в фоне после основного
+    storage_set_replica_path(getenv("STATIONS_REPLICA_PATH"));
+    
     // Инициализация системы хранения данных
     if (storage_init() != 0) {
         fprintf(stderr, "Ошибка инициализации системы хранения\n");
@@ -785,6 +790,18 @@ int initialize_server() {
     }
     
     printf("Система хранения инициализирована\n");
+    
+    // Собранный фронтенд
+    if (static_files_init("../dist/public") != 0) {
+        fprintf(stderr, "Ошибка инициализации статических файлов\n");
+        return -1;
+    }
+    
+    // Сжатие фронтенда в памяти для клиентов без предсжатых .br/.gz файлов
+    const char *env_gzip = getenv("STATIC_GZIP");
+    if (env_gzip && strcmp(env_gzip, "1") == 0 && static_files_enable_gzip_cache() != 0) {
+        fprintf(stderr, "STATIC_GZIP=1 требует сборки с ZLIB=1, сжатие в памяти отключено\n");
+    }
     return 0;
 }
 
@@ -815,6 +832,9 @@ int main(int argc, char *argv[]) {
     // Установка обработчиков сигналов
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
+    // writev/sendfile не принимают MSG_NOSIGNAL: разрыв соединения клиентом
+    // должен приводить к EPIPE, а не к завершению процесса
+    signal(SIGPIPE, SIG_IGN);
     
     // Инициализация сервера
     if (initialize_server() != 0) {
@@ -828,14 +848,62 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
     
-    if (http_server_start(&server) != 0) {
+    // Модель обработки соединений: HTTP_MODE=threads|epoll
+    const char *env_mode = getenv("HTTP_MODE");
+    if (env_mode && strlen(env_mode) > 0 && http_server_set_mode(&server, env_mode) != 0) {
+        fprintf(stderr, "Неизвестная модель соединений: %s (threads, epoll, pool)\n", env_mode);
+        storage_cleanup();
+        return EXIT_FAILURE;
+    }
+    
+    // Параметры пула: HTTP_WORKERS потоков, очередь до HTTP_QUEUE_DEPTH соединений
+    const char *env_workers = getenv("HTTP_WORKERS");
+    const char *env_queue = getenv("HTTP_QUEUE_DEPTH");
+    if ((env_workers && strlen(env_workers) > 0) || (env_queue && strlen(env_queue) > 0)) {
+        int workers = env_workers && strlen(env_workers) > 0 ? atoi(env_workers) : HTTP_DEFAULT_WORKERS;
+        int queue_depth = env_queue && strlen(env_queue) > 0 ? atoi(env_queue) : HTTP_DEFAULT_QUEUE_DEPTH;
+        if (http_server_set_pool(&server, workers, queue_depth) != 0) {
+            fprintf(stderr, "Неверные параметры пула: HTTP_WORKERS=%s HTTP_QUEUE_DEPTH=%s\n",
+                    env_workers ? env_workers : "", env_queue ? env_queue : "");
+            storage_cleanup();
+            return EXIT_FAILURE;
+        }
+    }
+    
+    // Постоянные соединения: HTTP_KEEPALIVE_TIMEOUT секунд простоя,
+    // не более HTTP_KEEPALIVE_MAX запросов на соединение (0 - выключить)
+    const char *env_ka_timeout = getenv("HTTP_KEEPALIVE_TIMEOUT");
+    const char *env_ka_max = getenv("HTTP_KEEPALIVE_MAX");
+    if ((env_ka_timeout && strlen(env_ka_timeout) > 0) || (env_ka_max && strlen(env_ka_max) > 0)) {
+        int timeout_ms = env_ka_timeout && strlen(env_ka_timeout) > 0 ?
+                         atoi(env_ka_timeout) * 1000 : HTTP_DEFAULT_KEEPALIVE_TIMEOUT_MS;
+        int max_requests = env_ka_max && strlen(env_ka_max) > 0 ? atoi(env_ka_max) : HTTP_DEFAULT_KEEPALIVE_MAX;
+        if (http_server_set_keepalive(&server, timeout_ms, max_requests) != 0) {
+            fprintf(stderr, "Неверные параметры keep-alive: HTTP_KEEPALIVE_TIMEOUT=%s HTTP_KEEPALIVE_MAX=%s\n",
+                    env_ka_timeout ? env_ka_timeout : "", env_ka_max ? env_ka_max : "");
+            storage_cleanup();
+            return EXIT_FAILURE;
+        }
+    }
+    
+    // Фоновый опрос ESP32 плат станций с ipAddress (ESP32_POLL=1)
+    const char *env_poll = getenv("ESP32_POLL");
+    if (env_poll && strcmp(env_poll, "1") == 0 && esp32_poller_start(NULL) != 0) {
+        fprintf(stderr, "ESP32_POLL=1 требует сборки с CURL=1, опрос плат отключен\n");
+    }
+    
+    // Сигнал мог прийти во время инициализации
+    if (server_running && http_server_start(&server) != 0) {
         fprintf(stderr, "Ошибка запуска HTTP сервера\n");
+        esp32_poller_stop();
         storage_cleanup();
         return EXIT_FAILURE;
     }
     
     // Корректное завершение работы
     http_server_cleanup(&server);
+    esp32_poller_stop();
+    static_files_cleanup();
     storage_cleanup();
     printf("Сервер остановлен\n");
     return EXIT_SUCCESS;
@@ -7,9 +7,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+
+#define EPOLL_MAX_EVENTS 256
 
 /**
  * Структура для передачи данных в поток обработки соединения
@@ -33,72 +46,259 @@ int http_server_init(http_server_t *server, const char *host, int port, request_
     server->handler = handler;
     server->running = 0;
     server->socket_fd = -1;
+    server->mode = HTTP_MODE_THREADS;
+    server->worker_count = HTTP_DEFAULT_WORKERS;
+    server->queue_depth = HTTP_DEFAULT_QUEUE_DEPTH;
+    server->keepalive_timeout_ms = HTTP_DEFAULT_KEEPALIVE_TIMEOUT_MS;
+    server->keepalive_max_requests = HTTP_DEFAULT_KEEPALIVE_MAX;
     
     return 0;
 }
 
 /**
- * Парсинг HTTP запроса
+ * Сброс состояния чтения перед следующим запросом
+ */
+void http_reader_reset(http_request_reader_t *reader) {
+    memset(reader, 0, sizeof(http_request_reader_t));
+}
+
+/**
+ * Разбор значения Content-Length. Возвращает -1 для некорректного значения
  */
-int http_parse_request(const char *raw_request, http_request_t *request) {
-    if (!raw_request || !request) {
+static int parse_content_length(const char *value, const char *end, size_t *content_length) {
+    while (value < end && (*value == ' ' || *value == '\t')) value++;
+    if (value == end || *value < '0' || *value > '9') {
         return -1;
     }
     
-    memset(request, 0, sizeof(http_request_t));
+    size_t result = 0;
+    while (value < end && *value >= '0' && *value <= '9') {
+        result = result * 10 + (*value - '0');
+        if (result > HTTP_MAX_BODY_SIZE) {
+            result = HTTP_MAX_BODY_SIZE + 1; // Дальше считать не нужно - тело все равно отклоняется
+        }
+        value++;
+    }
+    while (value < end && (*value == ' ' || *value == '\t' || *value == '\r')) value++;
+    if (value != end) {
+        return -1;
+    }
     
-    // Парсим первую строку запроса
-    char *line_end = strstr(raw_request, "\r\n");
-    if (!line_end) {
-        line_end = strstr(raw_request, "\n");
+    *content_length = result;
+    return 0;
+}
+
+/**
+ * Инкрементальное чтение запроса: поиск конца заголовков продолжается
+ * с места предыдущего вызова, поэтому стоимость не зависит от того, как
+ * клиент разбил запрос на пакеты. После заголовков учитывается Content-Length.
+ * Возвращает 1 и длину запроса в *request_length когда запрос получен целиком,
+ * 0 если нужны еще данные, либо отрицательный код ошибки HTTP
+ */
+int http_reader_scan(http_request_reader_t *reader, const char *data, size_t length, size_t *request_length) {
+    if (reader->headers_length == 0) {
+        size_t pos = reader->scanned;
+        size_t headers_end = 0;
+        
+        while (pos < length) {
+            const char *newline = memchr(data + pos, '\n', length - pos);
+            if (!newline) {
+                pos = length;
+                break;
+            }
+            pos = newline - data;
+            
+            // Пустая строка: "\n\n" или "\n\r\n"
+            if (pos + 1 < length && data[pos + 1] == '\n') {
+                headers_end = pos + 2;
+                break;
+            }
+            if (pos + 2 < length && data[pos + 1] == '\r' && data[pos + 2] == '\n') {
+                headers_end = pos + 3;
+                break;
+            }
+            if (pos + 2 >= length) {
+                break; // Недостаточно данных, чтобы решить - продолжим с этого '\n'
+            }
+            pos++;
+        }
+        reader->scanned = pos;
+        
+        if (headers_end == 0) {
+            return length > HTTP_MAX_HEADER_SIZE ? -431 : 0;
+        }
+        if (headers_end > HTTP_MAX_HEADER_SIZE) {
+            return -431;
+        }
+        
+        // Ищем Content-Length и Transfer-Encoding в заголовках
+        size_t content_length = 0;
+        const char *line = memchr(data, '\n', headers_end);
+        while (line && (size_t)(line - data) + 1 < headers_end) {
+            line++;
+            const char *line_end = memchr(line, '\n', headers_end - (line - data));
+            if (!line_end) break;
+            
+            if ((size_t)(line_end - line) > 15 && strncasecmp(line, "Content-Length:", 15) == 0) {
+                if (parse_content_length(line + 15, line_end, &content_length) != 0) {
+                    return -400;
+                }
+            } else if ((size_t)(line_end - line) > 18 && strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+                return -501; // chunked тела не поддерживаются
+            }
+            line = line_end;
+        }
+        
+        if (content_length > HTTP_MAX_BODY_SIZE) {
+            return -413;
+        }
+        reader->headers_length = headers_end;
+        reader->content_length = content_length;
     }
     
-    if (!line_end) {
+    size_t total = reader->headers_length + reader->content_length;
+    if (length < total) {
+        return 0;
+    }
+    *request_length = total;
+    return 1;
+}
+
+/**
+ * Парсинг HTTP запроса на месте: разделители в буфере заменяются нулями,
+ * а поля запроса указывают на части буфера. Запрос занимает length байт,
+ * buffer[length] перезаписывается нулем для завершения тела
+ */
+int http_parse_request(char *buffer, size_t length, http_request_t *request) {
+    if (!buffer || !request) {
         return -1;
     }
     
-    // Копируем первую строку
-    int line_length = line_end - raw_request;
-    char first_line[512];
-    strncpy(first_line, raw_request, line_length);
-    first_line[line_length] = '\0';
+    memset(request, 0, sizeof(http_request_t));
+    buffer[length] = '\0';
     
-    // Разбираем метод, путь и версию
-    char *token = strtok(first_line, " ");
-    if (token) {
-        strncpy(request->method, token, sizeof(request->method) - 1);
+    // Первая строка: метод, путь и версия
+    char *line_end = memchr(buffer, '\n', length);
+    if (!line_end) {
+        return -1;
     }
+    char *next_line = line_end + 1;
+    if (line_end > buffer && line_end[-1] == '\r') line_end--;
+    *line_end = '\0';
     
-    token = strtok(NULL, " ");
-    if (token) {
-        strncpy(request->path, token, sizeof(request->path) - 1);
+    char *method = buffer;
+    char *path = strchr(method, ' ');
+    if (!path) {
+        return -1;
+    }
+    *path++ = '\0';
+    char *version = strchr(path, ' ');
+    if (version) {
+        *version++ = '\0';
+    } else {
+        version = line_end; // Пустая строка
+    }
+    // Строка запроса отделяется от пути
+    char *query = strchr(path, '?');
+    if (query) {
+        *query++ = '\0';
+    } else {
+        query = line_end; // Пустая строка
     }
     
-    token = strtok(NULL, " ");
-    if (token) {
-        strncpy(request->version, token, sizeof(request->version) - 1);
+    request->method = method;
+    request->path = path;
+    request->query = query;
+    request->version = version;
+    
+    // Заголовки до пустой строки
+    char *line = next_line;
+    char *buffer_end = buffer + length;
+    while (line < buffer_end && *line != '\r' && *line != '\n') {
+        char *end = memchr(line, '\n', buffer_end - line);
+        if (!end) {
+            return -1;
+        }
+        next_line = end + 1;
+        if (end > line && end[-1] == '\r') end--;
+        *end = '\0';
+        
+        char *colon = strchr(line, ':');
+        if (colon && request->header_count < HTTP_MAX_HEADERS) {
+            *colon = '\0';
+            char *value = colon + 1;
+            while (*value == ' ' || *value == '\t') value++;
+            char *value_end = end;
+            while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+            *value_end = '\0';
+            
+            request->headers[request->header_count].name = line;
+            request->headers[request->header_count].value = value;
+            request->header_count++;
+        }
+        line = next_line;
     }
     
-    // Ищем тело запроса (после пустой строки)
-    char *body_start = strstr(raw_request, "\r\n\r\n");
-    if (!body_start) {
-        body_start = strstr(raw_request, "\n\n");
-        if (body_start) {
-            body_start += 2;
+    // Тело начинается после пустой строки
+    if (line < buffer_end && *line == '\r') line++;
+    if (line < buffer_end && *line == '\n') line++;
+    request->body = line;
+    request->content_length = buffer_end - line;
+    
+    return 0;
+}
+
+/**
+ * Поиск заголовка запроса без учета регистра имени
+ */
+const char* http_get_header(const http_request_t *request, const char *name) {
+    if (!request || !name) return NULL;
+    
+    for (int i = 0; i < request->header_count; i++) {
+        if (strcasecmp(request->headers[i].name, name) == 0) {
+            return request->headers[i].value;
         }
-    } else {
-        body_start += 4;
     }
+    return NULL;
+}
+
+/**
+ * Значение параметра строки запроса (раскодированное). Возвращает 0, если
+ * параметр есть, -1 если нет или значение не помещается в буфер
+ */
+int http_query_param(const http_request_t *request, const char *name, char *value, size_t size) {
+    if (!request || !request->query || !name || size == 0) return -1;
     
-    if (body_start) {
-        int body_length = strlen(body_start);
-        if (body_length > 0 && body_length < MAX_REQUEST_SIZE - 1) {
-            strcpy(request->body, body_start);
-            request->content_length = body_length;
+    size_t name_length = strlen(name);
+    const char *p = request->query;
+    while (*p) {
+        size_t length = strcspn(p, "&");
+        if (length > name_length && strncmp(p, name, name_length) == 0 && p[name_length] == '=') {
+            size_t value_length = length - name_length - 1;
+            if (value_length >= size) return -1;
+            memcpy(value, p + name_length + 1, value_length);
+            value[value_length] = '\0';
+            url_decode(value, value);
+            return 0;
         }
+        p += length;
+        if (*p == '&') p++;
     }
+    return -1;
+}
+
+/**
+ * Хочет ли клиент сохранить соединение: в HTTP/1.1 по умолчанию да,
+ * в HTTP/1.0 только с явным "Connection: keep-alive"
+ */
+int http_request_keep_alive(const http_request_t *request) {
+    if (!request) return 0;
     
-    return 0;
+    const char *connection = http_get_header(request, "Connection");
+    if (strcmp(request->version, "HTTP/1.1") == 0) {
+        return !(connection && strcasestr(connection, "close"));
+    }
+    return connection && strcasestr(connection, "keep-alive");
 }
 
 /**
@@ -142,40 +342,123 @@ void http_set_response_body(http_response_t *response, const char *body) {
     }
 }
 
+/**
+ * Тело ответа из буфера, выделенного через malloc: владение переходит
+ * к ответу, данные отправляются без копирования и без ограничения
+ * MAX_RESPONSE_SIZE
+ */
+void http_set_response_body_data(http_response_t *response, char *data, size_t length) {
+    if (!response || !data) return;
+    
+    response->body_data = data;
+    response->body_size = length;
+    response->body_release = NULL;
+    response->body_length = 0;
+}
+
+/**
+ * Тело ответа из открытого файла: отправляется через sendfile, а release
+ * вызывается после отправки (или сразу, если отправлять нечего)
+ */
+void http_set_response_file(http_response_t *response, int fd, off_t offset, size_t size,
+                            void (*release)(void *ctx), void *ctx) {
+    if (!response) return;
+    
+    if (size == 0) {
+        if (release) release(ctx);
+        http_set_response_body(response, "");
+        return;
+    }
+    
+    response->body_file_fd = fd;
+    response->body_file_offset = offset;
+    response->body_file_size = size;
+    response->body_release = release;
+    response->body_release_ctx = ctx;
+}
+
+/**
+ * Совпадает ли ETag с одним из значений If-None-Match. Для условного GET
+ * используется слабое сравнение: префикс W/ не учитывается
+ */
+int http_etag_matches(const http_request_t *request, const char *etag) {
+    const char *if_none_match = http_get_header(request, "If-None-Match");
+    if (!if_none_match || !etag) return 0;
+    
+    if (strncmp(etag, "W/", 2) == 0) etag += 2;
+    size_t etag_length = strlen(etag);
+    
+    const char *p = if_none_match;
+    while (*p) {
+        p += strspn(p, " \t,");
+        if (*p == '*') return 1;
+        if (strncmp(p, "W/", 2) == 0) p += 2;
+        
+        size_t length = strcspn(p, " \t,");
+        if (length == etag_length && strncmp(p, etag, etag_length) == 0) {
+            return 1;
+        }
+        p += length;
+    }
+    return 0;
+}
+
+/**
+ * Ответ 304 Not Modified: без тела, с тем же ETag
+ */
+void http_set_not_modified(http_response_t *response, const char *etag) {
+    if (!response) return;
+    
+    http_set_response_status(response, 304, "Not Modified");
+    if (etag) {
+        http_add_response_header(response, "ETag", etag);
+    }
+    response->body_length = 0;
+}
+
 /**
  * Формирование полного HTTP ответа
  */
 char* http_format_response(const http_response_t *response) {
-    if (!response) return NULL;
+    size_t length;
+    return http_format_response_len(response, &length);
+}
+
+/**
+ * Формирование полного HTTP ответа с возвратом его точной длины
+ * (тело может содержать бинарные данные, поэтому strlen неприменим)
+ */
+char* http_format_response_len(const http_response_t *response, size_t *length) {
+    if (!response || !length) return NULL;
+    
+    const char *body = response->body;
+    size_t body_size = response->body_length;
     
     // Handle large files stored in body_data
     if (response->body_data && response->body_size > 0) {
-        int header_size = strlen(response->headers) + 100;
-        char *full_response = malloc(header_size + response->body_size);
-        if (!full_response) return NULL;
-        
-        // Write headers first
-        int header_len = snprintf(full_response, header_size,
-            "%sContent-Length: %zu\r\n\r\n",
-            response->headers,
-            response->body_size);
-        
-        // Append binary data
-        memcpy(full_response + header_len, response->body_data, response->body_size);
-        
-        return full_response;
+        body = response->body_data;
+        body_size = response->body_size;
     }
     
-    // Handle regular small responses
-    int total_size = strlen(response->headers) + response->body_length + 100;
-    char *full_response = malloc(total_size);
+    size_t header_size = strlen(response->headers) + 64;
+    char *full_response = malloc(header_size + body_size + 1);
     if (!full_response) return NULL;
     
-    snprintf(full_response, total_size,
-        "%sContent-Length: %d\r\n\r\n%s",
-        response->headers,
-        response->body_length,
-        response->body);
+    // У 304 нет тела, а Content-Length описывал бы полное представление
+    int header_len;
+    if (response->status_code == 304) {
+        body_size = 0;
+        header_len = snprintf(full_response, header_size, "%s\r\n", response->headers);
+    } else {
+        header_len = snprintf(full_response, header_size,
+            "%sContent-Length: %zu\r\n\r\n",
+            response->headers,
+            body_size);
+    }
+    
+    memcpy(full_response + header_len, body, body_size);
+    full_response[header_len + body_size] = '\0';
+    *length = header_len + body_size;
     
     return full_response;
 }
@@ -188,7 +471,7 @@ void url_decode(char *dst, const char *src) {
     char code[3];
     
     while (*src) {
-        if (*src == '%') {
+        if (*src == '%' && isxdigit((unsigned char)src[1]) && isxdigit((unsigned char)src[2])) {
             memcpy(code, src + 1, 2);
             code[2] = '\0';
             *p++ = (char)strtol(code, NULL, 16);
@@ -204,156 +487,1389 @@ void url_decode(char *dst, const char *src) {
 }
 
 /**
- * Обработка клиентского соединения в отдельном потоке
+ * Исходящий ответ: заголовки (с небольшим телом) в собственном буфере,
+ * крупное тело - внешний буфер или файл, отправляемые без копирования
  */
-void* handle_connection(void *arg) {
-    connection_data_t *conn_data = (connection_data_t*)arg;
-    char buffer[MAX_REQUEST_SIZE];
-    
-    // Читаем запрос
-    ssize_t bytes_read = recv(conn_data->client_fd, buffer, sizeof(buffer) - 1, 0);
-    if (bytes_read > 0) {
-        buffer[bytes_read] = '\0';
-        
-        // Парсим запрос
-        http_request_t request;
-        if (http_parse_request(buffer, &request) == 0) {
-            // Создаем ответ
-            http_response_t response;
-            memset(&response, 0, sizeof(response));
-            
-            // Вызываем обработчик
-            conn_data->server->handler(&request, &response);
-            
-            // Отправляем ответ
-            char *full_response = http_format_response(&response);
-            if (full_response) {
-                // Calculate correct response size for binary data
-                size_t response_size;
-                if (response.body_data && response.body_size > 0) {
-                    // For large files: header size + body size
-                    response_size = strlen(response.headers) + 100 + response.body_size;
-                } else {
-                    // For regular responses: use string length
-                    response_size = strlen(full_response);
-                }
-                
-                send(conn_data->client_fd, full_response, response_size, 0);
-                free(full_response);
-                
-                // Clean up large file data
-                if (response.body_data) {
-                    free(response.body_data);
-                }
-            }
+typedef struct {
+    char *head;
+    size_t head_length;
+    size_t head_sent;
+    const char *body;
+    size_t body_length;
+    size_t body_sent;
+    int file_fd;
+    off_t file_offset;
+    size_t file_remaining;
+    void (*release)(void *ctx);
+    void *release_ctx;
+} http_outgoing_t;
+
+static void free_body_data(void *ctx) {
+    free(ctx);
+}
+
+/**
+ * Подготовка исходящего ответа. Владение body_data и файлом переходит
+ * к http_outgoing_t. Возвращает -1 при нехватке памяти
+ */
+static int outgoing_prepare(http_response_t *response, http_outgoing_t *out) {
+    memset(out, 0, sizeof(http_outgoing_t));
+    out->file_fd = -1;
+    
+    size_t external_size = 0;
+    if (response->body_file_size > 0) {
+        external_size = response->body_file_size;
+        out->file_fd = response->body_file_fd;
+        out->file_offset = response->body_file_offset;
+        out->file_remaining = response->body_file_size;
+    } else if (response->body_data && response->body_size > 0) {
+        external_size = response->body_size;
+        out->body = response->body_data;
+        out->body_length = response->body_size;
+    }
+    
+    if (external_size > 0) {
+        out->release = response->body_release ? response->body_release : free_body_data;
+        out->release_ctx = response->body_release ? response->body_release_ctx : response->body_data;
+        response->body_data = NULL;
+        response->body_release = NULL;
+        
+        size_t head_size = strlen(response->headers) + 64;
+        out->head = malloc(head_size);
+        if (!out->head) {
+            return -1;
         }
+        out->head_length = snprintf(out->head, head_size, "%sContent-Length: %zu\r\n\r\n",
+                                    response->headers, external_size);
+        return 0;
     }
     
-    close(conn_data->client_fd);
-    free(conn_data);
-    return NULL;
+    // Небольшое тело копируется вместе с заголовками
+    if (response->body_data) {
+        if (response->body_release) response->body_release(response->body_release_ctx);
+        else free(response->body_data);
+        response->body_data = NULL;
+    }
+    out->head = http_format_response_len(response, &out->head_length);
+    return out->head ? 0 : -1;
 }
 
 /**
- * Запуск HTTP сервера
+ * Освобождение исходящего ответа
  */
-int http_server_start(http_server_t *server) {
-    if (!server) {
-        return -1;
+static void outgoing_release(http_outgoing_t *out) {
+    free(out->head);
+    out->head = NULL;
+    if (out->release) {
+        out->release(out->release_ctx);
+        out->release = NULL;
+    }
+}
+
+/**
+ * Отправка исходящего ответа: заголовки и тело из памяти одним writev,
+ * тело из файла - через sendfile. Возвращает 1 когда ответ отправлен
+ * полностью, 0 если сокет не готов (EAGAIN), -1 при ошибке
+ */
+static int outgoing_flush(int fd, http_outgoing_t *out) {
+    while (out->head_sent < out->head_length || out->body_sent < out->body_length) {
+        struct iovec iov[2];
+        int count = 0;
+        if (out->head_sent < out->head_length) {
+            iov[count].iov_base = out->head + out->head_sent;
+            iov[count].iov_len = out->head_length - out->head_sent;
+            count++;
+        }
+        if (out->body_sent < out->body_length) {
+            iov[count].iov_base = (char*)out->body + out->body_sent;
+            iov[count].iov_len = out->body_length - out->body_sent;
+            count++;
+        }
+        
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        
+        size_t head_part = out->head_length - out->head_sent;
+        if ((size_t)written <= head_part) {
+            out->head_sent += written;
+        } else {
+            out->head_sent = out->head_length;
+            out->body_sent += written - head_part;
+        }
     }
     
-    // Создаем сокет
-    server->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server->socket_fd < 0) {
-        perror("Ошибка создания сокета");
-        return -1;
+    while (out->file_remaining > 0) {
+        ssize_t sent = sendfile(fd, out->file_fd, &out->file_offset, out->file_remaining);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        if (sent == 0) {
+            return -1; // Файл укоротился во время отправки
+        }
+        out->file_remaining -= sent;
     }
+    return 1;
+}
+
+/**
+ * Обработка одного полного запроса длиной request_length байт из буфера
+ * (за ним могут следовать конвейерные запросы): разбор на месте, вызов
+ * обработчика и подготовка ответа в out. keep_alive на входе - разрешает ли
+ * сервер оставить соединение открытым, на выходе - итоговое решение.
+ * Возвращает -1 если запрос не удалось обработать
+ */
+static int process_request(http_server_t *server, char *buffer, size_t request_length,
+                           int *keep_alive, http_outgoing_t *out) {
+    http_request_t request;
     
-    // Настраиваем сокет для переиспользования адреса
-    int opt = 1;
-    if (setsockopt(server->socket_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        perror("Ошибка настройки сокета");
-        close(server->socket_fd);
+    // Разбор завершает тело нулем поверх первого байта следующего запроса -
+    // восстанавливаем его после обработки
+    char saved = buffer[request_length];
+    if (http_parse_request(buffer, request_length, &request) != 0) {
+        buffer[request_length] = saved;
         return -1;
     }
     
-    // Настраиваем адрес сервера
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(server->port);
+    *keep_alive = *keep_alive && http_request_keep_alive(&request);
     
-    if (strcmp(server->host, "0.0.0.0") == 0) {
-        server_addr.sin_addr.s_addr = INADDR_ANY;
+    http_response_t response;
+    memset(&response, 0, sizeof(response));
+    
+    server->handler(&request, &response);
+    buffer[request_length] = saved;
+    
+    if (*keep_alive) {
+        char keep_alive_value[64];
+        snprintf(keep_alive_value, sizeof(keep_alive_value), "timeout=%d, max=%d",
+                 server->keepalive_timeout_ms / 1000, server->keepalive_max_requests);
+        http_add_response_header(&response, "Connection", "keep-alive");
+        http_add_response_header(&response, "Keep-Alive", keep_alive_value);
     } else {
-        if (inet_pton(AF_INET, server->host, &server_addr.sin_addr) <= 0) {
-            fprintf(stderr, "Неверный IP адрес: %s\n", server->host);
-            close(server->socket_fd);
-            return -1;
-        }
+        http_add_response_header(&response, "Connection", "close");
     }
     
-    // Привязываем сокет к адресу
-    if (bind(server->socket_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("Ошибка привязки сокета");
-        close(server->socket_fd);
+    if (outgoing_prepare(&response, out) != 0) {
+        outgoing_release(out);
         return -1;
     }
+    return 0;
+}
+
+/**
+ * Ответ на запрос, который не удалось прочитать (соединение затем закрывается)
+ */
+static int build_error_response(int status_code, http_outgoing_t *out) {
+    const char *status_text = "Bad Request";
+    const char *body = "{\"message\":\"Bad request\"}";
     
-    // Начинаем прослушивание
-    if (listen(server->socket_fd, MAX_CONNECTIONS) < 0) {
-        perror("Ошибка прослушивания");
-        close(server->socket_fd);
-        return -1;
+    switch (status_code) {
+        case 413:
+            status_text = "Payload Too Large";
+            body = "{\"message\":\"Request body is too large\"}";
+            break;
+        case 431:
+            status_text = "Request Header Fields Too Large";
+            body = "{\"message\":\"Request headers are too large\"}";
+            break;
+        case 501:
+            status_text = "Not Implemented";
+            body = "{\"message\":\"Transfer-Encoding is not supported\"}";
+            break;
+        default:
+            status_code = 400;
+            break;
     }
     
-    server->running = 1;
-    printf("🚀 Запуск системы управления зарядными станциями...\n");
-    printf("📍 Режим: разработка\n");
-    printf("🌐 Сервер: http://%s:%d\n", server->host, server->port);
-    printf("💻 Локальный доступ: http://localhost:%d\n", server->port);
-    printf("Сервер готов к работе!\n\n");
+    http_response_t response;
+    memset(&response, 0, sizeof(response));
+    http_set_response_status(&response, status_code, status_text);
+    http_add_response_header(&response, "Content-Type", "application/json; charset=utf-8");
+    http_add_response_header(&response, "Connection", "close");
+    http_set_response_body(&response, body);
+    return outgoing_prepare(&response, out);
+}
+
+/**
+ * Буфер чтения соединения. Начинается с HTTP_INITIAL_BUFFER_SIZE и растет
+ * только до размера, нужного текущему запросу
+ */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    http_request_reader_t reader;
+} conn_buffer_t;
+
+#define CONN_BUFFER_MAX_CAPACITY (HTTP_MAX_HEADER_SIZE + HTTP_MAX_BODY_SIZE + 1)
+
+static void conn_buffer_free(conn_buffer_t *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = buffer->capacity = 0;
+}
+
+/**
+ * Свободное место для чтения. Если буфер полон, он увеличивается, но только
+ * когда текущий запрос еще не получен целиком. Возвращает 0 если места нет
+ */
+static size_t conn_buffer_space(conn_buffer_t *buffer, int request_complete) {
+    size_t space = buffer->capacity ? buffer->capacity - 1 - buffer->length : 0;
+    if (space > 0 || request_complete) {
+        return space;
+    }
     
-    // Основной цикл сервера
-    while (server->running) {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        
-        int client_fd = accept(server->socket_fd, (struct sockaddr*)&client_addr, &client_len);
-        if (client_fd < 0) {
-            if (server->running) {
-                perror("Ошибка принятия соединения");
-            }
-            continue;
-        }
-        
-        // Создаем новый поток для обработки соединения
-        connection_data_t *conn_data = malloc(sizeof(connection_data_t));
-        if (conn_data) {
-            conn_data->client_fd = client_fd;
-            conn_data->server = server;
-            
-            pthread_t thread;
-            if (pthread_create(&thread, NULL, handle_connection, conn_data) == 0) {
-                pthread_detach(thread);
-            } else {
-                close(client_fd);
-                free(conn_data);
-            }
-        } else {
-            close(client_fd);
+    // Известен полный размер запроса - выделяем ровно под него
+    size_t needed = buffer->capacity ? buffer->capacity * 2 : HTTP_INITIAL_BUFFER_SIZE;
+    if (buffer->reader.headers_length) {
+        size_t total = buffer->reader.headers_length + buffer->reader.content_length + 1;
+        if (total > buffer->capacity) {
+            needed = total;
         }
     }
+    if (needed > CONN_BUFFER_MAX_CAPACITY) {
+        needed = CONN_BUFFER_MAX_CAPACITY;
+    }
+    if (needed <= buffer->capacity) {
+        return 0;
+    }
     
-    return 0;
+    char *data = realloc(buffer->data, needed);
+    if (!data) {
+        return 0;
+    }
+    buffer->data = data;
+    buffer->capacity = needed;
+    return buffer->capacity - 1 - buffer->length;
 }
 
 /**
- * Остановка HTTP сервера
+ * Удаление обработанного запроса: конвейерные данные сдвигаются в начало,
+ * а выросший под большое тело буфер возвращается к исходному размеру
  */
-void http_server_stop(http_server_t *server) {
-    if (server) {
-        server->running = 0;
+static void conn_buffer_consume(conn_buffer_t *buffer, size_t request_length) {
+    buffer->length -= request_length;
+    memmove(buffer->data, buffer->data + request_length, buffer->length);
+    http_reader_reset(&buffer->reader);
+    
+    if (buffer->length == 0 && buffer->capacity > HTTP_INITIAL_BUFFER_SIZE) {
+        conn_buffer_free(buffer);
+    }
+}
+
+/**
+ * Проверка, получен ли очередной запрос целиком.
+ * Возвращает 1 и его длину, 0 если нужны данные, или -код ошибки HTTP
+ */
+static int conn_buffer_next_request(conn_buffer_t *buffer, size_t *request_length) {
+    if (buffer->length == 0) {
+        return 0;
+    }
+    return http_reader_scan(&buffer->reader, buffer->data, buffer->length, request_length);
+}
+
+/**
+ * Ячейка очереди принятых соединений.
+ * sequence синхронизирует производителей и потребителей (очередь Вьюкова)
+ */
+typedef struct {
+    size_t sequence;
+    int fd;
+} fd_queue_cell_t;
+
+/**
+ * Ограниченная lock-free MPMC очередь дескрипторов
+ */
+typedef struct {
+    fd_queue_cell_t *cells;
+    size_t mask;
+    size_t limit;
+    char pad1[64];
+    size_t enqueue_pos;
+    char pad2[64];
+    size_t dequeue_pos;
+    char pad3[64];
+    sem_t available;    // Число готовых к выборке элементов, будит рабочие потоки
+} fd_queue_t;
+
+/**
+ * Инициализация очереди; емкость округляется вверх до степени двойки,
+ * а фактический предел глубины равен limit
+ */
+static int fd_queue_init(fd_queue_t *queue, size_t limit) {
+    size_t capacity = 2;
+    while (capacity < limit) {
+        capacity <<= 1;
+    }
+    
+    memset(queue, 0, sizeof(fd_queue_t));
+    queue->cells = malloc(capacity * sizeof(fd_queue_cell_t));
+    if (!queue->cells) {
+        return -1;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        queue->cells[i].sequence = i;
+    }
+    queue->mask = capacity - 1;
+    queue->limit = limit;
+    
+    if (sem_init(&queue->available, 0, 0) != 0) {
+        free(queue->cells);
+        return -1;
+    }
+    return 0;
+}
+
+static void fd_queue_destroy(fd_queue_t *queue) {
+    sem_destroy(&queue->available);
+    free(queue->cells);
+    queue->cells = NULL;
+}
+
+/**
+ * Постановка дескриптора в очередь. Возвращает -1 если очередь заполнена
+ */
+static int fd_queue_push(fd_queue_t *queue, int fd) {
+    size_t pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        size_t depth = pos - __atomic_load_n(&queue->dequeue_pos, __ATOMIC_ACQUIRE);
+        if (depth >= queue->limit) {
+            return -1;
+        }
+        
+        fd_queue_cell_t *cell = &queue->cells[pos & queue->mask];
+        size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell->fd = fd;
+                __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+                sem_post(&queue->available);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * Извлечение дескриптора из очереди. Возвращает -1 если очередь пуста
+ */
+static int fd_queue_pop(fd_queue_t *queue) {
+    size_t pos = __atomic_load_n(&queue->dequeue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        fd_queue_cell_t *cell = &queue->cells[pos & queue->mask];
+        size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->dequeue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                int fd = cell->fd;
+                __atomic_store_n(&cell->sequence, pos + queue->mask + 1, __ATOMIC_RELEASE);
+                return fd;
+            }
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = __atomic_load_n(&queue->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * Число соединений, ожидающих рабочий поток
+ */
+static size_t fd_queue_depth(fd_queue_t *queue) {
+    return __atomic_load_n(&queue->enqueue_pos, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&queue->dequeue_pos, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Получение текущего времени в миллисекундах (монотонные часы)
+ */
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Ожидание данных от клиента не дольше timeout_ms.
+ * Если передана очередь пула, простаивающее соединение уступает рабочий
+ * поток, как только в очереди появляются новые соединения.
+ * Возвращает 1 если данные готовы к чтению, 0 при таймауте или уступке
+ */
+static int wait_readable(int fd, int timeout_ms, fd_queue_t *pending) {
+    long long deadline = monotonic_ms() + timeout_ms;
+    
+    for (;;) {
+        long long remaining = deadline - monotonic_ms();
+        if (remaining <= 0) {
+            return 0;
+        }
+        // С очередью опрашиваем короткими интервалами, чтобы заметить нагрузку
+        int slice = pending && remaining > 100 ? 100 : (int)remaining;
+        
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, slice);
+        if (ready > 0) {
+            return 1;
+        }
+        if (ready < 0 && errno != EINTR) {
+            return 0;
+        }
+        if (pending && fd_queue_depth(pending) > 0) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * Обслуживание клиентского соединения в блокирующем режиме.
+ * Поддерживает keep-alive и конвейерные запросы в одном буфере чтения
+ */
+static void serve_connection(http_server_t *server, int client_fd, fd_queue_t *pending) {
+    conn_buffer_t buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    int served = 0;
+    
+    for (;;) {
+        size_t request_length = 0;
+        int status = conn_buffer_next_request(&buffer, &request_length);
+        
+        if (status < 0) {
+            http_outgoing_t out;
+            if (build_error_response(-status, &out) == 0) {
+                outgoing_flush(client_fd, &out);
+            }
+            outgoing_release(&out);
+            break;
+        }
+        
+        if (status == 0) {
+            // Между запросами действует таймаут простоя, внутри запроса - общий
+            int idle = (buffer.length == 0 && served > 0);
+            int timeout = idle ? server->keepalive_timeout_ms : HTTP_REQUEST_TIMEOUT_MS;
+            if (!wait_readable(client_fd, timeout, idle ? pending : NULL)) {
+                break;
+            }
+            
+            size_t space = conn_buffer_space(&buffer, 0);
+            if (space == 0) {
+                break;
+            }
+            ssize_t bytes_read = recv(client_fd, buffer.data + buffer.length, space, 0);
+            if (bytes_read < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes_read <= 0) {
+                break;
+            }
+            buffer.length += bytes_read;
+            continue;
+        }
+        
+        // Под нагрузкой пул не закрепляет поток за одним клиентом:
+        // ответ с "Connection: close" уступает поток ожидающим соединениям
+        int keep_alive = served + 1 < server->keepalive_max_requests &&
+                         !(pending && fd_queue_depth(pending) > 0);
+        http_outgoing_t out;
+        if (process_request(server, buffer.data, request_length, &keep_alive, &out) != 0) {
+            break;
+        }
+        int sent = outgoing_flush(client_fd, &out);
+        outgoing_release(&out);
+        served++;
+        if (sent != 1 || !keep_alive) {
+            break;
+        }
+        
+        conn_buffer_consume(&buffer, request_length);
+    }
+    
+    conn_buffer_free(&buffer);
+    close(client_fd);
+}
+
+/**
+ * Обработка клиентского соединения в отдельном потоке
+ */
+void* handle_connection(void *arg) {
+    connection_data_t *conn_data = (connection_data_t*)arg;
+    
+    serve_connection(conn_data->server, conn_data->client_fd, NULL);
+    
+    free(conn_data);
+    return NULL;
+}
+
+/**
+ * Состояние соединения в epoll реакторе
+ */
+typedef enum {
+    CONN_READING,   // Накапливаем запрос
+    CONN_HANDLING,  // Запрос обрабатывает рабочий поток
+    CONN_WRITING    // Отправляем сформированный ответ
+} epoll_conn_state_t;
+
+/**
+ * Соединение, обслуживаемое epoll реактором
+ */
+typedef struct epoll_connection {
+    int fd;
+    epoll_conn_state_t state;
+    uint32_t events;        // Текущая маска событий в epoll
+    int drained;            // Сокет прочитан до EAGAIN после последнего EPOLLIN
+    int peer_closed;        // Клиент закрыл свою сторону соединения
+    int keep_alive;         // Оставить соединение после текущего ответа
+    int served;             // Обслужено запросов на соединении
+    int broken;             // Ошибка сокета во время обработки рабочим потоком
+    int handled;            // Результат process_request в рабочем потоке
+    long long last_active;  // Время последней активности для таймаута простоя
+    struct epoll_connection *prev;  // Список соединений по давности активности
+    struct epoll_connection *next;
+    conn_buffer_t in;
+    size_t request_len;     // Длина обрабатываемого запроса в буфере чтения
+    http_outgoing_t out;
+    struct epoll_connection *queued;  // Очередь рабочих потоков или готовых ответов
+} epoll_connection_t;
+
+/**
+ * Рабочие потоки реактора для изменяющих запросов: такие запросы ждут
+ * фиксации журнала изменений (задержка группы и fdatasync), и реактор на это
+ * время не останавливается. Пока запрос у рабочего потока, соединением
+ * владеет он (буфер чтения и ответ); готовое соединение возвращается
+ * в список done, а реактор будится через event_fd
+ */
+typedef struct {
+    http_server_t *server;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    epoll_connection_t *pending_head;   // Ждут рабочий поток
+    epoll_connection_t *pending_tail;
+    epoll_connection_t *done;           // Обработаны, ждут отправки ответа
+    int stop;
+    int event_fd;
+    pthread_t *threads;
+    int started;
+} epoll_workers_t;
+
+/**
+ * Контекст epoll реактора
+ */
+typedef struct {
+    http_server_t *server;
+    int epoll_fd;
+    epoll_connection_t *idle_head;  // Самое давно активное соединение
+    epoll_connection_t *idle_tail;  // Самое недавно активное соединение
+    epoll_workers_t *workers;       // NULL - все запросы обрабатываются в реакторе
+} epoll_reactor_t;
+
+static void reactor_unlink(epoll_reactor_t *reactor, epoll_connection_t *conn) {
+    if (!conn->prev && !conn->next && reactor->idle_head != conn) {
+        return; // Соединение у рабочего потока не входит в список
+    }
+    if (conn->prev) conn->prev->next = conn->next;
+    else reactor->idle_head = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+    else reactor->idle_tail = conn->prev;
+    conn->prev = conn->next = NULL;
+}
+
+/**
+ * Отметка активности: соединение переносится в конец списка, поэтому
+ * просроченные соединения всегда находятся в его начале
+ */
+static void reactor_touch(epoll_reactor_t *reactor, epoll_connection_t *conn) {
+    conn->last_active = monotonic_ms();
+    if (reactor->idle_tail == conn) {
+        return;
+    }
+    if (conn->prev || conn->next || reactor->idle_head == conn) {
+        reactor_unlink(reactor, conn);
+    }
+    conn->prev = reactor->idle_tail;
+    if (reactor->idle_tail) reactor->idle_tail->next = conn;
+    else reactor->idle_head = conn;
+    reactor->idle_tail = conn;
+}
+
+/**
+ * Закрытие соединения реактора
+ */
+static void epoll_connection_close(epoll_reactor_t *reactor, epoll_connection_t *conn) {
+    reactor_unlink(reactor, conn);
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn_buffer_free(&conn->in);
+    outgoing_release(&conn->out);
+    free(conn);
+}
+
+/**
+ * Подписка соединения на нужные события (без лишних epoll_ctl)
+ */
+static int epoll_connection_want(epoll_reactor_t *reactor, epoll_connection_t *conn, uint32_t events) {
+    events |= EPOLLET | EPOLLRDHUP;
+    if (conn->events == events) {
+        return 0;
+    }
+    
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = conn;
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event) < 0) {
+        return -1;
+    }
+    conn->events = events;
+    return 0;
+}
+
+/**
+ * Чтение доступных данных до EAGAIN или заполнения буфера.
+ * Возвращает -1 при ошибке, иначе число прочитанных байт
+ */
+static ssize_t epoll_connection_fill(epoll_connection_t *conn) {
+    size_t total = 0;
+    
+    for (;;) {
+        size_t space = conn_buffer_space(&conn->in, 0);
+        if (space == 0) {
+            break; // Буфер полон: сначала обрабатываем накопленные запросы
+        }
+        
+        ssize_t bytes_read = recv(conn->fd, conn->in.data + conn->in.length, space, 0);
+        if (bytes_read > 0) {
+            conn->in.length += bytes_read;
+            total += bytes_read;
+            if ((size_t)bytes_read < space) {
+                // Короткое чтение: данных в сокете больше нет, лишний recv не нужен
+                conn->drained = 1;
+                break;
+            }
+        } else if (bytes_read == 0) {
+            conn->peer_closed = 1;
+            conn->drained = 1;
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            conn->drained = 1;
+            break;
+        } else {
+            return -1;
+        }
+    }
+    
+    return total;
+}
+
+/**
+ * Запрос может менять данные (метод не GET, HEAD или OPTIONS)
+ */
+static int request_is_mutating(const char *buffer, size_t length) {
+    static const char *const read_methods[] = { "GET ", "HEAD ", "OPTIONS " };
+    for (size_t i = 0; i < sizeof(read_methods) / sizeof(read_methods[0]); i++) {
+        size_t method_length = strlen(read_methods[i]);
+        if (length >= method_length && memcmp(buffer, read_methods[i], method_length) == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void epoll_workers_push(epoll_workers_t *workers, epoll_connection_t *conn) {
+    conn->queued = NULL;
+    pthread_mutex_lock(&workers->lock);
+    if (workers->pending_tail) workers->pending_tail->queued = conn;
+    else workers->pending_head = conn;
+    workers->pending_tail = conn;
+    pthread_cond_signal(&workers->cond);
+    pthread_mutex_unlock(&workers->lock);
+}
+
+/**
+ * Рабочий поток реактора: обрабатывает запрос и возвращает соединение
+ * реактору вместе с готовым ответом
+ */
+static void* epoll_worker_main(void *arg) {
+    epoll_workers_t *workers = arg;
+    
+    pthread_mutex_lock(&workers->lock);
+    for (;;) {
+        while (!workers->pending_head && !workers->stop) {
+            pthread_cond_wait(&workers->cond, &workers->lock);
+        }
+        if (workers->stop) {
+            break;
+        }
+        epoll_connection_t *conn = workers->pending_head;
+        workers->pending_head = conn->queued;
+        if (!workers->pending_head) workers->pending_tail = NULL;
+        pthread_mutex_unlock(&workers->lock);
+        
+        conn->handled = process_request(workers->server, conn->in.data, conn->request_len,
+                                        &conn->keep_alive, &conn->out);
+        
+        pthread_mutex_lock(&workers->lock);
+        conn->queued = workers->done;
+        workers->done = conn;
+        uint64_t one = 1;
+        if (write(workers->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            perror("Ошибка уведомления реактора");
+        }
+    }
+    pthread_mutex_unlock(&workers->lock);
+    return NULL;
+}
+
+/**
+ * Запуск рабочих потоков реактора. При ошибке возвращает -1, и реактор
+ * обрабатывает все запросы сам
+ */
+static int epoll_workers_start(epoll_workers_t *workers, http_server_t *server) {
+    memset(workers, 0, sizeof(*workers));
+    workers->server = server;
+    workers->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    workers->threads = calloc(server->worker_count, sizeof(pthread_t));
+    if (workers->event_fd < 0 || !workers->threads) {
+        if (workers->event_fd >= 0) close(workers->event_fd);
+        free(workers->threads);
+        return -1;
+    }
+    pthread_mutex_init(&workers->lock, NULL);
+    pthread_cond_init(&workers->cond, NULL);
+    
+    for (int i = 0; i < server->worker_count; i++) {
+        if (pthread_create(&workers->threads[i], NULL, epoll_worker_main, workers) != 0) {
+            perror("Ошибка создания рабочего потока");
+            break;
+        }
+        workers->started++;
+    }
+    if (workers->started == 0) {
+        close(workers->event_fd);
+        free(workers->threads);
+        pthread_cond_destroy(&workers->cond);
+        pthread_mutex_destroy(&workers->lock);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Конечный автомат соединения: читает, обрабатывает конвейерные запросы
+ * по порядку и отправляет ответы, пока не упрется в EAGAIN.
+ * Возвращает -1 если соединение нужно закрыть
+ */
+static int epoll_connection_drive(epoll_reactor_t *reactor, epoll_connection_t *conn) {
+    http_server_t *server = reactor->server;
+    
+    for (;;) {
+        if (conn->state == CONN_WRITING) {
+            int flushed = outgoing_flush(conn->fd, &conn->out);
+            if (flushed < 0) {
+                return -1;
+            }
+            if (flushed == 0) {
+                return epoll_connection_want(reactor, conn, EPOLLOUT);
+            }
+            
+            outgoing_release(&conn->out);
+            conn->served++;
+            if (!conn->keep_alive) {
+                return -1;
+            }
+            
+            conn_buffer_consume(&conn->in, conn->request_len);
+            conn->state = CONN_READING;
+            reactor_touch(reactor, conn);
+        }
+        
+        size_t request_length = 0;
+        int status = conn_buffer_next_request(&conn->in, &request_length);
+        
+        if (status < 0) {
+            // Ответ об ошибке, после отправки соединение закрывается
+            if (build_error_response(-status, &conn->out) != 0) {
+                return -1;
+            }
+            conn->keep_alive = 0;
+            conn->state = CONN_WRITING;
+            continue;
+        }
+        
+        if (status == 0) {
+            if (conn->peer_closed) {
+                return -1;
+            }
+            if (conn->drained) {
+                return epoll_connection_want(reactor, conn, EPOLLIN);
+            }
+            ssize_t bytes_read = epoll_connection_fill(conn);
+            if (bytes_read < 0) {
+                return -1;
+            }
+            if (bytes_read == 0 && !conn->drained && !conn->peer_closed) {
+                return -1; // Нет места в буфере и запрос не завершен
+            }
+            reactor_touch(reactor, conn);
+            continue;
+        }
+        
+        conn->request_len = request_length;
+        conn->keep_alive = !conn->peer_closed && conn->served + 1 < server->keepalive_max_requests;
+        if (reactor->workers && request_is_mutating(conn->in.data, request_length)) {
+            // На время обработки соединение не участвует в таймаутах простоя
+            reactor_unlink(reactor, conn);
+            conn->state = CONN_HANDLING;
+            epoll_workers_push(reactor->workers, conn);
+            return 0;
+        }
+        if (process_request(server, conn->in.data, request_length, &conn->keep_alive, &conn->out) != 0) {
+            return -1;
+        }
+        conn->state = CONN_WRITING;
+    }
+}
+
+/**
+ * Возврат обработанных соединений реактору: отправка ответов и чтение
+ * следующих конвейерных запросов
+ */
+static void epoll_workers_complete(epoll_reactor_t *reactor, epoll_workers_t *workers) {
+    uint64_t count;
+    while (read(workers->event_fd, &count, sizeof(count)) < 0 && errno == EINTR) {
+    }
+    
+    pthread_mutex_lock(&workers->lock);
+    epoll_connection_t *conn = workers->done;
+    workers->done = NULL;
+    pthread_mutex_unlock(&workers->lock);
+    
+    while (conn) {
+        epoll_connection_t *next = conn->queued;
+        if (conn->broken || conn->handled != 0) {
+            epoll_connection_close(reactor, conn);
+        } else {
+            conn->state = CONN_WRITING;
+            reactor_touch(reactor, conn);
+            if (epoll_connection_drive(reactor, conn) < 0) {
+                epoll_connection_close(reactor, conn);
+            }
+        }
+        conn = next;
+    }
+}
+
+/**
+ * Остановка рабочих потоков: начатые запросы дообрабатываются, соединения
+ * из обеих очередей закрываются
+ */
+static void epoll_workers_stop(epoll_reactor_t *reactor, epoll_workers_t *workers) {
+    pthread_mutex_lock(&workers->lock);
+    workers->stop = 1;
+    pthread_cond_broadcast(&workers->cond);
+    pthread_mutex_unlock(&workers->lock);
+    for (int i = 0; i < workers->started; i++) {
+        pthread_join(workers->threads[i], NULL);
+    }
+    
+    epoll_connection_t *lists[] = { workers->pending_head, workers->done };
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+        while (lists[i]) {
+            epoll_connection_t *next = lists[i]->queued;
+            epoll_connection_close(reactor, lists[i]);
+            lists[i] = next;
+        }
+    }
+    
+    close(workers->event_fd);
+    free(workers->threads);
+    pthread_cond_destroy(&workers->cond);
+    pthread_mutex_destroy(&workers->lock);
+}
+
+/**
+ * Перевод сокета в неблокирующий режим
+ */
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/**
+ * Прием всех ожидающих соединений (edge-triggered требует читать до EAGAIN)
+ */
+static void epoll_accept_connections(epoll_reactor_t *reactor) {
+    http_server_t *server = reactor->server;
+    
+    for (;;) {
+        int client_fd = accept4(server->socket_fd, NULL, NULL, SOCK_NONBLOCK);
+        if (client_fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && server->running) {
+                perror("Ошибка принятия соединения");
+            }
+            return;
+        }
+        
+        epoll_connection_t *conn = calloc(1, sizeof(epoll_connection_t));
+        if (!conn) {
+            close(client_fd);
+            continue;
+        }
+        conn->fd = client_fd;
+        conn->state = CONN_READING;
+        conn->events = EPOLLIN | EPOLLET | EPOLLRDHUP;
+        
+        struct epoll_event event;
+        event.events = conn->events;
+        event.data.ptr = conn;
+        if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, client_fd, &event) < 0) {
+            close(client_fd);
+            free(conn);
+            continue;
+        }
+        reactor_touch(reactor, conn);
+        
+        // Данные могли прийти вместе с соединением
+        if (epoll_connection_drive(reactor, conn) < 0) {
+            epoll_connection_close(reactor, conn);
+        }
+    }
+}
+
+/**
+ * Закрытие соединений, простаивающих дольше допустимого.
+ * Соединения с незавершенным запросом ограничены общим таймаутом запроса
+ */
+static void epoll_expire_connections(epoll_reactor_t *reactor) {
+    long long now = monotonic_ms();
+    int idle_timeout = reactor->server->keepalive_timeout_ms;
+    int limit = idle_timeout > HTTP_REQUEST_TIMEOUT_MS ? idle_timeout : HTTP_REQUEST_TIMEOUT_MS;
+    
+    epoll_connection_t *conn = reactor->idle_head;
+    while (conn && now - conn->last_active >= idle_timeout) {
+        epoll_connection_t *next = conn->next;
+        int waiting_request = conn->state == CONN_READING && conn->in.length == 0;
+        if (waiting_request || now - conn->last_active >= limit) {
+            epoll_connection_close(reactor, conn);
+        }
+        conn = next;
+    }
+}
+
+/**
+ * Основной цикл epoll реактора
+ */
+static int run_epoll_loop(http_server_t *server) {
+    if (set_nonblocking(server->socket_fd) < 0) {
+        perror("Ошибка перевода сокета в неблокирующий режим");
+        return -1;
+    }
+    
+    epoll_reactor_t reactor;
+    memset(&reactor, 0, sizeof(reactor));
+    reactor.server = server;
+    reactor.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor.epoll_fd < 0) {
+        perror("Ошибка создания epoll");
+        return -1;
+    }
+    
+    // Слушающий сокет помечаем NULL в data.ptr
+    struct epoll_event listen_event;
+    listen_event.events = EPOLLIN | EPOLLET;
+    listen_event.data.ptr = NULL;
+    if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, server->socket_fd, &listen_event) < 0) {
+        perror("Ошибка регистрации сокета в epoll");
+        close(reactor.epoll_fd);
+        return -1;
+    }
+    
+    // Изменяющие запросы - рабочим потокам, их уведомления помечены
+    // указателем на контекст рабочих потоков
+    epoll_workers_t workers;
+    if (epoll_workers_start(&workers, server) == 0) {
+        struct epoll_event workers_event;
+        workers_event.events = EPOLLIN | EPOLLET;
+        workers_event.data.ptr = &workers;
+        if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, workers.event_fd, &workers_event) == 0) {
+            reactor.workers = &workers;
+            printf("👷 Изменяющие запросы: %d рабочих потоков\n", workers.started);
+        } else {
+            epoll_workers_stop(&reactor, &workers);
+        }
+    }
+    
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+    while (server->running) {
+        int ready = epoll_wait(reactor.epoll_fd, events, EPOLL_MAX_EVENTS, 1000);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            perror("Ошибка epoll_wait");
+            break;
+        }
+        
+        for (int i = 0; i < ready; i++) {
+            epoll_connection_t *conn = events[i].data.ptr;
+            if (!conn) {
+                epoll_accept_connections(&reactor);
+                continue;
+            }
+            if ((void*)conn == (void*)reactor.workers) {
+                epoll_workers_complete(&reactor, reactor.workers);
+                continue;
+            }
+            if (conn->state == CONN_HANDLING) {
+                // Соединением владеет рабочий поток: события учитываются после ответа
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    conn->broken = 1;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+                    conn->drained = 0;
+                }
+                continue;
+            }
+            
+            int result = 0;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                result = -1;
+            } else {
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+                    conn->drained = 0;
+                }
+                result = epoll_connection_drive(&reactor, conn);
+            }
+            
+            if (result < 0) {
+                epoll_connection_close(&reactor, conn);
+            }
+        }
+        
+        epoll_expire_connections(&reactor);
+    }
+    
+    if (reactor.workers) {
+        epoll_workers_stop(&reactor, reactor.workers);
+    }
+    while (reactor.idle_head) {
+        epoll_connection_close(&reactor, reactor.idle_head);
+    }
+    close(reactor.epoll_fd);
+    return 0;
+}
+
+/**
+ * Основной цикл модели "поток на соединение"
+ */
+static int run_thread_loop(http_server_t *server) {
+    while (server->running) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        
+        int client_fd = accept(server->socket_fd, (struct sockaddr*)&client_addr, &client_len);
+        if (client_fd < 0) {
+            if (server->running) {
+                perror("Ошибка принятия соединения");
+            }
+            continue;
+        }
+        
+        // Создаем новый поток для обработки соединения
+        connection_data_t *conn_data = malloc(sizeof(connection_data_t));
+        if (conn_data) {
+            conn_data->client_fd = client_fd;
+            conn_data->server = server;
+            
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, handle_connection, conn_data) == 0) {
+                pthread_detach(thread);
+            } else {
+                close(client_fd);
+                free(conn_data);
+            }
+        } else {
+            close(client_fd);
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Контекст пула рабочих потоков
+ */
+typedef struct {
+    http_server_t *server;
+    fd_queue_t queue;
+} worker_pool_t;
+
+/**
+ * Рабочий поток пула: выбирает принятые соединения из очереди
+ */
+static void* pool_worker_main(void *arg) {
+    worker_pool_t *pool = arg;
+    
+    for (;;) {
+        if (sem_wait(&pool->queue.available) != 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        
+        int client_fd = fd_queue_pop(&pool->queue);
+        if (client_fd < 0) {
+            break; // Пустое пробуждение - сигнал завершения
+        }
+        serve_connection(pool->server, client_fd, &pool->queue);
+    }
+    return NULL;
+}
+
+/**
+ * Быстрый отказ при переполнении очереди: 503 без чтения запроса
+ */
+static void reject_overloaded(int client_fd, const char *response, size_t response_size) {
+    send(client_fd, response, response_size, MSG_NOSIGNAL | MSG_DONTWAIT);
+    close(client_fd);
+}
+
+/**
+ * Основной цикл модели "пул потоков": акцептор ставит соединения в очередь,
+ * фиксированное число рабочих потоков их обслуживает
+ */
+static int run_pool_loop(http_server_t *server) {
+    worker_pool_t pool;
+    pool.server = server;
+    if (fd_queue_init(&pool.queue, server->queue_depth) != 0) {
+        fprintf(stderr, "Ошибка создания очереди соединений\n");
+        return -1;
+    }
+    
+    pthread_t *workers = calloc(server->worker_count, sizeof(pthread_t));
+    if (!workers) {
+        fd_queue_destroy(&pool.queue);
+        return -1;
+    }
+    
+    int started = 0;
+    for (int i = 0; i < server->worker_count; i++) {
+        if (pthread_create(&workers[i], NULL, pool_worker_main, &pool) != 0) {
+            perror("Ошибка создания рабочего потока");
+            break;
+        }
+        started++;
+    }
+    printf("👷 Пул потоков: %d рабочих, очередь до %d соединений\n", started, server->queue_depth);
+    
+    // Готовый ответ 503 для переполненной очереди
+    http_response_t busy;
+    memset(&busy, 0, sizeof(busy));
+    http_set_response_status(&busy, 503, "Service Unavailable");
+    http_add_response_header(&busy, "Content-Type", "application/json; charset=utf-8");
+    http_add_response_header(&busy, "Retry-After", "1");
+    http_add_response_header(&busy, "Connection", "close");
+    http_set_response_body(&busy, "{\"message\":\"Server is busy\"}");
+    size_t busy_size = 0;
+    char *busy_response = http_format_response_len(&busy, &busy_size);
+    
+    while (server->running && started > 0) {
+        int client_fd = accept(server->socket_fd, NULL, NULL);
+        if (client_fd < 0) {
+            if (server->running && errno != EINTR) {
+                perror("Ошибка принятия соединения");
+            }
+            continue;
+        }
+        
+        if (fd_queue_push(&pool.queue, client_fd) != 0) {
+            if (busy_response) {
+                reject_overloaded(client_fd, busy_response, busy_size);
+            } else {
+                close(client_fd);
+            }
+        }
+    }
+    
+    // Будим рабочие потоки пустыми сигналами и дожидаемся их завершения
+    for (int i = 0; i < started; i++) {
+        sem_post(&pool.queue.available);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    
+    int client_fd;
+    while ((client_fd = fd_queue_pop(&pool.queue)) >= 0) {
+        close(client_fd);
+    }
+    
+    free(busy_response);
+    free(workers);
+    fd_queue_destroy(&pool.queue);
+    return started > 0 ? 0 : -1;
+}
+
+/**
+ * Выбор модели обработки соединений по имени
+ */
+int http_server_set_mode(http_server_t *server, const char *mode_name) {
+    if (!server || !mode_name) {
+        return -1;
+    }
+    
+    if (strcmp(mode_name, "threads") == 0) {
+        server->mode = HTTP_MODE_THREADS;
+    } else if (strcmp(mode_name, "epoll") == 0) {
+        server->mode = HTTP_MODE_EPOLL;
+    } else if (strcmp(mode_name, "pool") == 0) {
+        server->mode = HTTP_MODE_POOL;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Настройка размера пула потоков и предела очереди соединений
+ */
+int http_server_set_pool(http_server_t *server, int worker_count, int queue_depth) {
+    if (!server || worker_count <= 0 || queue_depth <= 0) {
+        return -1;
+    }
+    
+    server->worker_count = worker_count;
+    server->queue_depth = queue_depth;
+    return 0;
+}
+
+/**
+ * Настройка постоянных соединений: таймаут простоя и предел запросов
+ * на соединение (max_requests <= 1 отключает keep-alive)
+ */
+int http_server_set_keepalive(http_server_t *server, int timeout_ms, int max_requests) {
+    if (!server || timeout_ms <= 0 || max_requests < 0) {
+        return -1;
+    }
+    
+    server->keepalive_timeout_ms = timeout_ms;
+    server->keepalive_max_requests = max_requests;
+    return 0;
+}
+
+/**
+ * Имя модели обработки соединений для логов
+ */
+const char* http_server_mode_name(http_server_mode_t mode) {
+    switch (mode) {
+        case HTTP_MODE_EPOLL:
+            return "epoll";
+        case HTTP_MODE_POOL:
+            return "pool";
+        case HTTP_MODE_THREADS:
+        default:
+            return "threads";
+    }
+}
+
+/**
+ * Запуск HTTP сервера
+ */
+int http_server_start(http_server_t *server) {
+    if (!server) {
+        return -1;
+    }
+    
+    // Создаем сокет
+    server->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->socket_fd < 0) {
+        perror("Ошибка создания сокета");
+        return -1;
+    }
+    
+    // Настраиваем сокет для переиспользования адреса
+    int opt = 1;
+    if (setsockopt(server->socket_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        perror("Ошибка настройки сокета");
+        close(server->socket_fd);
+        return -1;
+    }
+    
+    // Настраиваем адрес сервера
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(server->port);
+    
+    if (strcmp(server->host, "0.0.0.0") == 0) {
+        server_addr.sin_addr.s_addr = INADDR_ANY;
+    } else {
+        if (inet_pton(AF_INET, server->host, &server_addr.sin_addr) <= 0) {
+            fprintf(stderr, "Неверный IP адрес: %s\n", server->host);
+            close(server->socket_fd);
+            return -1;
+        }
+    }
+    
+    // Привязываем сокет к адресу
+    if (bind(server->socket_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        perror("Ошибка привязки сокета");
+        close(server->socket_fd);
+        return -1;
+    }
+    
+    // Начинаем прослушивание
+    if (listen(server->socket_fd, MAX_CONNECTIONS) < 0) {
+        perror("Ошибка прослушивания");
+        close(server->socket_fd);
+        return -1;
+    }
+    
+    server->running = 1;
+    printf("🚀 Запуск системы управления зарядными станциями...\n");
+    printf("📍 Режим: разработка\n");
+    printf("🌐 Сервер: http://%s:%d\n", server->host, server->port);
+    printf("💻 Локальный доступ: http://localhost:%d\n", server->port);
+    printf("Сервер готов к работе!\n");
+    
+    printf("🧵 Модель соединений: %s\n\n", http_server_mode_name(server->mode));
+    
+    // Основной цикл сервера
+    if (server->mode == HTTP_MODE_EPOLL) {
+        return run_epoll_loop(server);
+    }
+    if (server->mode == HTTP_MODE_POOL) {
+        return run_pool_loop(server);
+    }
+    return run_thread_loop(server);
+}
+
+/**
+ * Остановка HTTP сервера
+ */
+void http_server_stop(http_server_t *server) {
+    if (server) {
+        server->running = 0;
+        // Вызывается из обработчика сигнала: shutdown будит поток, ждущий
+        // в accept, и цикл сервера завершается
+        if (server->socket_fd >= 0) {
+            shutdown(server->socket_fd, SHUT_RDWR);
+        }
     }
 }
 
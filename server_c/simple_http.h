@@ -9,22 +9,61 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/types.h>
 
-#define MAX_REQUEST_SIZE 8192
 #define MAX_RESPONSE_SIZE 65536
 #define MAX_CONNECTIONS 100
 
+// Пределы входящего запроса: заголовки до пустой строки и тело по Content-Length
+#define HTTP_MAX_HEADER_SIZE 8192
+#define HTTP_MAX_BODY_SIZE 65536
+#define HTTP_INITIAL_BUFFER_SIZE 4096
+
+// Заголовки запроса
+#define HTTP_MAX_HEADERS 32
+
+// Постоянные соединения (HTTP/1.1 keep-alive)
+#define HTTP_DEFAULT_KEEPALIVE_TIMEOUT_MS 5000
+#define HTTP_DEFAULT_KEEPALIVE_MAX 100
+#define HTTP_REQUEST_TIMEOUT_MS 30000
+
+// Параметры пула потоков по умолчанию
+#define HTTP_DEFAULT_WORKERS 8
+#define HTTP_DEFAULT_QUEUE_DEPTH 256
+
 /**
- * Структура HTTP запроса
+ * Заголовок HTTP запроса (указатели в буфер соединения)
  */
 typedef struct {
-    char method[16];
-    char path[512];
-    char version[16];
-    char body[MAX_REQUEST_SIZE];
+    const char *name;
+    const char *value;
+} http_header_t;
+
+/**
+ * Структура HTTP запроса.
+ * Все строки разбираются на месте и указывают в буфер соединения,
+ * поэтому действительны только во время вызова обработчика
+ */
+typedef struct {
+    const char *method;
+    const char *path;
+    const char *query;      // Строка запроса без '?' (пустая, если ее нет)
+    const char *version;
+    http_header_t headers[HTTP_MAX_HEADERS];
+    int header_count;
+    const char *body;       // Тело запроса, завершено нулем
     int content_length;
 } http_request_t;
 
+/**
+ * Состояние инкрементального чтения запроса
+ */
+typedef struct {
+    size_t scanned;         // Сколько байт уже проверено в поиске конца заголовков
+    size_t headers_length;  // Длина заголовков с пустой строкой (0 - еще не найдена)
+    size_t content_length;  // Значение Content-Length
+} http_request_reader_t;
+
 /**
  * Структура HTTP ответа
  */
@@ -35,6 +74,16 @@ typedef struct {
     int body_length;
     char *body_data;  // For large binary files
     size_t body_size; // Size of body_data
+    
+    // Тело из файла, отправляемое через sendfile без копирования
+    int body_file_fd;
+    off_t body_file_offset;
+    size_t body_file_size;
+    
+    // Освобождение ресурса тела (body_data или файла) после отправки;
+    // без него body_data освобождается через free()
+    void (*body_release)(void *ctx);
+    void *body_release_ctx;
 } http_response_t;
 
 /**
@@ -42,6 +91,15 @@ typedef struct {
  */
 typedef void (*request_handler_t)(const http_request_t *request, http_response_t *response);
 
+/**
+ * Модель обработки соединений
+ */
+typedef enum {
+    HTTP_MODE_THREADS,  // Поток на каждое соединение (по умолчанию)
+    HTTP_MODE_EPOLL,    // Однопоточный edge-triggered epoll реактор
+    HTTP_MODE_POOL      // Фиксированный пул потоков с ограниченной очередью
+} http_server_mode_t;
+
 /**
  * Структура HTTP сервера
  */
@@ -51,6 +109,11 @@ typedef struct {
     const char *host;
     request_handler_t handler;
     int running;
+    http_server_mode_t mode;
+    int worker_count;   // Размер пула потоков (HTTP_MODE_POOL)
+    int queue_depth;    // Предел очереди принятых соединений, сверх него - 503
+    int keepalive_timeout_ms;   // Время простоя постоянного соединения
+    int keepalive_max_requests; // Запросов на соединение (0 - keep-alive выключен)
 } http_server_t;
 
 // Функции HTTP сервера
@@ -59,14 +122,36 @@ int http_server_start(http_server_t *server);
 void http_server_stop(http_server_t *server);
 void http_server_cleanup(http_server_t *server);
 
-// Парсинг HTTP запроса
-int http_parse_request(const char *raw_request, http_request_t *request);
+// Выбор модели обработки соединений ("threads", "epoll" или "pool")
+int http_server_set_mode(http_server_t *server, const char *mode_name);
+int http_server_set_pool(http_server_t *server, int worker_count, int queue_depth);
+int http_server_set_keepalive(http_server_t *server, int timeout_ms, int max_requests);
+const char* http_server_mode_name(http_server_mode_t mode);
+
+// Инкрементальное чтение запроса: 1 и длина запроса когда он получен целиком,
+// 0 если данных пока недостаточно, либо -код_ошибки HTTP (400, 413, 431, 501)
+void http_reader_reset(http_request_reader_t *reader);
+int http_reader_scan(http_request_reader_t *reader, const char *data, size_t length, size_t *request_length);
+
+// Парсинг HTTP запроса на месте (buffer[length] должен быть доступен для записи)
+int http_parse_request(char *buffer, size_t length, http_request_t *request);
+const char* http_get_header(const http_request_t *request, const char *name);
+int http_query_param(const http_request_t *request, const char *name, char *value, size_t size);
+int http_request_keep_alive(const http_request_t *request);
 
 // Формирование HTTP ответа
 void http_set_response_status(http_response_t *response, int status_code, const char *status_text);
 void http_add_response_header(http_response_t *response, const char *name, const char *value);
 void http_set_response_body(http_response_t *response, const char *body);
+void http_set_response_body_data(http_response_t *response, char *data, size_t length);
+void http_set_response_file(http_response_t *response, int fd, off_t offset, size_t size,
+                            void (*release)(void *ctx), void *ctx);
 char* http_format_response(const http_response_t *response);
+char* http_format_response_len(const http_response_t *response, size_t *length);
+
+// Условные запросы (If-None-Match)
+int http_etag_matches(const http_request_t *request, const char *etag);
+void http_set_not_modified(http_response_t *response, const char *etag);
 
 // URL декодирование
 void url_decode(char *dst, const char *src);
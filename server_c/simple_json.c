@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
 
 /**
  * Создание NULL значения
@@ -85,10 +86,85 @@ json_value_t* json_create_object(void) {
         value->data.object.keys = NULL;
         value->data.object.values = NULL;
         value->data.object.count = 0;
+        value->data.object.capacity = 0;
+        value->data.object.index = NULL;
+        value->data.object.index_size = 0;
     }
     return value;
 }
 
+/**
+ * Хэш ключа объекта (FNV-1a)
+ */
+static unsigned int key_hash(const char *key) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char*)key; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Добавление слота в хэш-индекс объекта (место гарантировано заполнением <= 1/2)
+ */
+static void object_index_insert(json_value_t *object, int slot) {
+    unsigned int mask = object->data.object.index_size - 1;
+    unsigned int pos = key_hash(object->data.object.keys[slot]) & mask;
+    while (object->data.object.index[pos]) {
+        pos = (pos + 1) & mask;
+    }
+    object->data.object.index[pos] = slot + 1;
+}
+
+/**
+ * Построение хэш-индекса с запасом для роста объекта. При повторяющихся
+ * ключах поиск находит первый из них, как и линейный просмотр
+ */
+static int object_index_build(json_value_t *object, json_arena_t *arena) {
+    unsigned int size = 16;
+    while (size < (unsigned int)object->data.object.count * 2) {
+        size *= 2;
+    }
+    
+    unsigned int *index = arena ? json_arena_alloc(arena, size * sizeof(unsigned int))
+                                : malloc(size * sizeof(unsigned int));
+    if (!index) return -1;
+    memset(index, 0, size * sizeof(unsigned int));
+    
+    if (!arena) free(object->data.object.index);
+    object->data.object.index = index;
+    object->data.object.index_size = size;
+    for (int i = 0; i < object->data.object.count; i++) {
+        object_index_insert(object, i);
+    }
+    return 0;
+}
+
+/**
+ * Поиск слота по ключу: через индекс за O(1) или просмотром для малых объектов
+ */
+static int object_find(const json_value_t *object, const char *key) {
+    if (object->data.object.index) {
+        unsigned int mask = object->data.object.index_size - 1;
+        unsigned int pos = key_hash(key) & mask;
+        unsigned int entry;
+        while ((entry = object->data.object.index[pos]) != 0) {
+            if (strcmp(object->data.object.keys[entry - 1], key) == 0) {
+                return entry - 1;
+            }
+            pos = (pos + 1) & mask;
+        }
+        return -1;
+    }
+    
+    for (int i = 0; i < object->data.object.count; i++) {
+        if (strcmp(object->data.object.keys[i], key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 /**
  * Добавление элемента в массив
  */
@@ -143,40 +219,50 @@ int json_object_set(json_value_t *object, const char *key, json_value_t *value)
     }
     
     // Проверяем, существует ли уже такой ключ
-    for (int i = 0; i < object->data.object.count; i++) {
-        if (strcmp(object->data.object.keys[i], key) == 0) {
-            // Заменяем существующее значение
-            json_free(&object->data.object.values[i]);
-            object->data.object.values[i] = *value;
-            free(value);
-            return 0;
-        }
+    int existing = object_find(object, key);
+    if (existing >= 0) {
+        // Заменяем существующее значение
+        json_free(&object->data.object.values[existing]);
+        object->data.object.values[existing] = *value;
+        free(value);
+        return 0;
     }
     
-    // Добавляем новый ключ-значение
-    int new_count = object->data.object.count + 1;
-    
-    char **new_keys = realloc(object->data.object.keys, new_count * sizeof(char*));
-    json_value_t *new_values = realloc(object->data.object.values, 
-                                      new_count * sizeof(json_value_t));
-    
-    if (!new_keys || !new_values) {
-        return -1;
+    // Добавляем новый ключ-значение, емкость растет удвоением
+    int count = object->data.object.count;
+    if (count >= object->data.object.capacity) {
+        int capacity = object->data.object.capacity > 0 ? object->data.object.capacity * 2 : 8;
+        
+        char **new_keys = realloc(object->data.object.keys, capacity * sizeof(char*));
+        if (!new_keys) {
+            return -1;
+        }
+        object->data.object.keys = new_keys;
+        
+        json_value_t *new_values = realloc(object->data.object.values, capacity * sizeof(json_value_t));
+        if (!new_values) {
+            return -1;
+        }
+        object->data.object.values = new_values;
+        object->data.object.capacity = capacity;
     }
     
-    new_keys[object->data.object.count] = malloc(strlen(key) + 1);
-    if (!new_keys[object->data.object.count]) {
+    object->data.object.keys[count] = malloc(strlen(key) + 1);
+    if (!object->data.object.keys[count]) {
         return -1;
     }
-    strcpy(new_keys[object->data.object.count], key);
-    
-    new_values[object->data.object.count] = *value;
-    
-    object->data.object.keys = new_keys;
-    object->data.object.values = new_values;
-    object->data.object.count = new_count;
+    strcpy(object->data.object.keys[count], key);
     
+    object->data.object.values[count] = *value;
+    object->data.object.count = count + 1;
     free(value);
+    
+    // Индекс строится при достижении порога и перестраивается при заполнении наполовину
+    if (object->data.object.index && (unsigned int)(count + 1) * 2 <= object->data.object.index_size) {
+        object_index_insert(object, count);
+    } else if (count + 1 >= JSON_OBJECT_INDEX_MIN) {
+        object_index_build(object, NULL);
+    }
     return 0;
 }
 
@@ -188,13 +274,8 @@ json_value_t* json_object_get(json_value_t *object, const char *key) {
         return NULL;
     }
     
-    for (int i = 0; i < object->data.object.count; i++) {
-        if (strcmp(object->data.object.keys[i], key) == 0) {
-            return &object->data.object.values[i];
-        }
-    }
-    
-    return NULL;
+    int slot = object_find(object, key);
+    return slot >= 0 ? &object->data.object.values[slot] : NULL;
 }
 
 /**
@@ -234,6 +315,99 @@ const char* json_get_string(json_value_t *value) {
     return NULL;
 }
 
+/**
+ * Инициализация арены (блоки выделяются при первом использовании)
+ */
+void json_arena_init(json_arena_t *arena, size_t block_size) {
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->block_size = block_size > 0 ? block_size : JSON_ARENA_BLOCK_SIZE;
+}
+
+/**
+ * Выделение памяти из арены с выравниванием под любые типы
+ */
+void* json_arena_alloc(json_arena_t *arena, size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    
+    json_arena_block_t *block = arena->current;
+    while (block && block->used + size > block->size) {
+        // Следующий сохраненный блок начинается заново
+        block = block->next;
+        if (block) block->used = 0;
+    }
+    
+    if (!block) {
+        size_t block_size = size > arena->block_size ? size : arena->block_size;
+        block = malloc(sizeof(json_arena_block_t) + block_size);
+        if (!block) return NULL;
+        block->size = block_size;
+        block->used = 0;
+        
+        // Новый блок встает после текущего, чтобы пройденные блоки
+        // переиспользовались после сброса
+        if (arena->current) {
+            block->next = arena->current->next;
+            arena->current->next = block;
+        } else {
+            block->next = arena->first;
+            arena->first = block;
+        }
+    }
+    
+    arena->current = block;
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+/**
+ * Освобождение всего выделенного за O(1): блоки остаются для повторного
+ * использования, счетчик заполнения сбрасывается по мере перехода к ним
+ */
+void json_arena_reset(json_arena_t *arena) {
+    arena->current = arena->first;
+    if (arena->first) {
+        arena->first->used = 0;
+    }
+}
+
+/**
+ * Возврат всех блоков арены системе
+ */
+void json_arena_destroy(json_arena_t *arena) {
+    json_arena_block_t *block = arena->first;
+    while (block) {
+        json_arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->first = arena->current = NULL;
+}
+
+/**
+ * Выделение памяти для дерева разбора: из арены или через malloc
+ */
+static void* parse_alloc(json_arena_t *arena, size_t size) {
+    return arena ? json_arena_alloc(arena, size) : malloc(size);
+}
+
+/**
+ * Увеличение массива дерева разбора. В арене старый участок остается
+ * занятым до сброса - массивы растут удвоением, поэтому потери невелики
+ */
+static void* parse_grow(json_arena_t *arena, void *ptr, size_t old_size, size_t new_size) {
+    if (!arena) {
+        return realloc(ptr, new_size);
+    }
+    
+    void *grown = json_arena_alloc(arena, new_size);
+    if (grown && ptr) {
+        memcpy(grown, ptr, old_size);
+    }
+    return grown;
+}
+
 /**
  * Пропуск пробелов в JSON строке
  */
@@ -247,7 +421,7 @@ static const char* skip_whitespace(const char *str) {
 /**
  * Парсинг строки из JSON
  */
-static const char* parse_string(const char *str, char **result) {
+static const char* parse_string(const char *str, char **result, json_arena_t *arena) {
     if (*str != '"') return NULL;
     str++; // пропускаем открывающую кавычку
     
@@ -260,8 +434,9 @@ static const char* parse_string(const char *str, char **result) {
     if (*str != '"') return NULL;
     
     int len = str - start;
-    *result = malloc(len + 1);
-    strncpy(*result, start, len);
+    *result = parse_alloc(arena, len + 1);
+    if (!*result) return NULL;
+    memcpy(*result, start, len);
     (*result)[len] = '\0';
     
     return str + 1; // пропускаем закрывающую кавычку
@@ -279,20 +454,23 @@ static const char* parse_number(const char *str, double *result) {
 /**
  * Предварительное объявление для взаимной рекурсии
  */
-static const char* parse_value(const char *str, json_value_t *value);
+static const char* parse_value(const char *str, json_value_t *value, json_arena_t *arena);
 
 /**
  * Парсинг объекта из JSON
  */
-static const char* parse_object(const char *str, json_value_t *value) {
+static const char* parse_object(const char *str, json_value_t *value, json_arena_t *arena) {
     if (*str != '{') return NULL;
     str++;
     
     value->type = JSON_OBJECT;
     value->data.object.count = 0;
     value->data.object.capacity = 16;
-    value->data.object.keys = malloc(value->data.object.capacity * sizeof(char*));
-    value->data.object.values = malloc(value->data.object.capacity * sizeof(json_value_t));
+    value->data.object.index = NULL;
+    value->data.object.index_size = 0;
+    value->data.object.keys = parse_alloc(arena, value->data.object.capacity * sizeof(char*));
+    value->data.object.values = parse_alloc(arena, value->data.object.capacity * sizeof(json_value_t));
+    if (!value->data.object.keys || !value->data.object.values) return NULL;
     
     str = skip_whitespace(str);
     
@@ -305,12 +483,12 @@ static const char* parse_object(const char *str, json_value_t *value) {
         
         // Парсим ключ
         char *key;
-        str = parse_string(str, &key);
+        str = parse_string(str, &key, arena);
         if (!str) break;
         
         str = skip_whitespace(str);
         if (*str != ':') {
-            free(key);
+            if (!arena) free(key);
             break;
         }
         str++;
@@ -319,19 +497,21 @@ static const char* parse_object(const char *str, json_value_t *value) {
         
         // Парсим значение
         json_value_t val;
-        str = parse_value(str, &val);
+        str = parse_value(str, &val, arena);
         if (!str) {
-            free(key);
+            if (!arena) free(key);
             break;
         }
         
         // Добавляем в объект
         if (value->data.object.count >= value->data.object.capacity) {
+            int capacity = value->data.object.capacity;
             value->data.object.capacity *= 2;
-            value->data.object.keys = realloc(value->data.object.keys, 
-                value->data.object.capacity * sizeof(char*));
-            value->data.object.values = realloc(value->data.object.values,
-                value->data.object.capacity * sizeof(json_value_t));
+            value->data.object.keys = parse_grow(arena, value->data.object.keys,
+                capacity * sizeof(char*), value->data.object.capacity * sizeof(char*));
+            value->data.object.values = parse_grow(arena, value->data.object.values,
+                capacity * sizeof(json_value_t), value->data.object.capacity * sizeof(json_value_t));
+            if (!value->data.object.keys || !value->data.object.values) return NULL;
         }
         
         value->data.object.keys[value->data.object.count] = key;
@@ -340,6 +520,11 @@ static const char* parse_object(const char *str, json_value_t *value) {
         
         str = skip_whitespace(str);
         if (*str == '}') {
+            // Индекс ключей строится один раз после разбора объекта
+            if (value->data.object.count >= JSON_OBJECT_INDEX_MIN &&
+                object_index_build(value, arena) != 0) {
+                return NULL;
+            }
             return str + 1;
         } else if (*str == ',') {
             str++;
@@ -354,13 +539,13 @@ static const char* parse_object(const char *str, json_value_t *value) {
 /**
  * Парсинг значения из JSON
  */
-static const char* parse_value(const char *str, json_value_t *value) {
+static const char* parse_value(const char *str, json_value_t *value, json_arena_t *arena) {
     str = skip_whitespace(str);
     
     if (*str == '"') {
         // Строка
         char *string_val;
-        str = parse_string(str, &string_val);
+        str = parse_string(str, &string_val, arena);
         if (str) {
             value->type = JSON_STRING;
             value->data.string_val = string_val;
@@ -368,7 +553,7 @@ static const char* parse_value(const char *str, json_value_t *value) {
         return str;
     } else if (*str == '{') {
         // Объект
-        return parse_object(str, value);
+        return parse_object(str, value, arena);
     } else if (*str == 't' && strncmp(str, "true", 4) == 0) {
         // true
         value->type = JSON_BOOL;
@@ -406,7 +591,7 @@ json_value_t* json_parse(const char *json_string) {
     json_value_t *result = malloc(sizeof(json_value_t));
     if (!result) return NULL;
     
-    const char *end = parse_value(json_string, result);
+    const char *end = parse_value(json_string, result, NULL);
     if (!end) {
         free(result);
         return NULL;
@@ -416,67 +601,261 @@ json_value_t* json_parse(const char *json_string) {
 }
 
 /**
- * Сериализация JSON в строку
+ * Разбор JSON в арену: все строки, ключи и массивы значений берутся
+ * из арены и освобождаются ее сбросом, json_free для дерева не нужен
  */
-char* json_stringify(json_value_t *value) {
-    if (!value) return NULL;
+json_value_t* json_parse_arena(const char *json_string, json_arena_t *arena) {
+    if (!json_string || !arena) return NULL;
     
-    char *result = malloc(4096); // Буфер для результата
+    json_value_t *result = json_arena_alloc(arena, sizeof(json_value_t));
     if (!result) return NULL;
     
-    result[0] = '\0';
+    if (!parse_value(json_string, result, arena)) {
+        return NULL;
+    }
+    return result;
+}
+
+/**
+ * Инициализация буфера с начальной емкостью
+ */
+void json_buf_init(json_buf_t *buf, size_t capacity) {
+    buf->length = 0;
+    buf->capacity = capacity > 0 ? capacity : 256;
+    buf->data = malloc(buf->capacity);
+    buf->failed = buf->data == NULL;
+    if (buf->data) {
+        buf->data[0] = '\0';
+    }
+}
+
+/**
+ * Резервирование места под extra байт и завершающий ноль.
+ * Емкость растет вдвое, поэтому запись n байт стоит O(n)
+ */
+int json_buf_reserve(json_buf_t *buf, size_t extra) {
+    if (buf->failed) return -1;
+    
+    size_t needed = buf->length + extra + 1;
+    if (needed <= buf->capacity) return 0;
+    
+    size_t capacity = buf->capacity;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
     
+    char *data = realloc(buf->data, capacity);
+    if (!data) {
+        buf->failed = 1;
+        return -1;
+    }
+    buf->data = data;
+    buf->capacity = capacity;
+    return 0;
+}
+
+void json_buf_append(json_buf_t *buf, const char *data, size_t length) {
+    if (json_buf_reserve(buf, length) != 0) return;
+    
+    memcpy(buf->data + buf->length, data, length);
+    buf->length += length;
+    buf->data[buf->length] = '\0';
+}
+
+void json_buf_append_str(json_buf_t *buf, const char *str) {
+    json_buf_append(buf, str, strlen(str));
+}
+
+/**
+ * Число в формате сериализатора ("%.2f")
+ */
+void json_buf_append_number(json_buf_t *buf, double number) {
+    if (json_buf_reserve(buf, 32) != 0) return;
+    
+    // Целые значения (id, мощности в целых кВт) форматируются без snprintf;
+    // результат совпадает с "%.2f"
+    if (number > -1e15 && number < 1e15 && number == (double)(long long)number &&
+        !(number == 0 && signbit(number))) {
+        char digits[24];
+        long long integer = (long long)number;
+        unsigned long long magnitude = integer < 0 ? -(unsigned long long)integer : (unsigned long long)integer;
+        int count = 0;
+        do {
+            digits[count++] = '0' + magnitude % 10;
+            magnitude /= 10;
+        } while (magnitude);
+        
+        char *out = buf->data + buf->length;
+        if (integer < 0) *out++ = '-';
+        while (count > 0) *out++ = digits[--count];
+        memcpy(out, ".00", 4);
+        buf->length = out + 3 - buf->data;
+        return;
+    }
+    
+    size_t space = buf->capacity - buf->length;
+    int written = snprintf(buf->data + buf->length, space, "%.2f", number);
+    if (written < 0) return;
+    
+    // Очень большие числа не помещаются в резерв - повторяем с нужным местом
+    if ((size_t)written >= space) {
+        if (json_buf_reserve(buf, written) != 0) return;
+        snprintf(buf->data + buf->length, written + 1, "%.2f", number);
+    }
+    buf->length += written;
+}
+
+/**
+ * Число одинарной точности в формате "%.2f" без snprintf. Произведение
+ * float на 100 точно представимо в double, поэтому округление до сотых
+ * (половины - к четному, как в printf) дает тот же результат
+ */
+void json_buf_append_float(json_buf_t *buf, float number) {
+    double scaled = (double)number * 100.0;
+    if (!(scaled > -1e15 && scaled < 1e15)) {
+        json_buf_append_number(buf, number); // NaN, бесконечности, большие значения
+        return;
+    }
+    if (json_buf_reserve(buf, 24) != 0) return;
+    
+    double absolute = scaled < 0 ? -scaled : scaled;
+    unsigned long long hundredths = (unsigned long long)absolute;
+    double rest = absolute - (double)hundredths;
+    if (rest > 0.5 || (rest == 0.5 && (hundredths & 1))) {
+        hundredths++;
+    }
+    
+    char digits[24];
+    int count = 0;
+    digits[count++] = '0' + hundredths % 10;
+    hundredths /= 10;
+    digits[count++] = '0' + hundredths % 10;
+    hundredths /= 10;
+    do {
+        digits[count++] = '0' + hundredths % 10;
+        hundredths /= 10;
+    } while (hundredths);
+    
+    char *out = buf->data + buf->length;
+    if (signbit(number)) *out++ = '-';
+    while (count > 2) *out++ = digits[--count];
+    *out++ = '.';
+    *out++ = digits[1];
+    *out++ = digits[0];
+    *out = '\0';
+    buf->length = out - buf->data;
+}
+
+/**
+ * Строка в кавычках. Парсер сохраняет escape-последовательности как есть,
+ * поэтому содержимое выводится без повторного экранирования
+ */
+void json_buf_append_string(json_buf_t *buf, const char *str) {
+    size_t length = strlen(str);
+    if (json_buf_reserve(buf, length + 2) != 0) return;
+    
+    buf->data[buf->length++] = '"';
+    memcpy(buf->data + buf->length, str, length);
+    buf->length += length;
+    buf->data[buf->length++] = '"';
+    buf->data[buf->length] = '\0';
+}
+
+/**
+ * Запись значения в буфер за один проход по дереву
+ */
+void json_write_value(json_buf_t *buf, const json_value_t *value) {
     switch (value->type) {
         case JSON_NULL:
-            strcpy(result, "null");
+            json_buf_append(buf, "null", 4);
             break;
             
         case JSON_BOOL:
-            strcpy(result, value->data.bool_val ? "true" : "false");
+            if (value->data.bool_val) json_buf_append(buf, "true", 4);
+            else json_buf_append(buf, "false", 5);
             break;
             
         case JSON_NUMBER:
-            snprintf(result, 4096, "%.2f", value->data.number_val);
+            json_buf_append_number(buf, value->data.number_val);
             break;
             
         case JSON_STRING:
-            snprintf(result, 4096, "\"%s\"", value->data.string_val);
+            json_buf_append_string(buf, value->data.string_val);
             break;
             
         case JSON_ARRAY:
-            strcpy(result, "[");
+            json_buf_append(buf, "[", 1);
             for (int i = 0; i < value->data.array.count; i++) {
-                if (i > 0) strcat(result, ",");
-                char *item_str = json_stringify(&value->data.array.items[i]);
-                if (item_str) {
-                    strcat(result, item_str);
-                    free(item_str);
-                }
+                if (i > 0) json_buf_append(buf, ",", 1);
+                json_write_value(buf, &value->data.array.items[i]);
             }
-            strcat(result, "]");
+            json_buf_append(buf, "]", 1);
             break;
             
         case JSON_OBJECT:
-            strcpy(result, "{");
+            json_buf_append(buf, "{", 1);
             for (int i = 0; i < value->data.object.count; i++) {
-                if (i > 0) strcat(result, ",");
-                char key_str[256];
-                snprintf(key_str, sizeof(key_str), "\"%s\":", value->data.object.keys[i]);
-                strcat(result, key_str);
-                
-                char *val_str = json_stringify(&value->data.object.values[i]);
-                if (val_str) {
-                    strcat(result, val_str);
-                    free(val_str);
-                }
+                if (i > 0) json_buf_append(buf, ",", 1);
+                json_buf_append_string(buf, value->data.object.keys[i]);
+                json_buf_append(buf, ":", 1);
+                json_write_value(buf, &value->data.object.values[i]);
             }
-            strcat(result, "}");
+            json_buf_append(buf, "}", 1);
             break;
     }
+}
+
+/**
+ * Передача содержимого буфера вызывающему (освобождается через free).
+ * NULL если при записи не хватило памяти
+ */
+char* json_buf_detach(json_buf_t *buf, size_t *length) {
+    if (buf->failed) {
+        json_buf_free(buf);
+        return NULL;
+    }
+    
+    char *data = buf->data;
+    if (length) *length = buf->length;
+    buf->data = NULL;
+    buf->length = buf->capacity = 0;
+    return data;
+}
+
+void json_buf_free(json_buf_t *buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->length = buf->capacity = 0;
+}
+
+/**
+ * Сериализация JSON в строку с возвратом длины. Начальная емкость берется
+ * по размеру предыдущего результата в этом потоке, так что при регулярных
+ * опросах ответ обычно укладывается в одно выделение памяти
+ */
+char* json_stringify_len(const json_value_t *value, size_t *length) {
+    if (!value) return NULL;
+    
+    static __thread size_t last_length = 0;
+    
+    json_buf_t buf;
+    json_buf_init(&buf, last_length + last_length / 8 + 64);
+    json_write_value(&buf, value);
     
+    char *result = json_buf_detach(&buf, length);
+    if (result) {
+        last_length = length ? *length : strlen(result);
+    }
     return result;
 }
 
+/**
+ * Сериализация JSON в строку
+ */
+char* json_stringify(json_value_t *value) {
+    return json_stringify_len(value, NULL);
+}
+
 /**
  * Освобождение памяти JSON значения
  */
@@ -512,6 +891,7 @@ void json_free(json_value_t *value) {
             if (value->data.object.values) {
                 free(value->data.object.values);
             }
+            free(value->data.object.index);
             break;
             
         default:
@@ -12,6 +12,8 @@
 
 #define JSON_MAX_STRING 1024
 #define JSON_MAX_KEYS 50
+#define JSON_ARENA_BLOCK_SIZE 16384
+#define JSON_OBJECT_INDEX_MIN 8
 
 /**
  * Типы JSON значений
@@ -43,10 +45,45 @@ typedef struct json_value {
             struct json_value *values;
             int count;
             int capacity;
+            // Хэш-индекс ключей (открытая адресация, номер слота + 1, 0 - пусто)
+            // для объектов от JSON_OBJECT_INDEX_MIN ключей
+            unsigned int *index;
+            unsigned int index_size;
         } object;
     } data;
 } json_value_t;
 
+/**
+ * Растущий буфер вывода для сериализации в один проход
+ */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    int failed; // Не удалось выделить память, содержимое неполное
+} json_buf_t;
+
+/**
+ * Блок арены
+ */
+typedef struct json_arena_block {
+    struct json_arena_block *next;
+    size_t size;
+    size_t used;
+    char data[];
+} json_arena_block_t;
+
+/**
+ * Арена для деревьев разбора: память выделяется сдвигом указателя
+ * и освобождается целиком сбросом арены. Блоки сохраняются между
+ * сбросами, поэтому повторный разбор не обращается к malloc
+ */
+typedef struct {
+    json_arena_block_t *first;
+    json_arena_block_t *current;
+    size_t block_size;
+} json_arena_t;
+
 // Создание JSON значений
 json_value_t* json_create_null(void);
 json_value_t* json_create_bool(int value);
@@ -73,6 +110,28 @@ const char* json_get_string(json_value_t *value);
 // Парсинг и сериализация
 json_value_t* json_parse(const char *json_string);
 char* json_stringify(json_value_t *value);
+char* json_stringify_len(const json_value_t *value, size_t *length);
+
+// Разбор в арену (дерево только для чтения и не освобождается через json_free)
+json_value_t* json_parse_arena(const char *json_string, json_arena_t *arena);
+
+// Арена
+void json_arena_init(json_arena_t *arena, size_t block_size);
+void* json_arena_alloc(json_arena_t *arena, size_t size);
+void json_arena_reset(json_arena_t *arena);
+void json_arena_destroy(json_arena_t *arena);
+
+// Буфер вывода
+void json_buf_init(json_buf_t *buf, size_t capacity);
+int json_buf_reserve(json_buf_t *buf, size_t extra);
+void json_buf_append(json_buf_t *buf, const char *data, size_t length);
+void json_buf_append_str(json_buf_t *buf, const char *str);
+void json_buf_append_number(json_buf_t *buf, double number);
+void json_buf_append_float(json_buf_t *buf, float number);
+void json_buf_append_string(json_buf_t *buf, const char *str);
+void json_write_value(json_buf_t *buf, const json_value_t *value);
+char* json_buf_detach(json_buf_t *buf, size_t *length);
+void json_buf_free(json_buf_t *buf);
 
 // Освобождение памяти
 void json_free(json_value_t *value);
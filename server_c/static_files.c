@@ -0,0 +1,561 @@
+/**
+ * Раздача статических файлов фронтенда с кэшем открытых дескрипторов
+ */
+
+#include "static_files.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Корень статических файлов и кэш
+static char static_root[STATIC_MAX_PATH] = "";
+static static_file_t *cache_buckets[STATIC_CACHE_BUCKETS];
+static int cache_entries = 0;
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#ifdef HAVE_ZLIB
+static int gzip_cache_enabled = 0;
+#endif
+
+/**
+ * Соответствие расширений файлов MIME типам
+ */
+static const struct {
+    const char *extension;
+    const char *content_type;
+} content_types[] = {
+    { ".html", "text/html; charset=utf-8" },
+    { ".css",  "text/css; charset=utf-8" },
+    { ".js",   "text/javascript; charset=utf-8" },
+    { ".mjs",  "text/javascript; charset=utf-8" },
+    { ".json", "application/json; charset=utf-8" },
+    { ".png",  "image/png" },
+    { ".jpg",  "image/jpeg" },
+    { ".jpeg", "image/jpeg" },
+    { ".svg",  "image/svg+xml" },
+    { ".ico",  "image/x-icon" },
+    { ".woff", "font/woff" },
+    { ".woff2", "font/woff2" },
+    { ".webp", "image/webp" },
+    { ".txt",  "text/plain; charset=utf-8" },
+};
+
+static const char* content_type_for(const char *path) {
+    const char *extension = strrchr(path, '.');
+    if (extension && !strchr(extension, '/')) {
+        for (size_t i = 0; i < sizeof(content_types) / sizeof(content_types[0]); i++) {
+            if (strcasecmp(extension, content_types[i].extension) == 0) {
+                return content_types[i].content_type;
+            }
+        }
+    }
+    return "text/plain";
+}
+
+/**
+ * Имеет ли смысл сжимать содержимое такого типа (изображения уже сжаты)
+ */
+static int is_compressible(const char *content_type) {
+    return strncmp(content_type, "text/", 5) == 0 || strstr(content_type, "json") ||
+           strstr(content_type, "svg") || strstr(content_type, "javascript");
+}
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static unsigned int hash_path(const char *path) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char*)path; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash % STATIC_CACHE_BUCKETS;
+}
+
+/**
+ * Инициализация корня статических файлов
+ */
+int static_files_init(const char *root) {
+    if (!root || strlen(root) >= sizeof(static_root)) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&cache_mutex);
+    strcpy(static_root, root);
+    pthread_mutex_unlock(&cache_mutex);
+
+    printf("Статические файлы: %s\n", root);
+    return 0;
+}
+
+/**
+ * Уменьшение счетчика ссылок (под cache_mutex). Возвращает файл,
+ * который нужно закрыть вне блокировки, или NULL
+ */
+static static_file_t* file_unref_locked(static_file_t *file) {
+    return --file->refcount == 0 ? file : NULL;
+}
+
+static void file_destroy(static_file_t *file) {
+    if (!file) return;
+    if (file->fd >= 0) close(file->fd);
+    free(file->gzip_data);
+    free(file);
+}
+
+/**
+ * Удаление записи из кэша (под cache_mutex)
+ */
+static static_file_t* cache_remove_locked(static_file_t *file) {
+    static_file_t **link = &cache_buckets[hash_path(file->path)];
+    while (*link && *link != file) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = file->next;
+        cache_entries--;
+    }
+    file->cached = 0;
+    file->next = NULL;
+    return file_unref_locked(file);
+}
+
+/**
+ * Очистка кэша; файлы, которые еще отправляются, закроются при release
+ */
+void static_files_cleanup(void) {
+    pthread_mutex_lock(&cache_mutex);
+    for (int i = 0; i < STATIC_CACHE_BUCKETS; i++) {
+        while (cache_buckets[i]) {
+            file_destroy(cache_remove_locked(cache_buckets[i]));
+        }
+    }
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * Сжатие содержимого файла gzip в память. Копия сохраняется, только если
+ * она заметно меньше оригинала
+ */
+static void file_compress(static_file_t *file) {
+    char *source = malloc(file->size);
+    if (!source) return;
+    
+    size_t total = 0;
+    while (total < file->size) {
+        ssize_t n = pread(file->fd, source + total, file->size - total, total);
+        if (n <= 0) {
+            free(source);
+            return;
+        }
+        total += n;
+    }
+    
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // windowBits 15 + 16 - формат gzip вместо zlib
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(source);
+        return;
+    }
+    
+    size_t bound = deflateBound(&stream, file->size);
+    char *compressed = malloc(bound);
+    if (compressed) {
+        stream.next_in = (Bytef*)source;
+        stream.avail_in = file->size;
+        stream.next_out = (Bytef*)compressed;
+        stream.avail_out = bound;
+        
+        if (deflate(&stream, Z_FINISH) == Z_STREAM_END && stream.total_out < file->size - file->size / 10) {
+            char *shrunk = realloc(compressed, stream.total_out);
+            file->gzip_data = shrunk ? shrunk : compressed;
+            file->gzip_size = stream.total_out;
+        } else {
+            free(compressed);
+        }
+    }
+    
+    deflateEnd(&stream);
+    free(source);
+}
+#endif
+
+/**
+ * Открытие файла и чтение метаданных. Если файла нет (или это не обычный
+ * файл), при allow_missing возвращается запись-отметка об отсутствии,
+ * иначе NULL
+ */
+static static_file_t* file_open(const char *path, const char *content_type,
+                                const char *content_encoding, int allow_missing) {
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0 && (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))) {
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0 && !allow_missing) {
+        return NULL;
+    }
+    
+    static_file_t *file = calloc(1, sizeof(static_file_t));
+    if (!file) {
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    
+    strcpy(file->path, path);
+    file->fd = fd;
+    file->content_type = content_type;
+    file->content_encoding = content_encoding;
+    file->checked_ms = monotonic_ms();
+    file->refcount = 1;
+    if (fd >= 0) {
+        file->size = st.st_size;
+        file->mtime = st.st_mtime;
+        file->inode = st.st_ino;
+    }
+    
+#ifdef HAVE_ZLIB
+    if (fd >= 0 && gzip_cache_enabled && !content_encoding &&
+        file->size >= STATIC_GZIP_MIN_SIZE && is_compressible(content_type)) {
+        file_compress(file);
+    }
+#endif
+    return file;
+}
+
+/**
+ * Проверка, что закэшированная запись соответствует состоянию диска
+ */
+static int file_is_current(const static_file_t *file) {
+    struct stat st;
+    if (stat(file->path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return file->fd < 0;
+    }
+    return file->fd >= 0 && st.st_ino == file->inode &&
+           st.st_mtime == file->mtime && (size_t)st.st_size == file->size;
+}
+
+/**
+ * Поиск записи кэша по пути на диске (под cache_mutex)
+ */
+static static_file_t* cache_find_locked(unsigned int bucket, const char *path) {
+    static_file_t *file = cache_buckets[bucket];
+    while (file && strcmp(file->path, path) != 0) {
+        file = file->next;
+    }
+    return file;
+}
+
+/**
+ * Получение записи кэша по пути на диске. Метаданные перепроверяются не чаще
+ * раза в STATIC_REVALIDATE_MS, поэтому пересобранный фронтенд подхватывается
+ * без перезапуска сервера
+ */
+static static_file_t* cache_acquire(const char *path, const char *content_type,
+                                    const char *content_encoding, int allow_missing) {
+    unsigned int bucket = hash_path(path);
+    long long now = monotonic_ms();
+    static_file_t *stale = NULL;
+    
+    pthread_mutex_lock(&cache_mutex);
+    static_file_t *file = cache_find_locked(bucket, path);
+    if (file && now - file->checked_ms < STATIC_REVALIDATE_MS) {
+        file->refcount++;
+        pthread_mutex_unlock(&cache_mutex);
+        return file;
+    }
+    // Ссылка держит запись, пока stat проверяется без блокировки кэша:
+    // другой поток может за это время убрать ее из кэша
+    if (file) {
+        file->refcount++;
+    }
+    pthread_mutex_unlock(&cache_mutex);
+
+    if (file) {
+        int current = file_is_current(file);
+        pthread_mutex_lock(&cache_mutex);
+        if (current && file->cached) {
+            file->checked_ms = now;
+            pthread_mutex_unlock(&cache_mutex);
+            return file;
+        }
+        static_file_t *unused = file_unref_locked(file);
+        pthread_mutex_unlock(&cache_mutex);
+        file_destroy(unused);
+    }
+    
+    static_file_t *fresh = file_open(path, content_type, content_encoding, allow_missing);
+    
+    pthread_mutex_lock(&cache_mutex);
+    // Запись могла быть обновлена другим потоком
+    file = cache_find_locked(bucket, path);
+    if (file) {
+        stale = cache_remove_locked(file);
+    }
+    if (fresh && cache_entries < STATIC_CACHE_MAX_ENTRIES) {
+        fresh->cached = 1;
+        fresh->refcount++;
+        fresh->next = cache_buckets[bucket];
+        cache_buckets[bucket] = fresh;
+        cache_entries++;
+    }
+    pthread_mutex_unlock(&cache_mutex);
+    
+    file_destroy(stale);
+    return fresh;
+}
+
+/**
+ * Получение файла по пути URL. Строка запроса отбрасывается, пути с ".."
+ * отклоняются. Вызывающий обязан вернуть файл через static_file_release
+ */
+static_file_t* static_file_acquire(const char *url_path) {
+    if (!url_path || url_path[0] != '/' || strstr(url_path, "..")) {
+        return NULL;
+    }
+    
+    size_t url_length = strcspn(url_path, "?#");
+    char path[STATIC_MAX_PATH];
+    int path_length = snprintf(path, sizeof(path), "%s%.*s", static_root, (int)url_length, url_path);
+    if (path_length < 0 || path_length >= (int)sizeof(path)) {
+        return NULL;
+    }
+    
+    return cache_acquire(path, content_type_for(path), NULL, 0);
+}
+
+/**
+ * Получение предсжатого варианта файла (путь + suffix). Отсутствие варианта
+ * тоже кэшируется, чтобы не проверять диск на каждый запрос
+ */
+static static_file_t* variant_acquire(const static_file_t *file, const char *suffix, const char *encoding) {
+    char path[STATIC_MAX_PATH];
+    int path_length = snprintf(path, sizeof(path), "%s%s", file->path, suffix);
+    if (path_length < 0 || path_length >= (int)sizeof(path)) {
+        return NULL;
+    }
+    
+    static_file_t *variant = cache_acquire(path, file->content_type, encoding, 1);
+    if (variant && variant->fd < 0) {
+        static_file_release(variant);
+        return NULL;
+    }
+    return variant;
+}
+
+/**
+ * Возврат файла после отправки
+ */
+void static_file_release(static_file_t *file) {
+    if (!file) return;
+
+    pthread_mutex_lock(&cache_mutex);
+    static_file_t *unused = file_unref_locked(file);
+    pthread_mutex_unlock(&cache_mutex);
+
+    file_destroy(unused);
+}
+
+static void static_file_release_ctx(void *ctx) {
+    static_file_release(ctx);
+}
+
+/**
+ * Принимает ли клиент кодировку по заголовку Accept-Encoding.
+ * Учитывает "*" и явный отказ через q=0
+ */
+static int accepts_encoding(const char *accept_encoding, const char *encoding) {
+    if (!accept_encoding) return 0;
+    
+    size_t encoding_length = strlen(encoding);
+    int wildcard = 0;
+    const char *p = accept_encoding;
+    while (*p) {
+        p += strspn(p, " \t,");
+        size_t name_length = strcspn(p, " \t;,");
+        const char *params = p + name_length;
+        const char *item_end = params + strcspn(params, ",");
+        
+        int acceptable = 1;
+        const char *q = strstr(params, "q=");
+        if (q && q < item_end) {
+            acceptable = strtod(q + 2, NULL) > 0;
+        }
+        
+        if (name_length == encoding_length && strncasecmp(p, encoding, encoding_length) == 0) {
+            return acceptable;
+        }
+        if (name_length == 1 && *p == '*') {
+            wildcard = acceptable;
+        }
+        p = item_end;
+    }
+    return wildcard;
+}
+
+/**
+ * Проверка условий запроса: If-None-Match имеет приоритет, без него
+ * сравнивается If-Modified-Since с временем изменения файла
+ */
+static int is_not_modified(const http_request_t *request, const char *etag, time_t mtime) {
+    if (http_get_header(request, "If-None-Match")) {
+        return http_etag_matches(request, etag);
+    }
+    
+    const char *if_modified_since = http_get_header(request, "If-Modified-Since");
+    if (!if_modified_since) {
+        return 0;
+    }
+    
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (!strptime(if_modified_since, "%a, %d %b %Y %H:%M:%S GMT", &tm)) {
+        return 0;
+    }
+    return mtime <= timegm(&tm);
+}
+
+/**
+ * Формирование ответа со статическим файлом. Если клиент принимает сжатие,
+ * отдается вариант .br или .gz с диска либо сжатая копия из памяти.
+ * Возвращает -1, если файла нет
+ */
+int static_files_serve(const http_request_t *request, const char *url_path, http_response_t *response) {
+    static_file_t *file = static_file_acquire(url_path);
+    if (!file) {
+        return -1;
+    }
+    
+    static_file_t *chosen = file;
+    const char *encoding = NULL;
+    int vary = 0;
+    int use_gzip_cache = 0;
+    
+    if (is_compressible(file->content_type)) {
+        const char *accept_encoding = http_get_header(request, "Accept-Encoding");
+        static_file_t *br = variant_acquire(file, ".br", "br");
+        static_file_t *gz = variant_acquire(file, ".gz", "gzip");
+        vary = br || gz || file->gzip_data;
+        
+        if (br && accepts_encoding(accept_encoding, "br")) {
+            chosen = br;
+        } else if (gz && accepts_encoding(accept_encoding, "gzip")) {
+            chosen = gz;
+        } else if (file->gzip_data && accepts_encoding(accept_encoding, "gzip")) {
+            use_gzip_cache = 1;
+            encoding = "gzip";
+        }
+        
+        if (br && br != chosen) static_file_release(br);
+        if (gz && gz != chosen) static_file_release(gz);
+        if (chosen != file) {
+            static_file_release(file);
+            encoding = chosen->content_encoding;
+        }
+    }
+    
+    // Строгий ETag из времени изменения и размера: у каждой кодировки свой
+    char etag[64];
+    char last_modified[64];
+    snprintf(etag, sizeof(etag), "\"%lx-%zx%s\"", (unsigned long)chosen->mtime, chosen->size,
+             use_gzip_cache ? "-gz" : "");
+    struct tm modified_tm;
+    gmtime_r(&chosen->mtime, &modified_tm);
+    strftime(last_modified, sizeof(last_modified), "%a, %d %b %Y %H:%M:%S GMT", &modified_tm);
+    
+    if (is_not_modified(request, etag, chosen->mtime)) {
+        http_set_not_modified(response, etag);
+        http_add_response_header(response, "Last-Modified", last_modified);
+        if (vary) {
+            http_add_response_header(response, "Vary", "Accept-Encoding");
+        }
+        static_file_release(chosen);
+        return 0;
+    }
+    
+    http_set_response_status(response, 200, "OK");
+    http_add_response_header(response, "Content-Type", chosen->content_type);
+    if (encoding) {
+        http_add_response_header(response, "Content-Encoding", encoding);
+    }
+    if (vary) {
+        http_add_response_header(response, "Vary", "Accept-Encoding");
+    }
+    http_add_response_header(response, "ETag", etag);
+    http_add_response_header(response, "Last-Modified", last_modified);
+    
+    if (use_gzip_cache) {
+        // Сжатая копия живет, пока запись удерживается ответом
+        response->body_data = chosen->gzip_data;
+        response->body_size = chosen->gzip_size;
+        response->body_release = static_file_release_ctx;
+        response->body_release_ctx = chosen;
+    } else {
+        // Тело отправляется из кэшированного дескриптора через sendfile
+        http_set_response_file(response, chosen->fd, 0, chosen->size, static_file_release_ctx, chosen);
+    }
+    return 0;
+}
+
+/**
+ * Прогрев кэша: открытие и сжатие всех файлов под корнем
+ */
+static int warm_files = 0;
+static size_t warm_original = 0;
+static size_t warm_compressed = 0;
+
+static int warm_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    size_t length = strlen(path);
+    if (type != FTW_F || (length > 3 && (strcmp(path + length - 3, ".br") == 0 ||
+                                         strcmp(path + length - 3, ".gz") == 0))) {
+        return 0;
+    }
+    
+    static_file_t *file = static_file_acquire(path + strlen(static_root));
+    if (file) {
+        if (file->gzip_data) {
+            warm_files++;
+            warm_original += file->size;
+            warm_compressed += file->gzip_size;
+        }
+        static_file_release(file);
+    }
+    return 0;
+}
+
+/**
+ * Включение сжатия gzip в памяти и прогрев кэша файлами из корня.
+ * Предсжатые файлы на диске имеют приоритет над копией в памяти
+ */
+int static_files_enable_gzip_cache(void) {
+#ifdef HAVE_ZLIB
+    gzip_cache_enabled = 1;
+    
+    warm_files = 0;
+    warm_original = warm_compressed = 0;
+    nftw(static_root, warm_entry, 16, FTW_PHYS);
+    
+    printf("Сжато в памяти: %d файлов, %zu -> %zu байт\n", warm_files, warm_original, warm_compressed);
+    return 0;
+#else
+    (void)warm_entry;
+    return -1;
+#endif
+}
@@ -0,0 +1,58 @@
+/**
+ * Раздача статических файлов фронтенда
+ * Кэширует открытые дескрипторы и метаданные файлов, чтобы тело ответа
+ * отправлялось через sendfile без чтения файла в память. Поддерживает
+ * предсжатые варианты (.br/.gz рядом с файлом) и сжатие gzip в памяти
+ */
+
+#ifndef STATIC_FILES_H
+#define STATIC_FILES_H
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "simple_http.h"
+
+#define STATIC_MAX_PATH 1024
+#define STATIC_CACHE_BUCKETS 256
+#define STATIC_CACHE_MAX_ENTRIES 512
+#define STATIC_REVALIDATE_MS 1000
+#define STATIC_GZIP_MIN_SIZE 1024
+
+/**
+ * Открытый статический файл. Дескриптор общий для всех запросов:
+ * sendfile читает его с явным смещением, не сдвигая позицию файла.
+ * Для вариантов .br/.gz кэшируется и отсутствие файла (fd = -1)
+ */
+typedef struct static_file {
+    char path[STATIC_MAX_PATH];
+    int fd;
+    size_t size;
+    time_t mtime;
+    ino_t inode;
+    const char *content_type;
+    const char *content_encoding; // NULL, "br" или "gzip"
+    char *gzip_data;              // Сжатая в памяти копия (STATIC_GZIP)
+    size_t gzip_size;
+    long long checked_ms;         // Время последней проверки stat
+    int refcount;                 // Запросы, отправляющие файл, + ссылка кэша
+    int cached;                   // Запись еще находится в кэше
+    struct static_file *next;     // Цепочка корзины хэш-таблицы
+} static_file_t;
+
+// Инициализация и очистка
+int static_files_init(const char *root);
+void static_files_cleanup(void);
+
+// Сжатие текстовых файлов в памяти (требует сборки с ZLIB=1)
+int static_files_enable_gzip_cache(void);
+
+// Получение файла по пути URL (NULL - нет такого файла)
+static_file_t* static_file_acquire(const char *url_path);
+void static_file_release(static_file_t *file);
+
+// Формирование ответа с выбором кодировки по Accept-Encoding
+int static_files_serve(const http_request_t *request, const char *url_path, http_response_t *response);
+
+#endif // STATIC_FILES_H
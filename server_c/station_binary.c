@@ -0,0 +1,136 @@
+/**
+ * Бинарный снимок станций: запись заголовка и проверка при отображении
+ */
+
+#include "station_binary.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CHECKSUM_PRIME 0x9E3779B97F4A7C15ull
+
+/**
+ * Контрольная сумма записей: 64-битные слова в четыре независимые
+ * цепочки, чтобы проверка 100k станций не упиралась в задержку умножения
+ */
+static uint64_t binary_checksum(const void *data, size_t length) {
+    const unsigned char *p = data;
+    uint64_t lanes[4] = { 1, 2, 3, 4 };
+
+    size_t blocks = length / 32;
+    for (size_t i = 0; i < blocks; i++, p += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, p + lane * 8, 8);
+            lanes[lane] = (lanes[lane] ^ word) * CHECKSUM_PRIME;
+            lanes[lane] ^= lanes[lane] >> 32;
+        }
+    }
+
+    uint64_t hash = length;
+    for (size_t i = 0; i < length % 32; i++) {
+        hash = (hash ^ p[i]) * CHECKSUM_PRIME;
+    }
+    for (int lane = 0; lane < 4; lane++) {
+        hash = (hash ^ lanes[lane]) * CHECKSUM_PRIME;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+/**
+ * Хэш раскладки структуры по таблице полей
+ */
+#define STATION_LAYOUT_FIELD(kind, key, member) \
+    layout = (layout ^ offsetof(charging_station_t, member)) * 16777619u; \
+    layout = (layout ^ sizeof(((charging_station_t*)0)->member)) * 16777619u;
+
+static uint32_t station_layout(void) {
+    uint32_t layout = 2166136261u;
+    STATION_FIELDS(STATION_LAYOUT_FIELD)
+    layout = (layout ^ offsetof(charging_station_t, version)) * 16777619u;
+    return layout;
+}
+
+void station_binary_header(station_binary_header_t *header, const charging_station_t *stations,
+                           int count, unsigned long stations_version) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, STATION_BINARY_MAGIC, sizeof(header->magic));
+    header->format = STATION_BINARY_FORMAT;
+    header->record_size = sizeof(charging_station_t);
+    header->layout = station_layout();
+    header->count = count;
+    header->stations_version = stations_version;
+    header->checksum = binary_checksum(stations, (size_t)count * sizeof(charging_station_t));
+}
+
+int station_binary_open(const char *path, station_binary_map_t *map, const char **error) {
+    memset(map, 0, sizeof(*map));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        *error = strerror(errno);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(station_binary_header_t)) {
+        close(fd);
+        *error = "файл короче заголовка";
+        return -1;
+    }
+
+    // MAP_PRIVATE: станции можно менять на месте, страницы копируются при записи
+    void *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        *error = strerror(errno);
+        return -1;
+    }
+
+    const station_binary_header_t *header = base;
+    size_t records = (size_t)st.st_size - sizeof(station_binary_header_t);
+    charging_station_t *stations = (charging_station_t*)((char*)base + sizeof(station_binary_header_t));
+
+    *error = NULL;
+    if (memcmp(header->magic, STATION_BINARY_MAGIC, sizeof(header->magic)) != 0) {
+        *error = "неверная сигнатура";
+    } else if (header->format != STATION_BINARY_FORMAT) {
+        *error = "неподдерживаемая версия формата";
+    } else if (header->record_size != sizeof(charging_station_t) || header->layout != station_layout()) {
+        *error = "другая структура станции";
+    } else if ((size_t)header->count * sizeof(charging_station_t) != records) {
+        *error = "размер файла не совпадает с числом станций";
+    } else {
+        // Станции читаются подряд один раз: ядру можно читать с опережением
+        madvise(base, st.st_size, MADV_SEQUENTIAL);
+        if (binary_checksum(stations, records) != header->checksum) {
+            *error = "неверная контрольная сумма";
+        }
+        madvise(base, st.st_size, MADV_NORMAL);
+    }
+    if (*error) {
+        munmap(base, st.st_size);
+        return -1;
+    }
+
+    map->base = base;
+    map->length = st.st_size;
+    map->stations = stations;
+    map->count = header->count;
+    map->stations_version = header->stations_version;
+    return 0;
+}
+
+void station_binary_close(station_binary_map_t *map) {
+    if (map->base) {
+        munmap(map->base, map->length);
+    }
+    memset(map, 0, sizeof(*map));
+}
@@ -0,0 +1,54 @@
+/**
+ * Бинарный снимок станций
+ * Заголовок фиксированного размера и записи charging_station_t подряд, как
+ * в памяти. Файл отображается через mmap и используется как массив станций
+ * без разбора. JSON остается форматом импорта и экспорта
+ */
+
+#ifndef STATION_BINARY_H
+#define STATION_BINARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "storage.h"
+
+#define STATION_BINARY_MAGIC "EVSTATN"
+#define STATION_BINARY_FORMAT 1
+
+/**
+ * Заголовок снимка (64 байта). layout - хэш смещений и размеров полей:
+ * снимок, записанный сервером с другой структурой станции, не подходит
+ */
+typedef struct {
+    char magic[8];
+    uint32_t format;
+    uint32_t record_size;
+    uint32_t layout;
+    uint32_t count;
+    uint64_t stations_version;
+    uint64_t checksum;          // записей
+    uint64_t reserved[3];
+} station_binary_header_t;
+
+/**
+ * Отображенный снимок. stations указывает внутрь отображения
+ * (MAP_PRIVATE: изменения станций не попадают в файл)
+ */
+typedef struct {
+    void *base;
+    size_t length;
+    charging_station_t *stations;
+    int count;
+    unsigned long stations_version;
+} station_binary_map_t;
+
+// Заголовок для записи count станций подряд
+void station_binary_header(station_binary_header_t *header, const charging_station_t *stations,
+                           int count, unsigned long stations_version);
+
+// Отображение и проверка снимка (0 - успех; error получает причину отказа)
+int station_binary_open(const char *path, station_binary_map_t *map, const char **error);
+void station_binary_close(station_binary_map_t *map);
+
+#endif // STATION_BINARY_H
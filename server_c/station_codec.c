@@ -0,0 +1,550 @@
+/**
+ * Преобразование зарядных станций в JSON и обратно по таблице полей
+ */
+
+#include "station_codec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Маска полей должна вмещать все поля таблицы
+typedef char station_fields_fit_mask[STATION_FIELD_COUNT <= 32 ? 1 : -1];
+
+/**
+ * Виды полей таблицы
+ */
+typedef enum {
+    STATION_KIND_ID,
+    STATION_KIND_STRING,
+    STATION_KIND_STRING_OPT,
+    STATION_KIND_FLOAT,
+    STATION_KIND_BOOL
+} station_field_kind_t;
+
+/**
+ * Описание поля для разбора: где и как хранится значение
+ */
+typedef struct {
+    const char *key;
+    size_t key_length;
+    station_field_kind_t kind;
+    size_t offset;
+    size_t size;
+} station_field_desc_t;
+
+#define STATION_FIELD_DESC(kind, key, member) \
+    { key, sizeof(key) - 1, STATION_KIND_##kind, offsetof(charging_station_t, member), \
+      sizeof(((charging_station_t*)0)->member) },
+
+static const station_field_desc_t station_fields[STATION_FIELD_COUNT] = {
+    STATION_FIELDS(STATION_FIELD_DESC)
+};
+
+/**
+ * Ключ JSON поля по номеру
+ */
+const char* station_field_key(int index) {
+    return index >= 0 && index < STATION_FIELD_COUNT ? station_fields[index].key : NULL;
+}
+
+/* ---------- Сериализация ---------- */
+
+/**
+ * Запись ключа с разделителем; у первого поля объекта запятая пропускается
+ */
+static void write_key(json_buf_t *buf, const char *key, size_t length, int *first) {
+    if (*first) {
+        key++;
+        length--;
+        *first = 0;
+    }
+    json_buf_append(buf, key, length);
+}
+
+#define STATION_PRESENT_ID(value) 1
+#define STATION_PRESENT_STRING(value) 1
+#define STATION_PRESENT_STRING_OPT(value) ((value)[0] != '\0')
+#define STATION_PRESENT_FLOAT(value) 1
+#define STATION_PRESENT_BOOL(value) 1
+
+#define STATION_WRITE_ID(buf, value) json_buf_append_number(buf, (double)(value))
+#define STATION_WRITE_STRING(buf, value) json_buf_append_string(buf, value)
+#define STATION_WRITE_STRING_OPT(buf, value) json_buf_append_string(buf, value)
+#define STATION_WRITE_FLOAT(buf, value) json_buf_append_float(buf, value)
+#define STATION_WRITE_BOOL(buf, value) \
+    ((value) ? json_buf_append(buf, "true", 4) : json_buf_append(buf, "false", 5))
+
+// Ключ вместе с кавычками и двоеточием - строковый литерал времени компиляции
+#define STATION_WRITE_FIELD(kind, key, member) \
+    if ((fields & STATION_FIELD(member)) && (!skip_empty || STATION_PRESENT_##kind(station->member))) { \
+        write_key(buf, ",\"" key "\":", sizeof(",\"" key "\":") - 1, &first); \
+        STATION_WRITE_##kind(buf, station->member); \
+    }
+
+static void write_fields(json_buf_t *buf, const charging_station_t *station, station_field_mask_t fields,
+                         int skip_empty) {
+    int first = 1;
+    json_buf_append(buf, "{", 1);
+    STATION_FIELDS(STATION_WRITE_FIELD)
+    json_buf_append(buf, "}", 1);
+}
+
+/**
+ * Сериализация выбранных полей станции в JSON объект. Поля из маски
+ * записываются всегда, включая пустые необязательные строки
+ */
+void station_write_json_fields(json_buf_t *buf, const charging_station_t *station, station_field_mask_t fields) {
+    write_fields(buf, station, fields, 0);
+}
+
+/**
+ * Сериализация станции со всеми полями (пустые необязательные пропускаются)
+ */
+void station_write_json(json_buf_t *buf, const charging_station_t *station) {
+    write_fields(buf, station, STATION_FIELDS_ALL, 1);
+}
+
+/**
+ * Сериализация массива станций
+ */
+void stations_write_json(json_buf_t *buf, const charging_station_t *stations, int count) {
+    json_buf_append(buf, "[", 1);
+    for (int i = 0; i < count; i++) {
+        if (i > 0) json_buf_append(buf, ",", 1);
+        station_write_json(buf, &stations[i]);
+    }
+    json_buf_append(buf, "]", 1);
+}
+
+/**
+ * Сериализация выбранных станций массива (positions - их номера) с полями
+ * маски; при полной маске - как station_write_json
+ */
+void stations_write_json_selected(json_buf_t *buf, const charging_station_t *stations, const int *positions,
+                                  int count, station_field_mask_t fields) {
+    int skip_empty = fields == STATION_FIELDS_ALL;
+    json_buf_append(buf, "[", 1);
+    for (int i = 0; i < count; i++) {
+        if (i > 0) json_buf_append(buf, ",", 1);
+        write_fields(buf, &stations[positions[i]], fields, skip_empty);
+    }
+    json_buf_append(buf, "]", 1);
+}
+
+/**
+ * Станция в виде JSON строки (освобождается через free)
+ */
+char* station_to_json_string(const charging_station_t *station, size_t *length) {
+    json_buf_t buf;
+    json_buf_init(&buf, 1024);
+    station_write_json(&buf, station);
+    return json_buf_detach(&buf, length);
+}
+
+/* ---------- Разбор ---------- */
+
+#define FIELD_TABLE_SIZE 64
+
+// Хэш-таблица ключей (номер поля + 1), строится один раз
+static unsigned char field_table[FIELD_TABLE_SIZE];
+static pthread_once_t field_table_once = PTHREAD_ONCE_INIT;
+
+static unsigned int key_hash(const char *key, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void field_table_build(void) {
+    for (int i = 0; i < STATION_FIELD_COUNT; i++) {
+        unsigned int pos = key_hash(station_fields[i].key, station_fields[i].key_length) % FIELD_TABLE_SIZE;
+        while (field_table[pos]) {
+            pos = (pos + 1) % FIELD_TABLE_SIZE;
+        }
+        field_table[pos] = i + 1;
+    }
+}
+
+/**
+ * Номер поля по ключу (-1 для неизвестных ключей)
+ */
+static int field_lookup(const char *key, size_t length) {
+    unsigned int pos = key_hash(key, length) % FIELD_TABLE_SIZE;
+    while (field_table[pos]) {
+        const station_field_desc_t *field = &station_fields[field_table[pos] - 1];
+        if (field->key_length == length && memcmp(field->key, key, length) == 0) {
+            return field_table[pos] - 1;
+        }
+        pos = (pos + 1) % FIELD_TABLE_SIZE;
+    }
+    return -1;
+}
+
+/**
+ * Маска полей по списку ключей JSON через запятую ("id,displayName,type").
+ * Возвращает -1 для неизвестного ключа или пустого списка
+ */
+int station_fields_parse(const char *list, station_field_mask_t *fields) {
+    pthread_once(&field_table_once, field_table_build);
+
+    station_field_mask_t mask = 0;
+    const char *p = list;
+    while (*p) {
+        size_t length = strcspn(p, ",");
+        int index = field_lookup(p, length);
+        if (index < 0) {
+            return -1;
+        }
+        mask |= (station_field_mask_t)1 << index;
+        p += length;
+        if (*p == ',') p++;
+    }
+
+    if (mask == 0) {
+        return -1;
+    }
+    *fields = mask;
+    return 0;
+}
+
+static const char* skip_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    return p;
+}
+
+/**
+ * Строка в кавычках: границы содержимого без раскрытия escape-последовательностей
+ */
+static const char* scan_string(const char *p, const char **start, size_t *length) {
+    if (*p != '"') return NULL;
+    p++;
+    *start = p;
+    while (*p && *p != '"') {
+        if (*p == '\\') {
+            p++;
+            if (!*p) return NULL;
+        }
+        p++;
+    }
+    if (*p != '"') return NULL;
+    *length = p - *start;
+    return p + 1;
+}
+
+/**
+ * Пропуск значения неизвестного поля, включая вложенные объекты и массивы
+ */
+static const char* skip_value(const char *p) {
+    const char *start;
+    size_t length;
+
+    if (*p == '"') {
+        return scan_string(p, &start, &length);
+    }
+
+    if (*p == '{' || *p == '[') {
+        int depth = 0;
+        while (*p) {
+            if (*p == '"') {
+                p = scan_string(p, &start, &length);
+                if (!p) return NULL;
+                continue;
+            }
+            if (*p == '{' || *p == '[') depth++;
+            if (*p == '}' || *p == ']') {
+                if (--depth == 0) return p + 1;
+            }
+            p++;
+        }
+        return NULL;
+    }
+
+    if (strncmp(p, "true", 4) == 0 || strncmp(p, "null", 4) == 0) return p + 4;
+    if (strncmp(p, "false", 5) == 0) return p + 5;
+
+    if (*p != '-' && (*p < '0' || *p > '9')) return NULL;
+    char *end;
+    strtod(p, &end);
+    return end > p ? end : NULL;
+}
+
+/**
+ * Разбор числа. Десятичные числа до 15 значащих цифр без экспоненты (все,
+ * что пишет сериализация) делятся на точную степень 10 - результат такой
+ * же, как у strtod, но без ее накладных расходов. Остальное - через strtod
+ */
+static const char* read_number(const char *p, double *number) {
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15
+    };
+
+    const char *q = p;
+    int negative = *q == '-';
+    if (negative) q++;
+
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int fraction = 0;
+    while (*q >= '0' && *q <= '9') {
+        mantissa = mantissa * 10 + (*q++ - '0');
+        digits++;
+    }
+    if (*q == '.' && q[1] >= '0' && q[1] <= '9') {
+        q++;
+        while (*q >= '0' && *q <= '9') {
+            mantissa = mantissa * 10 + (*q++ - '0');
+            digits++;
+            fraction++;
+        }
+    }
+
+    int fast = digits > 0 && digits <= 15 && *q != '.' && *q != 'e' && *q != 'E' &&
+               *q != 'x' && *q != 'X';
+    if (fast) {
+        double value = (double)mantissa / powers[fraction];
+        *number = negative ? -value : value;
+        return q;
+    }
+
+    char *end;
+    *number = strtod(p, &end);
+    return end > p ? end : NULL;
+}
+
+/**
+ * Копирование строки в поле фиксированного размера. При усечении не
+ * разрываются escape-последовательности и многобайтовые символы UTF-8
+ */
+static void copy_string(char *dest, size_t size, const char *src, size_t length) {
+    if (length >= size) {
+        length = size - 1;
+        while (length > 0 && ((unsigned char)src[length] & 0xC0) == 0x80) {
+            length--;
+        }
+        size_t backslashes = 0;
+        while (backslashes < length && src[length - 1 - backslashes] == '\\') {
+            backslashes++;
+        }
+        if (backslashes % 2) {
+            length--;
+        }
+    }
+    memcpy(dest, src, length);
+    dest[length] = '\0';
+}
+
+/**
+ * Разбор значения поля в структуру
+ */
+static const char* read_field(const char *p, const station_field_desc_t *field,
+                              charging_station_t *station, int *result) {
+    char *target = (char*)station + field->offset;
+
+    if (strncmp(p, "null", 4) == 0) {
+        return p + 4; // null равносилен отсутствию поля
+    }
+
+    switch (field->kind) {
+        case STATION_KIND_STRING:
+        case STATION_KIND_STRING_OPT: {
+            const char *start;
+            size_t length;
+            if (*p != '"') break;
+            p = scan_string(p, &start, &length);
+            if (p) copy_string(target, field->size, start, length);
+            *result = 1;
+            return p;
+        }
+
+        case STATION_KIND_ID:
+        case STATION_KIND_FLOAT: {
+            if (*p != '-' && (*p < '0' || *p > '9')) break;
+            double number;
+            const char *end = read_number(p, &number);
+            if (!end) break;
+            if (field->kind == STATION_KIND_ID) *(int*)target = (int)number;
+            else *(float*)target = (float)number;
+            *result = 1;
+            return end;
+        }
+
+        case STATION_KIND_BOOL: {
+            if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0) {
+                *(int*)target = *p == 't';
+                *result = 1;
+                return p + (*p == 't' ? 4 : 5);
+            }
+            // Числа 0/1 от прошивок ESP32 тоже принимаются
+            if (*p != '-' && (*p < '0' || *p > '9')) break;
+            double number;
+            const char *end = read_number(p, &number);
+            if (!end) break;
+            *(int*)target = number != 0;
+            *result = 1;
+            return end;
+        }
+    }
+
+    // Корректное значение другого типа - ошибка типа, иначе - синтаксиса
+    *result = skip_value(p) ? STATION_CODEC_TYPE_ERROR : STATION_CODEC_SYNTAX_ERROR;
+    return p;
+}
+
+/**
+ * Разбор JSON объекта станции без построения дерева. Неизвестные ключи
+ * пропускаются, null трактуется как отсутствие поля
+ */
+int station_read_json(const char *json, const char **end, charging_station_t *station,
+                      station_field_mask_t *present) {
+    pthread_once(&field_table_once, field_table_build);
+
+    station_field_mask_t mask = 0;
+    const char *p = skip_ws(json);
+    if (*p != '{') return STATION_CODEC_SYNTAX_ERROR;
+    p = skip_ws(p + 1);
+
+    if (*p != '}') {
+        for (;;) {
+            const char *key;
+            size_t key_length;
+            p = scan_string(p, &key, &key_length);
+            if (!p) return STATION_CODEC_SYNTAX_ERROR;
+
+            p = skip_ws(p);
+            if (*p != ':') return STATION_CODEC_SYNTAX_ERROR;
+            p = skip_ws(p + 1);
+
+            int index = field_lookup(key, key_length);
+            if (index >= 0) {
+                int result = 0;
+                p = read_field(p, &station_fields[index], station, &result);
+                if (result < 0) return result;
+                if (!p) return STATION_CODEC_SYNTAX_ERROR;
+                if (result) mask |= (station_field_mask_t)1 << index;
+            } else {
+                p = skip_value(p);
+                if (!p) return STATION_CODEC_SYNTAX_ERROR;
+            }
+
+            p = skip_ws(p);
+            if (*p == '}') break;
+            if (*p != ',') return STATION_CODEC_SYNTAX_ERROR;
+            p = skip_ws(p + 1);
+        }
+    }
+    p++;
+
+    if (end) {
+        *end = p;
+    } else if (*skip_ws(p) != '\0') {
+        return STATION_CODEC_SYNTAX_ERROR;
+    }
+
+    if (present) *present = mask;
+    return STATION_CODEC_OK;
+}
+
+static int read_failed(int result, const char *at, const char **error_at) {
+    if (error_at) *error_at = at;
+    return result;
+}
+
+/**
+ * Разбор массива станций с передачей каждой станции в callback. Станции
+ * разбираются по одной прямо из текста, массив целиком в памяти не строится.
+ * error_at (если не NULL) при ошибке указывает на начало ошибочного элемента
+ */
+int stations_read_json(const char *json, station_read_fn callback, void *ctx, const char **error_at) {
+    const char *p = skip_ws(json);
+    if (*p != '[') return read_failed(STATION_CODEC_SYNTAX_ERROR, p, error_at);
+    p = skip_ws(p + 1);
+
+    if (*p != ']') {
+        for (;;) {
+            charging_station_t station;
+            station_field_mask_t present;
+            memset(&station, 0, sizeof(station));
+
+            const char *item = p;
+            int result = station_read_json(item, &p, &station, &present);
+            if (result == STATION_CODEC_OK) {
+                result = callback(&station, present, ctx);
+            }
+            if (result != 0) return read_failed(result, item, error_at);
+
+            p = skip_ws(p);
+            if (*p == ']') break;
+            if (*p != ',') return read_failed(STATION_CODEC_SYNTAX_ERROR, p, error_at);
+            p = skip_ws(p + 1);
+        }
+    }
+
+    p = skip_ws(p + 1);
+    if (*p != '\0') return read_failed(STATION_CODEC_SYNTAX_ERROR, p, error_at);
+    return STATION_CODEC_OK;
+}
+
+/* ---------- Деревья json_value_t ---------- */
+
+#define STATION_TREE_ID(value) json_create_number((double)(value))
+#define STATION_TREE_STRING(value) json_create_string(value)
+#define STATION_TREE_STRING_OPT(value) json_create_string(value)
+#define STATION_TREE_FLOAT(value) json_create_number(value)
+#define STATION_TREE_BOOL(value) json_create_bool(value)
+
+#define STATION_TREE_FIELD(kind, key, member) \
+    if (STATION_PRESENT_##kind(station->member)) { \
+        json_object_set(json, key, STATION_TREE_##kind(station->member)); \
+    }
+
+/**
+ * Преобразование структуры станции в дерево JSON
+ */
+json_value_t* station_to_json(const charging_station_t *station) {
+    json_value_t *json = json_create_object();
+    if (!json) return NULL;
+
+    STATION_FIELDS(STATION_TREE_FIELD)
+    return json;
+}
+
+/**
+ * Преобразование дерева JSON в структуру станции (только переданные поля)
+ */
+int station_from_json(const json_value_t *json, charging_station_t *station) {
+    if (!json || !station || json->type != JSON_OBJECT) return -1;
+
+    memset(station, 0, sizeof(charging_station_t));
+
+    for (int i = 0; i < STATION_FIELD_COUNT; i++) {
+        const station_field_desc_t *field = &station_fields[i];
+        json_value_t *value = json_object_get((json_value_t*)json, field->key);
+        if (!value) continue;
+
+        char *target = (char*)station + field->offset;
+        switch (field->kind) {
+            case STATION_KIND_STRING:
+            case STATION_KIND_STRING_OPT:
+                if (value->type == JSON_STRING) {
+                    copy_string(target, field->size, value->data.string_val, strlen(value->data.string_val));
+                }
+                break;
+            case STATION_KIND_ID:
+                *(int*)target = (int)json_get_number(value);
+                break;
+            case STATION_KIND_FLOAT:
+                *(float*)target = (float)json_get_number(value);
+                break;
+            case STATION_KIND_BOOL:
+                *(int*)target = json_get_bool(value);
+                break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+/**
+ * Преобразование зарядных станций в JSON и обратно
+ * Сериализация и разбор генерируются из таблицы STATION_FIELDS (storage.h)
+ * и работают напрямую со структурой, без промежуточного дерева json_value_t
+ */
+
+#ifndef STATION_CODEC_H
+#define STATION_CODEC_H
+
+#include "storage.h"
+#include "simple_json.h"
+
+// Результаты разбора
+#define STATION_CODEC_OK 0
+#define STATION_CODEC_SYNTAX_ERROR -1
+#define STATION_CODEC_TYPE_ERROR -2
+
+// Сериализация в буфер (station_write_json_fields записывает ровно поля маски)
+void station_write_json(json_buf_t *buf, const charging_station_t *station);
+void station_write_json_fields(json_buf_t *buf, const charging_station_t *station, station_field_mask_t fields);
+void stations_write_json(json_buf_t *buf, const charging_station_t *stations, int count);
+void stations_write_json_selected(json_buf_t *buf, const charging_station_t *stations, const int *positions,
+                                  int count, station_field_mask_t fields);
+char* station_to_json_string(const charging_station_t *station, size_t *length);
+
+// Разбор объекта станции: заполняются только переданные поля, их маска
+// возвращается в present. end (если не NULL) получает позицию после объекта
+int station_read_json(const char *json, const char **end, charging_station_t *station,
+                      station_field_mask_t *present);
+
+// Разбор массива станций: callback получает каждую станцию (поля, которых
+// нет в JSON, обнулены). Ненулевой результат callback прерывает разбор и
+// возвращается вызывающему. error_at получает позицию ошибочного элемента
+typedef int (*station_read_fn)(const charging_station_t *station, station_field_mask_t present, void *ctx);
+int stations_read_json(const char *json, station_read_fn callback, void *ctx, const char **error_at);
+
+// Ключ JSON поля по номеру и маска полей по списку ключей через запятую
+const char* station_field_key(int index);
+int station_fields_parse(const char *list, station_field_mask_t *fields);
+
+// Деревья json_value_t для кода, работающего с simple_json
+json_value_t* station_to_json(const charging_station_t *station);
+int station_from_json(const json_value_t *json, charging_station_t *station);
+
+#endif // STATION_CODEC_H
@@ -0,0 +1,140 @@
+/**
+ * Хэш-индекс станций по идентификатору
+ */
+
+#include "station_index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Перемешивание id: последовательные идентификаторы не должны
+ * попадать в соседние ячейки целыми сериями
+ */
+static size_t index_hash(int id, size_t capacity) {
+    unsigned int h = (unsigned int)id * 2654435761u;
+    h ^= h >> 16;
+    return h & (capacity - 1);
+}
+
+int station_index_init(station_index_t *index, size_t expected) {
+    size_t capacity = STATION_INDEX_MIN_CAPACITY;
+    while (capacity < expected * 2) {
+        capacity *= 2;
+    }
+
+    index->entries = calloc(capacity, sizeof(station_index_entry_t));
+    if (!index->entries) {
+        index->capacity = 0;
+        index->count = 0;
+        return -1;
+    }
+    index->capacity = capacity;
+    index->count = 0;
+    return 0;
+}
+
+void station_index_destroy(station_index_t *index) {
+    free(index->entries);
+    index->entries = NULL;
+    index->capacity = 0;
+    index->count = 0;
+}
+
+void station_index_clear(station_index_t *index) {
+    if (index->entries) {
+        memset(index->entries, 0, index->capacity * sizeof(station_index_entry_t));
+    }
+    index->count = 0;
+}
+
+int station_index_find(const station_index_t *index, int id) {
+    if (id <= 0 || index->capacity == 0) return -1;
+
+    size_t pos = index_hash(id, index->capacity);
+    while (index->entries[pos].id != 0) {
+        if (index->entries[pos].id == id) {
+            return index->entries[pos].slot;
+        }
+        pos = (pos + 1) & (index->capacity - 1);
+    }
+    return -1;
+}
+
+/**
+ * Перестроение таблицы с удвоенной емкостью
+ */
+static int index_grow(station_index_t *index) {
+    size_t capacity = index->capacity ? index->capacity * 2 : STATION_INDEX_MIN_CAPACITY;
+    station_index_entry_t *entries = calloc(capacity, sizeof(station_index_entry_t));
+    if (!entries) return -1;
+
+    for (size_t i = 0; i < index->capacity; i++) {
+        if (index->entries[i].id == 0) continue;
+        size_t pos = index_hash(index->entries[i].id, capacity);
+        while (entries[pos].id != 0) {
+            pos = (pos + 1) & (capacity - 1);
+        }
+        entries[pos] = index->entries[i];
+    }
+
+    free(index->entries);
+    index->entries = entries;
+    index->capacity = capacity;
+    return 0;
+}
+
+int station_index_put(station_index_t *index, int id, int slot) {
+    if (id <= 0) return -1;
+    if ((index->count + 1) * 2 > index->capacity && index_grow(index) != 0) {
+        return -1;
+    }
+
+    size_t pos = index_hash(id, index->capacity);
+    while (index->entries[pos].id != 0) {
+        if (index->entries[pos].id == id) {
+            index->entries[pos].slot = slot;
+            return 0;
+        }
+        pos = (pos + 1) & (index->capacity - 1);
+    }
+
+    index->entries[pos].id = id;
+    index->entries[pos].slot = slot;
+    index->count++;
+    return 0;
+}
+
+/**
+ * Удаление без "надгробий": следующие записи серии сдвигаются назад,
+ * поэтому поиск никогда не проходит лишние ячейки
+ */
+int station_index_remove(station_index_t *index, int id) {
+    if (id <= 0 || index->capacity == 0) return -1;
+
+    size_t mask = index->capacity - 1;
+    size_t pos = index_hash(id, index->capacity);
+    while (index->entries[pos].id != id) {
+        if (index->entries[pos].id == 0) return -1;
+        pos = (pos + 1) & mask;
+    }
+
+    int slot = index->entries[pos].slot;
+    size_t hole = pos;
+    for (;;) {
+        pos = (pos + 1) & mask;
+        if (index->entries[pos].id == 0) break;
+
+        // Запись можно перенести в дыру, если ее исходная ячейка не лежит
+        // циклически между дырой и текущей позицией
+        size_t home = index_hash(index->entries[pos].id, index->capacity);
+        if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+            index->entries[hole] = index->entries[pos];
+            hole = pos;
+        }
+    }
+    index->entries[hole].id = 0;
+    index->entries[hole].slot = 0;
+    index->count--;
+    return slot;
+}
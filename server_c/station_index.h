@@ -0,0 +1,44 @@
+/**
+ * Индекс станций по идентификатору: id -> номер слота в массиве станций
+ * Хэш-таблица с открытой адресацией и линейным пробированием
+ */
+
+#ifndef STATION_INDEX_H
+#define STATION_INDEX_H
+
+#include <stddef.h>
+
+#define STATION_INDEX_MIN_CAPACITY 16
+
+/**
+ * Запись таблицы. id = 0 - пустая ячейка (идентификаторы станций начинаются с 1)
+ */
+typedef struct {
+    int id;
+    int slot;
+} station_index_entry_t;
+
+/**
+ * Таблица заполняется не более чем наполовину, емкость - степень двойки
+ */
+typedef struct {
+    station_index_entry_t *entries;
+    size_t capacity;
+    size_t count;
+} station_index_t;
+
+// Создание и освобождение (expected - ожидаемое число станций)
+int station_index_init(station_index_t *index, size_t expected);
+void station_index_destroy(station_index_t *index);
+void station_index_clear(station_index_t *index);
+
+// Поиск слота по id (-1 - нет такой станции)
+int station_index_find(const station_index_t *index, int id);
+
+// Добавление или замена записи (-1 - ошибка памяти или неверный id)
+int station_index_put(station_index_t *index, int id, int slot);
+
+// Удаление записи, возвращает слот удаленной станции (-1 - не найдена)
+int station_index_remove(station_index_t *index, int id);
+
+#endif // STATION_INDEX_H
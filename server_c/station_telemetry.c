@@ -0,0 +1,1372 @@
+/**
+ * История телеметрии станций со сжатием столбцов
+ *
+ * Строка сырого уровня - значения метрик в момент измерения. Строка
+ * агрегата - число измерений интервала, затем минимумы, максимумы и средние
+ * метрик; время строки - начало интервала. Агрегаты считаются по мере
+ * поступления измерений: открытый интервал копится в памяти и записывается
+ * строкой, когда приходит измерение следующего интервала.
+ *
+ * Столбец времени: первое время блока хранится в заголовке, далее
+ * разность разностей соседних времен:
+ *   0                      -> '0'
+ *   [-63, 64]              -> '10'    + 7 бит
+ *   [-255, 256]            -> '110'   + 9 бит
+ *   [-2047, 2048]          -> '1110'  + 12 бит
+ *   [-(2^31 - 1), 2^31]    -> '11110' + 32 бита
+ *   иначе                  -> '11111' + 64 бита
+ * Столбец значения: первое значение - 32 бита float, далее XOR с предыдущим:
+ *   XOR = 0                -> '0'
+ *   значащие биты в окне предыдущего XOR -> '10' + биты окна
+ *   иначе                  -> '11' + 5 бит ведущих нулей + 5 бит (длина - 1) + биты
+ */
+
+#include "station_telemetry.h"
+#include "station_index.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Наибольший размер одного измерения в столбце, бит
+#define TIMESTAMP_MAX_BITS (5 + 64)
+#define VALUE_MAX_BITS (2 + 5 + 5 + 32)
+
+/**
+ * Битовый поток столбца (старшие биты вперед)
+ */
+typedef struct {
+    uint8_t *data;
+    size_t bits;
+    size_t capacity;  // байт
+} telemetry_column_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t pos;
+} telemetry_reader_t;
+
+/**
+ * Состояние XOR кодирования значения: предыдущее значение и окно значащих бит
+ */
+typedef struct {
+    uint32_t previous;
+    int leading;   // -1 - окна еще нет
+    int trailing;
+} telemetry_xor_t;
+
+// Столбцы значений в строке сырого уровня и агрегата
+#define RAW_WIDTH STATION_TELEMETRY_METRICS
+#define ROLLUP_WIDTH (1 + 3 * STATION_TELEMETRY_METRICS)
+#define MAX_WIDTH ROLLUP_WIDTH
+
+// Смещения столбцов агрегата
+#define ROLLUP_COUNT 0
+#define ROLLUP_MIN 1
+#define ROLLUP_MAX (1 + STATION_TELEMETRY_METRICS)
+#define ROLLUP_AVG (1 + 2 * STATION_TELEMETRY_METRICS)
+
+/**
+ * Блок строк: столбец 0 - время, далее width столбцов значений.
+ * seq - номер блока в уровне станции, по нему блоки сохраняются в файл один раз
+ */
+typedef struct {
+    uint32_t seq;
+    int count;
+    int width;
+    int64_t first_timestamp;
+    int64_t last_timestamp;
+    int64_t last_delta;
+    telemetry_xor_t xor_state[MAX_WIDTH];
+    telemetry_column_t columns[1 + MAX_WIDTH];
+} telemetry_chunk_t;
+
+/**
+ * Кольцо блоков уровня от старого к новому, растет до предела уровня.
+ * Закрытые блоки с номерами меньше persisted уже есть в файле истории
+ */
+typedef struct {
+    int first;
+    int count;
+    int capacity;
+    telemetry_chunk_t **chunks;
+    uint32_t next_seq;
+    uint32_t persisted;
+} telemetry_ring_t;
+
+/**
+ * Открытый интервал агрегата
+ */
+typedef struct {
+    int64_t bucket;
+    int samples;
+    float min[STATION_TELEMETRY_METRICS];
+    float max[STATION_TELEMETRY_METRICS];
+    double sums[STATION_TELEMETRY_METRICS];
+} telemetry_rollup_t;
+
+/**
+ * История станции: кольца уровней и открытые интервалы агрегатов
+ */
+typedef struct {
+    int id;
+    pthread_mutex_t lock;
+    int has_samples;
+    int64_t last_timestamp;
+    telemetry_ring_t tiers[STATION_TELEMETRY_TIERS];
+    telemetry_rollup_t open[STATION_TELEMETRY_TIERS];
+} telemetry_station_t;
+
+/**
+ * Параметры уровня: предел блоков на один больше, чем нужно под хранение,
+ * чтобы заполняемый блок не вытеснял строки, которые еще должны храниться
+ */
+typedef struct {
+    const char *name;
+    int64_t resolution_ms;  // 0 - сырые измерения
+    int64_t retention_ms;
+    int width;
+    int max_chunks;
+} telemetry_tier_info_t;
+
+#define CHUNKS_FOR(rows) ((int)(((rows) + STATION_TELEMETRY_CHUNK_SAMPLES - 1) / STATION_TELEMETRY_CHUNK_SAMPLES) + 1)
+#define MINUTE_MS (60LL * 1000)
+#define HOUR_MS (60LL * 60 * 1000)
+
+static const telemetry_tier_info_t tier_info[STATION_TELEMETRY_TIERS] = {
+    { "raw",    0,         STATION_TELEMETRY_RAW_RETENTION_MS,    RAW_WIDTH,
+      CHUNKS_FOR(STATION_TELEMETRY_RAW_MAX_SAMPLES) },
+    { "minute", MINUTE_MS, STATION_TELEMETRY_MINUTE_RETENTION_MS, ROLLUP_WIDTH,
+      CHUNKS_FOR(STATION_TELEMETRY_MINUTE_RETENTION_MS / MINUTE_MS) },
+    { "hour",   HOUR_MS,   STATION_TELEMETRY_HOUR_RETENTION_MS,   ROLLUP_WIDTH,
+      CHUNKS_FOR(STATION_TELEMETRY_HOUR_RETENTION_MS / HOUR_MS) },
+};
+
+// Истории станций и индекс id -> номер в массиве. Блокировка записи нужна
+// только для добавления и удаления станций, измерения пишутся под мьютексом станции
+static telemetry_station_t **telemetry_stations = NULL;
+static int telemetry_count = 0;
+static int telemetry_capacity = 0;
+static station_index_t telemetry_index = {0};
+static pthread_rwlock_t telemetry_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+#define STATION_TELEMETRY_KEY(key, member) key,
+static const char *metric_keys[STATION_TELEMETRY_METRICS] = {
+    STATION_TELEMETRY_FIELDS(STATION_TELEMETRY_KEY)
+};
+
+const char* station_telemetry_metric_key(int metric) {
+    return metric >= 0 && metric < STATION_TELEMETRY_METRICS ? metric_keys[metric] : NULL;
+}
+
+const char* station_telemetry_tier_name(station_telemetry_tier_t tier) {
+    return tier >= 0 && tier < STATION_TELEMETRY_TIERS ? tier_info[tier].name : NULL;
+}
+
+int station_telemetry_tier_parse(const char *name, station_telemetry_tier_t *tier) {
+    for (int i = 0; i < STATION_TELEMETRY_TIERS; i++) {
+        if (strcmp(name, tier_info[i].name) == 0) {
+            *tier = (station_telemetry_tier_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* ---------- Битовые потоки ---------- */
+
+static int column_reserve(telemetry_column_t *column, size_t bits) {
+    size_t need = (column->bits + bits + 7) / 8;
+    if (need <= column->capacity) return 0;
+
+    size_t capacity = column->capacity ? column->capacity * 2 : 32;
+    while (capacity < need) capacity *= 2;
+
+    uint8_t *data = realloc(column->data, capacity);
+    if (!data) return -1;
+    memset(data + column->capacity, 0, capacity - column->capacity);
+    column->data = data;
+    column->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Запись count младших бит value (место зарезервировано column_reserve)
+ */
+static void column_write(telemetry_column_t *column, uint64_t value, int count) {
+    while (count > 0) {
+        int space = 8 - (int)(column->bits % 8);
+        int take = count < space ? count : space;
+        unsigned int part = (unsigned int)(value >> (count - take)) & ((1u << take) - 1);
+        column->data[column->bits / 8] |= (uint8_t)(part << (space - take));
+        column->bits += take;
+        count -= take;
+    }
+}
+
+static uint64_t column_read(telemetry_reader_t *reader, int count) {
+    uint64_t value = 0;
+    while (count > 0) {
+        int space = 8 - (int)(reader->pos % 8);
+        int take = count < space ? count : space;
+        unsigned int part = (reader->data[reader->pos / 8] >> (space - take)) & ((1u << take) - 1);
+        value = (value << take) | part;
+        reader->pos += take;
+        count -= take;
+    }
+    return value;
+}
+
+/**
+ * Закрытый блок больше не растет: лишняя емкость столбцов возвращается
+ */
+static void column_shrink(telemetry_column_t *column) {
+    size_t length = (column->bits + 7) / 8;
+    if (length == 0 || length == column->capacity) return;
+
+    uint8_t *data = realloc(column->data, length);
+    if (data) {
+        column->data = data;
+        column->capacity = length;
+    }
+}
+
+/* ---------- Кодирование ---------- */
+
+static void write_timestamp(telemetry_column_t *column, int64_t dod) {
+    if (dod == 0) {
+        column_write(column, 0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        column_write(column, 0x2, 2);
+        column_write(column, (uint64_t)(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        column_write(column, 0x6, 3);
+        column_write(column, (uint64_t)(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        column_write(column, 0xE, 4);
+        column_write(column, (uint64_t)(dod + 2047), 12);
+    } else if (dod >= -2147483647LL && dod <= 2147483648LL) {
+        column_write(column, 0x1E, 5);
+        column_write(column, (uint64_t)(dod + 2147483647LL), 32);
+    } else {
+        column_write(column, 0x1F, 5);
+        column_write(column, (uint64_t)dod, 64);
+    }
+}
+
+static int64_t read_timestamp(telemetry_reader_t *reader) {
+    int ones = 0;
+    while (ones < 5 && column_read(reader, 1)) {
+        ones++;
+    }
+
+    switch (ones) {
+        case 0: return 0;
+        case 1: return (int64_t)column_read(reader, 7) - 63;
+        case 2: return (int64_t)column_read(reader, 9) - 255;
+        case 3: return (int64_t)column_read(reader, 12) - 2047;
+        case 4: return (int64_t)column_read(reader, 32) - 2147483647LL;
+        default: return (int64_t)column_read(reader, 64);
+    }
+}
+
+static uint32_t float_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void write_value(telemetry_column_t *column, telemetry_xor_t *state, uint32_t bits) {
+    uint32_t xor = bits ^ state->previous;
+    state->previous = bits;
+
+    if (xor == 0) {
+        column_write(column, 0, 1);
+        return;
+    }
+
+    int leading = __builtin_clz(xor);
+    int trailing = __builtin_ctz(xor);
+    if (state->leading >= 0 && leading >= state->leading && trailing >= state->trailing) {
+        column_write(column, 0x2, 2);
+        column_write(column, xor >> state->trailing, 32 - state->leading - state->trailing);
+        return;
+    }
+
+    int length = 32 - leading - trailing;
+    column_write(column, 0x3, 2);
+    column_write(column, leading, 5);
+    column_write(column, length - 1, 5);
+    column_write(column, xor >> trailing, length);
+    state->leading = leading;
+    state->trailing = trailing;
+}
+
+static uint32_t read_value(telemetry_reader_t *reader, telemetry_xor_t *state) {
+    if (column_read(reader, 1)) {
+        if (column_read(reader, 1)) {
+            state->leading = (int)column_read(reader, 5);
+            int length = (int)column_read(reader, 5) + 1;
+            state->trailing = 32 - state->leading - length;
+        }
+        int length = 32 - state->leading - state->trailing;
+        state->previous ^= (uint32_t)column_read(reader, length) << state->trailing;
+    }
+    return state->previous;
+}
+
+/* ---------- Блоки ---------- */
+
+static void chunk_free(telemetry_chunk_t *chunk) {
+    for (int i = 0; i <= chunk->width; i++) {
+        free(chunk->columns[i].data);
+    }
+    free(chunk);
+}
+
+static int chunk_append(telemetry_chunk_t *chunk, int64_t timestamp, const float *values) {
+    // Место резервируется заранее: блок не остается записанным наполовину
+    if (column_reserve(&chunk->columns[0], TIMESTAMP_MAX_BITS) != 0) return -1;
+    for (int i = 1; i <= chunk->width; i++) {
+        if (column_reserve(&chunk->columns[i], VALUE_MAX_BITS) != 0) return -1;
+    }
+
+    if (chunk->count == 0) {
+        chunk->first_timestamp = timestamp;
+        for (int i = 0; i < chunk->width; i++) {
+            chunk->xor_state[i].previous = float_bits(values[i]);
+            chunk->xor_state[i].leading = -1;
+            column_write(&chunk->columns[1 + i], chunk->xor_state[i].previous, 32);
+        }
+    } else {
+        int64_t delta = timestamp - chunk->last_timestamp;
+        write_timestamp(&chunk->columns[0], delta - chunk->last_delta);
+        chunk->last_delta = delta;
+        for (int i = 0; i < chunk->width; i++) {
+            write_value(&chunk->columns[1 + i], &chunk->xor_state[i], float_bits(values[i]));
+        }
+    }
+
+    chunk->last_timestamp = timestamp;
+    chunk->count++;
+    return 0;
+}
+
+/**
+ * Последовательное чтение строк блока
+ */
+typedef struct {
+    const telemetry_chunk_t *chunk;
+    int row;
+    int64_t timestamp;
+    int64_t delta;
+    telemetry_reader_t readers[1 + MAX_WIDTH];
+    telemetry_xor_t states[MAX_WIDTH];
+} telemetry_cursor_t;
+
+static void cursor_init(telemetry_cursor_t *cursor, const telemetry_chunk_t *chunk) {
+    cursor->chunk = chunk;
+    cursor->row = 0;
+    cursor->timestamp = chunk->first_timestamp;
+    cursor->delta = 0;
+    for (int i = 0; i <= chunk->width; i++) {
+        cursor->readers[i].data = chunk->columns[i].data;
+        cursor->readers[i].pos = 0;
+    }
+}
+
+/**
+ * Следующая строка: 1 - прочитана, 0 - блок закончился
+ */
+static int cursor_next(telemetry_cursor_t *cursor, int64_t *timestamp, float *values) {
+    const telemetry_chunk_t *chunk = cursor->chunk;
+    if (cursor->row == chunk->count) return 0;
+
+    if (cursor->row == 0) {
+        for (int i = 0; i < chunk->width; i++) {
+            cursor->states[i].previous = (uint32_t)column_read(&cursor->readers[1 + i], 32);
+            cursor->states[i].leading = -1;
+            values[i] = bits_float(cursor->states[i].previous);
+        }
+    } else {
+        cursor->delta += read_timestamp(&cursor->readers[0]);
+        cursor->timestamp += cursor->delta;
+        for (int i = 0; i < chunk->width; i++) {
+            values[i] = bits_float(read_value(&cursor->readers[1 + i], &cursor->states[i]));
+        }
+    }
+
+    cursor->row++;
+    *timestamp = cursor->timestamp;
+    return 1;
+}
+
+/* ---------- Уровни ---------- */
+
+static void ring_free(telemetry_ring_t *ring) {
+    for (int i = 0; i < ring->count; i++) {
+        chunk_free(ring->chunks[(ring->first + i) % ring->capacity]);
+    }
+    free(ring->chunks);
+    memset(ring, 0, sizeof(*ring));
+}
+
+static telemetry_chunk_t* ring_at(const telemetry_ring_t *ring, int i) {
+    return ring->chunks[(ring->first + i) % ring->capacity];
+}
+
+/**
+ * Добавление блока в конец кольца. Перед этим вытесняются блоки старше
+ * хранения уровня (от времени timestamp) и блоки сверх предела
+ */
+static int ring_push(telemetry_ring_t *ring, const telemetry_tier_info_t *info, int64_t timestamp,
+                     telemetry_chunk_t *chunk) {
+    while (ring->count > 0 && (ring->count == info->max_chunks ||
+                               ring_at(ring, 0)->last_timestamp < timestamp - info->retention_ms)) {
+        chunk_free(ring_at(ring, 0));
+        ring->first = (ring->first + 1) % ring->capacity;
+        ring->count--;
+    }
+
+    if (ring->count == ring->capacity) {
+        int capacity = ring->capacity ? ring->capacity * 2 : 4;
+        if (capacity > info->max_chunks) capacity = info->max_chunks;
+
+        telemetry_chunk_t **chunks = malloc(capacity * sizeof(*chunks));
+        if (!chunks) return -1;
+        for (int i = 0; i < ring->count; i++) {
+            chunks[i] = ring_at(ring, i);
+        }
+        free(ring->chunks);
+        ring->chunks = chunks;
+        ring->first = 0;
+        ring->capacity = capacity;
+    }
+
+    ring->chunks[(ring->first + ring->count) % ring->capacity] = chunk;
+    ring->count++;
+    return 0;
+}
+
+/**
+ * Блок для новой строки уровня: текущий или новый
+ */
+static telemetry_chunk_t* ring_open_chunk(telemetry_ring_t *ring, const telemetry_tier_info_t *info,
+                                          int64_t timestamp) {
+    telemetry_chunk_t *last = ring->count > 0 ? ring_at(ring, ring->count - 1) : NULL;
+    if (last && last->count < STATION_TELEMETRY_CHUNK_SAMPLES) {
+        return last;
+    }
+
+    if (last) {
+        // Закрытый блок больше не растет: лишняя емкость столбцов возвращается
+        for (int i = 0; i <= last->width; i++) {
+            column_shrink(&last->columns[i]);
+        }
+    }
+
+    telemetry_chunk_t *chunk = calloc(1, sizeof(telemetry_chunk_t));
+    if (!chunk) return NULL;
+    chunk->width = info->width;
+    chunk->seq = ring->next_seq;
+
+    if (ring_push(ring, info, timestamp, chunk) != 0) {
+        free(chunk);
+        return NULL;
+    }
+    ring->next_seq++;
+    return chunk;
+}
+
+static int tier_append(telemetry_station_t *station, int tier, int64_t timestamp, const float *values) {
+    telemetry_chunk_t *chunk = ring_open_chunk(&station->tiers[tier], &tier_info[tier], timestamp);
+    return chunk ? chunk_append(chunk, timestamp, values) : -1;
+}
+
+/**
+ * Строка агрегата из открытого интервала
+ */
+static void rollup_row(const telemetry_rollup_t *rollup, float *row) {
+    row[ROLLUP_COUNT] = (float)rollup->samples;
+    for (int i = 0; i < STATION_TELEMETRY_METRICS; i++) {
+        row[ROLLUP_MIN + i] = rollup->min[i];
+        row[ROLLUP_MAX + i] = rollup->max[i];
+        row[ROLLUP_AVG + i] = (float)(rollup->sums[i] / rollup->samples);
+    }
+}
+
+/**
+ * Добавление измерения в агрегат уровня: интервал, в который измерение не
+ * попадает, закрывается строкой уровня
+ */
+static int rollup_add(telemetry_station_t *station, int tier, int64_t timestamp, const float *values) {
+    int64_t resolution = tier_info[tier].resolution_ms;
+    int64_t bucket = timestamp - ((timestamp % resolution) + resolution) % resolution;
+    telemetry_rollup_t *rollup = &station->open[tier];
+    int result = 0;
+
+    if (rollup->samples > 0 && rollup->bucket != bucket) {
+        float row[ROLLUP_WIDTH];
+        rollup_row(rollup, row);
+        result = tier_append(station, tier, rollup->bucket, row);
+        rollup->samples = 0;
+    }
+
+    if (rollup->samples == 0) {
+        rollup->bucket = bucket;
+        for (int i = 0; i < STATION_TELEMETRY_METRICS; i++) {
+            rollup->min[i] = values[i];
+            rollup->max[i] = values[i];
+            rollup->sums[i] = 0;
+        }
+    }
+    for (int i = 0; i < STATION_TELEMETRY_METRICS; i++) {
+        if (values[i] < rollup->min[i]) rollup->min[i] = values[i];
+        if (values[i] > rollup->max[i]) rollup->max[i] = values[i];
+        rollup->sums[i] += values[i];
+    }
+    rollup->samples++;
+    return result;
+}
+
+/* ---------- Истории станций ---------- */
+
+static telemetry_station_t* telemetry_find(int id) {
+    int slot = station_index_find(&telemetry_index, id);
+    return slot >= 0 ? telemetry_stations[slot] : NULL;
+}
+
+/**
+ * История станции, созданная при первом измерении (под блокировкой записи)
+ */
+static telemetry_station_t* telemetry_create(int id) {
+    telemetry_station_t *station = telemetry_find(id);
+    if (station) return station;
+
+    if (telemetry_count == telemetry_capacity) {
+        int capacity = telemetry_capacity ? telemetry_capacity * 2 : 16;
+        telemetry_station_t **stations = realloc(telemetry_stations, capacity * sizeof(*stations));
+        if (!stations) return NULL;
+        telemetry_stations = stations;
+        telemetry_capacity = capacity;
+    }
+
+    station = calloc(1, sizeof(telemetry_station_t));
+    if (!station) return NULL;
+    station->id = id;
+    pthread_mutex_init(&station->lock, NULL);
+
+    if (station_index_put(&telemetry_index, id, telemetry_count) != 0) {
+        pthread_mutex_destroy(&station->lock);
+        free(station);
+        return NULL;
+    }
+    telemetry_stations[telemetry_count++] = station;
+    return station;
+}
+
+static void telemetry_station_free(telemetry_station_t *station) {
+    for (int i = 0; i < STATION_TELEMETRY_TIERS; i++) {
+        ring_free(&station->tiers[i]);
+    }
+    pthread_mutex_destroy(&station->lock);
+    free(station);
+}
+
+int station_telemetry_record(const charging_station_t *station, int64_t timestamp_ms) {
+#define STATION_TELEMETRY_VALUE(key, member) station->member,
+    const float values[STATION_TELEMETRY_METRICS] = {
+        STATION_TELEMETRY_FIELDS(STATION_TELEMETRY_VALUE)
+    };
+#undef STATION_TELEMETRY_VALUE
+
+    pthread_rwlock_rdlock(&telemetry_lock);
+    telemetry_station_t *series = telemetry_find(station->id);
+    if (!series) {
+        pthread_rwlock_unlock(&telemetry_lock);
+        pthread_rwlock_wrlock(&telemetry_lock);
+        series = telemetry_create(station->id);
+        pthread_rwlock_unlock(&telemetry_lock);
+        if (!series) return -1;
+
+        pthread_rwlock_rdlock(&telemetry_lock);
+        series = telemetry_find(station->id);
+        if (!series) {
+            pthread_rwlock_unlock(&telemetry_lock);
+            return -1;
+        }
+    }
+
+    pthread_mutex_lock(&series->lock);
+    // Время в истории не идет назад, даже если часы системы перевели
+    if (series->has_samples && timestamp_ms < series->last_timestamp) {
+        timestamp_ms = series->last_timestamp;
+    }
+    series->has_samples = 1;
+    series->last_timestamp = timestamp_ms;
+
+    int result = tier_append(series, STATION_TELEMETRY_RAW, timestamp_ms, values);
+    for (int tier = STATION_TELEMETRY_MINUTE; tier < STATION_TELEMETRY_TIERS; tier++) {
+        if (rollup_add(series, tier, timestamp_ms, values) != 0) {
+            result = -1;
+        }
+    }
+    pthread_mutex_unlock(&series->lock);
+    pthread_rwlock_unlock(&telemetry_lock);
+    return result;
+}
+
+/**
+ * Удаление истории под блокировкой записи
+ */
+static void telemetry_remove_locked(int id) {
+    int slot = station_index_remove(&telemetry_index, id);
+    if (slot >= 0) {
+        telemetry_station_free(telemetry_stations[slot]);
+
+        // Последняя история переносится на место удаленной
+        telemetry_count--;
+        if (slot != telemetry_count) {
+            telemetry_stations[slot] = telemetry_stations[telemetry_count];
+            station_index_put(&telemetry_index, telemetry_stations[slot]->id, slot);
+        }
+    }
+}
+
+void station_telemetry_remove(int id) {
+    pthread_rwlock_wrlock(&telemetry_lock);
+    telemetry_remove_locked(id);
+    pthread_rwlock_unlock(&telemetry_lock);
+}
+
+void station_telemetry_prune(int (*keep)(int id, void *ctx), void *ctx) {
+    pthread_rwlock_wrlock(&telemetry_lock);
+    // С конца: на место удаленной переносится уже проверенная история
+    for (int i = telemetry_count - 1; i >= 0; i--) {
+        if (!keep(telemetry_stations[i]->id, ctx)) {
+            telemetry_remove_locked(telemetry_stations[i]->id);
+        }
+    }
+    pthread_rwlock_unlock(&telemetry_lock);
+}
+
+void station_telemetry_cleanup(void) {
+    // Потоки соединений при завершении еще могут читать историю
+    if (pthread_rwlock_trywrlock(&telemetry_lock) != 0) {
+        return;
+    }
+    for (int i = 0; i < telemetry_count; i++) {
+        telemetry_station_free(telemetry_stations[i]);
+    }
+    free(telemetry_stations);
+    telemetry_stations = NULL;
+    telemetry_count = 0;
+    telemetry_capacity = 0;
+    station_index_destroy(&telemetry_index);
+    pthread_rwlock_unlock(&telemetry_lock);
+}
+
+/* ---------- Запросы ---------- */
+
+/**
+ * Сведение строк текущего интервала шага
+ */
+typedef struct {
+    int64_t bucket;
+    double samples;
+    double sums[STATION_TELEMETRY_METRICS];
+    float min[STATION_TELEMETRY_METRICS];
+    float max[STATION_TELEMETRY_METRICS];
+} telemetry_bucket_t;
+
+static int series_append(station_telemetry_series_t *series, int64_t timestamp, const telemetry_bucket_t *bucket) {
+    if (series->count == series->capacity) {
+        int capacity = series->capacity ? series->capacity * 2 : 64;
+        int64_t *timestamps = realloc(series->timestamps, capacity * sizeof(int64_t));
+        if (!timestamps) return -1;
+        series->timestamps = timestamps;
+
+        float **columns[] = { series->values, series->min, series->max };
+        for (int c = 0; c < 3; c++) {
+            for (int i = 0; i < STATION_TELEMETRY_METRICS; i++) {
+                float *values = realloc(columns[c][i], capacity * sizeof(float));
+                if (!values) return -1;
+                columns[c][i] = values;
+            }
+        }
+        series->capacity = capacity;
+    }
+
+    series->timestamps[series->count] = timestamp;
+    for (int i = 0; i < STATION_TELEMETRY_METRICS; i++) {
+        series->values[i][series->count] = (float)(bucket->sums[i] / bucket->samples);
+        series->min[i][series->count] = bucket->min[i];
+        series->max[i][series->count] = bucket->max[i];
+    }
+    series->count++;
+    return 0;
+}
+
+/**
+ * Добавление строки уровня в интервал шага: сырое измерение - строка из
+ * одного измерения, у агрегата среднее взвешивается числом измерений
+ */
+static int bucket_add(telemetry_bucket_t *bucket, station_telemetry_series_t *series, int raw,
+                      int64_t from, int64_t step, int64_t timestamp, const float *row) {
+    // Строки отобраны из [from, to], границы проверены в запросе: разность не переполняется
+    int64_t index = (timestamp - from) / step;
+    if (index != bucket->bucket) {
+        if (bucket->samples > 0 && series_append(series, from + bucket->bucket * step, bucket) != 0) {
+            return -1;
+        }
+        memset(bucket, 0, sizeof(*bucket));
+        bucket->bucket = index;
+    }
+
+    double samples = raw ? 1 : row[ROLLUP_COUNT];
+    for (int i = 0; i < STATION_TELEMETRY_METRICS; i++) {
+        float min = raw ? row[i] : row[ROLLUP_MIN + i];
+        float max = raw ? row[i] : row[ROLLUP_MAX + i];
+        float avg = raw ? row[i] : row[ROLLUP_AVG + i];
+        if (bucket->samples == 0 || min < bucket->min[i]) bucket->min[i] = min;
+        if (bucket->samples == 0 || max > bucket->max[i]) bucket->max[i] = max;
+        bucket->sums[i] += avg * samples;
+    }
+    bucket->samples += samples;
+    return 0;
+}
+
+/**
+ * Уровень для запроса без явного уровня
+ */
+static int telemetry_pick_tier(const telemetry_station_t *station, int64_t from_ms, int64_t step_ms) {
+    int tier = STATION_TELEMETRY_RAW;
+    for (int i = STATION_TELEMETRY_MINUTE; i < STATION_TELEMETRY_TIERS; i++) {
+        if (tier_info[i].resolution_ms <= step_ms ||
+            from_ms < station->last_timestamp - tier_info[tier].retention_ms) {
+            tier = i;
+        }
+    }
+    return tier;
+}
+
+int station_telemetry_query(int id, station_telemetry_tier_t tier, int64_t from_ms, int64_t to_ms,
+                            int64_t step_ms, station_telemetry_series_t *series) {
+    memset(series, 0, sizeof(*series));
+    series->tier = tier == STATION_TELEMETRY_AUTO ? STATION_TELEMETRY_RAW : tier;
+    if (step_ms <= 0 || step_ms > STATION_TELEMETRY_MAX_TIMESTAMP_MS || from_ms < 0 || to_ms < from_ms ||
+        to_ms > STATION_TELEMETRY_MAX_TIMESTAMP_MS ||
+        tier < STATION_TELEMETRY_AUTO || tier >= STATION_TELEMETRY_TIERS) {
+        return -1;
+    }
+
+    pthread_rwlock_rdlock(&telemetry_lock);
+    telemetry_station_t *station = telemetry_find(id);
+    if (!station) {
+        pthread_rwlock_unlock(&telemetry_lock);
+        return 0;
+    }
+
+    pthread_mutex_lock(&station->lock);
+    if (tier == STATION_TELEMETRY_AUTO) {
+        tier = telemetry_pick_tier(station, from_ms, step_ms);
+        series->tier = tier;
+    }
+    int raw = tier == STATION_TELEMETRY_RAW;
+
+    telemetry_bucket_t bucket = { .bucket = -1 };
+    int64_t timestamp;
+    float row[MAX_WIDTH];
+    int failed = 0, done = 0;
+
+    const telemetry_ring_t *ring = &station->tiers[tier];
+    for (int i = 0; i < ring->count && !done && !failed; i++) {
+        const telemetry_chunk_t *chunk = ring_at(ring, i);
+        if (chunk->count == 0 || chunk->last_timestamp < from_ms) continue;
+
+        telemetry_cursor_t cursor;
+        cursor_init(&cursor, chunk);
+        while (cursor_next(&cursor, &timestamp, row)) {
+            if (timestamp < from_ms) continue;
+            if (timestamp > to_ms) {
+                done = 1;
+                break;
+            }
+            if (bucket_add(&bucket, series, raw, from_ms, step_ms, timestamp, row) != 0) {
+                failed = 1;
+                break;
+            }
+        }
+    }
+
+    // Открытый интервал агрегата еще не записан в уровень
+    const telemetry_rollup_t *rollup = &station->open[tier];
+    if (!raw && !done && !failed && rollup->samples > 0 &&
+        rollup->bucket >= from_ms && rollup->bucket <= to_ms) {
+        rollup_row(rollup, row);
+        failed = bucket_add(&bucket, series, raw, from_ms, step_ms, rollup->bucket, row) != 0;
+    }
+
+    if (!failed && bucket.samples > 0 && series_append(series, from_ms + bucket.bucket * step_ms, &bucket) != 0) {
+        failed = 1;
+    }
+    pthread_mutex_unlock(&station->lock);
+    pthread_rwlock_unlock(&telemetry_lock);
+
+    if (failed) {
+        station_telemetry_series_free(series);
+        return -1;
+    }
+    return 0;
+}
+
+void station_telemetry_series_free(station_telemetry_series_t *series) {
+    free(series->timestamps);
+    for (int i = 0; i < STATION_TELEMETRY_METRICS; i++) {
+        free(series->values[i]);
+        free(series->min[i]);
+        free(series->max[i]);
+    }
+    memset(series, 0, sizeof(*series));
+}
+
+/* ---------- Файл истории ---------- */
+
+/*
+ * Запись файла: тип (4 байта), длина данных (4), контрольная сумма (8), данные.
+ * Блок: id станции, уровень, номер блока, затем блок - число строк, ширина,
+ * времена, состояния XOR, длины столбцов в битах и байты столбцов.
+ * Контрольная точка: формат, число метрик, строк в блоке, число станций,
+ * сегмент журнала; для станции - id, время последнего измерения и для
+ * каждого уровня номер первого несохраненного блока, открытый интервал
+ * агрегата и незаполненный блок (если есть)
+ */
+#define RECORD_CHUNK 0x4B4E4843u        // "CHNK"
+#define RECORD_CHECKPOINT 0x54504B43u   // "CKPT"
+#define RECORD_HEADER_SIZE 16
+#define CHECKPOINT_FORMAT 1
+
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+    int failed;
+} telemetry_output_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    size_t pos;
+    int failed;
+} telemetry_input_t;
+
+/**
+ * Границы уровней станции на момент снимка
+ */
+typedef struct {
+    int id;
+    uint32_t boundary[STATION_TELEMETRY_TIERS];   // блоки до границы закрыты
+    uint32_t persisted[STATION_TELEMETRY_TIERS];
+} telemetry_capture_station_t;
+
+struct telemetry_capture {
+    telemetry_output_t checkpoint;                // данные записи контрольной точки
+    telemetry_capture_station_t *stations;
+    int count;
+    size_t live_bytes;                            // записи закрытых блоков в памяти
+};
+
+static void output_write(telemetry_output_t *out, const void *data, size_t length) {
+    if (out->failed) return;
+    if (out->length + length > out->capacity) {
+        size_t capacity = out->capacity ? out->capacity * 2 : 4096;
+        while (capacity < out->length + length) capacity *= 2;
+
+        uint8_t *buffer = realloc(out->data, capacity);
+        if (!buffer) {
+            out->failed = 1;
+            return;
+        }
+        out->data = buffer;
+        out->capacity = capacity;
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+static void output_u32(telemetry_output_t *out, uint32_t value) {
+    output_write(out, &value, sizeof(value));
+}
+
+static void output_i64(telemetry_output_t *out, int64_t value) {
+    output_write(out, &value, sizeof(value));
+}
+
+static void input_read(telemetry_input_t *in, void *data, size_t length) {
+    if (in->failed || in->length - in->pos < length) {
+        in->failed = 1;
+        memset(data, 0, length);
+        return;
+    }
+    memcpy(data, in->data + in->pos, length);
+    in->pos += length;
+}
+
+static uint32_t input_u32(telemetry_input_t *in) {
+    uint32_t value;
+    input_read(in, &value, sizeof(value));
+    return value;
+}
+
+static int64_t input_i64(telemetry_input_t *in) {
+    int64_t value;
+    input_read(in, &value, sizeof(value));
+    return value;
+}
+
+static uint64_t record_checksum(uint32_t type, const uint8_t *data, size_t length) {
+    uint64_t hash = 0xCBF29CE484222325ull ^ type;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 0x100000001B3ull;
+    }
+    return hash ^ length;
+}
+
+/**
+ * Начало записи: заголовок дописывается record_end, когда известна длина
+ */
+static size_t record_begin(telemetry_output_t *out) {
+    size_t start = out->length;
+    uint8_t header[RECORD_HEADER_SIZE] = {0};
+    output_write(out, header, sizeof(header));
+    return start;
+}
+
+static void record_end(telemetry_output_t *out, size_t start, uint32_t type) {
+    if (out->failed) return;
+    const uint8_t *data = out->data + start + RECORD_HEADER_SIZE;
+    uint32_t length = (uint32_t)(out->length - start - RECORD_HEADER_SIZE);
+    uint64_t checksum = record_checksum(type, data, length);
+    memcpy(out->data + start, &type, 4);
+    memcpy(out->data + start + 4, &length, 4);
+    memcpy(out->data + start + 8, &checksum, 8);
+}
+
+static size_t chunk_saved_size(const telemetry_chunk_t *chunk) {
+    size_t size = 2 * 4 + 3 * 8 + (size_t)chunk->width * 3 * 4 + (size_t)(chunk->width + 1) * 8;
+    for (int i = 0; i <= chunk->width; i++) {
+        size += (chunk->columns[i].bits + 7) / 8;
+    }
+    return size;
+}
+
+static void chunk_save(telemetry_output_t *out, const telemetry_chunk_t *chunk) {
+    output_u32(out, (uint32_t)chunk->count);
+    output_u32(out, (uint32_t)chunk->width);
+    output_i64(out, chunk->first_timestamp);
+    output_i64(out, chunk->last_timestamp);
+    output_i64(out, chunk->last_delta);
+    for (int i = 0; i < chunk->width; i++) {
+        output_u32(out, chunk->xor_state[i].previous);
+        output_u32(out, (uint32_t)chunk->xor_state[i].leading);
+        output_u32(out, (uint32_t)chunk->xor_state[i].trailing);
+    }
+    for (int i = 0; i <= chunk->width; i++) {
+        uint64_t bits = chunk->columns[i].bits;
+        output_write(out, &bits, sizeof(bits));
+    }
+    for (int i = 0; i <= chunk->width; i++) {
+        output_write(out, chunk->columns[i].data, (chunk->columns[i].bits + 7) / 8);
+    }
+}
+
+/**
+ * Блок из файла; емкость столбцов - ровно по данным (незаполненный блок
+ * дорастет через column_reserve)
+ */
+static telemetry_chunk_t* chunk_load(telemetry_input_t *in, int width, uint32_t seq) {
+    int count = (int)input_u32(in);
+    if ((int)input_u32(in) != width || count <= 0 || count > STATION_TELEMETRY_CHUNK_SAMPLES) {
+        in->failed = 1;
+        return NULL;
+    }
+
+    telemetry_chunk_t *chunk = calloc(1, sizeof(telemetry_chunk_t));
+    if (!chunk) {
+        in->failed = 1;
+        return NULL;
+    }
+    chunk->seq = seq;
+    chunk->count = count;
+    chunk->width = width;
+    chunk->first_timestamp = input_i64(in);
+    chunk->last_timestamp = input_i64(in);
+    chunk->last_delta = input_i64(in);
+    for (int i = 0; i < width; i++) {
+        chunk->xor_state[i].previous = input_u32(in);
+        chunk->xor_state[i].leading = (int32_t)input_u32(in);
+        chunk->xor_state[i].trailing = (int32_t)input_u32(in);
+        if (chunk->xor_state[i].leading < -1 || chunk->xor_state[i].leading > 31 ||
+            chunk->xor_state[i].trailing < 0 || chunk->xor_state[i].trailing > 31) {
+            in->failed = 1;
+        }
+    }
+    for (int i = 0; i <= width; i++) {
+        uint64_t bits;
+        input_read(in, &bits, sizeof(bits));
+        size_t max_bits = (size_t)count * (i == 0 ? TIMESTAMP_MAX_BITS : VALUE_MAX_BITS);
+        if (bits > max_bits) in->failed = 1;
+        chunk->columns[i].bits = in->failed ? 0 : (size_t)bits;
+    }
+    for (int i = 0; i <= width && !in->failed; i++) {
+        size_t length = (chunk->columns[i].bits + 7) / 8;
+        if (length == 0) continue;
+        chunk->columns[i].data = malloc(length);
+        if (!chunk->columns[i].data) {
+            in->failed = 1;
+            break;
+        }
+        chunk->columns[i].capacity = length;
+        input_read(in, chunk->columns[i].data, length);
+    }
+
+    if (in->failed) {
+        chunk_free(chunk);
+        return NULL;
+    }
+    return chunk;
+}
+
+static void rollup_save(telemetry_output_t *out, const telemetry_rollup_t *rollup) {
+    output_i64(out, rollup->bucket);
+    output_u32(out, (uint32_t)rollup->samples);
+    output_write(out, rollup->min, sizeof(rollup->min));
+    output_write(out, rollup->max, sizeof(rollup->max));
+    output_write(out, rollup->sums, sizeof(rollup->sums));
+}
+
+static void rollup_load(telemetry_input_t *in, telemetry_rollup_t *rollup) {
+    rollup->bucket = input_i64(in);
+    rollup->samples = (int)input_u32(in);
+    input_read(in, rollup->min, sizeof(rollup->min));
+    input_read(in, rollup->max, sizeof(rollup->max));
+    input_read(in, rollup->sums, sizeof(rollup->sums));
+    if (rollup->samples < 0) in->failed = 1;
+}
+
+/**
+ * Незаполненный последний блок уровня (NULL - все блоки закрыты)
+ */
+static const telemetry_chunk_t* ring_open_tail(const telemetry_ring_t *ring) {
+    const telemetry_chunk_t *last = ring->count > 0 ? ring_at(ring, ring->count - 1) : NULL;
+    return last && last->count < STATION_TELEMETRY_CHUNK_SAMPLES ? last : NULL;
+}
+
+void station_telemetry_capture_free(station_telemetry_capture_t *capture) {
+    if (capture->state) {
+        free(capture->state->checkpoint.data);
+        free(capture->state->stations);
+        free(capture->state);
+    }
+    free(capture->data);
+    memset(capture, 0, sizeof(*capture));
+}
+
+/**
+ * Снимок под блокировкой чтения станций: измерения пишутся под блокировкой
+ * записи станций, поэтому снимок согласован с ротацией журнала. Копируются
+ * только незаполненные блоки и агрегаты; закрытые блоки не меняются и
+ * сериализуются позже, в station_telemetry_capture_records
+ */
+int station_telemetry_capture(station_telemetry_capture_t *capture, unsigned long wal_segment) {
+    memset(capture, 0, sizeof(*capture));
+    struct telemetry_capture *state = calloc(1, sizeof(struct telemetry_capture));
+    if (!state) return -1;
+    capture->state = state;
+
+    pthread_rwlock_rdlock(&telemetry_lock);
+    state->stations = telemetry_count > 0 ? malloc(telemetry_count * sizeof(telemetry_capture_station_t)) : NULL;
+    if (telemetry_count > 0 && !state->stations) {
+        pthread_rwlock_unlock(&telemetry_lock);
+        station_telemetry_capture_free(capture);
+        return -1;
+    }
+
+    telemetry_output_t *out = &state->checkpoint;
+    output_u32(out, CHECKPOINT_FORMAT);
+    output_u32(out, STATION_TELEMETRY_METRICS);
+    output_u32(out, STATION_TELEMETRY_CHUNK_SAMPLES);
+    output_u32(out, (uint32_t)telemetry_count);
+    uint64_t segment = wal_segment;
+    output_write(out, &segment, sizeof(segment));
+
+    for (int i = 0; i < telemetry_count; i++) {
+        telemetry_station_t *station = telemetry_stations[i];
+        telemetry_capture_station_t *entry = &state->stations[state->count++];
+        entry->id = station->id;
+
+        pthread_mutex_lock(&station->lock);
+        output_u32(out, (uint32_t)station->id);
+        output_u32(out, (uint32_t)station->has_samples);
+        output_i64(out, station->last_timestamp);
+        for (int tier = 0; tier < STATION_TELEMETRY_TIERS; tier++) {
+            const telemetry_ring_t *ring = &station->tiers[tier];
+            const telemetry_chunk_t *open = ring_open_tail(ring);
+            entry->boundary[tier] = open ? open->seq : ring->next_seq;
+            entry->persisted[tier] = ring->persisted;
+
+            for (int c = 0; c < ring->count; c++) {
+                const telemetry_chunk_t *chunk = ring_at(ring, c);
+                if (chunk->seq < entry->boundary[tier]) {
+                    state->live_bytes += RECORD_HEADER_SIZE + 3 * 4 + chunk_saved_size(chunk);
+                }
+            }
+
+            output_u32(out, entry->boundary[tier]);
+            rollup_save(out, &station->open[tier]);
+            output_u32(out, open && open->count > 0);
+            if (open && open->count > 0) {
+                chunk_save(out, open);
+            }
+        }
+        pthread_mutex_unlock(&station->lock);
+    }
+    pthread_rwlock_unlock(&telemetry_lock);
+
+    if (out->failed) {
+        station_telemetry_capture_free(capture);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Записи для файла: закрытые блоки, которых в нем еще нет (или все, если
+ * файл переписывается), и контрольная точка последней. Блоки читаются под
+ * мьютексом своей станции, измерения других станций не ждут
+ */
+int station_telemetry_capture_records(station_telemetry_capture_t *capture, size_t file_length) {
+    struct telemetry_capture *state = capture->state;
+    size_t live = state->live_bytes + RECORD_HEADER_SIZE + state->checkpoint.length;
+    capture->rewrite = file_length == 0 || file_length / 2 > live + STATION_TELEMETRY_FILE_SLACK / 2;
+
+    telemetry_output_t out = {0};
+    for (int i = 0; i < state->count && !out.failed; i++) {
+        const telemetry_capture_station_t *entry = &state->stations[i];
+
+        pthread_rwlock_rdlock(&telemetry_lock);
+        telemetry_station_t *station = telemetry_find(entry->id);
+        if (!station) {
+            pthread_rwlock_unlock(&telemetry_lock);
+            continue;
+        }
+        pthread_mutex_lock(&station->lock);
+        for (int tier = 0; tier < STATION_TELEMETRY_TIERS; tier++) {
+            const telemetry_ring_t *ring = &station->tiers[tier];
+            uint32_t from = capture->rewrite ? 0 : entry->persisted[tier];
+            for (int c = 0; c < ring->count; c++) {
+                const telemetry_chunk_t *chunk = ring_at(ring, c);
+                if (chunk->seq < from || chunk->seq >= entry->boundary[tier]) continue;
+
+                size_t start = record_begin(&out);
+                output_u32(&out, (uint32_t)entry->id);
+                output_u32(&out, (uint32_t)tier);
+                output_u32(&out, chunk->seq);
+                chunk_save(&out, chunk);
+                record_end(&out, start, RECORD_CHUNK);
+            }
+        }
+        pthread_mutex_unlock(&station->lock);
+        pthread_rwlock_unlock(&telemetry_lock);
+    }
+
+    size_t start = record_begin(&out);
+    output_write(&out, state->checkpoint.data, state->checkpoint.length);
+    record_end(&out, start, RECORD_CHECKPOINT);
+
+    if (out.failed) {
+        free(out.data);
+        return -1;
+    }
+    free(capture->data);
+    capture->data = out.data;
+    capture->length = out.length;
+    return 0;
+}
+
+void station_telemetry_capture_commit(station_telemetry_capture_t *capture) {
+    struct telemetry_capture *state = capture->state;
+
+    pthread_rwlock_rdlock(&telemetry_lock);
+    for (int i = 0; i < state->count; i++) {
+        const telemetry_capture_station_t *entry = &state->stations[i];
+        telemetry_station_t *station = telemetry_find(entry->id);
+        if (!station) continue;
+
+        pthread_mutex_lock(&station->lock);
+        for (int tier = 0; tier < STATION_TELEMETRY_TIERS; tier++) {
+            if (station->tiers[tier].persisted < entry->boundary[tier]) {
+                station->tiers[tier].persisted = entry->boundary[tier];
+            }
+        }
+        pthread_mutex_unlock(&station->lock);
+    }
+    pthread_rwlock_unlock(&telemetry_lock);
+}
+
+/**
+ * Следующая запись файла: 0 - прочитана, -1 - конец файла или оборванная запись
+ */
+static int record_next(telemetry_input_t *file, uint32_t *type, telemetry_input_t *record) {
+    if (file->length - file->pos < RECORD_HEADER_SIZE) return -1;
+
+    const uint8_t *header = file->data + file->pos;
+    uint32_t length;
+    uint64_t checksum;
+    memcpy(type, header, 4);
+    memcpy(&length, header + 4, 4);
+    memcpy(&checksum, header + 8, 8);
+    if ((*type != RECORD_CHUNK && *type != RECORD_CHECKPOINT) ||
+        file->length - file->pos - RECORD_HEADER_SIZE < length ||
+        record_checksum(*type, header + RECORD_HEADER_SIZE, length) != checksum) {
+        return -1;
+    }
+
+    record->data = header + RECORD_HEADER_SIZE;
+    record->length = length;
+    record->pos = 0;
+    record->failed = 0;
+    file->pos += RECORD_HEADER_SIZE + length;
+    return 0;
+}
+
+/**
+ * Блок из файла или незаполненный блок из контрольной точки - в кольцо
+ * уровня. Вытеснение - как при открытии блока (от его первой строки),
+ * поэтому в кольце остаются те же блоки, что были в памяти
+ */
+static void restore_push(telemetry_station_t *station, int tier, telemetry_chunk_t *chunk) {
+    if (ring_push(&station->tiers[tier], &tier_info[tier], chunk->first_timestamp, chunk) != 0) {
+        chunk_free(chunk);
+    }
+}
+
+/**
+ * Станции контрольной точки: границы уровней временно хранятся в persisted,
+ * незаполненные блоки - в open до загрузки закрытых
+ */
+static int restore_checkpoint(telemetry_input_t *in, unsigned long *wal_segment, telemetry_chunk_t ***open, int *count) {
+    if (input_u32(in) != CHECKPOINT_FORMAT || input_u32(in) != STATION_TELEMETRY_METRICS ||
+        input_u32(in) != STATION_TELEMETRY_CHUNK_SAMPLES) {
+        return -1;
+    }
+    *count = (int)input_u32(in);
+    uint64_t segment;
+    input_read(in, &segment, sizeof(segment));
+    *wal_segment = (unsigned long)segment;
+    if (in->failed || *count < 0) return -1;
+
+    *open = calloc((size_t)*count * STATION_TELEMETRY_TIERS + 1, sizeof(telemetry_chunk_t*));
+    if (!*open) return -1;
+
+    for (int i = 0; i < *count && !in->failed; i++) {
+        int id = (int)input_u32(in);
+        telemetry_station_t *station = id > 0 && !telemetry_find(id) ? telemetry_create(id) : NULL;
+        if (!station) return -1;
+
+        station->has_samples = (int)input_u32(in);
+        station->last_timestamp = input_i64(in);
+        for (int tier = 0; tier < STATION_TELEMETRY_TIERS && !in->failed; tier++) {
+            station->tiers[tier].persisted = input_u32(in);
+            rollup_load(in, &station->open[tier]);
+            if (input_u32(in)) {
+                telemetry_chunk_t *chunk = chunk_load(in, tier_info[tier].width, station->tiers[tier].persisted);
+                (*open)[i * STATION_TELEMETRY_TIERS + tier] = chunk;
+            }
+        }
+    }
+    return in->failed || in->pos != in->length ? -1 : 0;
+}
+
+int station_telemetry_restore(const void *data, size_t length, unsigned long *wal_segment, size_t *valid_length) {
+    *wal_segment = 0;
+    *valid_length = 0;
+
+    // Последняя целая контрольная точка; записи после нее не подтверждены
+    telemetry_input_t file = { data, length, 0, 0 };
+    telemetry_input_t record, checkpoint = {0};
+    uint32_t type;
+    while (record_next(&file, &type, &record) == 0) {
+        if (type == RECORD_CHECKPOINT) {
+            checkpoint = record;
+            *valid_length = file.pos;
+        }
+    }
+    if (*valid_length == 0) {
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&telemetry_lock);
+    int first = telemetry_count;
+    telemetry_chunk_t **open = NULL;
+    int count = 0;
+    unsigned long segment = 0;
+    if (restore_checkpoint(&checkpoint, &segment, &open, &count) != 0) {
+        for (int i = 0; open && i < count * STATION_TELEMETRY_TIERS; i++) {
+            if (open[i]) chunk_free(open[i]);
+        }
+        free(open);
+        pthread_rwlock_unlock(&telemetry_lock);
+        station_telemetry_cleanup();
+        *valid_length = 0;
+        return -1;
+    }
+
+    // Закрытые блоки по порядку; границы отсекают блоки, дописанные
+    // повторно после неудачной записи контрольной точки
+    file.pos = 0;
+    while (file.pos < *valid_length && record_next(&file, &type, &record) == 0) {
+        if (type != RECORD_CHUNK) continue;
+
+        int id = (int)input_u32(&record);
+        uint32_t tier = input_u32(&record);
+        uint32_t seq = input_u32(&record);
+        telemetry_station_t *station = telemetry_find(id);
+        if (record.failed || !station || tier >= STATION_TELEMETRY_TIERS) continue;
+
+        telemetry_ring_t *ring = &station->tiers[tier];
+        if (seq < ring->next_seq || seq >= ring->persisted) continue;
+
+        telemetry_chunk_t *chunk = chunk_load(&record, tier_info[tier].width, seq);
+        if (!chunk || chunk->count != STATION_TELEMETRY_CHUNK_SAMPLES) {
+            if (chunk) chunk_free(chunk);
+            continue;
+        }
+        ring->next_seq = seq + 1;
+        restore_push(station, (int)tier, chunk);
+    }
+
+    for (int i = 0; i < count; i++) {
+        for (int tier = 0; tier < STATION_TELEMETRY_TIERS; tier++) {
+            telemetry_station_t *station = telemetry_stations[first + i];
+            telemetry_ring_t *ring = &station->tiers[tier];
+            ring->next_seq = ring->persisted;
+            telemetry_chunk_t *chunk = open[i * STATION_TELEMETRY_TIERS + tier];
+            if (chunk) {
+                ring->next_seq++;
+                restore_push(station, tier, chunk);
+            }
+        }
+    }
+    free(open);
+    pthread_rwlock_unlock(&telemetry_lock);
+
+    *wal_segment = segment;
+    return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * История телеметрии станций: напряжения и токи по фазам, мощность зарядки
+ * Хранится на трех уровнях, которые пополняются по мере поступления измерений:
+ * сырые измерения за сутки, минутные и часовые агрегаты (min/max/avg).
+ * Каждый уровень - кольцо блоков по STATION_TELEMETRY_CHUNK_SAMPLES строк,
+ * внутри блока каждый столбец сжат отдельно: время - разность разностей,
+ * значения - XOR с предыдущим (как в Gorilla). Запрос читает только блоки
+ * из диапазона одного уровня и сводит строки по шагу
+ */
+
+#ifndef STATION_TELEMETRY_H
+#define STATION_TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "storage.h"
+
+// Строк в блоке
+#define STATION_TELEMETRY_CHUNK_SAMPLES 128
+
+// Хранение уровней (от последнего измерения станции). Сырых измерений
+// хранится не больше STATION_TELEMETRY_RAW_MAX_SAMPLES (в среднем раз в секунду)
+#define STATION_TELEMETRY_RAW_RETENTION_MS (24LL * 60 * 60 * 1000)
+#define STATION_TELEMETRY_RAW_MAX_SAMPLES (24 * 60 * 60)
+#define STATION_TELEMETRY_MINUTE_RETENTION_MS (30LL * 24 * 60 * 60 * 1000)
+#define STATION_TELEMETRY_HOUR_RETENTION_MS (366LL * 24 * 60 * 60 * 1000)
+
+// Предел точек в ответе на запрос; без параметров запрос охватывает
+// последний час с шагом не больше чем на STATION_TELEMETRY_DEFAULT_POINTS точек
+#define STATION_TELEMETRY_MAX_POINTS 10000
+#define STATION_TELEMETRY_DEFAULT_RANGE_MS (60 * 60 * 1000)
+#define STATION_TELEMETRY_DEFAULT_POINTS 500
+
+// Границы и шаг запроса - от 0 до 2^53 мс: разности времен и начала
+// интервалов в запросе не переполняют int64
+#define STATION_TELEMETRY_MAX_TIMESTAMP_MS (1LL << 53)
+
+/**
+ * Метрики истории: F(ключ JSON, поле charging_station_t), порядок - порядок столбцов
+ */
+#define STATION_TELEMETRY_FIELDS(F) \
+    F("voltagePhase1", voltage_phase1) \
+    F("voltagePhase2", voltage_phase2) \
+    F("voltagePhase3", voltage_phase3) \
+    F("currentPhase1", current_phase1) \
+    F("currentPhase2", current_phase2) \
+    F("currentPhase3", current_phase3) \
+    F("chargerPower",  charger_power)
+
+#define STATION_TELEMETRY_ENUM(key, member) STATION_TELEMETRY_##member,
+enum { STATION_TELEMETRY_FIELDS(STATION_TELEMETRY_ENUM) STATION_TELEMETRY_METRICS };
+#undef STATION_TELEMETRY_ENUM
+
+// Поля станции, изменение которых записывается в историю
+#define STATION_TELEMETRY_MASK_FIELD(key, member) | STATION_FIELD(member)
+#define STATION_TELEMETRY_MASK (0 STATION_TELEMETRY_FIELDS(STATION_TELEMETRY_MASK_FIELD))
+
+/**
+ * Уровни хранения; STATION_TELEMETRY_AUTO - выбор уровня по диапазону и шагу
+ */
+typedef enum {
+    STATION_TELEMETRY_AUTO = -1,
+    STATION_TELEMETRY_RAW,
+    STATION_TELEMETRY_MINUTE,
+    STATION_TELEMETRY_HOUR,
+    STATION_TELEMETRY_TIERS
+} station_telemetry_tier_t;
+
+/**
+ * Результат запроса: точки по шагу (начало интервала, среднее, минимум и
+ * максимум), интервалы без измерений пропускаются
+ */
+typedef struct {
+    station_telemetry_tier_t tier;  // уровень, из которого прочитаны точки
+    int count;
+    int capacity;
+    int64_t *timestamps;
+    float *values[STATION_TELEMETRY_METRICS];
+    float *min[STATION_TELEMETRY_METRICS];
+    float *max[STATION_TELEMETRY_METRICS];
+} station_telemetry_series_t;
+
+// Запись измерения с текущими значениями станции (время в мс с эпохи Unix)
+int station_telemetry_record(const charging_station_t *station, int64_t timestamp_ms);
+
+// Удаление истории станции
+void station_telemetry_remove(int id);
+void station_telemetry_cleanup(void);
+
+// Сведение строк уровня tier из [from_ms, to_ms] по интервалам step_ms
+// (границы и шаг до STATION_TELEMETRY_MAX_TIMESTAMP_MS, иначе -1).
+// При STATION_TELEMETRY_AUTO берется самый грубый уровень, не грубее шага,
+// или более грубый, если начало диапазона старше хранения уровня
+int station_telemetry_query(int id, station_telemetry_tier_t tier, int64_t from_ms, int64_t to_ms,
+                            int64_t step_ms, station_telemetry_series_t *series);
+void station_telemetry_series_free(station_telemetry_series_t *series);
+
+/**
+ * Сохранение истории в файл (пишет storage_simple.c при уплотнении).
+ * Файл - последовательность записей: закрытые блоки попадают в него один
+ * раз, дописываясь к концу, а за ними каждый раз следует контрольная точка -
+ * незаполненные блоки, открытые интервалы агрегатов и номер сегмента
+ * журнала изменений, начиная с которого измерения восстанавливаются из
+ * журнала. Когда вытесненные блоки и старые контрольные точки занимают
+ * больше половины файла, он переписывается целиком
+ */
+#define STATION_TELEMETRY_FILE_SLACK (1024 * 1024)
+
+struct telemetry_capture;
+
+typedef struct {
+    uint8_t *data;                    // записи для файла
+    size_t length;
+    int rewrite;                      // 1 - data заменяет файл, 0 - дописывается к нему
+    struct telemetry_capture *state;
+} station_telemetry_capture_t;
+
+// Состояние историй под блокировкой чтения станций, вместе с ротацией
+// журнала: измерения из сегментов от wal_segment в него не входят
+int station_telemetry_capture(station_telemetry_capture_t *capture, unsigned long wal_segment);
+
+// Сборка записей вне блокировки станций; file_length - текущий размер файла
+int station_telemetry_capture_records(station_telemetry_capture_t *capture, size_t file_length);
+
+// Записи на диске: закрытые блоки больше не дописываются
+void station_telemetry_capture_commit(station_telemetry_capture_t *capture);
+void station_telemetry_capture_free(station_telemetry_capture_t *capture);
+
+// Восстановление историй при запуске, до журнала изменений. В wal_segment -
+// первый сегмент, измерения из которого записываются в историю заново
+// (0 - контрольной точки нет), в valid_length - длина файла до конца
+// последней контрольной точки (дальше - оборванная запись)
+int station_telemetry_restore(const void *data, size_t length, unsigned long *wal_segment, size_t *valid_length);
+
+// Удаление историй станций, для которых keep вернул 0
+void station_telemetry_prune(int (*keep)(int id, void *ctx), void *ctx);
+
+// Ключ JSON метрики по номеру
+const char* station_telemetry_metric_key(int metric);
+
+// Имя уровня ("raw", "minute", "hour") и обратно (-1 - неизвестное имя)
+const char* station_telemetry_tier_name(station_telemetry_tier_t tier);
+int station_telemetry_tier_parse(const char *name, station_telemetry_tier_t *tier);
+
+#endif // STATION_TELEMETRY_H
@@ -6,6 +6,8 @@
 #ifndef STORAGE_H
 #define STORAGE_H
 
+#include <stdint.h>
+
 #include "simple_json.h"
 
 // Максимальные размеры строк
@@ -49,8 +51,59 @@ typedef struct {
     int single_phase_connection;
     int power_overconsumption;
     int fixed_power;
+
+    // Версия записи (растет при каждом изменении), основа ETag
+    unsigned long version;
 } charging_station_t;
 
+/**
+ * Таблица полей станции: единственное описание соответствия структуры
+ * и JSON. Из нее генерируются сериализация, разбор и маски полей.
+ * F(вид, ключ JSON, поле структуры), порядок задает порядок ключей в JSON:
+ *   ID         - целочисленный идентификатор (выводится как число)
+ *   STRING     - строка, выводится всегда
+ *   STRING_OPT - строка, пропускается если пустая
+ *   FLOAT      - число
+ *   BOOL       - логическое значение (хранится как int)
+ */
+#define STATION_FIELDS(F) \
+    F(ID,         "id",                       id) \
+    F(STRING,     "displayName",              display_name) \
+    F(STRING,     "technicalName",            technical_name) \
+    F(STRING,     "type",                     type) \
+    F(STRING,     "status",                   status) \
+    F(FLOAT,      "maxPower",                 max_power) \
+    F(FLOAT,      "currentPower",             current_power) \
+    F(STRING_OPT, "ipAddress",                ip_address) \
+    F(STRING_OPT, "description",              description) \
+    F(BOOL,       "carConnection",            car_connection) \
+    F(BOOL,       "carChargingPermission",    car_charging_permission) \
+    F(BOOL,       "carError",                 car_error) \
+    F(BOOL,       "masterOnline",             master_online) \
+    F(BOOL,       "masterChargingPermission", master_charging_permission) \
+    F(FLOAT,      "masterAvailablePower",     master_available_power) \
+    F(FLOAT,      "voltagePhase1",            voltage_phase1) \
+    F(FLOAT,      "voltagePhase2",            voltage_phase2) \
+    F(FLOAT,      "voltagePhase3",            voltage_phase3) \
+    F(FLOAT,      "currentPhase1",            current_phase1) \
+    F(FLOAT,      "currentPhase2",            current_phase2) \
+    F(FLOAT,      "currentPhase3",            current_phase3) \
+    F(FLOAT,      "chargerPower",             charger_power) \
+    F(BOOL,       "singlePhaseConnection",    single_phase_connection) \
+    F(BOOL,       "powerOverconsumption",     power_overconsumption) \
+    F(BOOL,       "fixedPower",               fixed_power)
+
+/**
+ * Номера полей и битовые маски наборов полей
+ */
+#define STATION_FIELD_ENUM(kind, key, member) STATION_FIELD_INDEX_##member,
+enum { STATION_FIELDS(STATION_FIELD_ENUM) STATION_FIELD_COUNT };
+#undef STATION_FIELD_ENUM
+
+typedef uint32_t station_field_mask_t;
+#define STATION_FIELD(member) ((station_field_mask_t)1 << STATION_FIELD_INDEX_##member)
+#define STATION_FIELDS_ALL ((station_field_mask_t)((1ull << STATION_FIELD_COUNT) - 1))
+
 /**
  * Структура для хранения массива станций
  */
@@ -60,20 +113,73 @@ typedef struct {
     int capacity;
 } stations_array_t;
 
+/**
+ * Неизменяемый снимок списка станций. Читатель держит ссылку, пока
+ * использует данные; изменения хранилища создают новый снимок, не затрагивая
+ * уже выданные
+ */
+struct stations_index;
+
+typedef struct {
+    unsigned long version; // версия коллекции, из которой собран снимок
+    unsigned long layout;  // версия состава станций: при равной версии номера станций совпадают
+    int count;
+    int refcount;
+    struct stations_index *index; // индексы по id, status и type (строятся при первой выборке
+                                  // или переносятся из предыдущего снимка)
+    charging_station_t stations[];
+} stations_snapshot_t;
+
+/**
+ * Выборка из снимка: станции с заданными status и type (NULL - любые)
+ * в порядке возрастания id, начиная после after_id
+ */
+typedef struct {
+    const char *status;
+    const char *type;
+    int after_id;   // курсор: id последней станции предыдущей страницы (0 - с начала)
+    int limit;      // 0 - без ограничения
+} stations_query_t;
+
+/**
+ * Изменение одной станции в пакете storage_update_stations
+ */
+typedef struct {
+    int id;
+    station_field_mask_t fields;
+    charging_station_t values;
+} station_update_t;
+
+// Уплотнение журнала изменений: по размеру журнала и по времени
+#define STORAGE_COMPACT_BYTES (8 * 1024 * 1024)
+#define STORAGE_COMPACT_INTERVAL_S 300
+
 // Функции инициализации и очистки
+void storage_set_data_file_path(const char *path);
+void storage_set_wal_commit_ms(int commit_ms);
+void storage_set_binary_snapshot(int enabled);
+void storage_set_replica_path(const char *path);
 int storage_init(void);
 void storage_cleanup(void);
 
 // CRUD операции для зарядных станций
 int storage_get_stations(stations_array_t *stations);
+const stations_snapshot_t* storage_acquire_stations(void);
+void storage_release_stations(const stations_snapshot_t *snapshot);
+int storage_select_stations(const stations_snapshot_t *snapshot, const stations_query_t *query,
+                            int *positions, int *next_cursor);
 int storage_get_station(int id, charging_station_t *station);
 int storage_create_station(const charging_station_t *station, int *new_id);
 int storage_delete_station(int id);
-int storage_update_station(int id, const charging_station_t *updates);
+int storage_update_station(int id, const charging_station_t *updates, station_field_mask_t fields);
+int storage_update_stations(const station_update_t *updates, int count);
+
+// Версии данных для условных запросов (ETag)
+#define STORAGE_ETAG_SIZE 64
+unsigned long storage_get_stations_version(void);
+void storage_stations_etag(unsigned long version, char *etag, size_t size);
+void storage_station_etag(const charging_station_t *station, char *etag, size_t size);
 
-// Утилиты для работы с JSON
-json_value_t* station_to_json(const charging_station_t *station);
-int station_from_json(const json_value_t *json, charging_station_t *station);
 void stations_array_free(stations_array_t *stations);
 
 // Валидация данных
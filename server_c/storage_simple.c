@@ -4,21 +4,111 @@
  */
 
 #include "storage.h"
+#include "station_codec.h"
+#include "station_index.h"
+#include "storage_wal.h"
+#include "station_binary.h"
+#include "station_telemetry.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <sys/stat.h>
 #include <errno.h>
 #include <time.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/uio.h>
 
 // Глобальные переменные для хранения данных в памяти
 static char data_file_path[512] = "../data/stations.json";
 static int next_id = 1;
+static int data_initialized = 0;
+
+// Станции лежат в слотах массива; слот удаленной станции помечается id = 0
+// и попадает в список свободных, поэтому удаление не сдвигает массив.
+// global_stations_count - число занятых когда-либо слотов, live_stations_count -
+// число существующих станций
 static charging_station_t* global_stations = NULL;
 static int global_stations_count = 0;
 static int global_stations_capacity = 0;
-static int data_initialized = 0;
+static int live_stations_count = 0;
+
+static int *free_slots = NULL;
+static int free_slots_count = 0;
+static int free_slots_capacity = 0;
+
+// Индекс id -> слот
+static station_index_t station_index = {0};
+
+// Необязательный бинарный снимок рядом с файлом станций (<файл>.bin).
+// Если станции загружены из него, global_stations указывает внутрь отображения
+static int binary_enabled = 0;
+static char binary_path[sizeof(data_file_path) + 8];
+static station_binary_map_t binary_map = {0};
+
+// Версия коллекции станций и время запуска: ETag из одного счетчика мог бы
+// совпасть с ETag, выданным до перезапуска сервера для других данных
+static unsigned long stations_version = 0;
+static time_t storage_epoch = 0;
+
+// Версия состава станций (создание, удаление, сброс): пока она не менялась,
+// станция занимает в снимках одно и то же место, и индексы снимка
+// переносятся в следующий с поправкой на изменившиеся status и type
+static unsigned long stations_layout = 0;
+
+// Данные станций, индекс, список свободных слотов и next_id защищены
+// блокировкой: читатели берут ее на время копирования станции, писатели -
+// на время изменения. Писатели имеют приоритет, поэтому поток GET запросов
+// не может бесконечно откладывать PATCH
+static pthread_rwlock_t stations_lock = PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
+static pthread_once_t stations_once = PTHREAD_ONCE_INIT;
+
+// Последний опубликованный снимок списка (одна ссылка принадлежит кэшу).
+// snapshot_lock охраняет только указатель и захват ссылки; сборку нового
+// снимка выполняет один поток, остальные ждут его на snapshot_build_lock
+static stations_snapshot_t *current_snapshot = NULL;
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t snapshot_build_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Изменения пишутся в журнал (storage_wal.c); полный файл станций
+// перезаписывается потоком уплотнения, после чего старые сегменты удаляются
+static int wal_commit_ms = STORAGE_WAL_COMMIT_MS;
+static pthread_t compactor_thread;
+static pthread_mutex_t compact_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t compact_cond = PTHREAD_COND_INITIALIZER;
+static int compact_requested = 0;
+static int compact_stop = 0;
+static int compactor_running = 0;
+
+// Уплотнения (поток и save_global_stations_to_file) выполняются по одному:
+// иначе более старый снимок мог бы лечь на диск после удаления сегментов
+// журнала, которые покрыты только более новым
+static pthread_mutex_t compact_run_lock = PTHREAD_MUTEX_INITIALIZER;
+// После storage_cleanup уплотнения не выполняются (под compact_run_lock)
+static int compact_closed = 0;
+
+// Файл истории телеметрии (<файл>.telemetry, см. station_telemetry.h).
+// Измерения из сегментов журнала от telemetry_segment при восстановлении
+// записываются в историю заново. telemetry_file_dirty - после неудачной
+// дозаписи хвост файла не удалось отрезать, следующая запись переписывает файл
+static char telemetry_path[sizeof(data_file_path) + 16];
+static unsigned long telemetry_segment = 0;
+static int telemetry_file_dirty = 0;
+
+// Необязательная копия файла станций (например, на другом диске). Пишется
+// отдельным потоком после основного файла и не задерживает уплотнение
+static char replica_path[sizeof(data_file_path)];
+static int replica_enabled = 0;
+static char *replica_data = NULL;
+static size_t replica_length = 0;
+static int replica_stop = 0;
+static pthread_t replica_thread;
+static pthread_mutex_t replica_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t replica_cond = PTHREAD_COND_INITIALIZER;
+static void* replica_writer(void *arg);
 
 /**
  * Создает папку для данных если она не существует
@@ -38,544 +128,1683 @@ static int ensure_data_directory(void) {
 }
 
 /**
- * Загрузка данных из JSON файла
+ * Изменение емкости массива станций. Массив внутри отображения бинарного
+ * снимка не растет: при первом росте станции переносятся в кучу
  */
-static int load_json_data(void) {
-    FILE *file = fopen(data_file_path, "r");
-    if (!file) {
-        printf("Файл данных не найден, создаем новый\n");
-        // Создаем пустой файл с массивом
-        if (ensure_data_directory() == 0) {
-            file = fopen(data_file_path, "w");
-            if (file) {
-                fprintf(file, "[]");
-                fclose(file);
-            }
+static int stations_resize(int capacity) {
+    charging_station_t *stations;
+    
+    if (binary_map.base) {
+        stations = malloc(capacity * sizeof(charging_station_t));
+        if (!stations) {
+            return -1;
+        }
+        memcpy(stations, global_stations, global_stations_count * sizeof(charging_station_t));
+        station_binary_close(&binary_map);
+    } else {
+        stations = realloc(global_stations, capacity * sizeof(charging_station_t));
+        if (!stations) {
+            return -1;
         }
-        return 0;
     }
     
-    // Получаем размер файла
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    if (file_size <= 0) {
-        fclose(file);
-        return 0;
+    global_stations = stations;
+    global_stations_capacity = capacity;
+    return 0;
+}
+
+/**
+ * Освобождение массива станций и индекса (очистка и неудачная загрузка)
+ */
+static void stations_reset(void) {
+    if (binary_map.base) {
+        station_binary_close(&binary_map);
+    } else {
+        free(global_stations);
     }
+    global_stations = NULL;
+    global_stations_count = 0;
+    global_stations_capacity = 0;
+    live_stations_count = 0;
+    next_id = 1;
+    stations_layout++;
+    station_index_destroy(&station_index);
+}
+
+/**
+ * Размещение станции в слоте и добавление в индекс: слот берется из списка
+ * освобожденных или в конце массива. Возвращает номер слота
+ */
+static int station_slot_insert(const charging_station_t *station) {
+    int slot;
+    int reused = free_slots_count > 0;
     
-    // Упрощенный подсчет станций по вхождениям "id"
-    char *json_string = malloc(file_size + 1);
-    if (!json_string) {
-        fclose(file);
-        return -1;
+    if (reused) {
+        slot = free_slots[--free_slots_count];
+    } else {
+        if (global_stations_count == global_stations_capacity) {
+            int capacity = global_stations_capacity ? global_stations_capacity * 2 : 16;
+            if (stations_resize(capacity) != 0) {
+                return -1;
+            }
+        }
+        slot = global_stations_count++;
     }
     
-    size_t read_size = fread(json_string, 1, file_size, file);
-    json_string[read_size] = '\0';
-    fclose(file);
-    
-    int count = 0;
-    char *pos = json_string;
-    while ((pos = strstr(pos, "\"id\":")) != NULL) {
-        pos += 5;
-        int id = atoi(pos);
-        if (id >= next_id) {
-            next_id = id + 1;
+    if (station_index_put(&station_index, station->id, slot) != 0) {
+        if (reused) {
+            free_slots_count++;
+        } else {
+            global_stations_count--;
         }
-        count++;
+        return -1;
     }
     
-    printf("Загружено %d станций из файла\n", count);
-    free(json_string);
-    return 0;
+    global_stations[slot] = *station;
+    live_stations_count++;
+    stations_layout++;
+    if (station->id >= next_id) {
+        next_id = station->id + 1;
+    }
+    return slot;
 }
 
 /**
- * Инициализация системы хранения данных
+ * Удаление станции из индекса с освобождением слота
  */
-int storage_init(void) {
-    if (ensure_data_directory() != 0) {
+/**
+ * Место для еще одного свободного слота: после него station_slot_remove
+ * существующей станции не отказывает
+ */
+static int free_slots_reserve(void) {
+    if (free_slots_count == free_slots_capacity) {
+        int capacity = free_slots_capacity ? free_slots_capacity * 2 : 16;
+        int *slots = realloc(free_slots, capacity * sizeof(int));
+        if (!slots) {
+            return -1;
+        }
+        free_slots = slots;
+        free_slots_capacity = capacity;
+    }
+    return 0;
+}
+
+static int station_slot_remove(int id) {
+    // Место в списке свободных резервируется до изменения индекса
+    if (free_slots_reserve() != 0) {
+        return -1;
+    }
+    
+    int slot = station_index_remove(&station_index, id);
+    if (slot < 0) {
         return -1;
     }
     
-    return load_json_data();
+    global_stations[slot].id = 0;
+    free_slots[free_slots_count++] = slot;
+    live_stations_count--;
+    stations_layout++;
+    return slot;
 }
 
+static int write_stations_file(const stations_snapshot_t *snapshot);
+static int write_telemetry_file(station_telemetry_capture_t *capture);
+static stations_snapshot_t* snapshot_build(void);
+static void stations_index_free(struct stations_index *index);
+static void snapshot_carry_index(stations_snapshot_t *snapshot, const stations_snapshot_t *previous);
+
 /**
- * Очистка ресурсов системы хранения
+ * Применение полей из маски к станции
  */
-void storage_cleanup(void) {
-    printf("Система хранения очищена\n");
+static void station_apply_fields(charging_station_t *current, const charging_station_t *updates,
+                                 station_field_mask_t fields) {
+#define STATION_APPLY_FIELD(kind, key, member) \
+    if (fields & STATION_FIELD(member)) { \
+        memcpy(&current->member, &updates->member, sizeof(current->member)); \
+    }
+    STATION_FIELDS(STATION_APPLY_FIELD)
+#undef STATION_APPLY_FIELD
 }
 
+// Время измерения в записи изменения (после полей станции, см. storage_log_change)
+#define STORAGE_TELEMETRY_KEY "\"telemetryAt\":"
+
 /**
- * Преобразование структуры станции в JSON
+ * Восстановление записи журнала при запуске. Записи применяются повторно
+ * поверх снимка, который может уже содержать их результат, поэтому
+ * создание существующей станции заменяет ее, а удаление отсутствующей
+ * ничего не делает. Измерения попадают в историю заново только из
+ * сегментов после ее контрольной точки
  */
-json_value_t* station_to_json(const charging_station_t *station) {
-    json_value_t *json = json_create_object();
-    if (!json) return NULL;
-    
-    json_object_set(json, "id", json_create_number(station->id));
-    json_object_set(json, "displayName", json_create_string(station->display_name));
-    json_object_set(json, "technicalName", json_create_string(station->technical_name));
-    json_object_set(json, "type", json_create_string(station->type));
-    json_object_set(json, "status", json_create_string(station->status));
-    
-    if (strlen(station->ip_address) > 0) {
-        json_object_set(json, "ipAddress", json_create_string(station->ip_address));
-    }
+static int storage_replay_record(char op, const char *json, unsigned long segment, void *ctx) {
+    (void)ctx;
     
-    if (strlen(station->description) > 0) {
-        json_object_set(json, "description", json_create_string(station->description));
+    charging_station_t record = {0};
+    station_field_mask_t fields = 0;
+    if (station_read_json(json, NULL, &record, &fields) != STATION_CODEC_OK ||
+        !(fields & STATION_FIELD(id)) || record.id <= 0) {
+        return -1;
     }
     
-    json_object_set(json, "maxPower", json_create_number(station->max_power));
-    json_object_set(json, "currentPower", json_create_number(station->current_power));
-    
-    // Данные для slave-станций
-    json_object_set(json, "carConnection", json_create_bool(station->car_connection));
-    json_object_set(json, "carChargingPermission", json_create_bool(station->car_charging_permission));
-    json_object_set(json, "carError", json_create_bool(station->car_error));
-    json_object_set(json, "masterOnline", json_create_bool(station->master_online));
-    json_object_set(json, "masterChargingPermission", json_create_bool(station->master_charging_permission));
-    json_object_set(json, "masterAvailablePower", json_create_number(station->master_available_power));
-    
-    // Электрические параметры
-    json_object_set(json, "voltagePhase1", json_create_number(station->voltage_phase1));
-    json_object_set(json, "voltagePhase2", json_create_number(station->voltage_phase2));
-    json_object_set(json, "voltagePhase3", json_create_number(station->voltage_phase3));
-    json_object_set(json, "currentPhase1", json_create_number(station->current_phase1));
-    json_object_set(json, "currentPhase2", json_create_number(station->current_phase2));
-    json_object_set(json, "currentPhase3", json_create_number(station->current_phase3));
-    json_object_set(json, "chargerPower", json_create_number(station->charger_power));
+    unsigned long version = ++stations_version;
+    int slot = station_index_find(&station_index, record.id);
     
-    // Дополнительные параметры
-    json_object_set(json, "singlePhaseConnection", json_create_bool(station->single_phase_connection));
-    json_object_set(json, "powerOverconsumption", json_create_bool(station->power_overconsumption));
-    json_object_set(json, "fixedPower", json_create_bool(station->fixed_power));
-    
-    return json;
+    switch (op) {
+        case STORAGE_WAL_CREATE:
+            record.version = version;
+            if (slot >= 0) {
+                global_stations[slot] = record;
+                return 0;
+            }
+            return station_slot_insert(&record) < 0 ? -1 : 0;
+            
+        case STORAGE_WAL_UPDATE:
+            if (slot >= 0) {
+                station_apply_fields(&global_stations[slot], &record, fields & ~STATION_FIELD(id));
+                global_stations[slot].version = version;
+                
+                const char *at = strstr(json, STORAGE_TELEMETRY_KEY);
+                if (at && (fields & STATION_TELEMETRY_MASK) && segment >= telemetry_segment) {
+                    station_telemetry_record(&global_stations[slot],
+                                             strtoll(at + strlen(STORAGE_TELEMETRY_KEY), NULL, 10));
+                }
+            }
+            return 0;
+            
+        case STORAGE_WAL_DELETE:
+            if (slot >= 0) {
+                station_slot_remove(record.id);
+            }
+            station_telemetry_remove(record.id);
+            return 0;
+    }
+    return -1;
 }
 
 /**
- * Преобразование JSON в структуру станции (только для переданных полей)
+ * Запись изменения в журнал. Вызывается под блокировкой записи, поэтому
+ * порядок записей в журнале совпадает с порядком изменений в памяти.
+ * telemetry_ms - время измерения, записанного в историю (0 - не записано):
+ * по нему история восстанавливается из журнала
  */
-int station_from_json(const json_value_t *json, charging_station_t *station) {
-    if (!json || !station) return -1;
+static unsigned long long storage_log_change(char op, const charging_station_t *station,
+                                             station_field_mask_t fields, int64_t telemetry_ms) {
+    json_buf_t buf;
+    json_buf_init(&buf, 2048);
+    station_write_json_fields(&buf, station, fields | STATION_FIELD(id));
     
-    // Инициализируем только обнуляемые поля, не все поля
-    memset(station, 0, sizeof(charging_station_t));
-    
-    // Парсим только переданные поля из JSON
-    if (json->type == JSON_OBJECT) {
-        json_value_t *value;
-        
-        if ((value = json_object_get(json, "displayName"))) {
-            const char* str_val = json_get_string(value);
-            if (str_val) {
-                strncpy(station->display_name, str_val, MAX_STRING_LENGTH - 1);
-            }
-        }
-        
-        if ((value = json_object_get(json, "technicalName"))) {
-            const char* str_val = json_get_string(value);
-            if (str_val) {
-                strncpy(station->technical_name, str_val, MAX_STRING_LENGTH - 1);
-            }
-        }
-        
-        if ((value = json_object_get(json, "type"))) {
-            const char* str_val = json_get_string(value);
-            if (str_val) {
-                strncpy(station->type, str_val, MAX_STRING_LENGTH - 1);
-            }
-        }
-        
-        if ((value = json_object_get(json, "status"))) {
-            const char* str_val = json_get_string(value);
-            if (str_val) {
-                strncpy(station->status, str_val, MAX_STRING_LENGTH - 1);
-            }
-        }
-        
-        if ((value = json_object_get(json, "description"))) {
-            const char* str_val = json_get_string(value);
-            if (str_val) {
-                strncpy(station->description, str_val, MAX_DESCRIPTION_LENGTH - 1);
-            }
-        }
-        
-        if ((value = json_object_get(json, "ipAddress"))) {
-            const char* str_val = json_get_string(value);
-            if (str_val) {
-                strncpy(station->ip_address, str_val, MAX_STRING_LENGTH - 1);
-            }
-        }
-        
-        if ((value = json_object_get(json, "maxPower"))) {
-            station->max_power = (float)json_get_number(value);
-        }
-        
-        if ((value = json_object_get(json, "currentPower"))) {
-            station->current_power = (float)json_get_number(value);
-        }
-        
-        if ((value = json_object_get(json, "chargerPower"))) {
-            station->charger_power = (float)json_get_number(value);
-        }
-        
-        if ((value = json_object_get(json, "masterAvailablePower"))) {
-            station->master_available_power = (float)json_get_number(value);
-        }
-        
-        if ((value = json_object_get(json, "voltagePhase1"))) {
-            station->voltage_phase1 = (float)json_get_number(value);
-        }
-        
-        if ((value = json_object_get(json, "voltagePhase2"))) {
-            station->voltage_phase2 = (float)json_get_number(value);
-        }
-        
-        if ((value = json_object_get(json, "voltagePhase3"))) {
-            station->voltage_phase3 = (float)json_get_number(value);
-        }
-        
-        if ((value = json_object_get(json, "currentPhase1"))) {
-            station->current_phase1 = (float)json_get_number(value);
-        }
-        
-        if ((value = json_object_get(json, "currentPhase2"))) {
-            station->current_phase2 = (float)json_get_number(value);
-        }
-        
-        if ((value = json_object_get(json, "currentPhase3"))) {
-            station->current_phase3 = (float)json_get_number(value);
-        }
-        
-        if ((value = json_object_get(json, "carConnection"))) {
-            station->car_connection = json_get_bool(value);
-        }
-        
-        if ((value = json_object_get(json, "carChargingPermission"))) {
-            station->car_charging_permission = json_get_bool(value);
-        }
-        
-        if ((value = json_object_get(json, "carError"))) {
-            station->car_error = json_get_bool(value);
-        }
-        
-        if ((value = json_object_get(json, "masterOnline"))) {
-            station->master_online = json_get_bool(value);
-        }
-        
-        if ((value = json_object_get(json, "masterChargingPermission"))) {
-            station->master_charging_permission = json_get_bool(value);
-        }
-        
-        if ((value = json_object_get(json, "singlePhaseConnection"))) {
-            station->single_phase_connection = json_get_bool(value);
-        }
-        
-        if ((value = json_object_get(json, "powerOverconsumption"))) {
-            station->power_overconsumption = json_get_bool(value);
-        }
-        
-        if ((value = json_object_get(json, "fixedPower"))) {
-            station->fixed_power = json_get_bool(value);
-        }
+    if (telemetry_ms > 0 && !buf.failed && buf.length > 0) {
+        char at[48];
+        int length = snprintf(at, sizeof(at), "," STORAGE_TELEMETRY_KEY "%lld}", (long long)telemetry_ms);
+        buf.length--;   // закрывающая скобка объекта
+        json_buf_append(&buf, at, (size_t)length);
     }
     
-    return 0;
+    unsigned long long lsn = buf.failed ? 0 : storage_wal_append(op, buf.data, buf.length);
+    json_buf_free(&buf);
+    return lsn;
+}
+
+static void storage_request_compaction(void) {
+    pthread_mutex_lock(&compact_lock);
+    compact_requested = 1;
+    pthread_cond_signal(&compact_cond);
+    pthread_mutex_unlock(&compact_lock);
 }
 
 /**
- * Инициализация глобальных данных станций
+ * Ожидание фиксации изменения в журнале (вне блокировки станций: пока
+ * запрос ждет fdatasync, другие изменения попадают в ту же группу)
  */
-static void initialize_global_stations(void) {
-    if (data_initialized) return;
-    
-    global_stations_capacity = 2;
-    global_stations = malloc(global_stations_capacity * sizeof(charging_station_t));
-    if (!global_stations) {
-        printf("Ошибка выделения памяти для станций\n");
-        return;
+static int storage_commit_change(unsigned long long lsn) {
+    if (storage_wal_commit(lsn) != 0) {
+        printf("ERROR: Изменение не записано в журнал\n");
+        return -1;
     }
     
-    global_stations_count = 2;
-    
-    // Первая станция
-    memset(&global_stations[0], 0, sizeof(charging_station_t));
-    global_stations[0].id = 1;
-    strcpy(global_stations[0].display_name, "Тестовая ESP32");
-    strcpy(global_stations[0].technical_name, "ESP32-001");
-    strcpy(global_stations[0].type, "slave");
-    strcpy(global_stations[0].status, "available");
-    global_stations[0].max_power = 22.0;
-    global_stations[0].current_power = 0.0;
-    
-    // Вторая станция
-    memset(&global_stations[1], 0, sizeof(charging_station_t));
-    global_stations[1].id = 2;
-    strcpy(global_stations[1].display_name, "Главная станция");
-    strcpy(global_stations[1].technical_name, "MASTER-001");
-    strcpy(global_stations[1].type, "master");
-    strcpy(global_stations[1].status, "online");
-    global_stations[1].max_power = 50.0;
-    global_stations[1].current_power = 15.5;
-    
-    data_initialized = 1;
-    printf("Инициализированы глобальные данные станций (%d станций)\n", global_stations_count);
+    if (storage_wal_size() >= STORAGE_COMPACT_BYTES) {
+        storage_request_compaction();
+    }
+    return 0;
 }
 
 /**
- * Получение всех зарядных станций из глобальной памяти
+ * Уплотнение: снимок станций, ротация журнала и снимок истории телеметрии
+ * выполняются под блокировкой чтения (без параллельных изменений), запись
+ * файлов - уже без нее. Сегменты журнала до ротации удаляются только после
+ * записи обоих файлов: по ним восстанавливаются и станции, и история
  */
-int storage_get_stations(stations_array_t *stations) {
-    initialize_global_stations();
-    
-    // Выделяем память и копируем данные из глобального хранилища
-    stations->stations = malloc(global_stations_count * sizeof(charging_station_t));
-    if (!stations->stations) {
+static int storage_compact(void) {
+    pthread_mutex_lock(&compact_run_lock);
+    if (compact_closed) {
+        pthread_mutex_unlock(&compact_run_lock);
         return -1;
     }
     
-    stations->count = global_stations_count;
-    stations->capacity = global_stations_count;
+    pthread_rwlock_rdlock(&stations_lock);
+    stations_snapshot_t *snapshot = snapshot_build();
+    unsigned long segment = snapshot ? storage_wal_rotate() : 0;
+    station_telemetry_capture_t telemetry = {0};
+    int captured = segment > 0 && station_telemetry_capture(&telemetry, segment) == 0;
+    pthread_rwlock_unlock(&stations_lock);
     
-    // Копируем данные из глобального хранилища
-    for (int i = 0; i < global_stations_count; i++) {
-        memcpy(&stations->stations[i], &global_stations[i], sizeof(charging_station_t));
+    int result = -1;
+    if (captured) {
+        result = write_stations_file(snapshot);
+        if (result == 0) {
+            result = write_telemetry_file(&telemetry);
+        }
+        if (result == 0) {
+            storage_wal_remove_before(segment);
+        }
     }
     
-    return 0;
+    station_telemetry_capture_free(&telemetry);
+    if (snapshot) {
+        storage_release_stations(snapshot);
+    }
+    pthread_mutex_unlock(&compact_run_lock);
+    return result;
 }
 
 /**
- * Получение зарядной станции по ID из глобальной памяти
+ * Поток уплотнения: по запросу (журнал вырос) или раз в интервал, если
+ * с прошлого уплотнения были изменения
  */
-int storage_get_station(int id, charging_station_t *station) {
-    initialize_global_stations();
+static void* storage_compactor(void *arg) {
+    (void)arg;
     
-    for (int i = 0; i < global_stations_count; i++) {
-        if (global_stations[i].id == id) {
-            memcpy(station, &global_stations[i], sizeof(charging_station_t));
-            return 0;
+    pthread_mutex_lock(&compact_lock);
+    while (!compact_stop) {
+        if (!compact_requested) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += STORAGE_COMPACT_INTERVAL_S;
+            pthread_cond_timedwait(&compact_cond, &compact_lock, &ts);
+        }
+        if (compact_stop) break;
+        
+        int requested = compact_requested;
+        compact_requested = 0;
+        pthread_mutex_unlock(&compact_lock);
+        
+        if (requested || storage_wal_size() > 0) {
+            if (storage_compact() != 0) {
+                printf("ERROR: Не удалось уплотнить журнал изменений\n");
+            }
         }
+        
+        pthread_mutex_lock(&compact_lock);
     }
-    
-    return -1;
+    pthread_mutex_unlock(&compact_lock);
+    return NULL;
+}
+
+// Оценка объема станции в файле для предварительного выделения массива.
+// Станция с обязательными полями в формате write_stations_file занимает
+// больше, поэтому массив по оценке почти никогда не растет во время загрузки
+#define STATION_JSON_ESTIMATE 400
+
+// Ошибка проверки станции при загрузке (ошибки разбора - STATION_CODEC_*)
+#define STORAGE_LOAD_INVALID -3
+
+static double storage_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
 }
 
 /**
- * Создание новой зарядной станции
+ * Состояние загрузки файла станций
  */
-int storage_create_station(const charging_station_t *station, int *new_id) {
-    *new_id = next_id++;
-    printf("Создана новая станция с ID %d\n", *new_id);
-    return 0;
-}
+typedef struct {
+    int count;
+    char error[128];
+} storage_load_t;
 
 /**
- * Обновление зарядной станции в глобальной памяти
+ * Проверка и размещение станции из файла
  */
-int storage_update_station(int id, const charging_station_t *updates) {
-    printf("DEBUG: storage_update_station called for ID %d\n", id);
-    initialize_global_stations();
+static int load_station(const charging_station_t *station, station_field_mask_t present, void *ctx) {
+    storage_load_t *load = ctx;
     
-    // Ищем станцию с нужным ID в глобальном хранилище
-    for (int i = 0; i < global_stations_count; i++) {
-        if (global_stations[i].id == id) {
-            printf("DEBUG: Found station with ID %d at index %d\n", id, i);
-            printf("DEBUG: Old data: name='%s', maxPower=%.2f\n", 
-                   global_stations[i].display_name, global_stations[i].max_power);
-            
-            charging_station_t *current = &global_stations[i];
-            
-            // Селективно обновляем только переданные поля
-            if (strlen(updates->display_name) > 0) {
-                strncpy(current->display_name, updates->display_name, sizeof(current->display_name) - 1);
-                current->display_name[sizeof(current->display_name) - 1] = '\0';
-            }
-            if (strlen(updates->technical_name) > 0) {
-                strncpy(current->technical_name, updates->technical_name, sizeof(current->technical_name) - 1);
-                current->technical_name[sizeof(current->technical_name) - 1] = '\0';
-            }
-            if (strlen(updates->type) > 0) {
-                strncpy(current->type, updates->type, sizeof(current->type) - 1);
-                current->type[sizeof(current->type) - 1] = '\0';
-            }
-            if (strlen(updates->status) > 0) {
-                strncpy(current->status, updates->status, sizeof(current->status) - 1);
-                current->status[sizeof(current->status) - 1] = '\0';
-            }
-            if (strlen(updates->description) > 0) {
-                strncpy(current->description, updates->description, sizeof(current->description) - 1);
-                current->description[sizeof(current->description) - 1] = '\0';
-            }
-            if (strlen(updates->ip_address) > 0) {
-                strncpy(current->ip_address, updates->ip_address, sizeof(current->ip_address) - 1);
-                current->ip_address[sizeof(current->ip_address) - 1] = '\0';
-            }
-            
-            // Числовые поля обновляем только если они не равны 0
-            if (updates->max_power != 0.0f) {
-                current->max_power = updates->max_power;
-            }
-            if (updates->current_power != current->current_power) {
-                current->current_power = updates->current_power;
-            }
-            if (updates->charger_power != 0.0f) {
-                current->charger_power = updates->charger_power;
-            }
-            if (updates->master_available_power != 0.0f) {
-                current->master_available_power = updates->master_available_power;
-            }
-            
-            // Параметры напряжения и тока
-            if (updates->voltage_phase1 != 0.0f) {
-                current->voltage_phase1 = updates->voltage_phase1;
-            }
-            if (updates->voltage_phase2 != 0.0f) {
-                current->voltage_phase2 = updates->voltage_phase2;
-            }
-            if (updates->voltage_phase3 != 0.0f) {
-                current->voltage_phase3 = updates->voltage_phase3;
-            }
-            if (updates->current_phase1 != 0.0f) {
-                current->current_phase1 = updates->current_phase1;
-            }
-            if (updates->current_phase2 != 0.0f) {
-                current->current_phase2 = updates->current_phase2;
-            }
-            if (updates->current_phase3 != 0.0f) {
-                current->current_phase3 = updates->current_phase3;
-            }
-            
-            printf("DEBUG: New data: name='%s', maxPower=%.2f\n", 
-                   current->display_name, current->max_power);
-            
-            // Сохраняем изменения в файл
-            if (save_global_stations_to_file() == 0) {
-                printf("Обновлена станция с ID %d в памяти и сохранена в файл\n", id);
-            } else {
-                printf("Обновлена станция с ID %d в памяти, но ошибка сохранения в файл\n", id);
-            }
-            return 0;
-        }
+    if (!(present & STATION_FIELD(id)) || station->id <= 0) {
+        snprintf(load->error, sizeof(load->error), "станция без корректного id");
+        return STORAGE_LOAD_INVALID;
+    }
+    if (station_index_find(&station_index, station->id) >= 0) {
+        snprintf(load->error, sizeof(load->error), "повторяющийся id %d", station->id);
+        return STORAGE_LOAD_INVALID;
     }
     
-    printf("DEBUG: Station with ID %d not found\n", id);
-    return -1;
+    int slot = station_slot_insert(station);
+    if (slot < 0) {
+        snprintf(load->error, sizeof(load->error), "недостаточно памяти");
+        return STORAGE_LOAD_INVALID;
+    }
+    global_stations[slot].version = stations_version;
+    load->count++;
+    return 0;
 }
 
 /**
- * Удаление зарядной станции
+ * Строка и столбец позиции в тексте (с 1, столбец в символах UTF-8)
  */
-int storage_delete_station(int id) {
-    printf("Удалена станция с ID %d\n", id);
-    return 0;
+static void text_position(const char *text, const char *at, int *line, int *column) {
+    *line = 1;
+    *column = 1;
+    for (const char *p = text; p < at; p++) {
+        if (*p == '\n') {
+            (*line)++;
+            *column = 1;
+        } else if (((unsigned char)*p & 0xC0) != 0x80) {
+            (*column)++;
+        }
+    }
 }
 
 /**
- * Сохранение глобальных данных станций в файл
+ * Чтение файла целиком в буфер, завершенный нулем (NULL - файла нет или ошибка)
  */
-int save_global_stations_to_file(void) {
-    if (!data_initialized) {
-        printf("DEBUG: Глобальные станции не инициализированы\n");
-        return -1;
+static char* read_file(const char *path, size_t *length) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
     }
     
-    json_value_t *json_array = json_create_array();
-    if (!json_array) {
-        printf("ERROR: Не удалось создать JSON массив\n");
-        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
     }
     
-    // Конвертируем все станции в JSON
-    for (int i = 0; i < global_stations_count; i++) {
-        json_value_t *station_obj = json_create_object();
-        if (!station_obj) {
-            json_free(json_array);
+    char *data = malloc(st.st_size + 1);
+    if (!data) {
+        close(fd);
+        return NULL;
+    }
+    
+    size_t total = 0;
+    while (total < (size_t)st.st_size) {
+        ssize_t n = read(fd, data + total, st.st_size - total);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        total += n;
+    }
+    close(fd);
+    
+    data[total] = '\0';
+    *length = total;
+    return data;
+}
+
+/**
+ * Загрузка станций из файла данных. Станции разбираются прямо в массив
+ * слотов, размер которого оценивается по размеру файла. Ошибка в файле
+ * останавливает запуск: иначе первое уплотнение перезаписало бы файл
+ * неполными данными
+ */
+static int load_json_file(void) {
+    double started = storage_now_ms();
+    
+    size_t length = 0;
+    char *json = read_file(data_file_path, &length);
+    if (!json) {
+        if (errno != ENOENT) {
+            printf("ERROR: Не удалось прочитать %s: %s\n", data_file_path, strerror(errno));
             return -1;
         }
-        
-        charging_station_t *station = &global_stations[i];
-        
-        json_object_set(station_obj, "id", json_create_number(station->id));
-        json_object_set(station_obj, "displayName", json_create_string(station->display_name));
-        json_object_set(station_obj, "technicalName", json_create_string(station->technical_name));
-        json_object_set(station_obj, "type", json_create_string(station->type));
-        json_object_set(station_obj, "status", json_create_string(station->status));
-        json_object_set(station_obj, "maxPower", json_create_number(station->max_power));
-        json_object_set(station_obj, "currentPower", json_create_number(station->current_power));
-        
-        if (strlen(station->ip_address) > 0) {
-            json_object_set(station_obj, "ipAddress", json_create_string(station->ip_address));
-        }
-        if (strlen(station->description) > 0) {
-            json_object_set(station_obj, "description", json_create_string(station->description));
+        printf("Файл данных не найден, создаем новый\n");
+        FILE *file = fopen(data_file_path, "w");
+        if (file) {
+            fprintf(file, "[]");
+            fclose(file);
         }
-        
-        json_object_set(station_obj, "carConnection", json_create_bool(station->car_connection));
-        json_object_set(station_obj, "carChargingPermission", json_create_bool(station->car_charging_permission));
-        json_object_set(station_obj, "carError", json_create_bool(station->car_error));
-        json_object_set(station_obj, "masterOnline", json_create_bool(station->master_online));
-        json_object_set(station_obj, "masterChargingPermission", json_create_bool(station->master_charging_permission));
-        json_object_set(station_obj, "masterAvailablePower", json_create_number(station->master_available_power));
-        
-        json_object_set(station_obj, "voltagePhase1", json_create_number(station->voltage_phase1));
-        json_object_set(station_obj, "voltagePhase2", json_create_number(station->voltage_phase2));
-        json_object_set(station_obj, "voltagePhase3", json_create_number(station->voltage_phase3));
-        json_object_set(station_obj, "currentPhase1", json_create_number(station->current_phase1));
-        json_object_set(station_obj, "currentPhase2", json_create_number(station->current_phase2));
-        json_object_set(station_obj, "currentPhase3", json_create_number(station->current_phase3));
-        json_object_set(station_obj, "chargerPower", json_create_number(station->charger_power));
-        
-        json_object_set(station_obj, "singlePhaseConnection", json_create_bool(station->single_phase_connection));
-        json_object_set(station_obj, "powerOverconsumption", json_create_bool(station->power_overconsumption));
-        json_object_set(station_obj, "fixedPower", json_create_bool(station->fixed_power));
-        
-        json_array_add(json_array, station_obj);
+        return station_index_init(&station_index, 16);
     }
     
-    // Сохраняем в оба файла
-    char *json_string = json_stringify(json_array);
-    if (!json_string) {
-        json_free(json_array);
+    size_t expected = length / STATION_JSON_ESTIMATE + 16;
+    global_stations = malloc(expected * sizeof(charging_station_t));
+    if (!global_stations || station_index_init(&station_index, expected) != 0) {
+        printf("ERROR: Недостаточно памяти для %zu станций\n", expected);
+        free(json);
         return -1;
     }
+    global_stations_capacity = expected;
     
-    int result = 0;
+    // Пустой файл равносилен пустому массиву
+    storage_load_t load = {0};
+    const char *error_at = json;
+    int result = length > 0 ? stations_read_json(json, load_station, &load, &error_at) : STATION_CODEC_OK;
+    if (result != STATION_CODEC_OK) {
+        int line, column;
+        text_position(json, error_at, &line, &column);
+        printf("ERROR: %s, строка %d, столбец %d (прочитано станций: %d): %s\n", data_file_path,
+               line, column, load.count,
+               result == STATION_CODEC_TYPE_ERROR ? "неверный тип поля" :
+               result == STORAGE_LOAD_INVALID ? load.error : "некорректный JSON");
+        free(json);
+        stations_reset();
+        return -1;
+    }
+    free(json);
     
-    // Сохранение в основной файл
-    FILE *file = fopen(data_file_path, "w");
-    if (file) {
-        fprintf(file, "%s", json_string);
-        fclose(file);
-        printf("DEBUG: Данные сохранены в %s\n", data_file_path);
-    } else {
-        printf("ERROR: Не удалось открыть файл %s для записи\n", data_file_path);
-        result = -1;
+    // Лишняя часть оценки возвращается системе
+    if (global_stations_capacity > global_stations_count + 16) {
+        stations_resize(global_stations_count + 16);
     }
     
-    // Сохранение в копию (для синхронизации)
-    const char *backup_path = "../data/stations.json";
-    file = fopen(backup_path, "w");
-    if (file) {
-        fprintf(file, "%s", json_string);
-        fclose(file);
-        printf("DEBUG: Данные синхронизированы с %s\n", backup_path);
-    } else {
-        printf("DEBUG: Не удалось синхронизировать с %s\n", backup_path);
+    printf("Загружено %d станций из %s за %.1f мс\n", load.count, data_file_path,
+           storage_now_ms() - started);
+    return 0;
+}
+
+/**
+ * Загрузка станций из бинарного снимка: файл отображается в память и
+ * используется как массив станций, строится только индекс
+ */
+static int load_binary_file(void) {
+    double started = storage_now_ms();
+    
+    const char *error;
+    if (station_binary_open(binary_path, &binary_map, &error) != 0) {
+        printf("ERROR: Бинарный снимок %s не подходит: %s\n", binary_path, error);
+        return -1;
+    }
+    if (station_index_init(&station_index, binary_map.count) != 0) {
+        printf("ERROR: Недостаточно памяти для %d станций\n", binary_map.count);
+        stations_reset();
+        return -1;
     }
     
-    free(json_string);
-    json_free(json_array);
+    global_stations = binary_map.stations;
+    global_stations_count = binary_map.count;
+    global_stations_capacity = binary_map.count;
+    
+    for (int slot = 0; slot < global_stations_count; slot++) {
+        int id = global_stations[slot].id;
+        if (id <= 0 || station_index_find(&station_index, id) >= 0 ||
+            station_index_put(&station_index, id, slot) != 0) {
+            printf("ERROR: Бинарный снимок %s: неверный или повторяющийся id %d\n", binary_path, id);
+            stations_reset();
+            return -1;
+        }
+        if (id >= next_id) {
+            next_id = id + 1;
+        }
+    }
+    live_stations_count = global_stations_count;
+    
+    // Версии станций сохранены в снимке, счетчик продолжается с них
+    if (binary_map.stations_version > stations_version) {
+        stations_version = binary_map.stations_version;
+    }
+    
+    printf("Загружено %d станций из %s за %.1f мс\n", live_stations_count, binary_path,
+           storage_now_ms() - started);
+    return 0;
+}
+
+/**
+ * Выбор источника станций: бинарный снимок, если он не старше JSON файла
+ * (уплотнение пишет его вторым), иначе JSON. Если более новый источник
+ * поврежден, используется другой
+ */
+static int load_stations(void) {
+    struct stat json_stat, binary_stat;
+    int have_json = stat(data_file_path, &json_stat) == 0;
+    int have_binary = stat(binary_path, &binary_stat) == 0;
+    
+    int binary_newer = have_binary &&
+        (!have_json || binary_stat.st_mtim.tv_sec > json_stat.st_mtim.tv_sec ||
+         (binary_stat.st_mtim.tv_sec == json_stat.st_mtim.tv_sec &&
+          binary_stat.st_mtim.tv_nsec >= json_stat.st_mtim.tv_nsec));
+    
+    if (binary_newer) {
+        if (load_binary_file() == 0) {
+            return 0;
+        }
+        printf("Загрузка из %s\n", data_file_path);
+    }
+    
+    if (load_json_file() == 0) {
+        return 0;
+    }
+    
+    if (have_binary && !binary_newer) {
+        printf("ВНИМАНИЕ: %s поврежден, загрузка из более старого %s\n", data_file_path, binary_path);
+        return load_binary_file();
+    }
+    return -1;
+}
+
+/**
+ * Инициализация системы хранения данных
+ */
+int storage_init(void) {
+    storage_epoch = time(NULL);
+    
+    if (ensure_data_directory() != 0) {
+        return -1;
+    }
+    
+    initialize_global_stations();
+    return data_initialized ? 0 : -1;
+}
+
+/**
+ * Путь файла станций (до storage_init)
+ */
+void storage_set_data_file_path(const char *path) {
+    snprintf(data_file_path, sizeof(data_file_path), "%s", path);
+}
+
+/**
+ * Запись бинарного снимка рядом с файлом станций при уплотнении (до storage_init)
+ */
+void storage_set_binary_snapshot(int enabled) {
+    binary_enabled = enabled;
+}
+
+/**
+ * Путь реплики файла станций (до storage_init, NULL или "" - без реплики)
+ */
+void storage_set_replica_path(const char *path) {
+    replica_enabled = path && path[0] != '\0';
+    if (replica_enabled) {
+        snprintf(replica_path, sizeof(replica_path), "%s", path);
+    }
+}
+
+/**
+ * Интервал групповой фиксации журнала (до storage_init)
+ */
+void storage_set_wal_commit_ms(int commit_ms) {
+    wal_commit_ms = commit_ms;
+}
+
+/**
+ * Очистка ресурсов системы хранения
+ */
+void storage_cleanup(void) {
+    // Сначала дожидается уплотнение: оно пишет файл истории и удаляет
+    // сегменты журнала, поэтому журнал закрывается и история освобождается
+    // только после него, а новые уплотнения уже не начинаются
+    pthread_mutex_lock(&compact_lock);
+    compact_stop = 1;
+    pthread_cond_signal(&compact_cond);
+    pthread_mutex_unlock(&compact_lock);
+    if (compactor_running) {
+        pthread_join(compactor_thread, NULL);
+        compactor_running = 0;
+    }
+    pthread_mutex_lock(&compact_run_lock);
+    compact_closed = 1;
+    pthread_mutex_unlock(&compact_run_lock);
+    
+    // При завершении сервера потоки соединений еще могут работать: если
+    // блокировку держит другой код, память остается до завершения процесса
+    storage_wal_close();
+    station_telemetry_cleanup();
+    
+    if (pthread_mutex_trylock(&replica_lock) == 0) {
+        replica_stop = 1;
+        pthread_cond_signal(&replica_cond);
+        pthread_mutex_unlock(&replica_lock);
+    }
+    
+    if (pthread_mutex_trylock(&snapshot_lock) == 0) {
+        stations_snapshot_t *snapshot = current_snapshot;
+        current_snapshot = NULL;
+        pthread_mutex_unlock(&snapshot_lock);
+        storage_release_stations(snapshot);
+    }
+    
+    if (pthread_rwlock_trywrlock(&stations_lock) != 0) {
+        printf("Система хранения очищена\n");
+        return;
+    }
+    
+    stations_reset();
+    
+    free(free_slots);
+    free_slots = NULL;
+    free_slots_count = 0;
+    free_slots_capacity = 0;
+    
+    data_initialized = 0;
+    pthread_rwlock_unlock(&stations_lock);
+    printf("Система хранения очищена\n");
+}
+
+/**
+ * Восстановление истории телеметрии из файла. Оборванная дозапись после
+ * последней контрольной точки отрезается; без контрольной точки история
+ * собирается из журнала изменений, а файл начинается заново
+ */
+static void load_telemetry_file(void) {
+    size_t length = 0;
+    char *data = read_file(telemetry_path, &length);
+    if (!data) {
+        return;
+    }
+    
+    double started = storage_now_ms();
+    size_t valid_length = 0;
+    if (station_telemetry_restore(data, length, &telemetry_segment, &valid_length) == 0) {
+        printf("История телеметрии загружена из %s за %.1f мс\n", telemetry_path, storage_now_ms() - started);
+    } else {
+        printf("ВНИМАНИЕ: История телеметрии в %s не подходит и будет собрана заново\n", telemetry_path);
+    }
+    free(data);
+    
+    if (valid_length < length) {
+        printf("Отрезан оборванный хвост %s: %zu байт\n", telemetry_path, length - valid_length);
+        if (truncate(telemetry_path, (off_t)valid_length) != 0) {
+            telemetry_file_dirty = 1;
+        }
+    }
+}
+
+static int telemetry_station_exists(int id, void *ctx) {
+    (void)ctx;
+    return station_index_find(&station_index, id) >= 0;
+}
+
+/**
+ * Инициализация глобальных данных станций (выполняется один раз)
+ */
+static void initialize_stations_once(void) {
+    stations_version = 1;
+    snprintf(binary_path, sizeof(binary_path), "%s.bin", data_file_path);
+    if (load_stations() != 0) {
+        return;
+    }
+    
+    // Временные файлы прерванной записи снимка не нужны: основные файлы целы
+    char temp_path[sizeof(telemetry_path) + 8];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", data_file_path);
+    unlink(temp_path);
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", binary_path);
+    unlink(temp_path);
+    snprintf(telemetry_path, sizeof(telemetry_path), "%s.telemetry", data_file_path);
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", telemetry_path);
+    unlink(temp_path);
+    
+    load_telemetry_file();
+    
+    // Изменения после последнего уплотнения восстанавливаются из журнала
+    char wal_prefix[sizeof(data_file_path) + 8];
+    snprintf(wal_prefix, sizeof(wal_prefix), "%s.wal", data_file_path);
+    int replayed = storage_wal_open(wal_prefix, wal_commit_ms, storage_replay_record, NULL);
+    if (replayed < 0) {
+        printf("Ошибка открытия журнала изменений\n");
+        return;
+    }
+    
+    // Удаление станции стирает ее историю уже после записи в журнал: в
+    // контрольную точку могла попасть история станции, которой больше нет
+    station_telemetry_prune(telemetry_station_exists, NULL);
+    
+    if (pthread_create(&compactor_thread, NULL, storage_compactor, NULL) != 0) {
+        printf("Ошибка запуска потока уплотнения\n");
+        return;
+    }
+    compactor_running = 1;
+    
+    if (replica_enabled) {
+        if (pthread_create(&replica_thread, NULL, replica_writer, NULL) != 0) {
+            printf("Ошибка запуска потока реплики, реплика отключена\n");
+            replica_enabled = 0;
+        } else {
+            pthread_detach(replica_thread);
+            printf("Реплика файла станций: %s\n", replica_path);
+        }
+    }
+    if (replayed > 0) {
+        storage_request_compaction();
+    }
+    
+    data_initialized = 1;
+    printf("Инициализированы глобальные данные станций (%d станций)\n", live_stations_count);
+}
+
+void initialize_global_stations(void) {
+    pthread_once(&stations_once, initialize_stations_once);
+}
+
+/**
+ * Копия существующих станций в новый снимок. Вызывается под блокировкой
+ * чтения, поэтому версия снимка соответствует его содержимому
+ */
+static stations_snapshot_t* snapshot_build(void) {
+    stations_snapshot_t *snapshot = malloc(sizeof(stations_snapshot_t) +
+                                           live_stations_count * sizeof(charging_station_t));
+    if (!snapshot) {
+        return NULL;
+    }
+    
+    int count = 0;
+    for (int i = 0; i < global_stations_count; i++) {
+        if (global_stations[i].id != 0) {
+            memcpy(&snapshot->stations[count++], &global_stations[i], sizeof(charging_station_t));
+        }
+    }
+    
+    snapshot->count = count;
+    snapshot->version = __atomic_load_n(&stations_version, __ATOMIC_ACQUIRE);
+    snapshot->layout = stations_layout;
+    snapshot->refcount = 1;
+    snapshot->index = NULL;
+    return snapshot;
+}
+
+/**
+ * Ссылка на опубликованный снимок, если он соответствует версии
+ */
+static stations_snapshot_t* snapshot_get_current(unsigned long version) {
+    stations_snapshot_t *snapshot = NULL;
+    
+    pthread_mutex_lock(&snapshot_lock);
+    if (current_snapshot && current_snapshot->version == version) {
+        snapshot = current_snapshot;
+        __atomic_add_fetch(&snapshot->refcount, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&snapshot_lock);
+    
+    return snapshot;
+}
+
+/**
+ * Неизменяемый снимок списка станций. Пока данные не менялись, все читатели
+ * получают один и тот же снимок без копирования; после изменения первый
+ * читатель собирает новый снимок и публикует его для остальных
+ */
+const stations_snapshot_t* storage_acquire_stations(void) {
+    initialize_global_stations();
+    
+    unsigned long version = __atomic_load_n(&stations_version, __ATOMIC_ACQUIRE);
+    stations_snapshot_t *snapshot = snapshot_get_current(version);
+    if (snapshot) {
+        return snapshot;
+    }
+    
+    pthread_mutex_lock(&snapshot_build_lock);
+    
+    // Пока ждали, снимок мог собрать другой поток
+    version = __atomic_load_n(&stations_version, __ATOMIC_ACQUIRE);
+    snapshot = snapshot_get_current(version);
+    if (!snapshot) {
+        // Предыдущий снимок - источник индексов для нового
+        pthread_mutex_lock(&snapshot_lock);
+        stations_snapshot_t *previous = current_snapshot;
+        if (previous) {
+            __atomic_add_fetch(&previous->refcount, 1, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_unlock(&snapshot_lock);
+        
+        pthread_rwlock_rdlock(&stations_lock);
+        snapshot = snapshot_build();
+        pthread_rwlock_unlock(&stations_lock);
+        
+        if (snapshot) {
+            snapshot_carry_index(snapshot, previous);
+            snapshot->refcount = 2; // читатель и кэш
+            pthread_mutex_lock(&snapshot_lock);
+            stations_snapshot_t *old = current_snapshot;
+            current_snapshot = snapshot;
+            pthread_mutex_unlock(&snapshot_lock);
+            storage_release_stations(old);
+        }
+        storage_release_stations(previous);
+    }
+    
+    pthread_mutex_unlock(&snapshot_build_lock);
+    return snapshot;
+}
+
+/**
+ * Освобождение ссылки на снимок; последняя ссылка освобождает память
+ */
+void storage_release_stations(const stations_snapshot_t *snapshot) {
+    if (!snapshot) return;
+    
+    stations_snapshot_t *owned = (stations_snapshot_t*)snapshot;
+    if (__atomic_sub_fetch(&owned->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        stations_index_free(owned->index);
+        free(owned);
+    }
+}
+
+/* ---------- Вторичные индексы снимка ---------- */
+
+/**
+ * Группа станций с одинаковым значением поля: отрезок positions. Значение
+ * хранится в группе: индекс может пережить снимок, из которого построен
+ */
+typedef struct {
+    char value[32];           // status и type - строки до 32 байт
+    int start;
+    int count;
+} stations_group_t;
+
+/**
+ * Номера станций снимка, упорядоченные по значению поля, внутри группы -
+ * по id. Снимки одного состава разделяют неизменившиеся индексы по ссылке
+ */
+typedef struct {
+    int refcount;
+    int *positions;
+    stations_group_t *groups;
+    int group_count;
+} stations_value_index_t;
+
+/**
+ * Индексы снимка. by_id - одна группа со всеми станциями по возрастанию id
+ */
+struct stations_index {
+    stations_value_index_t *by_id;
+    stations_value_index_t *by_status;
+    stations_value_index_t *by_type;
+};
+
+typedef struct {
+    const char *value;
+    int id;
+    int position;
+} stations_index_entry_t;
+
+static int compare_index_entries(const void *a, const void *b) {
+    const stations_index_entry_t *x = a, *y = b;
+    int result = strcmp(x->value, y->value);
+    if (result != 0) return result;
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+static void value_index_release(stations_value_index_t *index) {
+    if (!index || __atomic_sub_fetch(&index->refcount, 1, __ATOMIC_ACQ_REL) != 0) return;
+    free(index->positions);
+    free(index->groups);
+    free(index);
+}
+
+static stations_value_index_t* value_index_share(stations_value_index_t *index) {
+    __atomic_add_fetch(&index->refcount, 1, __ATOMIC_RELAXED);
+    return index;
+}
+
+static void stations_index_free(struct stations_index *index) {
+    if (!index) return;
+    value_index_release(index->by_id);
+    value_index_release(index->by_status);
+    value_index_release(index->by_type);
+    free(index);
+}
+
+static stations_value_index_t* value_index_alloc(int count, int max_groups) {
+    stations_value_index_t *index = calloc(1, sizeof(stations_value_index_t));
+    if (!index) return NULL;
+    index->refcount = 1;
+    index->positions = malloc((count > 0 ? (size_t)count : 1) * sizeof(int));
+    index->groups = malloc((max_groups > 0 ? (size_t)max_groups : 1) * sizeof(stations_group_t));
+    if (!index->positions || !index->groups) {
+        value_index_release(index);
+        return NULL;
+    }
+    return index;
+}
+
+static void value_index_add(stations_value_index_t *index, const char *value, int start, int count) {
+    stations_group_t *group = &index->groups[index->group_count++];
+    snprintf(group->value, sizeof(group->value), "%s", value);
+    group->start = start;
+    group->count = count;
+}
+
+/**
+ * Индекс по строковому полю со смещением offset (для by_id значение пустое у всех)
+ */
+static stations_value_index_t* value_index_build(const stations_snapshot_t *snapshot, stations_index_entry_t *entries,
+                                                 int by_value, size_t offset) {
+    int count = snapshot->count;
+    for (int i = 0; i < count; i++) {
+        entries[i].value = by_value ? (const char*)&snapshot->stations[i] + offset : "";
+        entries[i].id = snapshot->stations[i].id;
+        entries[i].position = i;
+    }
+    qsort(entries, count, sizeof(*entries), compare_index_entries);
+    
+    int group_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (i == 0 || strcmp(entries[i].value, entries[i - 1].value) != 0) group_count++;
+    }
+    
+    stations_value_index_t *index = value_index_alloc(count, group_count);
+    if (!index) {
+        return NULL;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        index->positions[i] = entries[i].position;
+        if (i == 0 || strcmp(entries[i].value, entries[i - 1].value) != 0) {
+            value_index_add(index, entries[i].value, i, 0);
+        }
+        index->groups[index->group_count - 1].count++;
+    }
+    return index;
+}
+
+/**
+ * Индекс нового снимка того же состава из индекса предыдущего: станции
+ * moved сменили значение поля и переносятся в свои новые группы, порядок
+ * остальных сохраняется. Сортируются только перенесенные станции
+ */
+static stations_value_index_t* value_index_patch(const stations_value_index_t *old, const stations_snapshot_t *snapshot,
+                                                 size_t offset, const int *moved, int moved_count) {
+    int count = snapshot->count;
+    stations_index_entry_t *entries = malloc((size_t)moved_count * sizeof(*entries));
+    unsigned char *is_moved = calloc(count > 0 ? (size_t)count : 1, 1);
+    stations_value_index_t *index = value_index_alloc(count, old->group_count + moved_count);
+    if (!entries || !is_moved || !index) {
+        free(entries);
+        free(is_moved);
+        value_index_release(index);
+        return NULL;
+    }
+    
+    for (int i = 0; i < moved_count; i++) {
+        entries[i].value = (const char*)&snapshot->stations[moved[i]] + offset;
+        entries[i].id = snapshot->stations[moved[i]].id;
+        entries[i].position = moved[i];
+        is_moved[moved[i]] = 1;
+    }
+    qsort(entries, moved_count, sizeof(*entries), compare_index_entries);
+    
+    // Слияние групп по значению, внутри группы - станций по id
+    int g = 0, m = 0, out = 0;
+    while (g < old->group_count || m < moved_count) {
+        const char *value = m == moved_count ||
+                            (g < old->group_count && strcmp(old->groups[g].value, entries[m].value) <= 0) ?
+                            old->groups[g].value : entries[m].value;
+        const stations_group_t *source = g < old->group_count && strcmp(old->groups[g].value, value) == 0 ?
+                                         &old->groups[g++] : NULL;
+        const int *members = source ? old->positions + source->start : NULL;
+        int member_count = source ? source->count : 0;
+        
+        int start = out, i = 0;
+        for (;;) {
+            while (i < member_count && is_moved[members[i]]) i++;
+            int has_old = i < member_count;
+            int has_moved = m < moved_count && strcmp(entries[m].value, value) == 0;
+            if (!has_old && !has_moved) break;
+            
+            if (has_old && (!has_moved || snapshot->stations[members[i]].id < entries[m].id)) {
+                index->positions[out++] = members[i++];
+            } else {
+                index->positions[out++] = entries[m++].position;
+            }
+        }
+        if (out > start) {
+            value_index_add(index, value, start, out - start);
+        }
+    }
+    
+    free(entries);
+    free(is_moved);
+    return index;
+}
+
+/**
+ * Индексы строятся при первой выборке из снимка: список без параметров и
+ * уплотнение за них не платят. Если два потока построили индексы
+ * одновременно, публикуется первый, второй освобождается
+ */
+static struct stations_index* snapshot_index(const stations_snapshot_t *snapshot) {
+    stations_snapshot_t *owned = (stations_snapshot_t*)snapshot;
+    struct stations_index *index = __atomic_load_n(&owned->index, __ATOMIC_ACQUIRE);
+    if (index) {
+        return index;
+    }
+    
+    index = calloc(1, sizeof(struct stations_index));
+    stations_index_entry_t *entries = malloc((snapshot->count ? snapshot->count : 1) * sizeof(*entries));
+    if (!index || !entries ||
+        !(index->by_id = value_index_build(snapshot, entries, 0, 0)) ||
+        !(index->by_status = value_index_build(snapshot, entries, 1, offsetof(charging_station_t, status))) ||
+        !(index->by_type = value_index_build(snapshot, entries, 1, offsetof(charging_station_t, type)))) {
+        free(entries);
+        stations_index_free(index);
+        return NULL;
+    }
+    free(entries);
+    
+    struct stations_index *expected = NULL;
+    if (!__atomic_compare_exchange_n(&owned->index, &expected, index, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        stations_index_free(index);
+        index = expected;
+    }
+    return index;
+}
+
+/**
+ * Перенос индексов предыдущего снимка в новый (до публикации нового). Если
+ * состав станций тот же, меняются только индексы полей, значения которых
+ * изменились у станций новее предыдущего снимка; by_id разделяется всегда.
+ * Если у предыдущего снимка индексов нет, новый построит их при выборке
+ */
+static void snapshot_carry_index(stations_snapshot_t *snapshot, const stations_snapshot_t *previous) {
+    struct stations_index *old = previous ? __atomic_load_n(&previous->index, __ATOMIC_ACQUIRE) : NULL;
+    if (!old || previous->layout != snapshot->layout || previous->count != snapshot->count) {
+        return;
+    }
+    
+    int count = snapshot->count;
+    int *moved_status = malloc((count > 0 ? (size_t)count : 1) * sizeof(int));
+    int *moved_type = malloc((count > 0 ? (size_t)count : 1) * sizeof(int));
+    struct stations_index *index = calloc(1, sizeof(struct stations_index));
+    if (!moved_status || !moved_type || !index) {
+        free(moved_status);
+        free(moved_type);
+        free(index);
+        return;
+    }
+    
+    int status_count = 0, type_count = 0;
+    for (int i = 0; i < count; i++) {
+        const charging_station_t *station = &snapshot->stations[i];
+        if (station->version <= previous->version) continue;
+        if (strcmp(station->status, previous->stations[i].status) != 0) moved_status[status_count++] = i;
+        if (strcmp(station->type, previous->stations[i].type) != 0) moved_type[type_count++] = i;
+    }
+    
+    index->by_id = value_index_share(old->by_id);
+    index->by_status = status_count == 0 ? value_index_share(old->by_status) :
+        value_index_patch(old->by_status, snapshot, offsetof(charging_station_t, status), moved_status, status_count);
+    index->by_type = type_count == 0 ? value_index_share(old->by_type) :
+        value_index_patch(old->by_type, snapshot, offsetof(charging_station_t, type), moved_type, type_count);
+    free(moved_status);
+    free(moved_type);
+    
+    if (!index->by_status || !index->by_type) {
+        stations_index_free(index);
+        return;
+    }
+    snapshot->index = index;
+}
+
+/**
+ * Группа с заданным значением (двоичный поиск), NULL - таких станций нет
+ */
+static const stations_group_t* value_index_find(const stations_value_index_t *index, const char *value) {
+    int low = 0, high = index->group_count - 1;
+    while (low <= high) {
+        int middle = low + (high - low) / 2;
+        int result = strcmp(index->groups[middle].value, value);
+        if (result == 0) return &index->groups[middle];
+        if (result < 0) low = middle + 1;
+        else high = middle - 1;
+    }
+    return NULL;
+}
+
+/**
+ * Выборка станций из снимка. positions получает номера станций снимка
+ * (места нужно на min(limit, count) номеров), next_cursor - id последней
+ * станции страницы, если за ней есть еще подходящие, иначе 0.
+ * Просматриваются только станции меньшей из групп фильтров.
+ * Возвращает число станций или -1 при ошибке памяти
+ */
+int storage_select_stations(const stations_snapshot_t *snapshot, const stations_query_t *query,
+                            int *positions, int *next_cursor) {
+    *next_cursor = 0;
+    struct stations_index *index = snapshot_index(snapshot);
+    if (!index) {
+        return -1;
+    }
+    
+    const stations_value_index_t *source = index->by_id;
+    const stations_group_t *group = index->by_id->group_count > 0 ? &index->by_id->groups[0] : NULL;
+    if (query->status) {
+        source = index->by_status;
+        group = value_index_find(source, query->status);
+    }
+    if (query->type && group) {
+        const stations_group_t *type_group = value_index_find(index->by_type, query->type);
+        if (!query->status || !type_group || type_group->count < group->count) {
+            source = index->by_type;
+            group = type_group;
+        }
+    }
+    if (!group) {
+        return 0;
+    }
+    
+    // Первая станция группы с id больше курсора
+    const int *members = source->positions + group->start;
+    int low = 0, high = group->count;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (snapshot->stations[members[middle]].id <= query->after_id) low = middle + 1;
+        else high = middle;
+    }
+    
+    // Второй фильтр проверяется по самой станции
+    const char *status = source == index->by_status ? NULL : query->status;
+    const char *type = source == index->by_type ? NULL : query->type;
+    
+    int count = 0;
+    for (int i = low; i < group->count; i++) {
+        const charging_station_t *station = &snapshot->stations[members[i]];
+        if ((status && strcmp(station->status, status) != 0) ||
+            (type && strcmp(station->type, type) != 0)) {
+            continue;
+        }
+        if (query->limit > 0 && count == query->limit) {
+            *next_cursor = snapshot->stations[positions[count - 1]].id;
+            break;
+        }
+        positions[count++] = members[i];
+    }
+    return count;
+}
+
+/**
+ * Получение всех зарядных станций (копия опубликованного снимка)
+ */
+int storage_get_stations(stations_array_t *stations) {
+    const stations_snapshot_t *snapshot = storage_acquire_stations();
+    if (!snapshot) {
+        return -1;
+    }
+    
+    stations->stations = malloc((snapshot->count ? snapshot->count : 1) * sizeof(charging_station_t));
+    if (!stations->stations) {
+        storage_release_stations(snapshot);
+        return -1;
+    }
+    
+    memcpy(stations->stations, snapshot->stations, snapshot->count * sizeof(charging_station_t));
+    stations->count = snapshot->count;
+    stations->capacity = snapshot->count;
+    
+    storage_release_stations(snapshot);
+    return 0;
+}
+
+/**
+ * Получение зарядной станции по ID из глобальной памяти
+ */
+int storage_get_station(int id, charging_station_t *station) {
+    initialize_global_stations();
+    
+    pthread_rwlock_rdlock(&stations_lock);
+    int slot = station_index_find(&station_index, id);
+    if (slot >= 0) {
+        memcpy(station, &global_stations[slot], sizeof(charging_station_t));
+    }
+    pthread_rwlock_unlock(&stations_lock);
+    
+    return slot >= 0 ? 0 : -1;
+}
+
+/**
+ * Текущая версия коллекции станций. Читается до копирования данных
+ */
+unsigned long storage_get_stations_version(void) {
+    initialize_global_stations();
+    return __atomic_load_n(&stations_version, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Строгий ETag списка станций для версии коллекции
+ */
+void storage_stations_etag(unsigned long version, char *etag, size_t size) {
+    snprintf(etag, size, "\"%lx-%lx\"", (unsigned long)storage_epoch, version);
+}
+
+/**
+ * Строгий ETag отдельной станции
+ */
+void storage_station_etag(const charging_station_t *station, char *etag, size_t size) {
+    snprintf(etag, size, "\"%lx-%d-%lx\"", (unsigned long)storage_epoch, station->id, station->version);
+}
+
+/**
+ * Создание новой зарядной станции
+ */
+int storage_create_station(const charging_station_t *station, int *new_id) {
+    initialize_global_stations();
+    
+    pthread_rwlock_wrlock(&stations_lock);
+    
+    charging_station_t created = *station;
+    created.id = next_id;
+    created.version = stations_version + 1;
+    
+    // Место для отката резервируется заранее: station_slot_remove не откажет
+    if (free_slots_reserve() != 0 || station_slot_insert(&created) < 0) {
+        pthread_rwlock_unlock(&stations_lock);
+        printf("Ошибка выделения памяти для новой станции\n");
+        return -1;
+    }
+    
+    // Станция без записи в журнале убирается: клиент получит ошибку
+    unsigned long long lsn = storage_log_change(STORAGE_WAL_CREATE, &created, STATION_FIELDS_ALL, 0);
+    if (lsn == 0) {
+        station_slot_remove(created.id);
+        next_id = created.id;
+        pthread_rwlock_unlock(&stations_lock);
+        printf("ERROR: Изменение не записано в журнал\n");
+        return -1;
+    }
+    __atomic_store_n(&stations_version, created.version, __ATOMIC_RELEASE);
+    *new_id = created.id;
+    pthread_rwlock_unlock(&stations_lock);
+    
+    if (storage_commit_change(lsn) != 0) {
+        return -1;
+    }
+    printf("Создана новая станция с ID %d\n", *new_id);
+    return 0;
+}
+
+/**
+ * Изменение станции под блокировкой записи. Возвращает LSN записи журнала,
+ * 0 - запись не добавлена в журнал (станция не изменена), -1 - станции нет
+ */
+static long long update_station_locked(int id, const charging_station_t *updates, station_field_mask_t fields,
+                                       int64_t now_ms) {
+    int slot = station_index_find(&station_index, id);
+    if (slot < 0) {
+        return -1;
+    }
+    
+    // Изменение собирается в копии и применяется, только когда запись
+    // добавлена в журнал: иначе клиент получил бы ошибку, а изменение
+    // осталось бы в памяти и попало в следующий снимок
+    charging_station_t updated = global_stations[slot];
+    station_apply_fields(&updated, updates, fields);
+    
+    // В журнал попадают только измененные поля
+    int64_t telemetry_ms = (fields & STATION_TELEMETRY_MASK) ? now_ms : 0;
+    unsigned long long lsn = storage_log_change(STORAGE_WAL_UPDATE, &updated, fields, telemetry_ms);
+    if (lsn == 0) {
+        return 0;
+    }
+    
+    // Новая версия публикуется после изменения данных: ETag, прочитанный
+    // до копирования станций, никогда не опережает сами данные
+    charging_station_t *current = &global_stations[slot];
+    *current = updated;
+    current->version = __atomic_add_fetch(&stations_version, 1, __ATOMIC_RELEASE);
+    
+    // Измерения попадают в историю в порядке изменений
+    if (telemetry_ms > 0) {
+        station_telemetry_record(current, now_ms);
+    }
+    return (long long)lsn;
+}
+
+static int64_t storage_wall_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Обновление зарядной станции в глобальной памяти: применяются только поля
+ * из маски fields (идентификатор не меняется)
+ */
+int storage_update_station(int id, const charging_station_t *updates, station_field_mask_t fields) {
+    printf("DEBUG: storage_update_station called for ID %d\n", id);
+    initialize_global_stations();
+    
+    fields &= ~STATION_FIELD(id);
+    
+    pthread_rwlock_wrlock(&stations_lock);
+    long long lsn = update_station_locked(id, updates, fields, storage_wall_ms());
+    pthread_rwlock_unlock(&stations_lock);
+    
+    if (lsn < 0) {
+        printf("DEBUG: Station with ID %d not found\n", id);
+        return -1;
+    }
+    if (storage_commit_change((unsigned long long)lsn) != 0) {
+        return -1;
+    }
+    printf("Обновлена станция с ID %d\n", id);
+    return 0;
+}
+
+/**
+ * Пакет изменений (опрос плат): одна блокировка записи и одно ожидание
+ * фиксации журнала на весь пакет. Станции, которых уже нет, пропускаются.
+ * Возвращает число измененных станций
+ */
+int storage_update_stations(const station_update_t *updates, int count) {
+    initialize_global_stations();
+    if (count <= 0) {
+        return 0;
+    }
+    
+    int64_t now_ms = storage_wall_ms();
+    long long last_lsn = 0;
+    int updated = 0;
+    int failed = 0;
+    
+    pthread_rwlock_wrlock(&stations_lock);
+    for (int i = 0; i < count; i++) {
+        long long lsn = update_station_locked(updates[i].id, &updates[i].values,
+                                              updates[i].fields & ~STATION_FIELD(id), now_ms);
+        if (lsn < 0) continue;
+        if (lsn == 0) {
+            failed = 1;   // запись не добавлена в журнал, станция не изменена
+            continue;
+        }
+        last_lsn = lsn;
+        updated++;
+    }
+    pthread_rwlock_unlock(&stations_lock);
+    
+    // Журнал фиксируется по порядку: последний LSN покрывает весь пакет
+    if (updated > 0 && storage_commit_change((unsigned long long)last_lsn) != 0) {
+        return -1;
+    }
+    if (failed) {
+        printf("ERROR: Изменение не записано в журнал\n");
+        return -1;
+    }
+    return updated;
+}
+
+/**
+ * Удаление зарядной станции
+ */
+int storage_delete_station(int id) {
+    initialize_global_stations();
+    
+    pthread_rwlock_wrlock(&stations_lock);
+    
+    // Станция удаляется из памяти только после записи в журнал
+    if (station_index_find(&station_index, id) < 0 || free_slots_reserve() != 0) {
+        pthread_rwlock_unlock(&stations_lock);
+        return -1;
+    }
+    
+    charging_station_t removed = {0};
+    removed.id = id;
+    unsigned long long lsn = storage_log_change(STORAGE_WAL_DELETE, &removed, 0, 0);
+    if (lsn == 0) {
+        pthread_rwlock_unlock(&stations_lock);
+        printf("ERROR: Изменение не записано в журнал\n");
+        return -1;
+    }
+    station_slot_remove(id);
+    __atomic_add_fetch(&stations_version, 1, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&stations_lock);
+    
+    station_telemetry_remove(id);
+    
+    if (storage_commit_change(lsn) != 0) {
+        return -1;
+    }
+    printf("Удалена станция с ID %d\n", id);
+    return 0;
+}
+
+/**
+ * fsync каталога: переименование файла должно пережить сбой питания
+ */
+static int sync_parent_directory(const char *path) {
+    char dir[sizeof(telemetry_path)];
+    snprintf(dir, sizeof(dir), "%s", path);
+    
+    int fd = open(dirname(dir), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return -1;
+    }
+    int result = fsync(fd);
+    close(fd);
+    return result;
+}
+
+/**
+ * Атомарная замена файла: данные пишутся во временный файл рядом с целевым,
+ * fsync, rename поверх целевого и fsync каталога. При сбое на любом шаге
+ * на диске остается либо прежний файл, либо новый целиком
+ */
+static int write_file_atomic(const char *path, const struct iovec *parts, int count) {
+    char temp_path[sizeof(telemetry_path) + 8];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        printf("ERROR: Не удалось создать %s: %s\n", temp_path, strerror(errno));
+        return -1;
+    }
+    
+    int failed = 0;
+    for (int i = 0; i < count && !failed; i++) {
+        const char *data = parts[i].iov_base;
+        size_t length = parts[i].iov_len;
+        while (length > 0) {
+            ssize_t n = write(fd, data, length);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                failed = 1;
+                break;
+            }
+            data += n;
+            length -= n;
+        }
+    }
+    
+    if (failed || fsync(fd) != 0) {
+        printf("ERROR: Ошибка записи %s: %s\n", temp_path, strerror(errno));
+        close(fd);
+        unlink(temp_path);
+        return -1;
+    }
+    close(fd);
+    
+    if (rename(temp_path, path) != 0) {
+        printf("ERROR: Не удалось заменить %s: %s\n", path, strerror(errno));
+        unlink(temp_path);
+        return -1;
+    }
+    
+    if (sync_parent_directory(path) != 0) {
+        printf("ERROR: Не удалось синхронизировать каталог %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Дозапись в конец существующего файла с fdatasync. При ошибке хвост
+ * отрезается, чтобы в файле не осталось оборванной записи
+ */
+static int append_file_durable(const char *path, const void *data, size_t length) {
+    int fd = open(path, O_WRONLY | O_APPEND | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("ERROR: Не удалось открыть %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    
+    const char *p = data;
+    int failed = 0;
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            failed = 1;
+            break;
+        }
+        p += n;
+        length -= n;
+    }
+    
+    if (failed || fdatasync(fd) != 0) {
+        printf("ERROR: Ошибка записи %s: %s\n", path, strerror(errno));
+        if (ftruncate(fd, st.st_size) != 0 || fdatasync(fd) != 0) {
+            telemetry_file_dirty = 1;
+        }
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * Запись истории телеметрии после файла станций: новые закрытые блоки и
+ * контрольная точка дописываются одной записью, а когда в файле больше
+ * половины мусора (или дозапись однажды не удалась) - файл переписывается
+ */
+static int write_telemetry_file(station_telemetry_capture_t *capture) {
+    struct stat st;
+    size_t file_length = telemetry_file_dirty ? SIZE_MAX :
+                         stat(telemetry_path, &st) == 0 ? (size_t)st.st_size : 0;
+    if (station_telemetry_capture_records(capture, file_length) != 0) {
+        printf("ERROR: Недостаточно памяти для записи истории телеметрии\n");
+        return -1;
+    }
+    
+    int result;
+    if (capture->rewrite) {
+        struct iovec part = { capture->data, capture->length };
+        result = write_file_atomic(telemetry_path, &part, 1);
+        if (result == 0) {
+            telemetry_file_dirty = 0;
+        }
+    } else {
+        result = append_file_durable(telemetry_path, capture->data, capture->length);
+    }
+    
+    if (result == 0) {
+        station_telemetry_capture_commit(capture);
+        printf("DEBUG: История телеметрии сохранена в %s (%zu байт%s)\n", telemetry_path,
+               capture->length, capture->rewrite ? ", файл переписан" : "");
+    }
+    return result;
+}
+
+/**
+ * Поток реплики: записывает последний переданный снимок. Если реплика
+ * отстает, промежуточные снимки пропускаются - важен только последний
+ */
+static void* replica_writer(void *arg) {
+    (void)arg;
+    
+    pthread_mutex_lock(&replica_lock);
+    for (;;) {
+        while (!replica_data && !replica_stop) {
+            pthread_cond_wait(&replica_cond, &replica_lock);
+        }
+        if (replica_stop) break;
+        
+        char *data = replica_data;
+        size_t length = replica_length;
+        replica_data = NULL;
+        pthread_mutex_unlock(&replica_lock);
+        
+        struct iovec part = { data, length };
+        if (write_file_atomic(replica_path, &part, 1) == 0) {
+            printf("DEBUG: Данные синхронизированы с %s\n", replica_path);
+        } else {
+            printf("DEBUG: Не удалось синхронизировать с %s\n", replica_path);
+        }
+        free(data);
+        
+        pthread_mutex_lock(&replica_lock);
+    }
+    pthread_mutex_unlock(&replica_lock);
+    return NULL;
+}
+
+/**
+ * Передача снимка потоку реплики (данные переходят во владение потока)
+ */
+static void replica_submit(char *data, size_t length) {
+    pthread_mutex_lock(&replica_lock);
+    free(replica_data);
+    replica_data = data;
+    replica_length = length;
+    pthread_cond_signal(&replica_cond);
+    pthread_mutex_unlock(&replica_lock);
+}
+
+/**
+ * Бинарный снимок пишется после JSON файла, поэтому при запуске он не старше
+ * JSON. Если снимки отключены, старый удаляется, чтобы не оказаться новее
+ */
+static int write_binary_file(const stations_snapshot_t *snapshot) {
+    if (!binary_enabled) {
+        if (unlink(binary_path) == 0) {
+            sync_parent_directory(binary_path);
+        }
+        return 0;
+    }
+    
+    station_binary_header_t header;
+    station_binary_header(&header, snapshot->stations, snapshot->count, snapshot->version);
+    
+    struct iovec parts[2] = {
+        { &header, sizeof(header) },
+        { (void*)snapshot->stations, snapshot->count * sizeof(charging_station_t) }
+    };
+    if (write_file_atomic(binary_path, parts, 2) != 0) {
+        return -1;
+    }
+    printf("DEBUG: Бинарный снимок сохранен в %s\n", binary_path);
+    return 0;
+}
+
+/**
+ * Запись снимка в файл данных (и бинарный снимок), передача копии реплике
+ */
+static int write_stations_file(const stations_snapshot_t *snapshot) {
+    // Сериализация напрямую из структур, без промежуточного дерева
+    json_buf_t buf;
+    json_buf_init(&buf, snapshot->count * 1024 + 64);
+    stations_write_json(&buf, snapshot->stations, snapshot->count);
+    
+    size_t json_length;
+    char *json_string = json_buf_detach(&buf, &json_length);
+    if (!json_string) {
+        printf("ERROR: Не удалось сериализовать станции\n");
+        return -1;
+    }
+    
+    struct iovec part = { json_string, json_length };
+    int result = write_file_atomic(data_file_path, &part, 1);
+    if (result == 0) {
+        printf("DEBUG: Данные сохранены в %s\n", data_file_path);
+        result = write_binary_file(snapshot);
+    }
+    
+    if (result == 0 && replica_enabled) {
+        replica_submit(json_string, json_length);
+    } else {
+        free(json_string);
+    }
     return result;
 }
 
+/**
+ * Сохранение глобальных данных станций в файл (внеочередное уплотнение)
+ */
+int save_global_stations_to_file(void) {
+    if (!data_initialized) {
+        printf("DEBUG: Глобальные станции не инициализированы\n");
+        return -1;
+    }
+    
+    return storage_compact();
+}
+
 /**
  * Освобождение памяти массива станций
  */
@@ -0,0 +1,547 @@
+/**
+ * Журнал изменений станций с групповой фиксацией
+ *
+ * Формат записи (одна на строку):
+ *   <операция> <длина JSON> <контрольная сумма FNV-1a, hex> <JSON>\n
+ * Длина позволяет не зависеть от содержимого строк, контрольная сумма -
+ * отбросить запись, оборванную на середине при сбое
+ */
+
+#include "storage_wal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <libgen.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * Буфер записей, ожидающих сброса
+ */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} wal_buffer_t;
+
+static char wal_prefix[PATH_MAX];
+static int wal_fd = -1;
+static unsigned long wal_segment = 0;
+static size_t wal_segment_size = 0;  // записано в текущий сегмент
+
+static wal_buffer_t wal_pending = {0};   // новые записи
+static wal_buffer_t wal_flushing = {0};  // группа, которую пишет поток записи
+static unsigned long long wal_appended_lsn = 0;
+static unsigned long long wal_flushed_lsn = 0;
+static unsigned long wal_failures = 0;
+static long long wal_first_pending_ms = 0;
+
+static int wal_commit_ms = STORAGE_WAL_COMMIT_MS;
+static int wal_running = 0;
+static int wal_stop = 0;
+static int wal_busy = 0;    // поток записи пишет группу без блокировки
+static int wal_urgent = 0;  // сбросить без ожидания группы (ротация)
+
+static pthread_t wal_thread;
+static pthread_mutex_t wal_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wal_work;  // новые записи для потока записи
+static pthread_cond_t wal_done;  // группа сброшена (или ошибка)
+
+static long long wal_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static unsigned int wal_checksum(const char *data, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int wal_buffer_append(wal_buffer_t *buf, const char *data, size_t length) {
+    if (buf->length + length > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity : 4096;
+        while (capacity < buf->length + length) {
+            capacity *= 2;
+        }
+        char *grown = realloc(buf->data, capacity);
+        if (!grown) return -1;
+        buf->data = grown;
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->length, data, length);
+    buf->length += length;
+    return 0;
+}
+
+static int wal_write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        length -= written;
+    }
+    return 0;
+}
+
+static void wal_segment_path(unsigned long segment, char *path, size_t size) {
+    snprintf(path, size, "%s.%06lu", wal_prefix, segment);
+}
+
+/**
+ * fsync каталога журнала: создание и удаление сегментов тоже должны
+ * пережить сбой питания
+ */
+static void wal_sync_directory(void) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", wal_prefix);
+    int fd = open(dirname(dir), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+/**
+ * Номер сегмента по имени файла (0 - чужой файл)
+ */
+static unsigned long wal_segment_number(const char *path) {
+    size_t prefix_length = strlen(wal_prefix);
+    if (strncmp(path, wal_prefix, prefix_length) != 0 || path[prefix_length] != '.') {
+        return 0;
+    }
+    char *end;
+    unsigned long segment = strtoul(path + prefix_length + 1, &end, 10);
+    return *end == '\0' ? segment : 0;
+}
+
+static int wal_compare_segments(const void *a, const void *b) {
+    unsigned long x = *(const unsigned long*)a, y = *(const unsigned long*)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Номера существующих сегментов по возрастанию (освобождается через free)
+ */
+static unsigned long* wal_list_segments(size_t *count) {
+    char pattern[PATH_MAX + 8];
+    snprintf(pattern, sizeof(pattern), "%s.*", wal_prefix);
+
+    glob_t found;
+    *count = 0;
+    if (glob(pattern, 0, NULL, &found) != 0) {
+        return NULL;
+    }
+
+    unsigned long *segments = malloc(sizeof(unsigned long) * found.gl_pathc);
+    if (segments) {
+        for (size_t i = 0; i < found.gl_pathc; i++) {
+            unsigned long segment = wal_segment_number(found.gl_pathv[i]);
+            if (segment > 0) {
+                segments[(*count)++] = segment;
+            }
+        }
+        qsort(segments, *count, sizeof(unsigned long), wal_compare_segments);
+    }
+    globfree(&found);
+    return segments;
+}
+
+/**
+ * Разбор заголовка записи "<операция> <длина> <сумма> ". Проверяет, что запись
+ * целиком лежит в буфере, завершается переводом строки и сумма совпадает
+ */
+static int wal_parse_header(const char *p, const char *end, const char **json, size_t *length) {
+    if (end - p < 4 || p[1] != ' ') return -1;
+    p += 2;
+
+    size_t value = 0;
+    const char *digits = p;
+    while (p < end && *p >= '0' && *p <= '9' && p - digits < 19) {
+        value = value * 10 + (*p++ - '0');
+    }
+    if (p == digits || p >= end || *p++ != ' ') return -1;
+
+    unsigned int checksum = 0;
+    for (int i = 0; i < 8; i++, p++) {
+        if (p >= end) return -1;
+        char c = *p;
+        int digit = c >= '0' && c <= '9' ? c - '0' :
+                    c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (digit < 0) return -1;
+        checksum = checksum * 16 + digit;
+    }
+    if (p >= end || *p++ != ' ') return -1;
+
+    if ((size_t)(end - p) < value + 1 || p[value] != '\n' || wal_checksum(p, value) != checksum) {
+        return -1;
+    }
+    *json = p;
+    *length = value;
+    return 0;
+}
+
+/**
+ * Восстановление записей одного сегмента. Оборванный хвост последнего
+ * сегмента отрезается; повреждение в середине журнала - ошибка
+ * (следующие записи зависят от потерянных)
+ */
+static int wal_replay_segment(unsigned long segment, int last, storage_wal_apply_fn apply, void *ctx,
+                              int *records) {
+    char path[PATH_MAX + 24];
+    wal_segment_path(segment, path, sizeof(path));
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf("Не удалось открыть сегмент журнала %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *data = malloc(file_size + 1);
+    if (!data) {
+        fclose(file);
+        return -1;
+    }
+    size_t size = fread(data, 1, file_size, file);
+    fclose(file);
+
+    data[size] = '\0';
+    size_t pos = 0;
+    while (pos < size) {
+        const char *json;
+        size_t length;
+        char op = data[pos];
+        if (wal_parse_header(data + pos, data + size, &json, &length) != 0) {
+            break;
+        }
+
+        size_t next = json - data + length + 1;
+        data[next - 1] = '\0';
+        if (apply(op, json, segment, ctx) != 0) {
+            printf("Пропущена некорректная запись журнала %s (смещение %zu)\n", path, pos);
+        }
+        (*records)++;
+        pos = next;
+    }
+
+    free(data);
+    if (pos == size) {
+        return 0;
+    }
+
+    if (last) {
+        printf("Отрезан оборванный хвост журнала %s: %zu байт\n", path, size - pos);
+        if (truncate(path, pos) != 0) {
+            printf("Не удалось обрезать %s: %s\n", path, strerror(errno));
+        }
+        return 0;
+    }
+
+    printf("Поврежден сегмент журнала %s (смещение %zu)\n", path, pos);
+    return -1;
+}
+
+/**
+ * Поток записи: собирает записи в группу, пока не истечет commit_ms с первой
+ * записи группы или группа не вырастет до STORAGE_WAL_COMMIT_BYTES,
+ * затем пишет группу одним write и fdatasync
+ */
+static void* wal_writer_thread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&wal_lock);
+    for (;;) {
+        while (!wal_stop && wal_pending.length == 0) {
+            pthread_cond_wait(&wal_work, &wal_lock);
+        }
+        if (wal_pending.length == 0) {
+            break;
+        }
+
+        long long deadline = wal_first_pending_ms + wal_commit_ms;
+        while (!wal_stop && !wal_urgent && wal_pending.length < STORAGE_WAL_COMMIT_BYTES) {
+            long long now = wal_now_ms();
+            if (now >= deadline) break;
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            long long wait_ms = deadline - now;
+            ts.tv_sec += wait_ms / 1000;
+            ts.tv_nsec += (wait_ms % 1000) * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&wal_work, &wal_lock, &ts);
+        }
+
+        // Группа уходит в запись, новые записи копятся во втором буфере
+        wal_buffer_t group = wal_pending;
+        wal_pending = wal_flushing;
+        wal_pending.length = 0;
+        unsigned long long group_lsn = wal_appended_lsn;
+        int fd = wal_fd;
+        size_t offset = wal_segment_size;
+        wal_busy = 1;
+        pthread_mutex_unlock(&wal_lock);
+
+        int ok = wal_write_all(fd, group.data, group.length) == 0 && fdatasync(fd) == 0;
+        if (!ok) {
+            printf("Ошибка записи журнала: %s\n", strerror(errno));
+            // Частично записанная группа отрезается, иначе повтор записал бы
+            // ее после мусора, который восстановление не пропустит
+            if (ftruncate(fd, offset) != 0) {
+                printf("Не удалось обрезать журнал: %s\n", strerror(errno));
+            }
+        }
+
+        pthread_mutex_lock(&wal_lock);
+        wal_busy = 0;
+        if (ok) {
+            wal_segment_size += group.length;
+            wal_flushed_lsn = group_lsn;
+            group.length = 0;
+            wal_flushing = group;
+        } else {
+            // Группа остается первой в очереди и будет записана повторно
+            if (wal_buffer_append(&group, wal_pending.data, wal_pending.length) == 0) {
+                wal_flushing = wal_pending;
+                wal_flushing.length = 0;
+                wal_pending = group;
+            } else {
+                group.length = 0;
+                wal_flushing = group;
+            }
+            wal_failures++;
+            wal_first_pending_ms = wal_now_ms() + STORAGE_WAL_RETRY_MS - wal_commit_ms;
+        }
+        if (wal_pending.length == 0) {
+            wal_urgent = 0;
+        }
+        pthread_cond_broadcast(&wal_done);
+    }
+    pthread_mutex_unlock(&wal_lock);
+    return NULL;
+}
+
+/**
+ * Открытие журнала: восстановление сегментов и начало нового сегмента.
+ * Если сегмент не прочитан целиком (кроме оборванного хвоста последнего),
+ * журнал не открывается: уплотнение записало бы снимок без последующих
+ * записей и удалило бы сегменты, в которых они еще есть
+ */
+int storage_wal_open(const char *prefix, int commit_ms, storage_wal_apply_fn apply, void *ctx) {
+    snprintf(wal_prefix, sizeof(wal_prefix), "%s", prefix);
+    wal_commit_ms = commit_ms >= 0 ? commit_ms : STORAGE_WAL_COMMIT_MS;
+
+    size_t count = 0;
+    unsigned long *segments = wal_list_segments(&count);
+    int records = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (wal_replay_segment(segments[i], i + 1 == count, apply, ctx, &records) != 0) {
+            printf("Журнал изменений не восстановлен: сегменты с %06lu по %06lu не тронуты, "
+                   "их нужно проверить вручную\n", segments[i], segments[count - 1]);
+            free(segments);
+            return -1;
+        }
+    }
+    wal_segment = count > 0 ? segments[count - 1] + 1 : 1;
+    free(segments);
+
+    char path[PATH_MAX + 24];
+    wal_segment_path(wal_segment, path, sizeof(path));
+    wal_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (wal_fd < 0) {
+        printf("Не удалось создать сегмент журнала %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    wal_sync_directory();
+    wal_segment_size = 0;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wal_work, &attr);
+    pthread_cond_init(&wal_done, &attr);
+    pthread_condattr_destroy(&attr);
+
+    wal_stop = 0;
+    if (pthread_create(&wal_thread, NULL, wal_writer_thread, NULL) != 0) {
+        close(wal_fd);
+        wal_fd = -1;
+        return -1;
+    }
+    pthread_detach(wal_thread);
+    wal_running = 1;
+
+    printf("Журнал изменений: %s (восстановлено записей: %d, группа %d мс)\n", path, records, wal_commit_ms);
+    return records;
+}
+
+/**
+ * Остановка журнала. Вызывается и из обработчика сигнала, поэтому не ждет
+ * поток записи: несброшенная группа дописывается здесь, если поток ее не пишет
+ */
+void storage_wal_close(void) {
+    if (pthread_mutex_trylock(&wal_lock) != 0) {
+        return;
+    }
+    if (!wal_running) {
+        pthread_mutex_unlock(&wal_lock);
+        return;
+    }
+
+    wal_running = 0;
+    wal_stop = 1;
+    if (!wal_busy) {
+        if (wal_pending.length > 0 &&
+            wal_write_all(wal_fd, wal_pending.data, wal_pending.length) == 0 && fdatasync(wal_fd) == 0) {
+            wal_flushed_lsn = wal_appended_lsn;
+        }
+        wal_pending.length = 0;
+        close(wal_fd);
+        wal_fd = -1;
+    }
+    pthread_cond_broadcast(&wal_work);
+    pthread_cond_broadcast(&wal_done);
+    pthread_mutex_unlock(&wal_lock);
+}
+
+/**
+ * Добавление записи в текущую группу
+ */
+unsigned long long storage_wal_append(char op, const char *json, size_t length) {
+    char header[48];
+    int header_length = snprintf(header, sizeof(header), "%c %zu %08x ", op, length, wal_checksum(json, length));
+
+    pthread_mutex_lock(&wal_lock);
+    if (!wal_running) {
+        pthread_mutex_unlock(&wal_lock);
+        return 0;
+    }
+
+    size_t previous = wal_pending.length;
+    if (wal_buffer_append(&wal_pending, header, header_length) != 0 ||
+        wal_buffer_append(&wal_pending, json, length) != 0 ||
+        wal_buffer_append(&wal_pending, "\n", 1) != 0) {
+        wal_pending.length = previous;
+        pthread_mutex_unlock(&wal_lock);
+        return 0;
+    }
+
+    if (previous == 0) {
+        wal_first_pending_ms = wal_now_ms();
+        pthread_cond_signal(&wal_work);
+    } else if (wal_pending.length >= STORAGE_WAL_COMMIT_BYTES) {
+        pthread_cond_signal(&wal_work);
+    }
+
+    unsigned long long lsn = ++wal_appended_lsn;
+    pthread_mutex_unlock(&wal_lock);
+    return lsn;
+}
+
+/**
+ * Ожидание фиксации записи. Ошибка записи группы, случившаяся во время
+ * ожидания, возвращается всем ожидающим; сами записи остаются в очереди
+ */
+int storage_wal_commit(unsigned long long lsn) {
+    if (lsn == 0) return -1;
+
+    pthread_mutex_lock(&wal_lock);
+    unsigned long failures = wal_failures;
+    int result = 0;
+    while (wal_flushed_lsn < lsn) {
+        if (!wal_running || wal_failures != failures) {
+            result = -1;
+            break;
+        }
+        pthread_cond_wait(&wal_done, &wal_lock);
+    }
+    pthread_mutex_unlock(&wal_lock);
+    return result;
+}
+
+/**
+ * Ротация: накопленные записи сбрасываются в текущий сегмент, новые записи
+ * пойдут в следующий. Вызывающий гарантирует отсутствие параллельных добавлений
+ */
+unsigned long storage_wal_rotate(void) {
+    pthread_mutex_lock(&wal_lock);
+    unsigned long failures = wal_failures;
+    while (wal_running && (wal_pending.length > 0 || wal_busy)) {
+        if (wal_failures != failures) {
+            pthread_mutex_unlock(&wal_lock);
+            return 0;
+        }
+        wal_urgent = 1;
+        pthread_cond_signal(&wal_work);
+        pthread_cond_wait(&wal_done, &wal_lock);
+    }
+    if (!wal_running) {
+        pthread_mutex_unlock(&wal_lock);
+        return 0;
+    }
+
+    char path[PATH_MAX + 24];
+    wal_segment_path(wal_segment + 1, path, sizeof(path));
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        printf("Не удалось создать сегмент журнала %s: %s\n", path, strerror(errno));
+        pthread_mutex_unlock(&wal_lock);
+        return 0;
+    }
+    wal_sync_directory();
+
+    close(wal_fd);
+    wal_fd = fd;
+    wal_segment++;
+    wal_segment_size = 0;
+    unsigned long segment = wal_segment;
+    pthread_mutex_unlock(&wal_lock);
+    return segment;
+}
+
+/**
+ * Удаление сегментов, покрытых записанным снимком
+ */
+void storage_wal_remove_before(unsigned long segment) {
+    size_t count = 0;
+    unsigned long *segments = wal_list_segments(&count);
+    int removed = 0;
+    for (size_t i = 0; i < count && segments[i] < segment; i++) {
+        char path[PATH_MAX + 24];
+        wal_segment_path(segments[i], path, sizeof(path));
+        if (unlink(path) == 0) {
+            removed++;
+        }
+    }
+    free(segments);
+    if (removed > 0) {
+        wal_sync_directory();
+    }
+}
+
+size_t storage_wal_size(void) {
+    pthread_mutex_lock(&wal_lock);
+    size_t size = wal_segment_size + wal_pending.length;
+    pthread_mutex_unlock(&wal_lock);
+    return size;
+}
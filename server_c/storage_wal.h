@@ -0,0 +1,52 @@
+/**
+ * Журнал изменений станций (write-ahead log)
+ * Каждое изменение дописывается строкой в текущий сегмент журнала;
+ * поток записи собирает строки в группы и сбрасывает их одним write + fdatasync
+ * (group commit). После записи полного снимка старые сегменты удаляются
+ */
+
+#ifndef STORAGE_WAL_H
+#define STORAGE_WAL_H
+
+#include <stddef.h>
+
+// Ожидание перед сбросом группы и размер группы, при котором сброс немедленный
+#define STORAGE_WAL_COMMIT_MS 2
+#define STORAGE_WAL_COMMIT_BYTES (64 * 1024)
+
+// Повтор сброса после ошибки записи
+#define STORAGE_WAL_RETRY_MS 1000
+
+// Операции журнала
+#define STORAGE_WAL_CREATE 'C'
+#define STORAGE_WAL_UPDATE 'U'
+#define STORAGE_WAL_DELETE 'D'
+
+// Применение записи при восстановлении: json - объект станции (строка завершена нулем),
+// segment - номер сегмента, в котором лежит запись
+typedef int (*storage_wal_apply_fn)(char op, const char *json, unsigned long segment, void *ctx);
+
+// Открытие: восстановление существующих сегментов через apply и запуск
+// потока записи. Возвращает число восстановленных записей (-1 - ошибка,
+// в том числе поврежденный или нечитаемый сегмент в середине журнала)
+int storage_wal_open(const char *prefix, int commit_ms, storage_wal_apply_fn apply, void *ctx);
+void storage_wal_close(void);
+
+// Добавление записи в буфер (порядок записей - порядок вызовов).
+// Возвращает номер записи для storage_wal_commit (0 - ошибка)
+unsigned long long storage_wal_append(char op, const char *json, size_t length);
+
+// Ожидание, пока запись и все предыдущие окажутся на диске
+int storage_wal_commit(unsigned long long lsn);
+
+// Начало нового сегмента; записи до него покрываются снимком, собранным
+// без параллельных добавлений. Возвращает номер нового сегмента (0 - ошибка)
+unsigned long storage_wal_rotate(void);
+
+// Удаление сегментов с номерами меньше segment (после записи снимка)
+void storage_wal_remove_before(unsigned long segment);
+
+// Объем журнала с момента последней ротации
+size_t storage_wal_size(void);
+
+#endif // STORAGE_WAL_H